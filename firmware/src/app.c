@@ -31,9 +31,20 @@
 #include "app.h"
 
 #include "definitions.h"
+#include "bench.h"
 #include "cmd_task.h"
+#include "delta_image.h"
 #include "dir_reader.h"
+#include "image_cache.h"
+#include "job.h"
+#include "line_reader.h"
+#include "prof.h"
+#include "sched.h"
+#include "station.h"
+#include "trace.h"
+#include "winc_bus.h"
 #include "winc_cloner.h"
+#include "winc_gang.h"
 #include <stdbool.h>
 
 // *****************************************************************************
@@ -42,13 +53,20 @@
 #define APP_STATES(M)                                                          \
   M(APP_STATE_IDLE)                                                            \
   M(APP_STATE_AWAIT_FILESYSTEM)                                                \
-  M(APP_STATE_PROCESSING_COMMANDS)                                             \
   M(APP_STATE_SUCCESS)                                                         \
   M(APP_STATE_ERROR)
 
 #define EXPAND_STATE_IDS(_name) _name,
 typedef enum { APP_STATES(EXPAND_STATE_IDS) } app_state_t;
 
+// How long to wait between attempts to mount the SD card.
+#define MOUNT_RETRY_MS 50
+
+// Print a progress dot every this many mount attempts (once a second).
+#define MOUNT_DOT_INTERVAL (1000 / MOUNT_RETRY_MS)
+
+#define APP_TASK_PRIORITY 1
+
 typedef struct {
   app_state_t state;
   uint32_t mount_retries;
@@ -67,6 +85,11 @@ static void set_state(app_state_t state);
  */
 static const char *state_name(app_state_t state);
 
+/**
+ * @brief Step the app's state machine.  Registered as a sched task.
+ */
+static void app_step(void);
+
 // *****************************************************************************
 // Private (static) storage
 
@@ -84,12 +107,37 @@ void APP_Initialize(void) {
   s_app_ctx.state = APP_STATE_IDLE;
   s_app_ctx.mount_retries = 0;
   APP_PrintBanner();
-  cmd_task_init();
+  sched_init();
+  sched_task_create("app", app_step, APP_TASK_PRIORITY);
   dir_reader_init();
+  line_reader_init();
+  cmd_task_init();
   winc_cloner_init();
+  image_cache_init();
+  delta_image_init();
+  bench_init();
+  winc_bus_init();
+  winc_gang_init();
+  station_init();
+  job_init();
+  prof_init();
+  trace_init();
 }
 
-void APP_Tasks(void) {
+void APP_Tasks(void) { sched_run(); }
+
+void APP_PrintBanner(void) {
+  SYS_CONSOLE_PRINT(
+      "\n\n####################"
+      "\n# winc-cloner v%s (https://github.com/rdpoor/winc-cloner)"
+      "\n####################\n",
+      WINC_IMAGER_VERSION);
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static void app_step(void) {
   switch (s_app_ctx.state) {
   case APP_STATE_IDLE: {
     // here on idle state.
@@ -112,46 +160,33 @@ void APP_Tasks(void) {
                         SYS_FS_Error());
         set_state(APP_STATE_ERROR);
       } else {
-        set_state(APP_STATE_PROCESSING_COMMANDS);
+        // hand over to the cmd_task, which runs as its own sched task.
+        cmd_task_start();
+        set_state(APP_STATE_SUCCESS);
       }
 
-    } else if (s_app_ctx.mount_retries % 10000 == 0) {
-      // waiting for file system to mount...
-      SYS_CONSOLE_MESSAGE(".");
-    }
-  } break;
-
-  case APP_STATE_PROCESSING_COMMANDS: {
-    cmd_task_step();
-    if (cmd_task_has_error()) {
-      set_state(APP_STATE_ERROR);
     } else {
-      // remain in this state processing user commands.
+      // waiting for file system to mount...
+      if (s_app_ctx.mount_retries % MOUNT_DOT_INTERVAL == 0) {
+        SYS_CONSOLE_MESSAGE(".");
+      }
+      sched_sleep_ms(MOUNT_RETRY_MS);
     }
   } break;
 
   case APP_STATE_SUCCESS: {
-    // here upon successful completion.
+    // here once the cmd_task has taken over.
+    sched_wait_ms(SCHED_FOREVER);
   } break;
 
   case APP_STATE_ERROR: {
     // here on error state
+    sched_wait_ms(SCHED_FOREVER);
   } break;
 
   } // switch
 }
 
-void APP_PrintBanner(void) {
-  SYS_CONSOLE_PRINT(
-      "\n\n####################"
-      "\n# winc-cloner v%s (https://github.com/rdpoor/winc-cloner)"
-      "\n####################\n",
-      WINC_IMAGER_VERSION);
-}
-
-// *****************************************************************************
-// Private (static) code
-
 static void set_state(app_state_t state) {
   if (s_app_ctx.state != state) {
     SYS_DEBUG_PRINT(SYS_ERROR_DEBUG,
@@ -0,0 +1,358 @@
+/**
+ * @file bench.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "bench.h"
+
+#include "definitions.h"
+#include "nmbus.h"
+#include "spi_flash.h"
+#include "spi_flash_map.h"
+#include "trace.h"
+#include "winc_cloner.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+#define STATES(M)                                                              \
+  M(BENCH_STATE_IDLE)                                                          \
+  M(BENCH_STATE_RUNNING)                                                       \
+  M(BENCH_STATE_COMPLETE)                                                      \
+  M(BENCH_STATE_ERROR)
+
+#define EXPAND_STATE_IDS(_name) _name,
+typedef enum { STATES(EXPAND_STATE_IDS) } bench_state_t;
+
+// WINC chip ID register: read for the register round trip test.
+#define WINC_CHIP_ID_REG 0x1000
+
+// WINC shared memory, also used by spi_flash as its transfer buffer.
+#define WINC_SHARED_MEM_ADDR 0xd0000
+
+// # of register reads to average over.
+#define N_REG_READS 1000
+
+// Bytes moved by each throughput test.
+#define BENCH_TOTAL_BYTES (64 * 1024ul)
+
+typedef struct {
+  const char *name;
+  bool (*run)(const char *name, size_t size);
+  size_t size;
+} bench_test_t;
+
+typedef struct {
+  bench_state_t state;
+  uint8_t idx; // index of the next test
+} bench_ctx_t;
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+static void set_state(bench_state_t state);
+
+static bool bench_reg_read(const char *name, size_t size);
+static bool bench_nm_read_block(const char *name, size_t size);
+static bool bench_nm_write_block(const char *name, size_t size);
+static bool bench_spi_flash_read(const char *name, size_t size);
+static bool bench_erase_program(const char *name, size_t size);
+static bool bench_sd_write(const char *name, size_t size);
+static bool bench_sd_read(const char *name, size_t size);
+
+/**
+ * @brief Return the current SYS_TIME count.
+ */
+static uint64_t now(void);
+
+/**
+ * @brief Print one row of the results table for n_ops operations of size
+ * bytes each that took the SYS_TIME ticks since start.
+ */
+static void print_row(const char *name,
+                      size_t size,
+                      uint32_t n_ops,
+                      uint64_t start);
+
+// *****************************************************************************
+// Private (static) storage
+
+static const bench_test_t s_tests[] = {
+    {"register read", bench_reg_read, 4},
+    {"nm_read_block", bench_nm_read_block, 256},
+    {"nm_read_block", bench_nm_read_block, 1024},
+    {"nm_read_block", bench_nm_read_block, 4096},
+    {"nm_write_block", bench_nm_write_block, 256},
+    {"nm_write_block", bench_nm_write_block, 1024},
+    {"nm_write_block", bench_nm_write_block, 4096},
+    {"spi_flash_read", bench_spi_flash_read, 256},
+    {"spi_flash_read", bench_spi_flash_read, 4096},
+    {"sector erase", bench_erase_program, FLASH_SECTOR_SZ},
+    {"SD write", bench_sd_write, 512},
+    {"SD read", bench_sd_read, 512},
+    {"SD write", bench_sd_write, 4096},
+    {"SD read", bench_sd_read, 4096},
+};
+
+#define N_TESTS (sizeof(s_tests) / sizeof(s_tests[0]))
+
+static bench_ctx_t s_bench_ctx;
+
+static uint8_t s_bench_buf[FLASH_SECTOR_SZ];
+
+static uint8_t s_saved_sector[FLASH_SECTOR_SZ];
+
+// *****************************************************************************
+// Public code
+
+void bench_init(void) { s_bench_ctx.state = BENCH_STATE_IDLE; }
+
+void bench_start(void) {
+  s_bench_ctx.idx = 0;
+  if (!winc_cloner_open_winc()) {
+    SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\nCould not open WINC");
+    set_state(BENCH_STATE_ERROR);
+    return;
+  }
+  SYS_CONSOLE_MESSAGE(
+      "\ntest                 size      ops      us/op     MB/s");
+  set_state(BENCH_STATE_RUNNING);
+}
+
+void bench_step(void) {
+  switch (s_bench_ctx.state) {
+  case BENCH_STATE_IDLE: {
+    // wait here for bench_start()
+  } break;
+
+  case BENCH_STATE_RUNNING: {
+    // one test per call
+    const bench_test_t *test = &s_tests[s_bench_ctx.idx++];
+    if (!test->run(test->name, test->size)) {
+      SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\n%s failed", test->name);
+      set_state(BENCH_STATE_ERROR);
+    } else if (s_bench_ctx.idx >= N_TESTS) {
+      SYS_FS_FileDirectoryRemove(BENCH_SCRATCH_FILENAME);
+      set_state(BENCH_STATE_COMPLETE);
+    }
+  } break;
+
+  case BENCH_STATE_COMPLETE: {
+    // here on complete state
+  } break;
+
+  case BENCH_STATE_ERROR: {
+    // here on error state
+  } break;
+  } // switch
+}
+
+bool bench_is_busy(void) { return s_bench_ctx.state == BENCH_STATE_RUNNING; }
+
+bool bench_has_error(void) { return s_bench_ctx.state == BENCH_STATE_ERROR; }
+
+// *****************************************************************************
+// Private (static) code
+
+static void set_state(bench_state_t state) {
+  if (s_bench_ctx.state != state) {
+    TRACE2(TRACE_BENCH_STATE, s_bench_ctx.state, state);
+    s_bench_ctx.state = state;
+  }
+}
+
+static bool bench_reg_read(const char *name, size_t size) {
+  uint32_t chip_id = 0;
+  uint64_t start = now();
+
+  for (int i = 0; i < N_REG_READS; i++) {
+    if (nm_read_reg_with_ret(WINC_CHIP_ID_REG, &chip_id) != M2M_SUCCESS) {
+      return false;
+    }
+  }
+  print_row(name, size, N_REG_READS, start);
+  return true;
+}
+
+static bool bench_nm_read_block(const char *name, size_t size) {
+  uint32_t n_ops = BENCH_TOTAL_BYTES / size;
+  uint64_t start = now();
+
+  for (uint32_t i = 0; i < n_ops; i++) {
+    if (nm_read_block(WINC_SHARED_MEM_ADDR, s_bench_buf, size) !=
+        M2M_SUCCESS) {
+      return false;
+    }
+  }
+  print_row(name, size, n_ops, start);
+  return true;
+}
+
+static bool bench_nm_write_block(const char *name, size_t size) {
+  uint32_t n_ops = BENCH_TOTAL_BYTES / size;
+  uint64_t start = now();
+
+  for (uint32_t i = 0; i < n_ops; i++) {
+    if (nm_write_block(WINC_SHARED_MEM_ADDR, s_bench_buf, size) !=
+        M2M_SUCCESS) {
+      return false;
+    }
+  }
+  print_row(name, size, n_ops, start);
+  return true;
+}
+
+static bool bench_spi_flash_read(const char *name, size_t size) {
+  uint32_t n_ops = BENCH_TOTAL_BYTES / size;
+  uint64_t start = now();
+
+  for (uint32_t i = 0; i < n_ops; i++) {
+    if (spi_flash_read(s_bench_buf, i * size, size) != M2M_SUCCESS) {
+      return false;
+    }
+  }
+  print_row(name, size, n_ops, start);
+  return true;
+}
+
+static bool bench_erase_program(const char *name, size_t size) {
+  // The last sector of the WINC flash serves as scratch.  Its contents are
+  // saved first and restored afterwards.
+  uint32_t addr = (spi_flash_get_size() << 17) - FLASH_SECTOR_SZ;
+  uint64_t start;
+
+  if (spi_flash_read(s_saved_sector, addr, FLASH_SECTOR_SZ) != M2M_SUCCESS) {
+    return false;
+  }
+
+  start = now();
+  if (spi_flash_erase(addr, FLASH_SECTOR_SZ) != M2M_SUCCESS) {
+    return false;
+  }
+  print_row(name, size, 1, start);
+
+  for (size_t i = 0; i < FLASH_SECTOR_SZ; i++) {
+    s_bench_buf[i] = (uint8_t)i;
+  }
+  start = now();
+  for (uint32_t offset = 0; offset < FLASH_SECTOR_SZ;
+       offset += FLASH_PAGE_SZ) {
+    if (spi_flash_write(&s_bench_buf[offset], addr + offset, FLASH_PAGE_SZ) !=
+        M2M_SUCCESS) {
+      return false;
+    }
+  }
+  print_row("page program",
+            FLASH_PAGE_SZ,
+            FLASH_SECTOR_SZ / FLASH_PAGE_SZ,
+            start);
+
+  // restore the scratch sector and check that it took
+  if ((spi_flash_erase(addr, FLASH_SECTOR_SZ) != M2M_SUCCESS) ||
+      (spi_flash_write(s_saved_sector, addr, FLASH_SECTOR_SZ) !=
+       M2M_SUCCESS) ||
+      (spi_flash_read(s_bench_buf, addr, FLASH_SECTOR_SZ) != M2M_SUCCESS) ||
+      (memcmp(s_bench_buf, s_saved_sector, FLASH_SECTOR_SZ) != 0)) {
+    SYS_DEBUG_PRINT(
+        SYS_ERROR_ERROR, "\nFailed to restore WINC sector at 0x%lx", addr);
+    return false;
+  }
+  return true;
+}
+
+static bool bench_sd_write(const char *name, size_t size) {
+  uint32_t n_ops = BENCH_TOTAL_BYTES / size;
+  SYS_FS_HANDLE handle;
+  uint64_t start;
+  bool ret = true;
+
+  handle = SYS_FS_FileOpen(BENCH_SCRATCH_FILENAME, SYS_FS_FILE_OPEN_WRITE);
+  if (handle == SYS_FS_HANDLE_INVALID) {
+    return false;
+  }
+  start = now();
+  for (uint32_t i = 0; ret && (i < n_ops); i++) {
+    ret = SYS_FS_FileWrite(handle, s_bench_buf, size) == (int32_t)size;
+  }
+  // include the time to flush the data to the card
+  ret = ret && (SYS_FS_FileSync(handle) == SYS_FS_RES_SUCCESS);
+  if (ret) {
+    print_row(name, size, n_ops, start);
+  }
+  SYS_FS_FileClose(handle);
+  return ret;
+}
+
+static bool bench_sd_read(const char *name, size_t size) {
+  uint32_t n_ops = BENCH_TOTAL_BYTES / size;
+  SYS_FS_HANDLE handle;
+  uint64_t start;
+  bool ret = true;
+
+  handle = SYS_FS_FileOpen(BENCH_SCRATCH_FILENAME, SYS_FS_FILE_OPEN_READ);
+  if (handle == SYS_FS_HANDLE_INVALID) {
+    return false;
+  }
+  start = now();
+  for (uint32_t i = 0; ret && (i < n_ops); i++) {
+    ret = SYS_FS_FileRead(handle, s_bench_buf, size) == (int32_t)size;
+  }
+  if (ret) {
+    print_row(name, size, n_ops, start);
+  }
+  SYS_FS_FileClose(handle);
+  return ret;
+}
+
+static uint64_t now(void) { return SYS_TIME_Counter64Get(); }
+
+static void print_row(const char *name,
+                      size_t size,
+                      uint32_t n_ops,
+                      uint64_t start) {
+  uint64_t us = (now() - start) * 1000000 / SYS_TIME_FrequencyGet();
+  uint64_t us_per_op_x10 = us * 10 / n_ops;
+  // bytes per microsecond == MB/s
+  uint64_t milli_mbps = (us == 0) ? 0 : (uint64_t)size * n_ops * 1000 / us;
+
+  SYS_CONSOLE_PRINT("\n%-16s %8u %8lu %8lu.%01lu %4lu.%03lu",
+                    name,
+                    size,
+                    n_ops,
+                    (uint32_t)(us_per_op_x10 / 10),
+                    (uint32_t)(us_per_op_x10 % 10),
+                    (uint32_t)(milli_mbps / 1000),
+                    (uint32_t)(milli_mbps % 1000));
+}
+
+// *****************************************************************************
+// End of file
@@ -0,0 +1,94 @@
+/**
+ * @file bench.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief bench measures each subsystem that winc_cloner depends on in
+ * isolation and prints a table of the results.
+ *
+ * The tests cover the raw WINC SPI register round trip, nm_read_block() and
+ * nm_write_block() into WINC shared memory, spi_flash_read(), sector erase
+ * and page program on a scratch sector (whose contents are saved and
+ * restored) and SD card sequential write and read through a scratch file.
+ * Each call to bench_step() runs one test so the rest of the system keeps
+ * running.
+ */
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stdbool.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+#define BENCH_SCRATCH_FILENAME "bench.tmp"
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Initialize the bench module.  Called once at startup.
+ */
+void bench_init(void);
+
+/**
+ * @brief Start running the benchmarks.  The work is done in bench_step().
+ */
+void bench_start(void);
+
+/**
+ * @brief Run the next benchmark.  Called frequently.
+ */
+void bench_step(void);
+
+/**
+ * @brief Return true if the benchmarks are running.
+ */
+bool bench_is_busy(void);
+
+/**
+ * @brief Return true if the last run failed.
+ */
+bool bench_has_error(void);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _BENCH_H_ */
@@ -0,0 +1,219 @@
+/**
+ * @file bus_capture.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "bus_capture.h"
+
+#include "definitions.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+typedef struct {
+  SYS_FS_HANDLE handle;
+  bus_capture_header_t header;
+  uint32_t begin_ticks;    // start of the current transaction
+  uint32_t excluded_ticks; // flush time so far, subtracted from timestamps
+  uint16_t n_buffered;     // # of records in s_records
+  bool has_error;          // a write failed: records are being dropped
+} bus_capture_ctx_t;
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+/**
+ * @brief Return true if rec can fold in one more of the given transaction.
+ */
+static bool is_repeat(const bus_capture_record_t *rec,
+                      bus_capture_type_t type,
+                      uint32_t addr,
+                      uint32_t value,
+                      uint16_t size,
+                      int8_t result);
+
+/**
+ * @brief Write the buffered records to the file and empty the buffer.  The
+ * time taken is left out of the timeline.
+ */
+static void flush(void);
+
+// *****************************************************************************
+// Public storage
+
+bool bus_capture_is_on;
+
+uint32_t bus_capture_polls;
+
+// *****************************************************************************
+// Private (static) storage
+
+static bus_capture_record_t s_records[BUS_CAPTURE_N_BUFFERED];
+
+static bus_capture_ctx_t s_bus_capture_ctx;
+
+// *****************************************************************************
+// Public code
+
+bool bus_capture_start(const char *filename) {
+  bus_capture_ctx_t *ctx = &s_bus_capture_ctx;
+
+  if (bus_capture_is_on) {
+    return false;
+  }
+  ctx->header.magic = BUS_CAPTURE_MAGIC;
+  ctx->header.version = BUS_CAPTURE_VERSION;
+  ctx->header.record_size = sizeof(bus_capture_record_t);
+  ctx->header.ticks_per_sec = SYS_TIME_FrequencyGet();
+  ctx->header.n_records = 0;
+  ctx->header.n_transactions = 0;
+  ctx->header.flush_ticks = 0;
+  ctx->excluded_ticks = 0;
+  ctx->n_buffered = 0;
+  ctx->has_error = false;
+
+  ctx->handle = SYS_FS_FileOpen(filename, SYS_FS_FILE_OPEN_WRITE);
+  if (ctx->handle == SYS_FS_HANDLE_INVALID) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nCould not open %s", filename);
+    return false;
+  }
+  // The header is rewritten with the final counts by bus_capture_stop().
+  if (SYS_FS_FileWrite(ctx->handle, &ctx->header, sizeof(ctx->header)) !=
+      sizeof(ctx->header)) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nCould not write %s", filename);
+    SYS_FS_FileClose(ctx->handle);
+    return false;
+  }
+  bus_capture_is_on = true;
+  return true;
+}
+
+int32_t bus_capture_stop(void) {
+  bus_capture_ctx_t *ctx = &s_bus_capture_ctx;
+  bool ret;
+
+  if (!bus_capture_is_on) {
+    return -1;
+  }
+  bus_capture_is_on = false;
+  flush();
+  ret = !ctx->has_error &&
+        (SYS_FS_FileSeek(ctx->handle, 0, SYS_FS_SEEK_SET) == 0) &&
+        (SYS_FS_FileWrite(ctx->handle, &ctx->header, sizeof(ctx->header)) ==
+         sizeof(ctx->header));
+  SYS_FS_FileClose(ctx->handle);
+  if (!ret) {
+    SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\nCould not write the bus capture");
+    return -1;
+  }
+  return ctx->header.n_transactions;
+}
+
+void bus_capture_begin(void) {
+  bus_capture_polls = 0;
+  s_bus_capture_ctx.begin_ticks = SYS_TIME_CounterGet();
+}
+
+void bus_capture_end(bus_capture_type_t type,
+                     uint32_t addr,
+                     uint32_t value,
+                     uint16_t size,
+                     int8_t result) {
+  bus_capture_ctx_t *ctx = &s_bus_capture_ctx;
+  uint32_t duration = SYS_TIME_CounterGet() - ctx->begin_ticks;
+  uint32_t polls = (bus_capture_polls > UINT16_MAX) ? UINT16_MAX
+                                                      : bus_capture_polls;
+  bus_capture_record_t *rec;
+
+  ctx->header.n_transactions += 1;
+  if (ctx->n_buffered > 0) {
+    rec = &s_records[ctx->n_buffered - 1];
+    if (is_repeat(rec, type, addr, value, size, result) &&
+        (rec->polls <= UINT16_MAX - polls)) {
+      rec->repeat += 1;
+      rec->duration += duration;
+      rec->polls += polls;
+      return;
+    }
+  }
+  rec = &s_records[ctx->n_buffered++];
+  rec->ticks = ctx->begin_ticks - ctx->excluded_ticks;
+  rec->duration = duration;
+  rec->addr = addr;
+  rec->value = value;
+  rec->size = size;
+  rec->type = type;
+  rec->result = result;
+  rec->repeat = 1;
+  rec->polls = polls;
+  if (ctx->n_buffered == BUS_CAPTURE_N_BUFFERED) {
+    flush();
+  }
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static bool is_repeat(const bus_capture_record_t *rec,
+                      bus_capture_type_t type,
+                      uint32_t addr,
+                      uint32_t value,
+                      uint16_t size,
+                      int8_t result) {
+  return (rec->type == type) && (rec->addr == addr) &&
+         (rec->value == value) && (rec->size == size) &&
+         (rec->result == result) && (rec->repeat < UINT16_MAX);
+}
+
+static void flush(void) {
+  bus_capture_ctx_t *ctx = &s_bus_capture_ctx;
+  size_t n_bytes = ctx->n_buffered * sizeof(bus_capture_record_t);
+  uint32_t t0 = SYS_TIME_CounterGet();
+  uint32_t elapsed;
+
+  if ((n_bytes == 0) || ctx->has_error) {
+    ctx->n_buffered = 0;
+    return;
+  }
+  if (SYS_FS_FileWrite(ctx->handle, s_records, n_bytes) != n_bytes) {
+    // keep counting, but the file is no longer complete
+    ctx->has_error = true;
+  } else {
+    ctx->header.n_records += ctx->n_buffered;
+  }
+  ctx->n_buffered = 0;
+  elapsed = SYS_TIME_CounterGet() - t0;
+  ctx->excluded_ticks += elapsed;
+  ctx->header.flush_ticks += elapsed;
+}
+
+// *****************************************************************************
+// End of file
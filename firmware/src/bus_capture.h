@@ -0,0 +1,174 @@
+/**
+ * @file bus_capture.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief bus_capture records every WINC bus transaction to the SD card.
+ *
+ * While a capture is running, nmbus.c records each register read and write
+ * and each block transfer (in chunks of at most 2040 bytes, as they go over
+ * the bus): its type, address, register value, size, result, start time and
+ * duration, and how many response bytes nmspi.c polled for.  Consecutive
+ * identical transactions (a poll loop reading the same register and getting
+ * the same value) are folded into one record with a repeat count.
+ *
+ * Records are buffered in RAM and written to the file when the buffer fills.
+ * That happens between two transactions, never inside one; the time spent
+ * writing is left out of the recorded timeline, so the capture shows the bus
+ * as it would run without capturing.  Block contents are not captured.
+ *
+ * tools/winc_sim's winc_sim_replay feeds a capture into the simulated WINC
+ * and compares the recorded latencies and poll counts with the model.
+ *
+ * The file is a bus_capture_header_t followed by n_records
+ * bus_capture_record_t, stored little-endian.  This header depends only on
+ * stdint.h so it can be shared with host tools.
+ */
+
+#ifndef _BUS_CAPTURE_H_
+#define _BUS_CAPTURE_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+#define BUS_CAPTURE_TYPES(M)                                                   \
+  M(BUS_CAPTURE_REG_READ, "reg read")                                          \
+  M(BUS_CAPTURE_REG_WRITE, "reg write")                                        \
+  M(BUS_CAPTURE_BLOCK_READ, "block read")                                      \
+  M(BUS_CAPTURE_BLOCK_WRITE, "block write")
+
+#define EXPAND_BUS_CAPTURE_IDS(_id, _name) _id,
+typedef enum {
+  BUS_CAPTURE_TYPES(EXPAND_BUS_CAPTURE_IDS) BUS_CAPTURE_N_TYPES
+} bus_capture_type_t;
+
+#define BUS_CAPTURE_MAGIC 0x43535542 // "BUSC" when read as little-endian bytes
+#define BUS_CAPTURE_VERSION 1
+#define BUS_CAPTURE_NAME "capture.bin"
+
+// # of records buffered in RAM between writes to the card.
+#define BUS_CAPTURE_N_BUFFERED 256
+
+typedef struct {
+  uint32_t ticks;    // SYS_TIME_CounterGet() at the start of the first repeat
+  uint32_t duration; // ticks spent in the transaction, summed over repeats
+  uint32_t addr;     // WINC address
+  uint32_t value;    // register value written or read; 0 for blocks
+  uint16_t size;     // # of bytes transferred (4 for registers)
+  uint8_t type;      // bus_capture_type_t
+  int8_t result;     // M2M_SUCCESS or an M2M_ERR_* code
+  uint16_t repeat;   // # of identical consecutive transactions
+  uint16_t polls;    // response bytes polled for, summed over repeats
+} bus_capture_record_t;
+
+typedef struct {
+  uint32_t magic;          // BUS_CAPTURE_MAGIC
+  uint16_t version;        // BUS_CAPTURE_VERSION
+  uint16_t record_size;    // sizeof(bus_capture_record_t)
+  uint32_t ticks_per_sec;  // SYS_TIME_FrequencyGet()
+  uint32_t n_records;      // # of bus_capture_record_t that follow
+  uint32_t n_transactions; // # of transactions, counting repeats
+  uint32_t flush_ticks;    // time spent writing, left out of the timeline
+} bus_capture_header_t;
+
+#define BUS_CAPTURE_BEGIN()                                                    \
+  do {                                                                         \
+    if (bus_capture_is_on) {                                                   \
+      bus_capture_begin();                                                     \
+    }                                                                          \
+  } while (0)
+
+#define BUS_CAPTURE_END(type, addr, value, size, result)                       \
+  do {                                                                         \
+    if (bus_capture_is_on) {                                                   \
+      bus_capture_end((type), (addr), (value), (size), (result));              \
+    }                                                                          \
+  } while (0)
+
+#define BUS_CAPTURE_POLL() (bus_capture_polls += 1)
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief True while a capture is running.  Tested by BUS_CAPTURE_BEGIN()
+ * and BUS_CAPTURE_END().
+ */
+extern bool bus_capture_is_on;
+
+/**
+ * @brief Response bytes polled for since bus_capture_begin().  Incremented
+ * by BUS_CAPTURE_POLL().
+ */
+extern uint32_t bus_capture_polls;
+
+/**
+ * @brief Create filename on the SD card and start capturing into it.
+ * Return false if a capture is already running or the file can't be created.
+ */
+bool bus_capture_start(const char *filename);
+
+/**
+ * @brief Write out the buffered records, finish the header and close the
+ * file.  Return the number of transactions captured, or -1 on error.
+ */
+int32_t bus_capture_stop(void);
+
+/**
+ * @brief Mark the start of a transaction.  Called by BUS_CAPTURE_BEGIN().
+ */
+void bus_capture_begin(void);
+
+/**
+ * @brief Record the transaction begun by bus_capture_begin().  Called by
+ * BUS_CAPTURE_END().
+ */
+void bus_capture_end(bus_capture_type_t type,
+                     uint32_t addr,
+                     uint32_t value,
+                     uint16_t size,
+                     int8_t result);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _BUS_CAPTURE_H_ */
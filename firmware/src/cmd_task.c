@@ -31,18 +31,44 @@
 #include "cmd_task.h"
 
 #include "app.h"
+#include "bench.h"
+#include "bus_capture.h"
 #include "definitions.h"
+#include "delta_image.h"
 #include "dir_reader.h"
+#include "flash_regions.h"
+#include "image_cache.h"
+#include "job.h"
 #include "line_reader.h"
+#include "prof.h"
+#include "sched.h"
+#include "station.h"
+#include "trace.h"
+#include "uart_stream.h"
 #include "winc_cloner.h"
+#include "winc_gang.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 // *****************************************************************************
 // Private types and definitions
 
+#define MAX_ARGS 3
+#define MAX_ARGS_LENGTH 100
+
+#define CATALOG_PAGE_SIZE 10
+
+#define ESC_KEY 0x1b
+
+// How often to poll the console while waiting for a command.
+#define COMMAND_POLL_MS 10
+
+#define CMD_TASK_PRIORITY 1
+
 #define STATES(M)                                                              \
+  M(CMD_TASK_STATE_AWAIT_START)                                                \
   M(CMD_TASK_STATE_INIT)                                                       \
   M(CMD_TASK_STATE_PRINTING_HELP)                                              \
   M(CMD_TASK_STATE_READING_DIRECTORY)                                          \
@@ -52,6 +78,23 @@
   M(CMD_TASK_STATE_START_UPDATING)                                             \
   M(CMD_TASK_STATE_START_COMPARING)                                            \
   M(CMD_TASK_STATE_START_REBUILDING)                                           \
+  M(CMD_TASK_STATE_START_MAKING_DELTA)                                         \
+  M(CMD_TASK_STATE_START_PATCHING)                                             \
+  M(CMD_TASK_STATE_START_SLOT_UPDATING)                                        \
+  M(CMD_TASK_STATE_START_STAGING)                                              \
+  M(CMD_TASK_STATE_START_GANG_UPDATING)                                        \
+  M(CMD_TASK_STATE_START_STATION)                                              \
+  M(CMD_TASK_STATE_START_JOB)                                                  \
+  M(CMD_TASK_STATE_START_STREAMING)                                            \
+  M(CMD_TASK_STATE_SELECTING_REGIONS)                                          \
+  M(CMD_TASK_STATE_RUNNING_CLONER)                                             \
+  M(CMD_TASK_STATE_RUNNING_BENCH)                                              \
+  M(CMD_TASK_STATE_RUNNING_GANG)                                               \
+  M(CMD_TASK_STATE_RUNNING_DELTA)                                              \
+  M(CMD_TASK_STATE_RUNNING_STAGING)                                            \
+  M(CMD_TASK_STATE_RUNNING_STATION)                                            \
+  M(CMD_TASK_STATE_RUNNING_JOB)                                                \
+  M(CMD_TASK_STATE_RUNNING_STREAM)                                             \
   M(CMD_TASK_STATE_ERROR)
 
 #define EXPAND_STATE_IDS(_name) _name,
@@ -59,6 +102,9 @@ typedef enum { STATES(EXPAND_STATE_IDS) } cmd_task_state_t;
 
 typedef struct {
   cmd_task_state_t state;
+  sched_task_id_t task;
+  uint16_t catalog_page; // page of the image catalog to list
+  bool catalog_is_stale; // true if the directory may have changed
 } cmd_task_ctx_t;
 
 // *****************************************************************************
@@ -70,69 +116,137 @@ typedef struct {
 static void set_state(cmd_task_state_t state);
 
 /**
- * @brief Return the name of the given state.
+ * @brief Wake the cmd_task when the dir_reader or line_reader completes.
  */
-static const char *state_name(cmd_task_state_t state);
+static void wake_task(uintptr_t arg);
 
 static void flush_serial_input(void);
 
 static uint8_t downcase(uint8_t ch);
 
-// *****************************************************************************
-// Private (static) storage
+/**
+ * @brief Split line into at most MAX_ARGS whitespace separated words.
+ *
+ * The words are copied into private storage and remain valid until the next
+ * call.  Returns the number of words found, or -1 if there are more than
+ * MAX_ARGS.
+ */
+static int split_args(const char *line, char *argv[]);
 
-#define EXPAND_STATE_NAMES(_name) #_name,
-static const char *s_state_names[] = {STATES(EXPAND_STATE_NAMES)};
+/**
+ * @brief Print one page of the image catalog.
+ */
+static void list_catalog_page(void);
 
-#define N_STATES (sizeof(s_state_names) / sizeof(s_state_names[0]))
+/**
+ * @brief Await the winc_cloner operation if it started.
+ */
+static void start_cloner(bool started);
+
+/**
+ * @brief List the flash regions and prompt for a selection.
+ */
+static void print_regions_prompt(void);
+
+// *****************************************************************************
+// Private (static) storage
 
 static cmd_task_ctx_t s_cmd_task_ctx;
 
+static char s_args[MAX_ARGS_LENGTH];
+
 // *****************************************************************************
 // Public code
 
-void cmd_task_init(void) { s_cmd_task_ctx.state = CMD_TASK_STATE_INIT; }
+void cmd_task_init(void) {
+  s_cmd_task_ctx.state = CMD_TASK_STATE_AWAIT_START;
+  s_cmd_task_ctx.catalog_page = 0;
+  s_cmd_task_ctx.catalog_is_stale = true;
+  s_cmd_task_ctx.task =
+      sched_task_create("cmd_task", cmd_task_step, CMD_TASK_PRIORITY);
+  dir_reader_set_callback(wake_task, 0);
+  line_reader_set_callback(wake_task, 0);
+}
+
+void cmd_task_start(void) {
+  set_state(CMD_TASK_STATE_INIT);
+  sched_signal(s_cmd_task_ctx.task, 1);
+}
 
 /**
- * @brief Step the demo task internal state.  Called frequently.
+ * @brief Step the cmd_task internal state.  Registered as a sched task.
  */
 void cmd_task_step(void) {
+  (void)sched_take_events();
   switch (s_cmd_task_ctx.state) {
+  case CMD_TASK_STATE_AWAIT_START: {
+    // wait here for the SD card to mount and a call to cmd_task_start()
+    sched_wait_ms(SCHED_FOREVER);
+  } break;
+
   case CMD_TASK_STATE_INIT: {
-    // here on idle state.
-    set_state(CMD_TASK_STATE_PRINTING_HELP);
+    // here on idle state.  Run the autorun job, if there is one, otherwise
+    // finish any update that was interrupted.
+    if (job_autorun()) {
+      set_state(CMD_TASK_STATE_RUNNING_JOB);
+    } else {
+      start_cloner(winc_cloner_resume_update());
+    }
   } break;
 
   case CMD_TASK_STATE_PRINTING_HELP: {
     APP_PrintBanner();
-    dir_reader_read_directory();
-    set_state(CMD_TASK_STATE_READING_DIRECTORY);
+    if (s_cmd_task_ctx.catalog_is_stale) {
+      dir_reader_read_directory();
+      set_state(CMD_TASK_STATE_READING_DIRECTORY);
+    } else {
+      set_state(CMD_TASK_STATE_LISTING_DIRECTORY);
+    }
   } break;
 
   case CMD_TASK_STATE_READING_DIRECTORY: {
-    dir_reader_step();
     if (dir_reader_is_complete()) {
+      s_cmd_task_ctx.catalog_is_stale = false;
       set_state(CMD_TASK_STATE_LISTING_DIRECTORY);
     } else if (dir_reader_has_error()) {
       set_state(CMD_TASK_STATE_ERROR);
     } else {
-      // remain in this state until dir_reader completes
+      // remain in this state until dir_reader's callback wakes this task
+      sched_wait_ms(SCHED_FOREVER);
     }
   } break;
 
   case CMD_TASK_STATE_LISTING_DIRECTORY: {
     // Here when dir_reader has completed successfully
-    uint8_t count = dir_reader_filename_count();
-    SYS_CONSOLE_PRINT("\nFound %d file%s", count, count == 1 ? "" : "s");
-    for (uint8_t idx = 0; idx < count; idx++) {
-      SYS_CONSOLE_PRINT("\n   %s", dir_reader_filename_ref(idx));
+    list_catalog_page();
+    if (image_cache_is_valid()) {
+      SYS_CONSOLE_PRINT("\n   %s (cached copy of %s)",
+                        IMAGE_CACHE_NAME,
+                        image_cache_image_name());
     }
     SYS_CONSOLE_MESSAGE("\nCommands:"
-                        "\nh: print this help"
+                        "\nh: print this help (and rescan the card)"
+                        "\nl: list the next page of images"
                         "\ne: extract WINC firmware to a file"
                         "\nu: update WINC firmware from a file"
+                        "\nw: write firmware to the spare OTA slot and boot it"
+                        "\ns: update WINC firmware streamed from the host"
+                        "\nm: update every WINC on the bus from a file"
+                        "\na: station mode: update each WINC inserted"
+                        "\nj: run a job script"
                         "\nc: compare WINC firmware against a file"
                         "\nr: recompute / rebuild WINC PLL tables"
+                        "\no: select the flash regions to work on"
+                        "\nq: toggle the quick up-to-date check before u"
+                        "\nk: toggle booting the WINC to check u, w, s and a"
+                        "\nd: make a delta file between two images"
+                        "\np: patch WINC firmware from a delta file"
+                        "\ng: stage an image file into the internal cache"
+                        "\nb: benchmark the WINC and SD subsystems"
+                        "\nf: print (and clear) the driver profile"
+                        "\nt: write (and clear) the trace log to trace.bin"
+                        "\nv: toggle echoing the trace log to the console"
+                        "\nx: start / stop capturing WINC bus transactions"
                         "\n> ");
     flush_serial_input();
     set_state(CMD_TASK_STATE_AWAIT_COMMAND);
@@ -151,8 +265,13 @@ void cmd_task_step(void) {
     } else if (n_read > 0) {
       switch (downcase(buf[0])) {
       case 'h':
+        s_cmd_task_ctx.catalog_is_stale = true;
         set_state(CMD_TASK_STATE_PRINTING_HELP);
         break;
+      case 'l':
+        s_cmd_task_ctx.catalog_page += 1;
+        set_state(CMD_TASK_STATE_LISTING_DIRECTORY);
+        break;
       case 'e':
         line_reader_start();
         SYS_CONSOLE_MESSAGE("extract WINC firmware into filename: ");
@@ -163,27 +282,128 @@ void cmd_task_step(void) {
         SYS_CONSOLE_MESSAGE("update WINC firmware from filename: ");
         set_state(CMD_TASK_STATE_START_UPDATING);
         break;
+      case 'w':
+        line_reader_start();
+        SYS_CONSOLE_MESSAGE("write spare WINC firmware slot from filename: ");
+        set_state(CMD_TASK_STATE_START_SLOT_UPDATING);
+        break;
+      case UART_STREAM_COMMAND:
+        SYS_CONSOLE_PRINT("update WINC firmware streamed from the host at %d "
+                          "baud\n",
+                          UART_STREAM_BAUD);
+        uart_stream_listen();
+        set_state(CMD_TASK_STATE_START_STREAMING);
+        break;
+      case 'm':
+        line_reader_start();
+        SYS_CONSOLE_MESSAGE("update every WINC slot from filename: ");
+        set_state(CMD_TASK_STATE_START_GANG_UPDATING);
+        break;
+      case 'a':
+        line_reader_start();
+        SYS_CONSOLE_MESSAGE("station mode: update each WINC from filename: ");
+        set_state(CMD_TASK_STATE_START_STATION);
+        break;
+      case 'j':
+        line_reader_start();
+        SYS_CONSOLE_MESSAGE("run job script from filename: ");
+        set_state(CMD_TASK_STATE_START_JOB);
+        break;
       case 'c':
         line_reader_start();
         SYS_CONSOLE_MESSAGE("compare WINC firmware against filename: ");
         set_state(CMD_TASK_STATE_START_COMPARING);
         break;
+      case 'o':
+        print_regions_prompt();
+        line_reader_start();
+        set_state(CMD_TASK_STATE_SELECTING_REGIONS);
+        break;
+      case 'q':
+        winc_cloner_set_quick_check(!winc_cloner_get_quick_check());
+        SYS_CONSOLE_PRINT("quick check %s",
+                          winc_cloner_get_quick_check() ? "on" : "off");
+        set_state(CMD_TASK_STATE_PRINTING_HELP);
+        break;
+      case 'k':
+        winc_cloner_set_boot_check(!winc_cloner_get_boot_check());
+        SYS_CONSOLE_PRINT("boot check %s",
+                          winc_cloner_get_boot_check() ? "on" : "off");
+        set_state(CMD_TASK_STATE_PRINTING_HELP);
+        break;
       case 'r':
         SYS_CONSOLE_MESSAGE("recompute / rebuild WINC PLL tables");
         set_state(CMD_TASK_STATE_START_REBUILDING);
         break;
+      case 'd':
+        line_reader_start();
+        SYS_CONSOLE_MESSAGE("make delta from base, target, delta filenames: ");
+        set_state(CMD_TASK_STATE_START_MAKING_DELTA);
+        break;
+      case 'p':
+        line_reader_start();
+        SYS_CONSOLE_MESSAGE("patch WINC firmware from delta filename: ");
+        set_state(CMD_TASK_STATE_START_PATCHING);
+        break;
+      case 'g':
+        line_reader_start();
+        SYS_CONSOLE_MESSAGE("stage into internal cache from filename: ");
+        set_state(CMD_TASK_STATE_START_STAGING);
+        break;
+      case 'b':
+        SYS_CONSOLE_MESSAGE("benchmark WINC and SD subsystems");
+        bench_start();
+        set_state(CMD_TASK_STATE_RUNNING_BENCH);
+        break;
+      case 'f':
+        SYS_CONSOLE_MESSAGE("driver profile since the last 'f'");
+        prof_print();
+        prof_reset();
+        set_state(CMD_TASK_STATE_PRINTING_HELP);
+        break;
+      case 't': {
+        int32_t n_written = trace_dump(TRACE_DUMP_NAME);
+        if (n_written >= 0) {
+          SYS_CONSOLE_PRINT(
+              "wrote %ld trace events to %s", n_written, TRACE_DUMP_NAME);
+          trace_reset();
+          s_cmd_task_ctx.catalog_is_stale = true;
+        }
+        set_state(CMD_TASK_STATE_PRINTING_HELP);
+      } break;
+      case 'v':
+        trace_set_echo(!trace_is_echoing());
+        SYS_CONSOLE_PRINT("trace echo %s", trace_is_echoing() ? "on" : "off");
+        set_state(CMD_TASK_STATE_PRINTING_HELP);
+        break;
+      case 'x':
+        if (!bus_capture_is_on) {
+          if (bus_capture_start(BUS_CAPTURE_NAME)) {
+            SYS_CONSOLE_PRINT("capturing WINC bus transactions to %s",
+                              BUS_CAPTURE_NAME);
+          }
+        } else {
+          int32_t n_captured = bus_capture_stop();
+          if (n_captured >= 0) {
+            SYS_CONSOLE_PRINT("captured %ld WINC bus transactions to %s",
+                              n_captured,
+                              BUS_CAPTURE_NAME);
+          }
+          s_cmd_task_ctx.catalog_is_stale = true;
+        }
+        set_state(CMD_TASK_STATE_PRINTING_HELP);
+        break;
       default:
         SYS_CONSOLE_PRINT("\nUnrecognized command '%c'", buf[0]);
         set_state(CMD_TASK_STATE_PRINTING_HELP);
       }
     } else {
-      // no bytes read -- remain in this state.
+      // no bytes read -- remain in this state, but don't spin.
+      sched_sleep_ms(COMMAND_POLL_MS);
     }
   } break;
 
   case CMD_TASK_STATE_START_EXTRACTING: {
-    line_reader_step();
-
     if (line_reader_has_error()) {
       SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\ncould not read filename");
       set_state(CMD_TASK_STATE_PRINTING_HELP);  // restart...
@@ -191,17 +411,16 @@ void cmd_task_step(void) {
     } else if (line_reader_succeeded()) {
       const char *filename = line_reader_get_line();
       SYS_CONSOLE_PRINT("\nExtracting WINC firmware into %s", filename);
-      winc_cloner_extract(filename);
-      set_state(CMD_TASK_STATE_PRINTING_HELP);
+      s_cmd_task_ctx.catalog_is_stale = true;
+      start_cloner(winc_cloner_extract(filename));
 
     } else {
-      // remain in this state until line_reader completes.
+      // remain in this state until line_reader's callback wakes this task
+      sched_wait_ms(SCHED_FOREVER);
     }
   } break;
 
   case CMD_TASK_STATE_START_UPDATING: {
-    line_reader_step();
-
     if (line_reader_has_error()) {
       SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\ncould not read filename");
       set_state(CMD_TASK_STATE_PRINTING_HELP);  // restart...
@@ -209,17 +428,16 @@ void cmd_task_step(void) {
     } else if (line_reader_succeeded()) {
       const char *filename = line_reader_get_line();
       SYS_CONSOLE_PRINT("\nUpdating WINC firmware from %s", filename);
-      winc_cloner_update(filename);
-      set_state(CMD_TASK_STATE_PRINTING_HELP);
+      s_cmd_task_ctx.catalog_is_stale = true; // may have written a manifest
+      start_cloner(winc_cloner_update(filename));
 
     } else {
-      // remain in this state until line_reader completes.
+      // remain in this state until line_reader's callback wakes this task
+      sched_wait_ms(SCHED_FOREVER);
     }
   } break;
 
   case CMD_TASK_STATE_START_COMPARING: {
-    line_reader_step();
-
     if (line_reader_has_error()) {
       SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\ncould not read filename");
       set_state(CMD_TASK_STATE_PRINTING_HELP);  // restart...
@@ -227,11 +445,11 @@ void cmd_task_step(void) {
     } else if (line_reader_succeeded()) {
       const char *filename = line_reader_get_line();
       SYS_CONSOLE_PRINT("\nComparing WINC firmware against %s", filename);
-      winc_cloner_compare(filename);
-      set_state(CMD_TASK_STATE_PRINTING_HELP);
+      start_cloner(winc_cloner_compare(filename));
 
     } else {
-      // remain in this state until line_reader completes.
+      // remain in this state until line_reader's callback wakes this task
+      sched_wait_ms(SCHED_FOREVER);
     }
   } break;
 
@@ -241,33 +459,395 @@ void cmd_task_step(void) {
     set_state(CMD_TASK_STATE_PRINTING_HELP);
   } break;
 
+  case CMD_TASK_STATE_START_MAKING_DELTA: {
+    if (line_reader_has_error()) {
+      SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\ncould not read filenames");
+      set_state(CMD_TASK_STATE_PRINTING_HELP);  // restart...
+
+    } else if (line_reader_succeeded()) {
+      char *argv[MAX_ARGS];
+      bool started = false;
+      int argc = split_args(line_reader_get_line(), argv);
+      if (argc < 0) {
+        SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\nToo many arguments");
+      }
+      if (argc != MAX_ARGS) {
+        SYS_CONSOLE_MESSAGE("\nexpected: base.img target.img delta.dlt");
+      } else {
+        SYS_CONSOLE_PRINT(
+            "\nMaking delta %s from %s to %s", argv[2], argv[0], argv[1]);
+        s_cmd_task_ctx.catalog_is_stale = true;
+        started = delta_image_make(argv[0], argv[1], argv[2]);
+      }
+      if (started) {
+        SYS_CONSOLE_MESSAGE(" (ESC to cancel)");
+        set_state(CMD_TASK_STATE_RUNNING_DELTA);
+      } else {
+        set_state(CMD_TASK_STATE_PRINTING_HELP);
+      }
+
+    } else {
+      // remain in this state until line_reader's callback wakes this task
+      sched_wait_ms(SCHED_FOREVER);
+    }
+  } break;
+
+  case CMD_TASK_STATE_START_SLOT_UPDATING: {
+    if (line_reader_has_error()) {
+      SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\ncould not read filename");
+      set_state(CMD_TASK_STATE_PRINTING_HELP);  // restart...
+
+    } else if (line_reader_succeeded()) {
+      const char *filename = line_reader_get_line();
+      SYS_CONSOLE_PRINT("\nWriting spare WINC firmware slot from %s", filename);
+      start_cloner(winc_cloner_slot_update(filename));
+
+    } else {
+      // remain in this state until line_reader's callback wakes this task
+      sched_wait_ms(SCHED_FOREVER);
+    }
+  } break;
+
+  case CMD_TASK_STATE_START_PATCHING: {
+    if (line_reader_has_error()) {
+      SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\ncould not read filename");
+      set_state(CMD_TASK_STATE_PRINTING_HELP);  // restart...
+
+    } else if (line_reader_succeeded()) {
+      const char *filename = line_reader_get_line();
+      SYS_CONSOLE_PRINT("\nPatching WINC firmware from %s", filename);
+      start_cloner(winc_cloner_apply_delta(filename));
+
+    } else {
+      // remain in this state until line_reader's callback wakes this task
+      sched_wait_ms(SCHED_FOREVER);
+    }
+  } break;
+
+  case CMD_TASK_STATE_START_STAGING: {
+    if (line_reader_has_error()) {
+      SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\ncould not read filename");
+      set_state(CMD_TASK_STATE_PRINTING_HELP);  // restart...
+
+    } else if (line_reader_succeeded()) {
+      const char *filename = line_reader_get_line();
+      SYS_CONSOLE_PRINT("\nStaging %s into internal cache", filename);
+      if (image_cache_stage(filename)) {
+        SYS_CONSOLE_MESSAGE(" (ESC to cancel)");
+        set_state(CMD_TASK_STATE_RUNNING_STAGING);
+      } else {
+        set_state(CMD_TASK_STATE_PRINTING_HELP);
+      }
+
+    } else {
+      // remain in this state until line_reader's callback wakes this task
+      sched_wait_ms(SCHED_FOREVER);
+    }
+  } break;
+
+  case CMD_TASK_STATE_START_GANG_UPDATING: {
+    if (line_reader_has_error()) {
+      SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\ncould not read filename");
+      set_state(CMD_TASK_STATE_PRINTING_HELP);  // restart...
+
+    } else if (line_reader_succeeded()) {
+      const char *filename = line_reader_get_line();
+      SYS_CONSOLE_PRINT("\nUpdating every WINC slot from %s", filename);
+      if (winc_gang_update(filename)) {
+        SYS_CONSOLE_MESSAGE(" (ESC to cancel)");
+        set_state(CMD_TASK_STATE_RUNNING_GANG);
+      } else {
+        set_state(CMD_TASK_STATE_PRINTING_HELP);
+      }
+
+    } else {
+      // remain in this state until line_reader's callback wakes this task
+      sched_wait_ms(SCHED_FOREVER);
+    }
+  } break;
+
+  case CMD_TASK_STATE_START_STATION: {
+    if (line_reader_has_error()) {
+      SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\ncould not read filename");
+      set_state(CMD_TASK_STATE_PRINTING_HELP);  // restart...
+
+    } else if (line_reader_succeeded()) {
+      const char *filename = line_reader_get_line();
+      SYS_CONSOLE_PRINT("\nStation mode with %s (ESC to leave)", filename);
+      s_cmd_task_ctx.catalog_is_stale = true; // may write a manifest
+      if (station_start(filename)) {
+        set_state(CMD_TASK_STATE_RUNNING_STATION);
+      } else {
+        set_state(CMD_TASK_STATE_PRINTING_HELP);
+      }
+
+    } else {
+      // remain in this state until line_reader's callback wakes this task
+      sched_wait_ms(SCHED_FOREVER);
+    }
+  } break;
+
+  case CMD_TASK_STATE_START_JOB: {
+    if (line_reader_has_error()) {
+      SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\ncould not read filename");
+      set_state(CMD_TASK_STATE_PRINTING_HELP);  // restart...
+
+    } else if (line_reader_succeeded()) {
+      const char *filename = line_reader_get_line();
+      SYS_CONSOLE_PRINT("\nRunning %s (ESC to cancel)", filename);
+      if (job_start(filename)) {
+        set_state(CMD_TASK_STATE_RUNNING_JOB);
+      } else {
+        set_state(CMD_TASK_STATE_PRINTING_HELP);
+      }
+
+    } else {
+      // remain in this state until line_reader's callback wakes this task
+      sched_wait_ms(SCHED_FOREVER);
+    }
+  } break;
+
+  case CMD_TASK_STATE_START_STREAMING: {
+    // Wait for the host to START sending.
+    uart_stream_step();
+
+    if (uart_stream_has_error()) {
+      uart_stream_close(false);
+      set_state(CMD_TASK_STATE_PRINTING_HELP);
+
+    } else if (uart_stream_is_started()) {
+      SYS_CONSOLE_PRINT("\nUpdating WINC firmware from %s (%ld bytes)",
+                        UART_STREAM_NAME,
+                        uart_stream_image_size());
+      if (winc_cloner_stream_update()) {
+        set_state(CMD_TASK_STATE_RUNNING_STREAM);
+      } else {
+        uart_stream_close(false);
+        set_state(CMD_TASK_STATE_PRINTING_HELP);
+      }
+
+    } else {
+      // no START yet -- remain in this state, but don't spin.
+      sched_sleep_ms(COMMAND_POLL_MS);
+    }
+  } break;
+
+  case CMD_TASK_STATE_SELECTING_REGIONS: {
+    if (line_reader_has_error()) {
+      SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\ncould not read regions");
+      set_state(CMD_TASK_STATE_PRINTING_HELP);  // restart...
+
+    } else if (line_reader_succeeded()) {
+      flash_region_set_t regions;
+      if (flash_region_set_parse(line_reader_get_line(), &regions) &&
+          (regions != 0)) {
+        winc_cloner_set_regions(regions);
+      } else {
+        SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                        "\nUnknown regions %s",
+                        line_reader_get_line());
+      }
+      set_state(CMD_TASK_STATE_PRINTING_HELP);
+
+    } else {
+      // remain in this state until line_reader's callback wakes this task
+      sched_wait_ms(SCHED_FOREVER);
+    }
+  } break;
+
+  case CMD_TASK_STATE_RUNNING_CLONER: {
+    // Step the cloner one sector at a time, watching for ESC or space.
+    uint8_t ch;
+
+    winc_cloner_step();
+    if (SYS_CONSOLE_Read(SYS_CONSOLE_DEFAULT_INSTANCE, &ch, sizeof(ch)) > 0) {
+      if (ch == ESC_KEY) {
+        winc_cloner_cancel();
+      } else if (ch == ' ') {
+        if (winc_cloner_is_paused()) {
+          winc_cloner_resume();
+        } else {
+          winc_cloner_pause();
+        }
+      }
+    }
+    if (!winc_cloner_is_busy()) {
+      set_state(CMD_TASK_STATE_PRINTING_HELP);
+    }
+  } break;
+
+  case CMD_TASK_STATE_RUNNING_BENCH: {
+    // Run one benchmark per step.
+    bench_step();
+    if (!bench_is_busy()) {
+      set_state(CMD_TASK_STATE_PRINTING_HELP);
+    }
+  } break;
+
+  case CMD_TASK_STATE_RUNNING_GANG: {
+    // Step the gang update one sector at a time, watching for ESC.
+    uint8_t ch;
+
+    winc_gang_step();
+    if ((SYS_CONSOLE_Read(SYS_CONSOLE_DEFAULT_INSTANCE, &ch, sizeof(ch)) > 0) &&
+        (ch == ESC_KEY)) {
+      winc_gang_cancel();
+    }
+    if (!winc_gang_is_busy()) {
+      set_state(CMD_TASK_STATE_PRINTING_HELP);
+    }
+  } break;
+
+  case CMD_TASK_STATE_RUNNING_DELTA: {
+    // Compare the images one sector at a time, watching for ESC.
+    uint8_t ch;
+
+    delta_image_step();
+    if ((SYS_CONSOLE_Read(SYS_CONSOLE_DEFAULT_INSTANCE, &ch, sizeof(ch)) > 0) &&
+        (ch == ESC_KEY)) {
+      delta_image_cancel();
+    }
+    if (!delta_image_is_busy()) {
+      set_state(CMD_TASK_STATE_PRINTING_HELP);
+    }
+  } break;
+
+  case CMD_TASK_STATE_RUNNING_STAGING: {
+    // Stage the image one block or sector at a time, watching for ESC.
+    uint8_t ch;
+
+    image_cache_step();
+    if ((SYS_CONSOLE_Read(SYS_CONSOLE_DEFAULT_INSTANCE, &ch, sizeof(ch)) > 0) &&
+        (ch == ESC_KEY)) {
+      image_cache_cancel();
+    }
+    if (!image_cache_is_busy()) {
+      set_state(CMD_TASK_STATE_PRINTING_HELP);
+    }
+  } break;
+
+  case CMD_TASK_STATE_RUNNING_STATION: {
+    // Poll for and program WINCs until ESC.
+    uint8_t ch;
+
+    station_step();
+    if ((SYS_CONSOLE_Read(SYS_CONSOLE_DEFAULT_INSTANCE, &ch, sizeof(ch)) > 0) &&
+        (ch == ESC_KEY)) {
+      station_stop();
+    }
+    if (!station_is_busy()) {
+      set_state(CMD_TASK_STATE_PRINTING_HELP);
+    }
+  } break;
+
+  case CMD_TASK_STATE_RUNNING_JOB: {
+    // Run the script one operation step at a time, watching for ESC.
+    uint8_t ch;
+
+    job_step();
+    if ((SYS_CONSOLE_Read(SYS_CONSOLE_DEFAULT_INSTANCE, &ch, sizeof(ch)) > 0) &&
+        (ch == ESC_KEY)) {
+      job_cancel();
+    }
+    if (!job_is_busy()) {
+      s_cmd_task_ctx.catalog_is_stale = true; // may have extracted images
+      set_state(CMD_TASK_STATE_PRINTING_HELP);
+    }
+  } break;
+
+  case CMD_TASK_STATE_RUNNING_STREAM: {
+    // The console carries the stream, so there is no ESC or space here: the
+    // host cancels by aborting the stream.
+    winc_cloner_step();
+    if (!winc_cloner_is_busy()) {
+      uart_stream_close(winc_cloner_is_complete());
+      set_state(CMD_TASK_STATE_PRINTING_HELP);
+    }
+  } break;
+
   case CMD_TASK_STATE_ERROR: {
     // here on error state
+    sched_wait_ms(SCHED_FOREVER);
   } break;
 
   } // switch
 }
 
-bool cmd_task_has_error(void) {
-  return s_cmd_task_ctx.state == CMD_TASK_STATE_ERROR;
-}
-
 // *****************************************************************************
 // Private (static) code
 
 static void set_state(cmd_task_state_t state) {
   if (s_cmd_task_ctx.state != state) {
-    SYS_DEBUG_PRINT(SYS_ERROR_DEBUG,
-                    "%s => %s",
-                    state_name(s_cmd_task_ctx.state),
-                    state_name(state));
+    TRACE2(TRACE_CMD_TASK_STATE, s_cmd_task_ctx.state, state);
     s_cmd_task_ctx.state = state;
   }
 }
 
-static const char *state_name(cmd_task_state_t state) {
-  SYS_ASSERT(state < N_STATES, "cmd_task_state_t out of bounds");
-  return s_state_names[state];
+static void wake_task(uintptr_t arg) {
+  (void)arg;
+  sched_signal(s_cmd_task_ctx.task, 1);
+}
+
+static void start_cloner(bool started) {
+  if (started) {
+    SYS_CONSOLE_MESSAGE(" (ESC to cancel, space to pause)");
+    set_state(CMD_TASK_STATE_RUNNING_CLONER);
+  } else {
+    set_state(CMD_TASK_STATE_PRINTING_HELP);
+  }
+}
+
+static void print_regions_prompt(void) {
+  char regions[FLASH_REGION_SET_FORMAT_SIZE];
+
+  SYS_CONSOLE_MESSAGE("\nRegions:");
+  for (int id = 0; id < FLASH_REGION_COUNT; id++) {
+    const flash_region_t *region = flash_region_get(id);
+    SYS_CONSOLE_PRINT("\n   %-12s 0x%06lx %4lu KB",
+                      region->name,
+                      region->offset,
+                      region->size / 1024);
+  }
+  SYS_CONSOLE_MESSAGE("\nor all, firmware or certs, separated by commas;"
+                      " -name leaves a region out");
+  flash_region_set_format(winc_cloner_get_regions(), regions, sizeof(regions));
+  SYS_CONSOLE_PRINT("\nselect regions (now %s): ", regions);
+}
+
+static void list_catalog_page(void) {
+  dir_reader_entry_t entry;
+  uint16_t count = dir_reader_filename_count();
+  uint16_t n_pages = (count + CATALOG_PAGE_SIZE - 1) / CATALOG_PAGE_SIZE;
+  uint16_t first;
+
+  if (s_cmd_task_ctx.catalog_page >= n_pages) {
+    s_cmd_task_ctx.catalog_page = 0; // wrap around
+  }
+  first = s_cmd_task_ctx.catalog_page * CATALOG_PAGE_SIZE;
+
+  SYS_CONSOLE_PRINT("\nFound %d image%s", count, count == 1 ? "" : "s");
+  if (n_pages > 1) {
+    SYS_CONSOLE_PRINT(
+        " (page %d of %d)", s_cmd_task_ctx.catalog_page + 1, n_pages);
+  }
+  for (uint16_t idx = first;
+       (idx < count) && (idx < first + CATALOG_PAGE_SIZE);
+       idx++) {
+    if (!dir_reader_get_entry(idx, &entry)) {
+      SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\nUnable to read image catalog");
+      break;
+    }
+    SYS_CONSOLE_PRINT(
+        "\n   %-40s %8ld  %-8s", entry.name, entry.size, entry.version);
+    if (entry.has_manifest) {
+      // enough of the digest to tell images apart at a glance
+      SYS_CONSOLE_PRINT(" %02x%02x%02x%02x",
+                        entry.sha256[0],
+                        entry.sha256[1],
+                        entry.sha256[2],
+                        entry.sha256[3]);
+    }
+  }
 }
 
 static void flush_serial_input(void) {
@@ -284,5 +864,23 @@ static uint8_t downcase(uint8_t ch) {
   return ch;
 }
 
+static int split_args(const char *line, char *argv[]) {
+  int argc = 0;
+  char *word;
+
+  strncpy(s_args, line, sizeof(s_args) - 1);
+  s_args[sizeof(s_args) - 1] = '\0';
+  word = strtok(s_args, " \t");
+  while (word != NULL) {
+    if (argc == MAX_ARGS) {
+      // rather than silently drop the rest of the line
+      return -1;
+    }
+    argv[argc++] = word;
+    word = strtok(NULL, " \t");
+  }
+  return argc;
+}
+
 // *****************************************************************************
 // End of file
@@ -57,19 +57,21 @@ typedef void (*cmd_task_callback_fn)(uintptr_t arg);
 // Public declarations
 
 /**
- * @brief Initialize the cmd_task.  Called once at startup.
+ * @brief Initialize the cmd_task and register it as a sched task.  Call after
+ * sched_init(), dir_reader_init() and line_reader_init().
  */
 void cmd_task_init(void);
 
 /**
- * @brief Step the cmd_task internal state.  Called frequently.
+ * @brief Start processing commands.  Called once the SD card is mounted.
  */
-void cmd_task_step(void);
+void cmd_task_start(void);
 
 /**
- * @brief Return true if the cmd_task has encountered an error.
+ * @brief Step the cmd_task internal state.  Registered as a sched task by
+ * cmd_task_init().
  */
-bool cmd_task_has_error(void);
+void cmd_task_step(void);
 
 // *****************************************************************************
 // End of file
@@ -49,6 +49,7 @@
 #include "drv_sdspi_plib_interface.h"
 
 #include "drv_sdspi_local.h"
+#include "prof.h"
 
 
 // *****************************************************************************
@@ -1666,6 +1667,11 @@ static void _DRV_SDSPI_BufferIOTasks
 
         case DRV_SDSPI_TASK_READ_START_TOKEN:
 
+            if (dObj->timerFlag == false)
+            {
+                /* First poll for this block's start token */
+                PROF_BEGIN(PROF_SD_READ_TOKEN);
+            }
             if (_DRV_SDSPI_SPIRead(dObj, dObj->pCmdResp, 1) == true)
             {
                 dObj->nextTaskState = DRV_SDSPI_TASK_READ_START_TOKEN_STATUS;
@@ -1687,6 +1693,7 @@ static void _DRV_SDSPI_BufferIOTasks
                */
             if (dObj->pCmdResp[0] == DRV_SDSPI_DATA_START_TOKEN)
             {
+                PROF_END(PROF_SD_READ_TOKEN);
                 dObj->taskBufferIOState = DRV_SDSPI_TASK_READ_DATA;
                 /* Received the start token. Stop the timer */
                 _DRV_SDSPI_TimerStop(dObj);
@@ -1893,6 +1900,7 @@ static void _DRV_SDSPI_BufferIOTasks
             }
             else
             {
+                PROF_BEGIN(PROF_SD_BUSY);
                 dObj->taskBufferIOState = DRV_SDSPI_TASK_WRITE_CHECK_BUSY;
                 dObj->timerFlag = false;
             }
@@ -1947,6 +1955,7 @@ static void _DRV_SDSPI_BufferIOTasks
             else
             {
                 /* The card is out of the busy state. Stop the timer */
+                PROF_END(PROF_SD_BUSY);
                 _DRV_SDSPI_TimerStop(dObj);
                 dObj->timerFlag = false;
                 dObj->taskBufferIOState = DRV_SDSPI_TASK_WRITE_COMPLETE_CHECK;
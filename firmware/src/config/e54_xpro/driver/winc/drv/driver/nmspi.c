@@ -42,6 +42,8 @@
 #include "nmasic.h"
 #include "wdrv_winc_common.h"
 #include "wdrv_winc_spi.h"
+#include "bus_capture.h"
+#include "prof.h"
 
 #define NMI_PERIPH_REG_BASE 0x1000
 #define NMI_INTR_REG_BASE (NMI_PERIPH_REG_BASE+0xa00)
@@ -302,6 +304,7 @@ static int8_t spi_cmd_rsp(uint8_t cmd, uint8_t clockless)
     }
 
     /* wait for response */
+    PROF_BEGIN(PROF_SPI_RSP_POLL);
     s8RetryCnt = SPI_RESP_RETRY_COUNT;
     do
     {
@@ -310,6 +313,7 @@ static int8_t spi_cmd_rsp(uint8_t cmd, uint8_t clockless)
             M2M_ERR("[spi_cmd_rsp]: Failed cmd response read, bus error...\r\n");
             return N_FAIL;
         }
+        BUS_CAPTURE_POLL();
     }
     while((rsp != cmd) && (!clockless) && (s8RetryCnt-- > 0));
 
@@ -330,6 +334,7 @@ static int8_t spi_cmd_rsp(uint8_t cmd, uint8_t clockless)
             M2M_ERR("[spi_cmd_rsp]: Failed cmd response read, bus error...\r\n");
             return N_FAIL;
         }
+        BUS_CAPTURE_POLL();
     }
     while((rsp != 0x00) && (!clockless) && (s8RetryCnt-- > 0));
 
@@ -338,6 +343,7 @@ static int8_t spi_cmd_rsp(uint8_t cmd, uint8_t clockless)
         M2M_ERR("[spi_cmd_rsp]: Failed cmd response read\n");
         return N_FAIL;
     }
+    PROF_END(PROF_SPI_RSP_POLL);
 
     return N_OK;
 }
@@ -376,6 +382,7 @@ static int8_t spi_data_read(uint8_t *b, uint16_t sz,uint8_t clockless)
         /**
             Data Response header
         **/
+        PROF_BEGIN(PROF_SPI_DATA_POLL);
         retry = SPI_RESP_RETRY_COUNT;
         do
         {
@@ -385,6 +392,7 @@ static int8_t spi_data_read(uint8_t *b, uint16_t sz,uint8_t clockless)
                 result = N_FAIL;
                 break;
             }
+            BUS_CAPTURE_POLL();
             if ((rsp & 0xf0) == 0xf0)
                 break;
         }
@@ -399,6 +407,7 @@ static int8_t spi_data_read(uint8_t *b, uint16_t sz,uint8_t clockless)
             result = N_FAIL;
             break;
         }
+        PROF_END(PROF_SPI_DATA_POLL);
 
         /**
             Read bytes
@@ -792,6 +801,28 @@ int8_t nm_spi_deinit(void)
     return M2M_SUCCESS;
 }
 
+/*
+*   @fn     nm_spi_get_crc_off
+*   @brief  Return the CRC mode negotiated by nm_spi_init()
+*   @return 1 if CRC is off, 0 if on
+*/
+uint8_t nm_spi_get_crc_off(void)
+{
+    return gu8Crc_off;
+}
+
+/*
+*   @fn     nm_spi_set_crc_off
+*   @brief  Restore the CRC mode of the WINC about to be addressed, as saved
+*           by nm_spi_get_crc_off().  For hosts that drive several WINCs.
+*   @param [in] u8CrcOff
+*               1 if CRC is off, 0 if on
+*/
+void nm_spi_set_crc_off(uint8_t u8CrcOff)
+{
+    gu8Crc_off = u8CrcOff;
+}
+
 /*
 *   @fn     nm_spi_read_reg
 *   @brief  Read register
@@ -40,6 +40,8 @@
 #ifndef _WDRV_WINC_GPIO_H
 #define _WDRV_WINC_GPIO_H
 
+#include "system/ports/sys_ports.h"
+
 //*******************************************************************************
 /*
   Function:
@@ -188,4 +190,31 @@ void WDRV_WINC_GPIOResetAssert(void);
  */
 void WDRV_WINC_GPIOResetDeassert(void);
 
+//*******************************************************************************
+/*
+  Function:
+    void WDRV_WINC_GPIOSelect(SYS_PORT_PIN resetN, SYS_PORT_PIN chipEn)
+
+  Summary:
+    Select the reset and chip enable pins to control.
+
+  Description:
+    Makes the functions above control the WINC whose reset and chip enable
+    lines are on resetN and chipEn, for hosts that program several WINCs.
+
+  Precondition:
+    None.
+
+  Parameters:
+    resetN - reset pin, initially WDRV_WINC_RESETN_PIN
+    chipEn - chip enable pin, initially WDRV_WINC_CHIP_EN_PIN
+
+  Returns:
+    None.
+
+  Remarks:
+    Both pins are made outputs.
+ */
+void WDRV_WINC_GPIOSelect(SYS_PORT_PIN resetN, SYS_PORT_PIN chipEn);
+
 #endif /* _WDRV_WINC_GPIO_H */
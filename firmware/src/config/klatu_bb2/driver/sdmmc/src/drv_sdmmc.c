@@ -52,6 +52,7 @@
 #include "configuration.h"
 #include "driver/sdmmc/drv_sdmmc.h"
 #include "driver/sdmmc/src/drv_sdmmc_local.h"
+#include "prof.h"
 #include <string.h>
 
 static DRV_SDMMC_OBJ gDrvSDMMCObj[DRV_SDMMC_INSTANCES_NUMBER];
@@ -477,6 +478,7 @@ static void _DRV_SDMMC_CommandSend (
                 break;
             }
             dObj->cmdState = DRV_SDMMC_CMD_LINE_STATE_CHECK;
+            PROF_BEGIN(PROF_SD_BUSY);
             /* Fall through to the next state. */
 
         case DRV_SDMMC_CMD_LINE_STATE_CHECK:
@@ -515,6 +517,7 @@ static void _DRV_SDMMC_CommandSend (
             }
 
             //Command and data lines are available, now send the command
+            PROF_END(PROF_SD_BUSY);
             dObj->cmdState = DRV_SDMMC_CMD_FRAME_AND_SEND_CMD;
             /* Fall through to the next case. */
 
@@ -40,13 +40,29 @@
 #include "configuration.h"
 #include "definitions.h"
 
+/* The reset and chip enable pins of the selected WINC. */
+static SYS_PORT_PIN resetNPin = (SYS_PORT_PIN)WDRV_WINC_RESETN_PIN;
+static SYS_PORT_PIN chipEnPin = (SYS_PORT_PIN)WDRV_WINC_CHIP_EN_PIN;
+
+/****************************************************************************
+ * Function:        WDRV_WINC_GPIOSelect
+ * Summary: Select the reset and chip enable pins of the WINC to control.
+ *****************************************************************************/
+void WDRV_WINC_GPIOSelect(SYS_PORT_PIN resetN, SYS_PORT_PIN chipEn)
+{
+    resetNPin = resetN;
+    chipEnPin = chipEn;
+    SYS_PORT_PinOutputEnable(resetNPin);
+    SYS_PORT_PinOutputEnable(chipEnPin);
+}
+
 /****************************************************************************
  * Function:        WDRV_WINC_GPIOResetAssert
  * Summary: Reset the WINC by asserting the reset line.
  *****************************************************************************/
 void WDRV_WINC_GPIOResetAssert(void)
 {
-    WDRV_WINC_RESETN_Clear();
+    SYS_PORT_PinClear(resetNPin);
 }
 
 /****************************************************************************
@@ -55,7 +71,7 @@ void WDRV_WINC_GPIOResetAssert(void)
  *****************************************************************************/
 void WDRV_WINC_GPIOResetDeassert(void)
 {
-    WDRV_WINC_RESETN_Set();
+    SYS_PORT_PinSet(resetNPin);
 }
 
 /****************************************************************************
@@ -64,7 +80,7 @@ void WDRV_WINC_GPIOResetDeassert(void)
  *****************************************************************************/
 void WDRV_WINC_GPIOChipEnableAssert(void)
 {
-    WDRV_WINC_CHIP_EN_Set();
+    SYS_PORT_PinSet(chipEnPin);
 }
 
 /****************************************************************************
@@ -73,7 +89,7 @@ void WDRV_WINC_GPIOChipEnableAssert(void)
  *****************************************************************************/
 void WDRV_WINC_GPIOChipEnableDeassert(void)
 {
-    WDRV_WINC_CHIP_EN_Clear();
+    SYS_PORT_PinClear(chipEnPin);
 }
 
 //DOM-IGNORE-END
@@ -65,7 +65,10 @@ typedef struct
 // *****************************************************************************
 // *****************************************************************************
 
-static WDRV_WINC_SPIDCPT spiDcpt;
+static WDRV_WINC_SPIDCPT spiDcpt[WDRV_WINC_SPI_MAX_TARGETS];
+
+/* The target that WDRV_WINC_SPISend/Receive/Open address. */
+static WDRV_WINC_SPIDCPT *pSpiDcpt = &spiDcpt[0];
 
 // *****************************************************************************
 // *****************************************************************************
@@ -76,17 +79,19 @@ static WDRV_WINC_SPIDCPT spiDcpt;
 static void _WDRV_WINC_SPITransferEventHandler(DRV_SPI_TRANSFER_EVENT event,
         DRV_SPI_TRANSFER_HANDLE handle, uintptr_t context)
 {
+    WDRV_WINC_SPIDCPT *const pDcpt = (WDRV_WINC_SPIDCPT*)context;
+
     switch(event)
     {
         case DRV_SPI_TRANSFER_EVENT_COMPLETE:
             // This means the data was transferred.
-            if (spiDcpt.transferTxHandle == handle)
+            if (pDcpt->transferTxHandle == handle)
             {
-                OSAL_SEM_PostISR(&spiDcpt.txSyncSem);
+                OSAL_SEM_PostISR(&pDcpt->txSyncSem);
             }
-            else if (spiDcpt.transferRxHandle == handle)
+            else if (pDcpt->transferRxHandle == handle)
             {
-                OSAL_SEM_PostISR(&spiDcpt.rxSyncSem);
+                OSAL_SEM_PostISR(&pDcpt->rxSyncSem);
             }
 
             break;
@@ -117,14 +122,14 @@ static void _WDRV_WINC_SPITransferEventHandler(DRV_SPI_TRANSFER_EVENT event,
 
 bool WDRV_WINC_SPISend(void* pTransmitData, size_t txSize)
 {
-    DRV_SPI_WriteTransferAdd(spiDcpt.spiHandle, pTransmitData, txSize, &spiDcpt.transferTxHandle);
+    DRV_SPI_WriteTransferAdd(pSpiDcpt->spiHandle, pTransmitData, txSize, &pSpiDcpt->transferTxHandle);
 
-    if (DRV_SPI_TRANSFER_HANDLE_INVALID == spiDcpt.transferTxHandle)
+    if (DRV_SPI_TRANSFER_HANDLE_INVALID == pSpiDcpt->transferTxHandle)
     {
         return false;
     }
 
-    while (OSAL_RESULT_FALSE == OSAL_SEM_Pend(&spiDcpt.txSyncSem, OSAL_WAIT_FOREVER))
+    while (OSAL_RESULT_FALSE == OSAL_SEM_Pend(&pSpiDcpt->txSyncSem, OSAL_WAIT_FOREVER))
     {
     }
 
@@ -150,14 +155,14 @@ bool WDRV_WINC_SPIReceive(void* pReceiveData, size_t rxSize)
 {
     static uint8_t dummy = 0;
 
-    DRV_SPI_WriteReadTransferAdd(spiDcpt.spiHandle, &dummy, 1, pReceiveData, rxSize, &spiDcpt.transferRxHandle);
+    DRV_SPI_WriteReadTransferAdd(pSpiDcpt->spiHandle, &dummy, 1, pReceiveData, rxSize, &pSpiDcpt->transferRxHandle);
 
-    if (DRV_SPI_TRANSFER_HANDLE_INVALID == spiDcpt.transferRxHandle)
+    if (DRV_SPI_TRANSFER_HANDLE_INVALID == pSpiDcpt->transferRxHandle)
     {
         return false;
     }
 
-    while (OSAL_RESULT_FALSE == OSAL_SEM_Pend(&spiDcpt.rxSyncSem, OSAL_WAIT_FOREVER))
+    while (OSAL_RESULT_FALSE == OSAL_SEM_Pend(&pSpiDcpt->rxSyncSem, OSAL_WAIT_FOREVER))
     {
     }
 
@@ -189,21 +194,21 @@ bool WDRV_WINC_SPIOpen(void)
         .csPolarity     = DRV_SPI_CS_POLARITY_ACTIVE_LOW
     };
 
-    if (OSAL_RESULT_TRUE != OSAL_SEM_Create(&spiDcpt.txSyncSem, OSAL_SEM_TYPE_COUNTING, 10, 0))
+    if (OSAL_RESULT_TRUE != OSAL_SEM_Create(&pSpiDcpt->txSyncSem, OSAL_SEM_TYPE_COUNTING, 10, 0))
     {
         return false;
     }
 
-    if (OSAL_RESULT_TRUE != OSAL_SEM_Create(&spiDcpt.rxSyncSem, OSAL_SEM_TYPE_COUNTING, 10, 0))
+    if (OSAL_RESULT_TRUE != OSAL_SEM_Create(&pSpiDcpt->rxSyncSem, OSAL_SEM_TYPE_COUNTING, 10, 0))
     {
         return false;
     }
 
-    if (DRV_HANDLE_INVALID == spiDcpt.spiHandle)
+    if (DRV_HANDLE_INVALID == pSpiDcpt->spiHandle)
     {
-        spiDcpt.spiHandle = DRV_SPI_Open(spiDcpt.cfg.drvIndex, DRV_IO_INTENT_READWRITE | DRV_IO_INTENT_BLOCKING);
+        pSpiDcpt->spiHandle = DRV_SPI_Open(pSpiDcpt->cfg.drvIndex, DRV_IO_INTENT_READWRITE | DRV_IO_INTENT_BLOCKING);
 
-        if (DRV_HANDLE_INVALID == spiDcpt.spiHandle)
+        if (DRV_HANDLE_INVALID == pSpiDcpt->spiHandle)
         {
             WDRV_DBG_ERROR_PRINT("SPI open failed\r\n");
 
@@ -211,17 +216,17 @@ bool WDRV_WINC_SPIOpen(void)
         }
     }
 
-    spiTransConf.baudRateInHz = spiDcpt.cfg.baudRateInHz;
-    spiTransConf.chipSelect   = spiDcpt.cfg.chipSelect;
+    spiTransConf.baudRateInHz = pSpiDcpt->cfg.baudRateInHz;
+    spiTransConf.chipSelect   = pSpiDcpt->cfg.chipSelect;
 
-    if (false == DRV_SPI_TransferSetup(spiDcpt.spiHandle, &spiTransConf))
+    if (false == DRV_SPI_TransferSetup(pSpiDcpt->spiHandle, &spiTransConf))
     {
         WDRV_DBG_ERROR_PRINT("SPI transfer setup failed\r\n");
 
         return false;
     }
 
-    DRV_SPI_TransferEventHandlerSet(spiDcpt.spiHandle, _WDRV_WINC_SPITransferEventHandler, 0);
+    DRV_SPI_TransferEventHandlerSet(pSpiDcpt->spiHandle, _WDRV_WINC_SPITransferEventHandler, (uintptr_t)pSpiDcpt);
 
     return true;
 }
@@ -248,9 +253,68 @@ void WDRV_WINC_SPIInitialize(const WDRV_WINC_SPI_CFG *const pInitData)
         return;
     }
 
-    memcpy(&spiDcpt.cfg, pInitData, sizeof(WDRV_WINC_SPI_CFG));
+    memcpy(&spiDcpt[0].cfg, pInitData, sizeof(WDRV_WINC_SPI_CFG));
+
+    spiDcpt[0].spiHandle = DRV_HANDLE_INVALID;
+}
+
+//*******************************************************************************
+/*
+  Function:
+    bool WDRV_WINC_SPITargetInitialize(unsigned int target,
+                const WDRV_WINC_SPI_CFG *const pInitData)
+
+  Summary:
+    Initializes the SPI object for an additional WINC.
+
+  Description:
+    This function initializes the SPI object for the WINC on another SPI
+    bus.  Target 0 is the WINC initialized by WDRV_WINC_SPIInitialize.
+
+  Remarks:
+    See wdrv_winc_spi.h for usage information.
+ */
+
+bool WDRV_WINC_SPITargetInitialize(unsigned int target, const WDRV_WINC_SPI_CFG *const pInitData)
+{
+    if ((NULL == pInitData) || (target >= WDRV_WINC_SPI_MAX_TARGETS))
+    {
+        return false;
+    }
+
+    memcpy(&spiDcpt[target].cfg, pInitData, sizeof(WDRV_WINC_SPI_CFG));
+
+    spiDcpt[target].spiHandle = DRV_HANDLE_INVALID;
 
-    spiDcpt.spiHandle = DRV_HANDLE_INVALID;
+    return true;
+}
+
+//*******************************************************************************
+/*
+  Function:
+    bool WDRV_WINC_SPITargetSelect(unsigned int target)
+
+  Summary:
+    Selects the WINC addressed by subsequent SPI transfers.
+
+  Description:
+    This function selects the WINC addressed by WDRV_WINC_SPISend,
+    WDRV_WINC_SPIReceive, WDRV_WINC_SPIOpen and WDRV_WINC_SPIDeinitialize.
+
+  Remarks:
+    See wdrv_winc_spi.h for usage information.
+ */
+
+bool WDRV_WINC_SPITargetSelect(unsigned int target)
+{
+    if (target >= WDRV_WINC_SPI_MAX_TARGETS)
+    {
+        return false;
+    }
+
+    pSpiDcpt = &spiDcpt[target];
+
+    return true;
 }
 
 //*******************************************************************************
@@ -270,16 +334,16 @@ void WDRV_WINC_SPIInitialize(const WDRV_WINC_SPI_CFG *const pInitData)
 
 void WDRV_WINC_SPIDeinitialize(void)
 {
-    OSAL_SEM_Post(&spiDcpt.txSyncSem);
-    OSAL_SEM_Delete(&spiDcpt.txSyncSem);
+    OSAL_SEM_Post(&pSpiDcpt->txSyncSem);
+    OSAL_SEM_Delete(&pSpiDcpt->txSyncSem);
 
-    OSAL_SEM_Post(&spiDcpt.rxSyncSem);
-    OSAL_SEM_Delete(&spiDcpt.rxSyncSem);
+    OSAL_SEM_Post(&pSpiDcpt->rxSyncSem);
+    OSAL_SEM_Delete(&pSpiDcpt->rxSyncSem);
 
-    if (DRV_HANDLE_INVALID != spiDcpt.spiHandle)
+    if (DRV_HANDLE_INVALID != pSpiDcpt->spiHandle)
     {
-        DRV_SPI_Close(spiDcpt.spiHandle);
-        spiDcpt.spiHandle = DRV_HANDLE_INVALID;
+        DRV_SPI_Close(pSpiDcpt->spiHandle);
+        pSpiDcpt->spiHandle = DRV_HANDLE_INVALID;
     }
 }
 
@@ -163,10 +163,21 @@ int8_t cpu_start(void) {
     return ret;
 }
 
-uint32_t nmi_get_chipid(void)
+/* Cached by nmi_get_chipid(): see nmi_set_chipid_cache(). */
+static uint32_t chipid = 0;
+
+uint32_t nmi_get_chipid_cache(void)
 {
-    static uint32_t chipid = 0;
+    return chipid;
+}
 
+void nmi_set_chipid_cache(uint32_t u32ChipId)
+{
+    chipid = u32ChipId;
+}
+
+uint32_t nmi_get_chipid(void)
+{
     if (chipid == 0) {
         uint32_t rfrevid;
 
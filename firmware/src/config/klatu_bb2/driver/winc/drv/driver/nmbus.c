@@ -37,6 +37,8 @@
 
 #include "nmbus.h"
 #include "nmspi.h"
+#include "bus_capture.h"
+#include "prof.h"
 
 #define MAX_TRX_CFG_SZ      8
 #define NM_BUS_MAX_TRX_SZ   2048
@@ -144,7 +146,13 @@ int8_t nm_bus_iface_reconfigure(void *ptr)
 */
 uint32_t nm_read_reg(uint32_t u32Addr)
 {
-    return nm_spi_read_reg(u32Addr);
+    uint32_t u32Val;
+    PROF_BEGIN(PROF_NM_REG);
+    BUS_CAPTURE_BEGIN();
+    u32Val = nm_spi_read_reg(u32Addr);
+    BUS_CAPTURE_END(BUS_CAPTURE_REG_READ, u32Addr, u32Val, 4, M2M_SUCCESS);
+    PROF_END(PROF_NM_REG);
+    return u32Val;
 }
 
 /*
@@ -161,7 +169,13 @@ uint32_t nm_read_reg(uint32_t u32Addr)
 */
 int8_t nm_read_reg_with_ret(uint32_t u32Addr, uint32_t* pu32RetVal)
 {
-    return nm_spi_read_reg_with_ret(u32Addr,pu32RetVal);
+    int8_t s8Ret;
+    PROF_BEGIN(PROF_NM_REG);
+    BUS_CAPTURE_BEGIN();
+    s8Ret = nm_spi_read_reg_with_ret(u32Addr,pu32RetVal);
+    BUS_CAPTURE_END(BUS_CAPTURE_REG_READ, u32Addr, *pu32RetVal, 4, s8Ret);
+    PROF_END(PROF_NM_REG);
+    return s8Ret;
 }
 
 /*
@@ -178,12 +192,24 @@ int8_t nm_read_reg_with_ret(uint32_t u32Addr, uint32_t* pu32RetVal)
 */
 int8_t nm_write_reg(uint32_t u32Addr, uint32_t u32Val)
 {
-    return nm_spi_write_reg(u32Addr,u32Val);
+    int8_t s8Ret;
+    PROF_BEGIN(PROF_NM_REG);
+    BUS_CAPTURE_BEGIN();
+    s8Ret = nm_spi_write_reg(u32Addr,u32Val);
+    BUS_CAPTURE_END(BUS_CAPTURE_REG_WRITE, u32Addr, u32Val, 4, s8Ret);
+    PROF_END(PROF_NM_REG);
+    return s8Ret;
 }
 
 static int8_t p_nm_read_block(uint32_t u32Addr, uint8_t *puBuf, uint16_t u16Sz)
 {
-    return nm_spi_read_block(u32Addr,puBuf,u16Sz);
+    int8_t s8Ret;
+    PROF_BEGIN(PROF_NM_BLOCK_READ);
+    BUS_CAPTURE_BEGIN();
+    s8Ret = nm_spi_read_block(u32Addr,puBuf,u16Sz);
+    BUS_CAPTURE_END(BUS_CAPTURE_BLOCK_READ, u32Addr, 0, u16Sz, s8Ret);
+    PROF_END(PROF_NM_BLOCK_READ);
+    return s8Ret;
 }
 /*
 *   @fn     nm_read_block
@@ -227,7 +253,13 @@ int8_t nm_read_block(uint32_t u32Addr, uint8_t *puBuf, uint32_t u32Sz)
 
 static int8_t p_nm_write_block(uint32_t u32Addr, uint8_t *puBuf, uint16_t u16Sz)
 {
-    return nm_spi_write_block(u32Addr,puBuf,u16Sz);
+    int8_t s8Ret;
+    PROF_BEGIN(PROF_NM_BLOCK_WRITE);
+    BUS_CAPTURE_BEGIN();
+    s8Ret = nm_spi_write_block(u32Addr,puBuf,u16Sz);
+    BUS_CAPTURE_END(BUS_CAPTURE_BLOCK_WRITE, u32Addr, 0, u16Sz, s8Ret);
+    PROF_END(PROF_NM_BLOCK_WRITE);
+    return s8Ret;
 }
 /**
 *   @fn     nm_write_block
@@ -36,6 +36,8 @@
 *******************************************************************************/
 
 #include "spi_flash.h"
+#include "prof.h"
+#include "trace.h"
 #define DUMMY_REGISTER  (0x1084)
 
 #define TIMEOUT (-1) /*MS*/
@@ -65,6 +67,9 @@ SPI Flash DMA
 #define SPI_FLASH_MSB_CTL       (SPI_FLASH_BASE + 0x20)
 #define SPI_FLASH_TX_CTL        (SPI_FLASH_BASE + 0x24)
 
+/* Cached by spi_flash_get_size(): see spi_flash_set_size_cache(). */
+static uint32_t gu32InternalFlashSize= 0;
+
 /*********************************************/
 /* STATIC FUNCTIONS                          */
 /*********************************************/
@@ -136,12 +141,14 @@ static int8_t spi_flash_load_to_cortus_mem(uint32_t u32MemAdr, uint32_t u32Flash
     ret += nm_write_reg(SPI_FLASH_BUF_DIR, 0x1f);
     ret += nm_write_reg(SPI_FLASH_DMA_ADDR, u32MemAdr);
     ret += nm_write_reg(SPI_FLASH_CMD_CNT, 5 | (1<<7));
+    PROF_BEGIN(PROF_FLASH_DMA_WAIT);
     do
     {
         ret += nm_read_reg_with_ret(SPI_FLASH_TR_DONE, (uint32_t *)&val);
         if(M2M_SUCCESS != ret) break;
     }
     while(val != 1);
+    PROF_END(PROF_FLASH_DMA_WAIT);
 
     return ret;
 }
@@ -182,6 +189,41 @@ static int8_t spi_flash_sector_erase(uint32_t u32FlashAdr)
     return ret;
 }
 
+/**
+*   @fn         spi_flash_block_erase
+*   @brief      Erase block (32KB)
+*   @param[IN]  u32FlashAdr
+*                   Any memory address within the block
+*   @return     Status of execution
+*   @note       Same sequence as spi_flash_sector_erase, with the 32KB block
+*               erase command
+*/
+static int8_t spi_flash_block_erase(uint32_t u32FlashAdr)
+{
+    uint8_t cmd[4];
+    uint32_t    val = 0;
+    int8_t  ret = M2M_SUCCESS;
+
+    cmd[0] = 0x52;
+    cmd[1] = (uint8_t)(u32FlashAdr >> 16);
+    cmd[2] = (uint8_t)(u32FlashAdr >> 8);
+    cmd[3] = (uint8_t)(u32FlashAdr);
+
+    ret += nm_write_reg(SPI_FLASH_DATA_CNT, 0);
+    ret += nm_write_reg(SPI_FLASH_BUF1, cmd[0]|(((uint32_t)cmd[1])<<8)|(((uint32_t)cmd[2])<<16)|(((uint32_t)cmd[3])<<24));
+    ret += nm_write_reg(SPI_FLASH_BUF_DIR, 0x0f);
+    ret += nm_write_reg(SPI_FLASH_DMA_ADDR, 0);
+    ret += nm_write_reg(SPI_FLASH_CMD_CNT, 4 | (1<<7));
+    do
+    {
+        ret += nm_read_reg_with_ret(SPI_FLASH_TR_DONE, (uint32_t *)&val);
+        if(M2M_SUCCESS != ret) break;
+    }
+    while(val != 1);
+
+    return ret;
+}
+
 /**
 *   @fn         spi_flash_write_enable
 *   @brief      Send write enable command to SPI flash
@@ -322,16 +364,15 @@ static int8_t spi_flash_pp(uint32_t u32Offset, uint8_t *pu8Buf, uint16_t u16Sz)
 {
     int8_t ret = M2M_SUCCESS;
     uint8_t tmp;
-    spi_flash_write_enable();
-    /* use shared packet memory as temp mem */
-    ret += nm_write_block(HOST_SHARE_MEM_BASE, pu8Buf, u16Sz);
-    ret += spi_flash_page_program(HOST_SHARE_MEM_BASE, u32Offset, u16Sz);
+    ret += spi_flash_page_program_start(pu8Buf, u32Offset, u16Sz);
+    PROF_BEGIN(PROF_FLASH_PROGRAM_WAIT);
     ret += spi_flash_read_status_reg(&tmp);
     do
     {
         if(ret != M2M_SUCCESS) goto ERR;
         ret += spi_flash_read_status_reg(&tmp);
     }while(tmp & 0x01);
+    PROF_END(PROF_FLASH_PROGRAM_WAIT);
     ret += spi_flash_write_disable();
 ERR:
     return ret;
@@ -556,25 +597,100 @@ int8_t spi_flash_erase(uint32_t u32Offset, uint32_t u32Sz)
     uint32_t i = 0;
     int8_t ret = M2M_SUCCESS;
     uint8_t  tmp = 0;
-    M2M_PRINT("\r\n>Start erasing...\r\n");
     for(i = u32Offset; i < (u32Sz +u32Offset); i += (16*FLASH_PAGE_SZ))
     {
-        ret += spi_flash_write_enable();
-        ret += spi_flash_read_status_reg(&tmp);
-        ret += spi_flash_sector_erase(i + 10);
+        ret += spi_flash_erase_start(i);
+        PROF_BEGIN(PROF_FLASH_ERASE_WAIT);
         ret += spi_flash_read_status_reg(&tmp);
         do
         {
             if(ret != M2M_SUCCESS) goto ERR;
             ret += spi_flash_read_status_reg(&tmp);
         }while(tmp & 0x01);
+        PROF_END(PROF_FLASH_ERASE_WAIT);
 
     }
-    M2M_PRINT("Done\r\n");
 ERR:
     return ret;
 }
 
+/**
+*   @fn         spi_flash_erase_start
+*   @brief      Start erasing one sector of SPI flash without waiting
+*   @param[IN]  u32Offset
+*                   Any address within the sector
+*   @return     Status of execution
+*   @note       Poll spi_flash_is_busy() until the erase completes
+*/
+int8_t spi_flash_erase_start(uint32_t u32Offset)
+{
+    int8_t ret = M2M_SUCCESS;
+    uint8_t  tmp = 0;
+    TRACE2(TRACE_FLASH_ERASE, u32Offset, FLASH_SECTOR_SZ);
+    ret += spi_flash_write_enable();
+    ret += spi_flash_read_status_reg(&tmp);
+    ret += spi_flash_sector_erase(u32Offset + 10);
+    return ret;
+}
+
+/**
+*   @fn         spi_flash_erase_block_start
+*   @brief      Start erasing one 32KB block of SPI flash without waiting
+*   @param[IN]  u32Offset
+*                   Any address within the block
+*   @return     Status of execution
+*   @note       Poll spi_flash_is_busy() until the erase completes
+*/
+int8_t spi_flash_erase_block_start(uint32_t u32Offset)
+{
+    int8_t ret = M2M_SUCCESS;
+    uint8_t  tmp = 0;
+    TRACE2(TRACE_FLASH_ERASE, u32Offset, FLASH_BLOCK_SIZE);
+    ret += spi_flash_write_enable();
+    ret += spi_flash_read_status_reg(&tmp);
+    ret += spi_flash_block_erase(u32Offset);
+    return ret;
+}
+
+/**
+*   @fn         spi_flash_page_program_start
+*   @brief      Start programming (at most) one page of SPI flash without
+*               waiting
+*   @param[IN]  pu8Buf
+*                   Pointer to data buffer
+*   @param[IN]  u32Offset
+*                   Address to write to at the SPI flash
+*   @param[IN]  u16Sz
+*                   Data size, which must not cross a page boundary
+*   @return     Status of execution
+*   @note       Poll spi_flash_is_busy() until the program completes.  The
+*               flash clears its write enable latch when done.
+*/
+int8_t spi_flash_page_program_start(uint8_t *pu8Buf, uint32_t u32Offset, uint16_t u16Sz)
+{
+    int8_t ret = M2M_SUCCESS;
+    spi_flash_write_enable();
+    /* use shared packet memory as temp mem */
+    ret += nm_write_block(HOST_SHARE_MEM_BASE, pu8Buf, u16Sz);
+    ret += spi_flash_page_program(HOST_SHARE_MEM_BASE, u32Offset, u16Sz);
+    return ret;
+}
+
+/**
+*   @fn         spi_flash_is_busy
+*   @brief      Read whether an erase or program is still in progress
+*   @param[OUT] pu8Busy
+*                   1 if busy, 0 if not
+*   @return     Status of execution
+*/
+int8_t spi_flash_is_busy(uint8_t *pu8Busy)
+{
+    uint8_t tmp = 0;
+    int8_t ret = spi_flash_read_status_reg(&tmp);
+    *pu8Busy = tmp & 0x01;
+    return ret;
+}
+
 /**
 *   @fn         spi_flash_get_size
 *   @brief      Get size of SPI Flash
@@ -585,7 +701,6 @@ ERR:
 uint32_t spi_flash_get_size(void)
 {
     uint32_t u32FlashId = 0, u32FlashPwr = 0;
-    static uint32_t gu32InternalFlashSize= 0;
 
     if(!gu32InternalFlashSize)
     {
@@ -605,4 +720,24 @@ uint32_t spi_flash_get_size(void)
     }
 
     return gu32InternalFlashSize;
-}
\ No newline at end of file
+}
+
+/**
+*   @fn         spi_flash_get_size_cache
+*   @brief      Return the size cached by spi_flash_get_size(), or 0 if none
+*/
+uint32_t spi_flash_get_size_cache(void)
+{
+    return gu32InternalFlashSize;
+}
+
+/**
+*   @fn         spi_flash_set_size_cache
+*   @brief      Set the size cached by spi_flash_get_size().  0 makes the
+*               next spi_flash_get_size() read it from the flash.  Lets a
+*               host that drives several WINCs keep one cache per WINC.
+*/
+void spi_flash_set_size_cache(uint32_t u32Size)
+{
+    gu32InternalFlashSize = u32Size;
+}
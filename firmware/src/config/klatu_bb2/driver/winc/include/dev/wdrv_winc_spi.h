@@ -42,6 +42,24 @@
 
 #include "system/ports/sys_ports.h"
 
+// *****************************************************************************
+/*  Maximum Number of WINCs
+
+  Summary:
+    The number of WINCs, each on its own SPI bus, that may be addressed.
+
+  Description:
+    See WDRV_WINC_SPITargetInitialize and WDRV_WINC_SPITargetSelect.
+
+  Remarks:
+    None.
+
+*/
+
+#ifndef WDRV_WINC_SPI_MAX_TARGETS
+#define WDRV_WINC_SPI_MAX_TARGETS   4
+#endif
+
 // *****************************************************************************
 /*  SPI Speed Modes
 
@@ -199,6 +217,65 @@ bool WDRV_WINC_SPIOpen(void);
 
 void WDRV_WINC_SPIInitialize(const WDRV_WINC_SPI_CFG *const pInitData);
 
+//*******************************************************************************
+/*
+  Function:
+    bool WDRV_WINC_SPITargetInitialize(unsigned int target,
+                const WDRV_WINC_SPI_CFG *const pInitData)
+
+  Summary:
+    Initializes the SPI object for an additional WINC.
+
+  Description:
+    This function initializes the SPI object for the WINC on another SPI
+    bus, for hosts that program several WINCs.  Target 0 is the WINC
+    initialized by WDRV_WINC_SPIInitialize.
+
+  Precondition:
+    None.
+
+  Parameters:
+    target    - 1 to WDRV_WINC_SPI_MAX_TARGETS - 1
+    pInitData - Pointer to initialization data
+
+  Returns:
+    true  - Indicates success
+    false - Indicates failure
+
+  Remarks:
+    Select the target and call WDRV_WINC_SPIOpen before using it.
+ */
+
+bool WDRV_WINC_SPITargetInitialize(unsigned int target, const WDRV_WINC_SPI_CFG *const pInitData);
+
+//*******************************************************************************
+/*
+  Function:
+    bool WDRV_WINC_SPITargetSelect(unsigned int target)
+
+  Summary:
+    Selects the WINC addressed by subsequent SPI transfers.
+
+  Description:
+    This function selects the WINC addressed by WDRV_WINC_SPISend,
+    WDRV_WINC_SPIReceive, WDRV_WINC_SPIOpen and WDRV_WINC_SPIDeinitialize.
+
+  Precondition:
+    None.
+
+  Parameters:
+    target - 0 to WDRV_WINC_SPI_MAX_TARGETS - 1
+
+  Returns:
+    true  - Indicates success
+    false - Indicates failure
+
+  Remarks:
+    Target 0 is selected at startup.  Transfers must not be in progress.
+ */
+
+bool WDRV_WINC_SPITargetSelect(unsigned int target);
+
 //*******************************************************************************
 /*
   Function:
@@ -128,6 +128,18 @@ int8_t cpu_start(void);
 */
 uint32_t nmi_get_chipid(void);
 /*
+*   @fn     nmi_get_chipid_cache
+*   @brief  Return the chip ID cached by nmi_get_chipid(), or 0 if none
+*/
+uint32_t nmi_get_chipid_cache(void);
+/*
+*   @fn     nmi_set_chipid_cache
+*   @brief  Set the chip ID cached by nmi_get_chipid().  0 makes the next
+*           nmi_get_chipid() read it from the chip.  Lets a host that drives
+*           several WINCs keep one cache per chip.
+*/
+void nmi_set_chipid_cache(uint32_t u32ChipId);
+/*
 *   @fn     nmi_get_rfrevid
 *   @brief
 */
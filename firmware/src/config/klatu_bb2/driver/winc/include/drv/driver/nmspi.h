@@ -73,6 +73,22 @@ int8_t nm_spi_reset(void);
 */
 int8_t nm_spi_deinit(void);
 
+/**
+*   @fn     nm_spi_get_crc_off
+*   @brief  Return the CRC mode negotiated by nm_spi_init()
+*   @return 1 if CRC is off, 0 if on
+*/
+uint8_t nm_spi_get_crc_off(void);
+
+/**
+*   @fn     nm_spi_set_crc_off
+*   @brief  Restore the CRC mode of the WINC about to be addressed, as saved
+*           by nm_spi_get_crc_off().  For hosts that drive several WINCs.
+*   @param [in] u8CrcOff
+*               1 if CRC is off, 0 if on
+*/
+void nm_spi_set_crc_off(uint8_t u8CrcOff);
+
 /**
 *   @fn     nm_spi_read_reg
 *   @brief  Read register
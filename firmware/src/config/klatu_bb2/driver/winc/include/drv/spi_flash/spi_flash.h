@@ -219,4 +219,59 @@ int8_t spi_flash_write(uint8_t* pu8Buf, uint32_t u32Offset, uint32_t u32Sz);
 int8_t spi_flash_erase(uint32_t u32Offset, uint32_t u32Sz);
  /**@}*/
 
+/*!
+ * @fn             int8_t spi_flash_erase_start(uint32_t);
+ * @brief          Start erasing the sector that holds u32Offset and return
+ *                 without waiting for the erase to complete.\n
+ * @note           Poll @ref spi_flash_is_busy until it reports not busy.
+ *                 Lets a host overlap the erase time of several WINCs.
+ * @return       The function returns @ref M2M_SUCCESS for successful operations  and a negative value otherwise.
+ */
+int8_t spi_flash_erase_start(uint32_t u32Offset);
+
+/*!
+ * @fn             int8_t spi_flash_erase_block_start(uint32_t);
+ * @brief          Start erasing the 32KB block that holds u32Offset and
+ *                 return without waiting for the erase to complete.\n
+ * @note           Poll @ref spi_flash_is_busy until it reports not busy.
+ *                 One block erase takes well under the time of erasing its
+ *                 eight sectors one at a time.
+ * @return       The function returns @ref M2M_SUCCESS for successful operations  and a negative value otherwise.
+ */
+int8_t spi_flash_erase_block_start(uint32_t u32Offset);
+
+/*!
+ * @fn             int8_t spi_flash_page_program_start(uint8_t *, uint32_t, uint16_t);
+ * @brief          Start programming u16Sz bytes, which must not cross a page
+ *                 boundary, and return without waiting for the program to
+ *                 complete.\n
+ * @note           Poll @ref spi_flash_is_busy until it reports not busy.
+ *                 The sector must have been erased first.
+ * @return       The function returns @ref M2M_SUCCESS for successful operations  and a negative value otherwise.
+ */
+int8_t spi_flash_page_program_start(uint8_t *pu8Buf, uint32_t u32Offset, uint16_t u16Sz);
+
+/*!
+ * @fn             int8_t spi_flash_is_busy(uint8_t *);
+ * @brief          Set *pu8Busy to 1 while an erase or program started by
+ *                 @ref spi_flash_erase_start or
+ *                 @ref spi_flash_page_program_start is in progress, else 0.
+ * @return       The function returns @ref M2M_SUCCESS for successful operations  and a negative value otherwise.
+ */
+int8_t spi_flash_is_busy(uint8_t *pu8Busy);
+
+/*!
+ * @fn             uint32_t spi_flash_get_size_cache(void);
+ * @brief          Return the size cached by @ref spi_flash_get_size, or 0.
+ */
+uint32_t spi_flash_get_size_cache(void);
+
+/*!
+ * @fn             void spi_flash_set_size_cache(uint32_t);
+ * @brief          Set the size cached by @ref spi_flash_get_size.  0 makes
+ *                 the next call read it from the flash.  Lets a host that
+ *                 drives several WINCs keep one cache per WINC.
+ */
+void spi_flash_set_size_cache(uint32_t u32Size);
+
 #endif  //__SPI_FLASH_H__
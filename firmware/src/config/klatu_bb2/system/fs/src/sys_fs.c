@@ -44,6 +44,7 @@
 
 #include "system/fs/src/sys_fs_local.h"
 #include "system/fs/sys_fs_media_manager.h"
+#include "prof.h"
 
 // *****************************************************************************
 /* Registration table for each native file system
@@ -1069,11 +1070,13 @@ size_t SYS_FS_FileRead
     }
     else
     {
+        PROF_BEGIN(PROF_FS_READ);
         fileStatus = fileObj->mountPoint->fsFunctions->read(
                 fileObj->nativeFSFileObj,
                 buffer,
                 nbyte,
                 &bytesRead);
+        PROF_END(PROF_FS_READ);
 
         /* Release the acquired mutex. */
         OSAL_MUTEX_Unlock(&(fileObj->mountPoint->mutexDiskVolume));
@@ -2405,11 +2408,13 @@ size_t SYS_FS_FileWrite
     }
     else
     {
+        PROF_BEGIN(PROF_FS_WRITE);
         fileStatus = fileObj->mountPoint->fsFunctions->write(
                 fileObj->nativeFSFileObj,
                 buffer,
                 nbyte,
                 &bytesWritten);
+        PROF_END(PROF_FS_WRITE);
 
         /* Release the acquired mutex. */
         OSAL_MUTEX_Unlock(&(fileObj->mountPoint->mutexDiskVolume));
@@ -2482,7 +2487,9 @@ SYS_FS_RESULT SYS_FS_FileSync
     osalResult = OSAL_MUTEX_Lock(&(fileObj->mountPoint->mutexDiskVolume), OSAL_WAIT_FOREVER);
     if (osalResult == OSAL_RESULT_TRUE)
     {
+        PROF_BEGIN(PROF_FS_SYNC);
         fileStatus = fileObj->mountPoint->fsFunctions->sync(fileObj->nativeFSFileObj);
+        PROF_END(PROF_FS_SYNC);
 
         /* Release the acquired mutex. */
         OSAL_MUTEX_Unlock(&(fileObj->mountPoint->mutexDiskVolume));
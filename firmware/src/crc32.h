@@ -0,0 +1,81 @@
+/**
+ * @file crc32.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief crc32 computes the IEEE 802.3 CRC-32 (as used by zlib and PNG).
+ *
+ * crc32 is used to fingerprint WINC flash sectors so that two sectors can be
+ * compared without having both sectors in memory at the same time.
+ */
+
+#ifndef _CRC32_H_
+#define _CRC32_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stddef.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+/**
+ * @brief The initial value to pass to crc32_update().
+ */
+#define CRC32_INITIAL_VALUE 0
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Extend a running CRC-32 with n_bytes of buf.
+ *
+ * Pass CRC32_INITIAL_VALUE as crc on the first call.  The result after the
+ * last call is the finished CRC; no further post-processing is required.
+ */
+uint32_t crc32_update(uint32_t crc, const uint8_t *buf, size_t n_bytes);
+
+/**
+ * @brief Compute the CRC-32 of n_bytes of buf.
+ */
+uint32_t crc32_compute(const uint8_t *buf, size_t n_bytes);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _CRC32_H_ */
@@ -0,0 +1,332 @@
+/**
+ * @file delta_image.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "delta_image.h"
+
+#include "crc32.h"
+#include "definitions.h"
+#include "trace.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+#define STATES(M)                                                              \
+  M(DELTA_IMAGE_STATE_IDLE)                                                    \
+  M(DELTA_IMAGE_STATE_MAKING)                                                  \
+  M(DELTA_IMAGE_STATE_COMPLETE)                                                \
+  M(DELTA_IMAGE_STATE_ERROR)
+
+#define EXPAND_STATE_IDS(_name) _name,
+typedef enum { STATES(EXPAND_STATE_IDS) } delta_image_state_t;
+
+typedef struct {
+  delta_image_state_t state;
+  SYS_FS_HANDLE base_handle;
+  SYS_FS_HANDLE target_handle;
+  SYS_FS_HANDLE delta_handle;
+  uint16_t idx; // index of the next sector
+  bool cancel_requested;
+  char delta_name[DELTA_IMAGE_NAME_LEN];
+} delta_image_ctx_t;
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+static void set_state(delta_image_state_t state);
+
+/**
+ * @brief Open the three files and check the images.  On failure, close
+ * whatever was opened and return false.
+ */
+static bool open_files(const char *base_name,
+                       const char *target_name,
+                       const char *delta_name);
+
+/**
+ * @brief Compare sector ctx->idx of the two images, record its CRCs and
+ * write a record for it if it changed.
+ */
+static bool make_sector(void);
+
+/**
+ * @brief Rewrite the header now that the CRCs and changed_map are complete.
+ */
+static bool write_header(void);
+
+/**
+ * @brief Close the files and go to the COMPLETE or ERROR state.
+ */
+static void finish(bool ok);
+
+static bool read_sector(SYS_FS_HANDLE file_handle, uint8_t *dst);
+
+static bool write_bytes(SYS_FS_HANDLE file_handle,
+                        const void *src,
+                        size_t n_bytes);
+
+static void set_changed(delta_image_header_t *header, uint16_t idx);
+
+// *****************************************************************************
+// Private (static) storage
+
+static delta_image_ctx_t s_delta_image_ctx;
+
+static delta_image_header_t s_header;
+
+static uint8_t s_base_buf[FLASH_SECTOR_SZ];
+static uint8_t s_target_buf[FLASH_SECTOR_SZ];
+
+// *****************************************************************************
+// Public code
+
+void delta_image_init(void) {
+  s_delta_image_ctx.state = DELTA_IMAGE_STATE_IDLE;
+}
+
+bool delta_image_make(const char *base_name,
+                      const char *target_name,
+                      const char *delta_name) {
+  delta_image_ctx_t *ctx = &s_delta_image_ctx;
+
+  if (delta_image_is_busy()) {
+    SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\ndelta_image is busy");
+    return false;
+  }
+  if (!open_files(base_name, target_name, delta_name)) {
+    set_state(DELTA_IMAGE_STATE_ERROR);
+    return false;
+  }
+  memset(&s_header, 0, sizeof(s_header));
+  s_header.version = DELTA_IMAGE_VERSION;
+  s_header.n_sectors = SYS_FS_FileSize(ctx->target_handle) / FLASH_SECTOR_SZ;
+  s_header.sector_size = FLASH_SECTOR_SZ;
+  strncpy(s_header.base_name, base_name, DELTA_IMAGE_NAME_LEN - 1);
+  strncpy(s_header.target_name, target_name, DELTA_IMAGE_NAME_LEN - 1);
+  strncpy(ctx->delta_name, delta_name, DELTA_IMAGE_NAME_LEN - 1);
+  ctx->delta_name[DELTA_IMAGE_NAME_LEN - 1] = '\0';
+  ctx->idx = 0;
+  ctx->cancel_requested = false;
+
+  // Reserve room for the header, without its magic number until the CRCs
+  // are known: a delta that is cancelled part way is never mistaken for one.
+  SYS_CONSOLE_MESSAGE("\n");
+  if (!write_bytes(ctx->delta_handle, &s_header, sizeof(s_header))) {
+    finish(false);
+    return false;
+  }
+  set_state(DELTA_IMAGE_STATE_MAKING);
+  return true;
+}
+
+void delta_image_step(void) {
+  delta_image_ctx_t *ctx = &s_delta_image_ctx;
+
+  if (ctx->state != DELTA_IMAGE_STATE_MAKING) {
+    return;
+  }
+  if (ctx->cancel_requested) {
+    SYS_CONSOLE_MESSAGE("\nDelta cancelled");
+    finish(false);
+  } else if (ctx->idx < s_header.n_sectors) {
+    if (!make_sector()) {
+      finish(false);
+    }
+  } else {
+    finish(write_header());
+  }
+}
+
+void delta_image_cancel(void) {
+  if (delta_image_is_busy()) {
+    s_delta_image_ctx.cancel_requested = true;
+  }
+}
+
+bool delta_image_is_busy(void) {
+  return s_delta_image_ctx.state == DELTA_IMAGE_STATE_MAKING;
+}
+
+bool delta_image_is_complete(void) {
+  return s_delta_image_ctx.state == DELTA_IMAGE_STATE_COMPLETE;
+}
+
+bool delta_image_is_changed(const delta_image_header_t *header, uint16_t idx) {
+  return (header->changed_map[idx / 32] & (1ul << (idx % 32))) != 0;
+}
+
+bool delta_image_header_is_valid(const delta_image_header_t *header) {
+  return (header->magic == DELTA_IMAGE_MAGIC) &&
+         (header->version == DELTA_IMAGE_VERSION) &&
+         (header->sector_size == FLASH_SECTOR_SZ) &&
+         (header->n_sectors <= DELTA_IMAGE_MAX_SECTORS) &&
+         (header->n_changed <= header->n_sectors);
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static void set_state(delta_image_state_t state) {
+  if (s_delta_image_ctx.state != state) {
+    TRACE2(TRACE_DELTA_IMAGE_STATE, s_delta_image_ctx.state, state);
+    s_delta_image_ctx.state = state;
+  }
+}
+
+static bool open_files(const char *base_name,
+                       const char *target_name,
+                       const char *delta_name) {
+  delta_image_ctx_t *ctx = &s_delta_image_ctx;
+  int32_t n_bytes;
+
+  ctx->base_handle = SYS_FS_FileOpen(base_name, SYS_FS_FILE_OPEN_READ);
+  if (ctx->base_handle == SYS_FS_HANDLE_INVALID) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nCould not open file %s", base_name);
+    return false;
+  }
+  ctx->target_handle = SYS_FS_FileOpen(target_name, SYS_FS_FILE_OPEN_READ);
+  if (ctx->target_handle == SYS_FS_HANDLE_INVALID) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nCould not open file %s", target_name);
+    SYS_FS_FileClose(ctx->base_handle);
+    return false;
+  }
+
+  n_bytes = SYS_FS_FileSize(ctx->target_handle);
+  ctx->delta_handle = SYS_FS_HANDLE_INVALID;
+  if (n_bytes != SYS_FS_FileSize(ctx->base_handle)) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\n%s and %s differ in size",
+                    base_name,
+                    target_name);
+  } else if ((n_bytes <= 0) || (n_bytes % FLASH_SECTOR_SZ != 0) ||
+             (n_bytes / FLASH_SECTOR_SZ > DELTA_IMAGE_MAX_SECTORS)) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\n%s has unsupported size %ld",
+                    target_name,
+                    n_bytes);
+  } else {
+    ctx->delta_handle = SYS_FS_FileOpen(delta_name, SYS_FS_FILE_OPEN_WRITE);
+    if (ctx->delta_handle == SYS_FS_HANDLE_INVALID) {
+      SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nCould not open file %s", delta_name);
+    }
+  }
+  if (ctx->delta_handle == SYS_FS_HANDLE_INVALID) {
+    SYS_FS_FileClose(ctx->target_handle);
+    SYS_FS_FileClose(ctx->base_handle);
+    return false;
+  }
+  return true;
+}
+
+static bool make_sector(void) {
+  delta_image_ctx_t *ctx = &s_delta_image_ctx;
+  uint16_t idx = ctx->idx;
+
+  if (!read_sector(ctx->base_handle, s_base_buf) ||
+      !read_sector(ctx->target_handle, s_target_buf)) {
+    return false;
+  }
+  s_header.base_crc[idx] = crc32_compute(s_base_buf, FLASH_SECTOR_SZ);
+  s_header.target_crc[idx] = crc32_compute(s_target_buf, FLASH_SECTOR_SZ);
+
+  if (memcmp(s_base_buf, s_target_buf, FLASH_SECTOR_SZ) == 0) {
+    // sector unchanged: nothing to record
+    SYS_CONSOLE_MESSAGE("=");
+  } else {
+    delta_image_record_t record = {.sector = idx};
+    if (!write_bytes(ctx->delta_handle, &record, sizeof(record)) ||
+        !write_bytes(ctx->delta_handle, s_target_buf, FLASH_SECTOR_SZ)) {
+      return false;
+    }
+    set_changed(&s_header, idx);
+    s_header.n_changed += 1;
+    SYS_CONSOLE_MESSAGE("!");
+  }
+  ctx->idx += 1;
+  return true;
+}
+
+static bool write_header(void) {
+  delta_image_ctx_t *ctx = &s_delta_image_ctx;
+
+  if (SYS_FS_FileSeek(ctx->delta_handle, 0, SYS_FS_SEEK_SET) != 0) {
+    SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\nFailed to rewind delta file");
+    return false;
+  }
+  s_header.magic = DELTA_IMAGE_MAGIC;
+  return write_bytes(ctx->delta_handle, &s_header, sizeof(s_header));
+}
+
+static void finish(bool ok) {
+  delta_image_ctx_t *ctx = &s_delta_image_ctx;
+
+  SYS_FS_FileClose(ctx->delta_handle);
+  SYS_FS_FileClose(ctx->target_handle);
+  SYS_FS_FileClose(ctx->base_handle);
+  if (ok) {
+    SYS_DEBUG_PRINT(SYS_ERROR_INFO,
+                    "\nSuccessfully wrote %s (%d of %d sectors changed)",
+                    ctx->delta_name,
+                    s_header.n_changed,
+                    s_header.n_sectors);
+  }
+  set_state(ok ? DELTA_IMAGE_STATE_COMPLETE : DELTA_IMAGE_STATE_ERROR);
+}
+
+static bool read_sector(SYS_FS_HANDLE file_handle, uint8_t *dst) {
+  if (SYS_FS_FileRead(file_handle, dst, FLASH_SECTOR_SZ) != FLASH_SECTOR_SZ) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\nFailed to read %ld bytes from file",
+                    FLASH_SECTOR_SZ);
+    return false;
+  }
+  return true;
+}
+
+static bool write_bytes(SYS_FS_HANDLE file_handle,
+                        const void *src,
+                        size_t n_bytes) {
+  if (SYS_FS_FileWrite(file_handle, src, n_bytes) != n_bytes) {
+    SYS_DEBUG_PRINT(
+        SYS_ERROR_ERROR, "\nFailed to write %ld bytes to file", n_bytes);
+    return false;
+  }
+  return true;
+}
+
+static void set_changed(delta_image_header_t *header, uint16_t idx) {
+  header->changed_map[idx / 32] |= (1ul << (idx % 32));
+}
+
+// *****************************************************************************
+// End of file
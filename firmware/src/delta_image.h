@@ -0,0 +1,153 @@
+/**
+ * @file delta_image.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief delta_image builds sector-delta files between two WINC images.
+ *
+ * A delta file holds only the sectors of a target image that differ from a
+ * named base image, along with the CRC-32 of every sector of both images.
+ * winc_cloner_apply_delta() uses the CRCs to confirm that the WINC holds the
+ * base (or already holds the target) before touching only the changed sectors.
+ *
+ * File layout (all fields little-endian):
+ *
+ *   delta_image_header_t                  (fixed size)
+ *   n_changed x {
+ *     delta_image_record_t                (sector index)
+ *     uint8_t data[FLASH_SECTOR_SZ]       (target sector contents)
+ *   }
+ *
+ * Records appear in ascending sector order, and a sector has a record if and
+ * only if its bit is set in changed_map.
+ */
+
+#ifndef _DELTA_IMAGE_H_
+#define _DELTA_IMAGE_H_
+
+// *****************************************************************************
+// Includes
+
+#include "spi_flash_map.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+#define DELTA_IMAGE_MAGIC 0x544c4457 // "WDLT" when read as little-endian bytes
+#define DELTA_IMAGE_VERSION 1
+
+// Largest supported image: 8 Mbit of WINC flash.
+#define DELTA_IMAGE_MAX_SECTORS (FLASH_8M_TOTAL_SZ / FLASH_SECTOR_SZ)
+
+#define DELTA_IMAGE_NAME_LEN 64
+
+typedef struct {
+  uint32_t magic;       // DELTA_IMAGE_MAGIC
+  uint16_t version;     // DELTA_IMAGE_VERSION
+  uint16_t n_sectors;   // # of sectors in both base and target image
+  uint16_t n_changed;   // # of sector records following the header
+  uint16_t reserved;
+  uint32_t sector_size; // FLASH_SECTOR_SZ
+  char base_name[DELTA_IMAGE_NAME_LEN];   // base image filename (informative)
+  char target_name[DELTA_IMAGE_NAME_LEN]; // target image filename (informative)
+  uint32_t changed_map[DELTA_IMAGE_MAX_SECTORS / 32]; // 1 bit per sector
+  uint32_t base_crc[DELTA_IMAGE_MAX_SECTORS];         // CRC-32 of base sectors
+  uint32_t target_crc[DELTA_IMAGE_MAX_SECTORS];       // CRC-32 of target
+} delta_image_header_t;
+
+typedef struct {
+  uint32_t sector; // sector index (not byte address) of the following data
+} delta_image_record_t;
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Initialize the delta_image module.  Called once at startup.
+ */
+void delta_image_init(void);
+
+/**
+ * @brief Start writing a delta file that transforms base_name into
+ * target_name.  The work is done in delta_image_step().
+ *
+ * Both images must be the same size, a whole number of sectors, and no larger
+ * than DELTA_IMAGE_MAX_SECTORS.
+ *
+ * @return true if the delta was started.
+ */
+bool delta_image_make(const char *base_name,
+                      const char *target_name,
+                      const char *delta_name);
+
+/**
+ * @brief Compare the next sector of the two images.  Called frequently.
+ */
+void delta_image_step(void);
+
+/**
+ * @brief Cancel the delta after the current sector.
+ *
+ * Note: a cancelled delta file is left without a valid header.
+ */
+void delta_image_cancel(void);
+
+/**
+ * @brief Return true if a delta is being made.
+ */
+bool delta_image_is_busy(void);
+
+/**
+ * @brief Return true if the last delta was written successfully.
+ */
+bool delta_image_is_complete(void);
+
+/**
+ * @brief Return true if sector idx has a record in the delta file.
+ */
+bool delta_image_is_changed(const delta_image_header_t *header, uint16_t idx);
+
+/**
+ * @brief Return true if header is a well-formed delta header.
+ */
+bool delta_image_header_is_valid(const delta_image_header_t *header);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _DELTA_IMAGE_H_ */
@@ -0,0 +1,192 @@
+/**
+ * @file device_record.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "device_record.h"
+
+#include "crc32.h"
+#include "definitions.h"
+#include "nmasic.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+// The CRC covers every field before it.
+#define RECORD_CRC_SIZE offsetof(device_record_t, crc)
+
+// twelve hex digits and the suffix
+#define MAX_RECORD_NAME_LENGTH                                                 \
+  (2 * DEVICE_RECORD_MAC_LEN + sizeof(DEVICE_RECORD_SUFFIX))
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+static void record_name(char *dst, size_t size, const uint8_t *mac);
+
+/**
+ * @brief Fill in the size and timestamp of image_name.
+ */
+static bool image_stamp(const char *image_name,
+                        uint32_t *size,
+                        uint32_t *stamp);
+
+static uint32_t record_crc(const device_record_t *record);
+
+// *****************************************************************************
+// Private (static) storage
+
+static SYS_FS_FSTAT s_stat; // too big for the stack
+
+// *****************************************************************************
+// Public code
+
+bool device_record_init(device_record_t *record,
+                        const uint8_t *mac,
+                        const char *image_name,
+                        flash_region_set_t regions) {
+  memset(record, 0, sizeof(*record));
+  if (!image_stamp(image_name, &record->image_size, &record->image_stamp)) {
+    return false;
+  }
+  record->magic = DEVICE_RECORD_MAGIC;
+  record->version = DEVICE_RECORD_VERSION;
+  memcpy(record->mac, mac, DEVICE_RECORD_MAC_LEN);
+  record->chip_id = nmi_get_chipid();
+  strncpy(record->image_name, image_name, IMAGE_MANIFEST_NAME_LEN - 1);
+  record->regions = regions;
+  return true;
+}
+
+bool device_record_read(const uint8_t *mac, device_record_t *record) {
+  char filename[MAX_RECORD_NAME_LENGTH];
+  SYS_FS_HANDLE file_handle;
+  bool ret;
+
+  record_name(filename, sizeof(filename), mac);
+  file_handle = SYS_FS_FileOpen(filename, SYS_FS_FILE_OPEN_READ);
+  if (file_handle == SYS_FS_HANDLE_INVALID) {
+    // a WINC not seen before: not an error
+    return false;
+  }
+  ret = (SYS_FS_FileRead(file_handle, record, sizeof(*record)) ==
+         sizeof(*record)) &&
+        (record->magic == DEVICE_RECORD_MAGIC) &&
+        (record->version == DEVICE_RECORD_VERSION) &&
+        (record->n_sectors <= IMAGE_MANIFEST_MAX_SECTORS) &&
+        (memcmp(record->mac, mac, DEVICE_RECORD_MAC_LEN) == 0) &&
+        (record->crc == record_crc(record));
+  SYS_FS_FileClose(file_handle);
+
+  if (!ret) {
+    SYS_DEBUG_PRINT(
+        SYS_ERROR_WARNING, "\nIgnoring invalid device record %s", filename);
+  }
+  return ret;
+}
+
+bool device_record_write(device_record_t *record) {
+  char filename[MAX_RECORD_NAME_LENGTH];
+  SYS_FS_HANDLE file_handle;
+  bool ret;
+
+  record->crc = record_crc(record);
+  record_name(filename, sizeof(filename), record->mac);
+  file_handle = SYS_FS_FileOpen(filename, SYS_FS_FILE_OPEN_WRITE);
+  if (file_handle == SYS_FS_HANDLE_INVALID) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nCould not open file %s", filename);
+    return false;
+  }
+  ret = SYS_FS_FileWrite(file_handle, record, sizeof(*record)) ==
+        sizeof(*record);
+  SYS_FS_FileClose(file_handle);
+
+  if (!ret) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nFailed to write %s", filename);
+  }
+  return ret;
+}
+
+void device_record_remove(const uint8_t *mac) {
+  char filename[MAX_RECORD_NAME_LENGTH];
+
+  record_name(filename, sizeof(filename), mac);
+  SYS_FS_FileDirectoryRemove(filename);
+}
+
+bool device_record_is_for_image(const device_record_t *record,
+                                const char *image_name) {
+  uint32_t size;
+  uint32_t stamp;
+
+  return (strncmp(record->image_name, image_name, IMAGE_MANIFEST_NAME_LEN) ==
+          0) &&
+         image_stamp(image_name, &size, &stamp) &&
+         (record->image_size == size) && (record->image_stamp == stamp) &&
+         (record->chip_id == nmi_get_chipid());
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static void record_name(char *dst, size_t size, const uint8_t *mac) {
+  snprintf(dst,
+           size,
+           "%02x%02x%02x%02x%02x%02x%s",
+           mac[0],
+           mac[1],
+           mac[2],
+           mac[3],
+           mac[4],
+           mac[5],
+           DEVICE_RECORD_SUFFIX);
+}
+
+static bool image_stamp(const char *image_name,
+                        uint32_t *size,
+                        uint32_t *stamp) {
+  s_stat.lfname = NULL;
+  if (SYS_FS_FileStat(image_name, &s_stat) != SYS_FS_RES_SUCCESS) {
+    return false;
+  }
+  *size = s_stat.fsize;
+  *stamp = ((uint32_t)s_stat.fdate << 16) | s_stat.ftime;
+  return true;
+}
+
+static uint32_t record_crc(const device_record_t *record) {
+  return crc32_compute((const uint8_t *)record, RECORD_CRC_SIZE);
+}
+
+// *****************************************************************************
+// End of file
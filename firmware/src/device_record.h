@@ -0,0 +1,128 @@
+/**
+ * @file device_record.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief device_record keeps a record on the SD card for each WINC that has
+ * been updated, keyed by the MAC address in its OTP memory: the image it was
+ * last updated from and the CRC-32 of every sector that the update wrote.
+ *
+ * When the same WINC comes back for the same image, winc_cloner trusts the
+ * record for the regions that do not change in the field and only spot
+ * checks them, reading the others (FLASH_REGION_SET_MUTABLE) in full.
+ */
+
+#ifndef _DEVICE_RECORD_H_
+#define _DEVICE_RECORD_H_
+
+// *****************************************************************************
+// Includes
+
+#include "flash_regions.h"
+#include "image_manifest.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+#define DEVICE_RECORD_MAGIC 0x56454457 // "WDEV" when read as little-endian
+#define DEVICE_RECORD_VERSION 1
+#define DEVICE_RECORD_SUFFIX ".dev" // after the MAC address in hex
+
+#define DEVICE_RECORD_MAC_LEN 6
+
+typedef struct {
+  uint32_t magic;     // DEVICE_RECORD_MAGIC
+  uint16_t version;   // DEVICE_RECORD_VERSION
+  uint16_t n_sectors; // # of valid entries in sector_crc[]
+  uint8_t mac[DEVICE_RECORD_MAC_LEN];
+  uint8_t reserved[2];
+  uint32_t chip_id;
+  char image_name[IMAGE_MANIFEST_NAME_LEN]; // the image last written
+  uint32_t image_size;                      // in bytes
+  uint32_t image_stamp; // FAT date (high half) and time of the image file
+  flash_region_set_t regions; // the regions that were written
+  uint32_t sector_crc[IMAGE_MANIFEST_MAX_SECTORS]; // as written
+  uint32_t crc; // CRC-32 of all the preceding fields
+} device_record_t;
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Fill in the identity of the open WINC, whose MAC address is mac,
+ * and of image_name, for an update of regions.  The caller fills in
+ * n_sectors and sector_crc[].
+ *
+ * @return false if image_name cannot be found.
+ */
+bool device_record_init(device_record_t *record,
+                        const uint8_t *mac,
+                        const char *image_name,
+                        flash_region_set_t regions);
+
+/**
+ * @brief Read the record for the WINC with the given MAC address.
+ *
+ * @return true if there is a valid record.
+ */
+bool device_record_read(const uint8_t *mac, device_record_t *record);
+
+/**
+ * @brief Write record to the card, replacing any earlier one for its WINC.
+ *
+ * @return true on success.
+ */
+bool device_record_write(device_record_t *record);
+
+/**
+ * @brief Remove the record for the WINC with the given MAC address, once its
+ * flash no longer matches it.
+ */
+void device_record_remove(const uint8_t *mac);
+
+/**
+ * @brief Return true if record was written from image_name as it is now
+ * (same size and timestamp), on the open WINC.
+ */
+bool device_record_is_for_image(const device_record_t *record,
+                                const char *image_name);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _DEVICE_RECORD_H_ */
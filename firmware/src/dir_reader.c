@@ -31,36 +31,61 @@
 #include "dir_reader.h"
 
 #include "app.h"
+#include "crc32.h"
 #include "definitions.h"
+#include "image_manifest.h"
+#include "m2m_types.h"
+#include "sched.h"
+#include "spi_flash_map.h"
+#include <ctype.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 
 // *****************************************************************************
 // Private types and definitions
 
-#define MAX_FILENAME_LENGTH 80
-#define MAX_IMG_FILENAMES 20
+#define IMAGE_EXTENSION ".img"
 
-#define IMAGE_EXTENSION ".wimg"
+#define INDEX_MAGIC 0x58444957 // "WIDX" when read as little-endian bytes
+#define INDEX_VERSION 1
+
+#define DIR_READER_TASK_PRIORITY 1
 
 #define STATES(M)                                                              \
   M(DIR_READER_STATE_IDLE)                                                     \
   M(DIR_READER_STATE_OPENING_DIRECTORY)                                        \
-  M(DIR_READER_STATE_READING_DIRECTORY)                                        \
+  M(DIR_READER_STATE_SCANNING_DIRECTORY)                                       \
   M(DIR_READER_STATE_CLOSING_DIRECTORY)                                        \
+  M(DIR_READER_STATE_CHECKING_INDEX)                                           \
+  M(DIR_READER_STATE_OPENING_INDEX)                                            \
+  M(DIR_READER_STATE_CATALOGING)                                               \
+  M(DIR_READER_STATE_CLOSING_INDEX)                                            \
   M(DIR_READER_STATE_COMPLETE)                                                 \
   M(DIR_READER_STATE_ERROR)
 
 #define EXPAND_STATE_IDS(_name) _name,
 typedef enum { STATES(EXPAND_STATE_IDS) } dir_reader_state_t;
 
+typedef struct {
+  uint32_t magic;     // INDEX_MAGIC, written last
+  uint16_t version;   // INDEX_VERSION
+  uint16_t n_entries; // # of dir_reader_entry_t that follow
+  uint32_t signature; // CRC-32 over the directory entries
+  uint32_t reserved;
+} index_header_t;
+
 typedef struct {
   dir_reader_state_t state;
   dir_reader_callback_fn callback_fn;
   uintptr_t callback_arg;
+  sched_task_id_t task;
   SYS_FS_HANDLE dir_handle;
-  uint8_t file_count; // # of .img files found
+  SYS_FS_HANDLE index_handle;
+  uint16_t file_count; // # of .img files found
+  uint32_t signature;  // CRC-32 over the directory entries
 } dir_reader_ctx_t;
 
 // *****************************************************************************
@@ -82,9 +107,39 @@ static const char *state_name(dir_reader_state_t state);
 static void endgame(dir_reader_state_t final_state);
 
 /**
- * @brief Return true if the last chars of str equal suffix.
+ * @brief Open the root directory and advance to next_state.
+ */
+static void open_directory(dir_reader_state_t next_state);
+
+/**
+ * @brief Read the next directory entry into s_stat.  Returns false at the end
+ * of the directory or on error (in which case the state is set to ERROR).
+ */
+static bool read_directory(void);
+
+/**
+ * @brief Fold the directory entry in s_stat into the directory signature.
+ */
+static void update_signature(const SYS_FS_FSTAT *stat);
+
+/**
+ * @brief Fill in entry for the image named by stat.
+ */
+static void catalog_image(const SYS_FS_FSTAT *stat, dir_reader_entry_t *entry);
+
+/**
+ * @brief Write the firmware version stored in the image's control sector.
+ */
+static void read_image_version(const char *name, char *version, size_t size);
+
+/**
+ * @brief Return true if str names an image file.
+ */
+static bool is_image_name(const char *str);
+
+/**
+ * @brief Return true if the last chars of str equal suffix, ignoring case.
  */
-__attribute__((unused))
 static bool string_ends_with(const char *str, const char *suffix);
 
 // *****************************************************************************
@@ -95,9 +150,11 @@ static const char *s_state_names[] = {STATES(EXPAND_STATE_NAMES)};
 
 #define N_STATES (sizeof(s_state_names) / sizeof(s_state_names[0]))
 
-char s_filenames[MAX_IMG_FILENAMES * MAX_FILENAME_LENGTH];
+static SYS_FS_FSTAT s_stat;
+
+static dir_reader_entry_t s_entry;
 
-char s_filename[MAX_FILENAME_LENGTH]; // to hold stat's long file names
+static image_manifest_t s_manifest;
 
 static dir_reader_ctx_t s_dir_reader_ctx;
 
@@ -107,74 +164,155 @@ static dir_reader_ctx_t s_dir_reader_ctx;
 void dir_reader_init(void) {
   s_dir_reader_ctx.state = DIR_READER_STATE_IDLE;
   s_dir_reader_ctx.dir_handle = SYS_FS_HANDLE_INVALID;
+  s_dir_reader_ctx.index_handle = SYS_FS_HANDLE_INVALID;
+  s_dir_reader_ctx.task = sched_task_create(
+      "dir_reader", dir_reader_step, DIR_READER_TASK_PRIORITY);
 }
 
 /**
- * @brief Step the demo task internal state.  Called frequently.
+ * @brief Step the dir_reader internal state.  Registered as a sched task.
  */
 void dir_reader_step(void) {
+  (void)sched_take_events();
   switch (s_dir_reader_ctx.state) {
   case DIR_READER_STATE_IDLE: {
-    // wait here for a call to dirlist_read_directory()
+    // wait here for a call to dir_reader_read_directory()
+    sched_wait_ms(SCHED_FOREVER);
   } break;
 
   case DIR_READER_STATE_OPENING_DIRECTORY: {
     // here when dirlist_read_directory() has been called.
     s_dir_reader_ctx.file_count = 0;
-    memset(s_filenames, 0, sizeof(s_filenames));
+    s_dir_reader_ctx.signature = CRC32_INITIAL_VALUE;
+    open_directory(DIR_READER_STATE_SCANNING_DIRECTORY);
+  } break;
 
-    s_dir_reader_ctx.dir_handle = SYS_FS_DirOpen(SD_MOUNT_NAME "/");
-    if (s_dir_reader_ctx.dir_handle != SYS_FS_HANDLE_INVALID) {
-      set_state(DIR_READER_STATE_READING_DIRECTORY);
-    } else {
+  case DIR_READER_STATE_SCANNING_DIRECTORY: {
+    // Fold one directory entry per call into the signature.  This is cheap:
+    // no files are opened.
+    if (read_directory()) {
+      update_signature(&s_stat);
+      if (is_image_name(s_stat.fname)) {
+        s_dir_reader_ctx.file_count += 1;
+      }
+    } else if (s_dir_reader_ctx.state != DIR_READER_STATE_ERROR) {
+      set_state(DIR_READER_STATE_CLOSING_DIRECTORY);
+    }
+  } break;
+
+  case DIR_READER_STATE_CLOSING_DIRECTORY: {
+    if (SYS_FS_DirClose(s_dir_reader_ctx.dir_handle) != SYS_FS_RES_SUCCESS) {
       SYS_DEBUG_PRINT(
-          SYS_ERROR_ERROR, "\nUnable to open directory %s", SD_MOUNT_NAME "/");
-      endgame(DIR_READER_STATE_ERROR);
+          SYS_ERROR_ERROR, "\nClosing directory %s failed", SD_MOUNT_NAME "/");
     }
+    s_dir_reader_ctx.dir_handle = SYS_FS_HANDLE_INVALID;
+    set_state(DIR_READER_STATE_CHECKING_INDEX);
   } break;
 
-  case DIR_READER_STATE_READING_DIRECTORY: {
-    // remain in this state until all directory entries are read and printed
-    SYS_FS_FSTAT stat;
-    stat.lfname = s_filename;
-    stat.lfsize = sizeof(s_filename);
+  case DIR_READER_STATE_CHECKING_INDEX: {
+    // Reuse the index if it was built from an identical directory.
+    index_header_t header;
+    SYS_FS_HANDLE handle =
+        SYS_FS_FileOpen(DIR_READER_INDEX_NAME, SYS_FS_FILE_OPEN_READ);
+    bool is_current =
+        (handle != SYS_FS_HANDLE_INVALID) &&
+        (SYS_FS_FileRead(handle, &header, sizeof(header)) == sizeof(header)) &&
+        (header.magic == INDEX_MAGIC) && (header.version == INDEX_VERSION) &&
+        (header.signature == s_dir_reader_ctx.signature) &&
+        (header.n_entries == s_dir_reader_ctx.file_count);
+    if (handle != SYS_FS_HANDLE_INVALID) {
+      SYS_FS_FileClose(handle);
+    }
+    if (is_current) {
+      endgame(DIR_READER_STATE_COMPLETE);
+    } else {
+      SYS_CONSOLE_MESSAGE("\nUpdating " DIR_READER_INDEX_NAME);
+      set_state(DIR_READER_STATE_OPENING_INDEX);
+    }
+  } break;
 
-    if (SYS_FS_DirRead(s_dir_reader_ctx.dir_handle, &stat) ==
-        SYS_FS_RES_FAILURE) {
+  case DIR_READER_STATE_OPENING_INDEX: {
+    // Start the index with a header that is not yet valid.
+    index_header_t header;
+    memset(&header, 0, sizeof(header));
+    s_dir_reader_ctx.file_count = 0;
+    s_dir_reader_ctx.index_handle =
+        SYS_FS_FileOpen(DIR_READER_INDEX_NAME, SYS_FS_FILE_OPEN_WRITE);
+    if ((s_dir_reader_ctx.index_handle == SYS_FS_HANDLE_INVALID) ||
+        (SYS_FS_FileWrite(s_dir_reader_ctx.index_handle,
+                          &header,
+                          sizeof(header)) != sizeof(header))) {
       SYS_DEBUG_PRINT(
-          SYS_ERROR_ERROR, "\nUnable to read directory %s", SD_MOUNT_NAME "/");
+          SYS_ERROR_ERROR, "\nUnable to write %s", DIR_READER_INDEX_NAME);
       endgame(DIR_READER_STATE_ERROR);
-
-    } else if ((stat.lfname[0] == '\0') && (stat.fname[0] == '\0')) {
-      set_state(DIR_READER_STATE_CLOSING_DIRECTORY);
-
-    } else if (s_dir_reader_ctx.file_count >= MAX_IMG_FILENAMES) {
-        SYS_DEBUG_PRINT(
-            SYS_ERROR_ERROR, "\ndirectory full, skipping %s", stat.fname);
     } else {
-      // read succeeded.  Record it.
-      strncpy((char *)dir_reader_filename_ref(s_dir_reader_ctx.file_count++),
-              (const char *)stat.fname,
-              MAX_FILENAME_LENGTH);
+      open_directory(DIR_READER_STATE_CATALOGING);
     }
-    // remain in this state to read more filenames
   } break;
 
-  case DIR_READER_STATE_CLOSING_DIRECTORY: {
-    if (SYS_FS_DirClose(s_dir_reader_ctx.dir_handle) != SYS_FS_RES_SUCCESS) {
-      SYS_DEBUG_PRINT(
-          SYS_ERROR_ERROR, "\nClosing directory %s failed", SD_MOUNT_NAME "/");
+  case DIR_READER_STATE_CATALOGING: {
+    // Catalog one image per call.
+    if (read_directory()) {
+      if (is_image_name(s_stat.fname)) {
+        catalog_image(&s_stat, &s_entry);
+        if (SYS_FS_FileWrite(s_dir_reader_ctx.index_handle,
+                             &s_entry,
+                             sizeof(s_entry)) != sizeof(s_entry)) {
+          SYS_DEBUG_PRINT(
+              SYS_ERROR_ERROR, "\nUnable to write %s", DIR_READER_INDEX_NAME);
+          set_state(DIR_READER_STATE_ERROR);
+        } else {
+          s_dir_reader_ctx.file_count += 1;
+          SYS_CONSOLE_MESSAGE(".");
+        }
+      }
+    } else if (s_dir_reader_ctx.state != DIR_READER_STATE_ERROR) {
+      set_state(DIR_READER_STATE_CLOSING_INDEX);
+    }
+    if (s_dir_reader_ctx.state == DIR_READER_STATE_ERROR) {
+      SYS_FS_DirClose(s_dir_reader_ctx.dir_handle);
+      SYS_FS_FileClose(s_dir_reader_ctx.index_handle);
+      s_dir_reader_ctx.dir_handle = SYS_FS_HANDLE_INVALID;
+      s_dir_reader_ctx.index_handle = SYS_FS_HANDLE_INVALID;
+      endgame(DIR_READER_STATE_ERROR);
     }
+  } break;
+
+  case DIR_READER_STATE_CLOSING_INDEX: {
+    // Now that all entries are written, mark the index as valid.
+    index_header_t header = {
+        .magic = INDEX_MAGIC,
+        .version = INDEX_VERSION,
+        .n_entries = s_dir_reader_ctx.file_count,
+        .signature = s_dir_reader_ctx.signature,
+    };
+    bool ok = (SYS_FS_FileSeek(s_dir_reader_ctx.index_handle,
+                               0,
+                               SYS_FS_SEEK_SET) == 0) &&
+              (SYS_FS_FileWrite(s_dir_reader_ctx.index_handle,
+                                &header,
+                                sizeof(header)) == sizeof(header));
+    SYS_FS_FileClose(s_dir_reader_ctx.index_handle);
+    SYS_FS_DirClose(s_dir_reader_ctx.dir_handle);
     s_dir_reader_ctx.dir_handle = SYS_FS_HANDLE_INVALID;
-    endgame(DIR_READER_STATE_COMPLETE);
+    s_dir_reader_ctx.index_handle = SYS_FS_HANDLE_INVALID;
+    if (ok) {
+      endgame(DIR_READER_STATE_COMPLETE);
+    } else {
+      SYS_DEBUG_PRINT(
+          SYS_ERROR_ERROR, "\nUnable to write %s", DIR_READER_INDEX_NAME);
+      endgame(DIR_READER_STATE_ERROR);
+    }
   } break;
 
   case DIR_READER_STATE_COMPLETE: {
-    // here on error state
+    // here on complete state, until the next dir_reader_read_directory()
+    sched_wait_ms(SCHED_FOREVER);
   } break;
 
   case DIR_READER_STATE_ERROR: {
-    // here on error state
+    // here on error state, until the next dir_reader_read_directory()
+    sched_wait_ms(SCHED_FOREVER);
   } break;
   } // switch
 }
@@ -187,16 +325,29 @@ void dir_reader_set_callback(dir_reader_callback_fn callback_fn,
 
 void dir_reader_read_directory(void) {
   set_state(DIR_READER_STATE_OPENING_DIRECTORY);
+  sched_signal(s_dir_reader_ctx.task, 1);
 }
 
-uint8_t dir_reader_filename_count(void) { return s_dir_reader_ctx.file_count; }
+uint16_t dir_reader_filename_count(void) {
+  return s_dir_reader_ctx.file_count;
+}
 
-const char *dir_reader_filename_ref(uint8_t idx) {
-  if (idx < s_dir_reader_ctx.file_count) {
-    return &s_filenames[idx * MAX_FILENAME_LENGTH];
-  } else {
-    return NULL;
+bool dir_reader_get_entry(uint16_t idx, dir_reader_entry_t *entry) {
+  SYS_FS_HANDLE handle;
+  int32_t offset = sizeof(index_header_t) + idx * sizeof(dir_reader_entry_t);
+  bool ret;
+
+  if (idx >= s_dir_reader_ctx.file_count) {
+    return false;
+  }
+  handle = SYS_FS_FileOpen(DIR_READER_INDEX_NAME, SYS_FS_FILE_OPEN_READ);
+  if (handle == SYS_FS_HANDLE_INVALID) {
+    return false;
   }
+  ret = (SYS_FS_FileSeek(handle, offset, SYS_FS_SEEK_SET) == offset) &&
+        (SYS_FS_FileRead(handle, entry, sizeof(*entry)) == sizeof(*entry));
+  SYS_FS_FileClose(handle);
+  return ret;
 }
 
 bool dir_reader_is_idle(void) {
@@ -236,7 +387,96 @@ static void endgame(dir_reader_state_t final_state) {
   }
 }
 
-__attribute__((unused))
+static void open_directory(dir_reader_state_t next_state) {
+  s_dir_reader_ctx.dir_handle = SYS_FS_DirOpen(SD_MOUNT_NAME "/");
+  if (s_dir_reader_ctx.dir_handle != SYS_FS_HANDLE_INVALID) {
+    set_state(next_state);
+  } else {
+    SYS_DEBUG_PRINT(
+        SYS_ERROR_ERROR, "\nUnable to open directory %s", SD_MOUNT_NAME "/");
+    if (s_dir_reader_ctx.index_handle != SYS_FS_HANDLE_INVALID) {
+      SYS_FS_FileClose(s_dir_reader_ctx.index_handle);
+      s_dir_reader_ctx.index_handle = SYS_FS_HANDLE_INVALID;
+    }
+    endgame(DIR_READER_STATE_ERROR);
+  }
+}
+
+static bool read_directory(void) {
+  // For FAT, fname holds the long file name: lfname is not used.
+  s_stat.lfname = NULL;
+  s_stat.lfsize = 0;
+
+  if (SYS_FS_DirRead(s_dir_reader_ctx.dir_handle, &s_stat) ==
+      SYS_FS_RES_FAILURE) {
+    SYS_DEBUG_PRINT(
+        SYS_ERROR_ERROR, "\nUnable to read directory %s", SD_MOUNT_NAME "/");
+    set_state(DIR_READER_STATE_ERROR);
+    return false;
+  }
+  return s_stat.fname[0] != '\0';
+}
+
+static void update_signature(const SYS_FS_FSTAT *stat) {
+  uint32_t crc = s_dir_reader_ctx.signature;
+
+  if (strcmp(stat->fname, DIR_READER_INDEX_NAME) == 0) {
+    // the index itself is not part of the signature
+    return;
+  }
+  // Any added, removed, resized or rewritten file changes the signature.
+  crc = crc32_update(crc, (const uint8_t *)stat->fname, strlen(stat->fname));
+  crc = crc32_update(crc, (const uint8_t *)&stat->fsize, sizeof(stat->fsize));
+  crc = crc32_update(crc, (const uint8_t *)&stat->fdate, sizeof(stat->fdate));
+  crc = crc32_update(crc, (const uint8_t *)&stat->ftime, sizeof(stat->ftime));
+  s_dir_reader_ctx.signature = crc;
+}
+
+static void catalog_image(const SYS_FS_FSTAT *stat, dir_reader_entry_t *entry) {
+  memset(entry, 0, sizeof(*entry));
+  strncpy(entry->name, stat->fname, DIR_READER_MAX_NAME_LENGTH - 1);
+  entry->size = stat->fsize;
+  read_image_version(stat->fname, entry->version, sizeof(entry->version));
+  if (image_manifest_read(stat->fname, &s_manifest)) {
+    entry->has_manifest = true;
+    memcpy(entry->sha256, s_manifest.sha256, SHA256_DIGEST_SIZE);
+  }
+}
+
+static void read_image_version(const char *name, char *version, size_t size) {
+  tstrOtaControlSec control;
+  SYS_FS_HANDLE handle;
+  bool ok;
+
+  handle = SYS_FS_FileOpen(name, SYS_FS_FILE_OPEN_READ);
+  if (handle == SYS_FS_HANDLE_INVALID) {
+    snprintf(version, size, "?");
+    return;
+  }
+  ok = (SYS_FS_FileSeek(handle, M2M_CONTROL_FLASH_OFFSET, SYS_FS_SEEK_SET) ==
+        M2M_CONTROL_FLASH_OFFSET) &&
+       (SYS_FS_FileRead(handle, &control, sizeof(control)) ==
+        sizeof(control)) &&
+       (control.u32OtaMagicValue == OTA_MAGIC_VALUE);
+  SYS_FS_FileClose(handle);
+
+  if (ok) {
+    uint32_t ver = control.u32OtaCurrentworkingImagFirmwareVer;
+    snprintf(version,
+             size,
+             "%d.%d.%d",
+             M2M_GET_FW_MAJOR(ver),
+             M2M_GET_FW_MINOR(ver),
+             M2M_GET_FW_PATCH(ver));
+  } else {
+    snprintf(version, size, "?");
+  }
+}
+
+static bool is_image_name(const char *str) {
+  return string_ends_with(str, IMAGE_EXTENSION);
+}
+
 static bool string_ends_with(const char *str, const char *suffix) {
   if (str == NULL) {
     return false;
@@ -247,10 +487,16 @@ static bool string_ends_with(const char *str, const char *suffix) {
   size_t suffix_len = strlen(suffix);
   if (str_len < suffix_len) {
     return false;
-  } else {
-    // compare strings starting at suffix_len from the end of str.
-    return strcmp(&str[str_len - suffix_len], suffix) == 0;
   }
+  // compare strings starting at suffix_len from the end of str.  FAT file
+  // names are case insensitive, so the comparison is too.
+  str = &str[str_len - suffix_len];
+  for (size_t i = 0; i < suffix_len; i++) {
+    if (tolower((unsigned char)str[i]) != tolower((unsigned char)suffix[i])) {
+      return false;
+    }
+  }
+  return true;
 }
 
 // *****************************************************************************
@@ -25,7 +25,16 @@
  */
 
 /**
- * @brief dir_reader lists the available .img files in the root directory.
+ * @brief dir_reader catalogs the available .img files in the root directory.
+ *
+ * The catalog is kept in an index file (DIR_READER_INDEX_NAME) on the card
+ * holding each image's name, size, firmware version and manifest digest.
+ * dir_reader_read_directory() makes one quick pass over the directory entries
+ * to compute a signature; if it matches the index, the index is reused as-is.
+ * Otherwise the index is rebuilt, which opens every image once.
+ *
+ * Entries are read from the index on demand, so there is no limit on the
+ * number of images other than the card itself.
  */
 
 #ifndef _DIR_READER_H_
@@ -34,6 +43,7 @@
 // *****************************************************************************
 // Includes
 
+#include "sha256.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -48,6 +58,22 @@ extern "C" {
 // *****************************************************************************
 // Public types and definitions
 
+#define DIR_READER_INDEX_NAME "catalog.idx"
+#define DIR_READER_MAX_NAME_LENGTH 80
+#define DIR_READER_VERSION_LENGTH 16
+
+/**
+ * @brief One image in the catalog.
+ */
+typedef struct {
+  char name[DIR_READER_MAX_NAME_LENGTH];
+  uint32_t size;
+  char version[DIR_READER_VERSION_LENGTH]; // e.g. "19.7.7", or "?"
+  uint8_t has_manifest;                    // true if sha256 is valid
+  uint8_t reserved[3];
+  uint8_t sha256[SHA256_DIGEST_SIZE]; // from the image's manifest
+} dir_reader_entry_t;
+
 /**
  * @brief Signature for the callback function.
  */
@@ -57,12 +83,14 @@ typedef void (*dir_reader_callback_fn)(uintptr_t arg);
 // Public declarations
 
 /**
- * @brief Initialize the dir_reader.  Called once at startup.
+ * @brief Initialize the dir_reader and register it as a sched task.  Call
+ * after sched_init().
  */
 void dir_reader_init(void);
 
 /**
- * @brief Step the dir_reader internal state.  Called frequently.
+ * @brief Step the dir_reader internal state.  Registered as a sched task by
+ * dir_reader_init().
  */
 void dir_reader_step(void);
 
@@ -73,9 +101,9 @@ void dir_reader_set_callback(dir_reader_callback_fn callback_fn,
                              uintptr_t callback_arg);
 
 /**
- * @brief Read the rood directory to discover the .img files.
+ * @brief Read the root directory to discover the .img files.
  *
- * Note: this is asynchronous.  The results are avaiable after
+ * Note: this is asynchronous.  The results are available after
  * dir_reader_is_complete() returns true.
  */
 void dir_reader_read_directory(void);
@@ -85,14 +113,16 @@ void dir_reader_read_directory(void);
  *
  * Note: valid only after dir_reader_is_complete() returns true.
  */
-uint8_t dir_reader_filename_count(void);
+uint16_t dir_reader_filename_count(void);
 
 /**
- * @brief Return the idx'th image filename, or NULL if idx is out of bounds.
+ * @brief Read the idx'th catalog entry into entry.
  *
  * Note: valid only after dir_reader_is_complete() returns true.
+ *
+ * @return false if idx is out of bounds or the index could not be read.
  */
-const char *dir_reader_filename_ref(uint8_t idx);
+bool dir_reader_get_entry(uint16_t idx, dir_reader_entry_t *entry);
 
 /**
  * @brief Return true if the dir_reader is idle.
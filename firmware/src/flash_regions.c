@@ -0,0 +1,191 @@
+/**
+ * @file flash_regions.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "flash_regions.h"
+
+#include "spi_flash_map.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+typedef struct {
+  const char *name;
+  flash_region_set_t set;
+} flash_region_alias_t;
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+/**
+ * @brief Return the set named by the n characters at name, or 0 if none.
+ */
+static flash_region_set_t lookup_set(const char *name, size_t n);
+
+// *****************************************************************************
+// Private (static) storage
+
+// Indexed by flash_region_id_t, in ascending address order.
+static const flash_region_t s_flash_regions[FLASH_REGION_COUNT] = {
+    {"boot", M2M_BOOT_FIRMWARE_STARTING_ADDR, M2M_BOOT_FIRMWARE_FLASH_SZ},
+    {"control", M2M_CONTROL_FLASH_OFFSET, M2M_CONTROL_FLASH_TOTAL_SZ},
+    {"pll_gain", M2M_PLL_FLASH_OFFSET, M2M_CONFIG_SECT_TOTAL_SZ},
+    {"tls_root", M2M_TLS_ROOTCER_FLASH_OFFSET, M2M_TLS_ROOTCER_FLASH_SIZE},
+    {"tls_server", M2M_TLS_SERVER_FLASH_OFFSET, M2M_TLS_SERVER_FLASH_SIZE},
+    {"http", M2M_HTTP_MEM_FLASH_OFFSET, M2M_HTTP_MEM_FLASH_SZ},
+    {"cached_conns", M2M_CACHED_CONNS_FLASH_OFFSET, M2M_CACHED_CONNS_FLASH_SZ},
+    {"ota_image1", M2M_OTA_IMAGE1_OFFSET, OTA_IMAGE_SIZE},
+    {"ota_image2", M2M_OTA_IMAGE2_OFFSET, OTA_IMAGE_SIZE},
+    {"app", M2M_APP_8M_MEM_FLASH_OFFSET, M2M_APP_8M_MEM_FLASH_SZ},
+    {"app_ota",
+     M2M_APP_OTA_MEM_FLASH_OFFSET,
+     FLASH_8M_TOTAL_SZ - M2M_APP_OTA_MEM_FLASH_OFFSET},
+};
+
+// Named sets, tried in order when formatting.
+static const flash_region_alias_t s_aliases[] = {
+    {"all", FLASH_REGION_SET_ALL},
+    {"firmware", FLASH_REGION_SET_FIRMWARE},
+    {"certs", FLASH_REGION_SET_CERTS},
+};
+
+#define N_ALIASES (sizeof(s_aliases) / sizeof(s_aliases[0]))
+
+// *****************************************************************************
+// Public code
+
+const flash_region_t *flash_region_get(flash_region_id_t id) {
+  if (id < FLASH_REGION_COUNT) {
+    return &s_flash_regions[id];
+  } else {
+    return NULL;
+  }
+}
+
+flash_region_id_t flash_region_find(uint32_t addr) {
+  for (int id = 0; id < FLASH_REGION_COUNT; id++) {
+    const flash_region_t *region = &s_flash_regions[id];
+    if ((addr >= region->offset) && (addr < region->offset + region->size)) {
+      return (flash_region_id_t)id;
+    }
+  }
+  return FLASH_REGION_COUNT;
+}
+
+bool flash_region_set_contains(flash_region_set_t set, uint32_t addr) {
+  flash_region_id_t id = flash_region_find(addr);
+
+  if (id == FLASH_REGION_COUNT) {
+    return set == FLASH_REGION_SET_ALL;
+  }
+  return (set & FLASH_REGION_BIT(id)) != 0;
+}
+
+bool flash_region_set_parse(const char *spec, flash_region_set_t *set) {
+  flash_region_set_t result = (spec[0] == '-') ? FLASH_REGION_SET_ALL : 0;
+
+  while (*spec != '\0') {
+    bool is_removal = (*spec == '-');
+    const char *name = is_removal ? spec + 1 : spec;
+    size_t n = strcspn(name, ",");
+    flash_region_set_t named = lookup_set(name, n);
+
+    if (named == 0) {
+      return false;
+    }
+    result = is_removal ? (result & ~named) : (result | named);
+    spec = (name[n] == ',') ? &name[n + 1] : &name[n];
+  }
+  *set = result;
+  return true;
+}
+
+void flash_region_set_format(flash_region_set_t set, char *buf, size_t size) {
+  size_t len = 0;
+
+  buf[0] = '\0';
+  for (size_t i = 0; i < N_ALIASES; i++) {
+    if (set == s_aliases[i].set) {
+      snprintf(buf, size, "%s", s_aliases[i].name);
+      return;
+    }
+  }
+  if (set == 0) {
+    snprintf(buf, size, "none");
+    return;
+  }
+  // List whichever is shorter: the members, or the regions left out of all.
+  flash_region_set_t left_out = FLASH_REGION_SET_ALL & ~set;
+  int n_members = 0;
+  for (int id = 0; id < FLASH_REGION_COUNT; id++) {
+    n_members += (set & FLASH_REGION_BIT(id)) ? 1 : 0;
+  }
+  bool list_left_out = (FLASH_REGION_COUNT - n_members) < n_members;
+  if (list_left_out) {
+    len = snprintf(buf, size, "all");
+  }
+  for (int id = 0; id < FLASH_REGION_COUNT; id++) {
+    flash_region_set_t listed = list_left_out ? left_out : set;
+    if ((listed & FLASH_REGION_BIT(id)) && (len < size)) {
+      len += snprintf(&buf[len],
+                      size - len,
+                      "%s%s%s",
+                      (len == 0) ? "" : ",",
+                      list_left_out ? "-" : "",
+                      s_flash_regions[id].name);
+    }
+  }
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static flash_region_set_t lookup_set(const char *name, size_t n) {
+  for (size_t i = 0; i < N_ALIASES; i++) {
+    if ((strlen(s_aliases[i].name) == n) &&
+        (strncmp(s_aliases[i].name, name, n) == 0)) {
+      return s_aliases[i].set;
+    }
+  }
+  for (int id = 0; id < FLASH_REGION_COUNT; id++) {
+    if ((strlen(s_flash_regions[id].name) == n) &&
+        (strncmp(s_flash_regions[id].name, name, n) == 0)) {
+      return FLASH_REGION_BIT(id);
+    }
+  }
+  return 0;
+}
+
+// *****************************************************************************
+// End of file
@@ -0,0 +1,154 @@
+/**
+ * @file flash_regions.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief flash_regions names the regions of WINC flash laid out in
+ * spi_flash_map.h.
+ *
+ * This module depends only on spi_flash_map.h so that it can be shared with
+ * host-side tools.
+ */
+
+#ifndef _FLASH_REGIONS_H_
+#define _FLASH_REGIONS_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+typedef enum {
+  FLASH_REGION_BOOT,
+  FLASH_REGION_CONTROL,
+  FLASH_REGION_PLL_GAIN,
+  FLASH_REGION_TLS_ROOT,
+  FLASH_REGION_TLS_SERVER,
+  FLASH_REGION_HTTP,
+  FLASH_REGION_CACHED_CONNS,
+  FLASH_REGION_OTA_IMAGE1,
+  FLASH_REGION_OTA_IMAGE2,
+  FLASH_REGION_APP,
+  FLASH_REGION_APP_OTA,
+  FLASH_REGION_COUNT, // also returned for "no region"
+} flash_region_id_t;
+
+typedef struct {
+  const char *name;
+  uint32_t offset; // byte offset in WINC flash
+  uint32_t size;   // in bytes
+} flash_region_t;
+
+/**
+ * @brief A set of regions, with bit (1 << id) set for each member.
+ */
+typedef uint32_t flash_region_set_t;
+
+#define FLASH_REGION_BIT(_id) ((flash_region_set_t)1 << (_id))
+
+// Every region, and any flash beyond the 8 Mbit map.
+#define FLASH_REGION_SET_ALL (FLASH_REGION_BIT(FLASH_REGION_COUNT) - 1)
+
+// The WINC firmware proper.
+#define FLASH_REGION_SET_FIRMWARE                                              \
+  (FLASH_REGION_BIT(FLASH_REGION_BOOT) |                                       \
+   FLASH_REGION_BIT(FLASH_REGION_CONTROL) |                                    \
+   FLASH_REGION_BIT(FLASH_REGION_OTA_IMAGE1) |                                 \
+   FLASH_REGION_BIT(FLASH_REGION_OTA_IMAGE2))
+
+// TLS root certificates and the TLS server certificate and key.
+#define FLASH_REGION_SET_CERTS                                                 \
+  (FLASH_REGION_BIT(FLASH_REGION_TLS_ROOT) |                                   \
+   FLASH_REGION_BIT(FLASH_REGION_TLS_SERVER))
+
+// Room for flash_region_set_format() to list every region.
+#define FLASH_REGION_SET_FORMAT_SIZE 120
+
+// Regions that the WINC firmware rewrites in normal operation.
+#define FLASH_REGION_SET_VOLATILE FLASH_REGION_BIT(FLASH_REGION_CACHED_CONNS)
+
+// Regions that can change in the field: the control sectors (switched by an
+// OTA update), the certificates, the HTTP provisioning pages and the volatile
+// regions.
+#define FLASH_REGION_SET_MUTABLE                                               \
+  (FLASH_REGION_BIT(FLASH_REGION_CONTROL) | FLASH_REGION_SET_CERTS |           \
+   FLASH_REGION_BIT(FLASH_REGION_HTTP) | FLASH_REGION_SET_VOLATILE)
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Return the region with the given id, or NULL if id is out of range.
+ */
+const flash_region_t *flash_region_get(flash_region_id_t id);
+
+/**
+ * @brief Return the id of the region containing addr, or FLASH_REGION_COUNT if
+ * addr lies outside of the 8 Mbit flash map.
+ */
+flash_region_id_t flash_region_find(uint32_t addr);
+
+/**
+ * @brief Return true if addr lies in one of the regions of set.  Flash beyond
+ * the 8 Mbit map belongs only to FLASH_REGION_SET_ALL.
+ */
+bool flash_region_set_contains(flash_region_set_t set, uint32_t addr);
+
+/**
+ * @brief Parse a comma-separated list of region names into a set.  "all",
+ * "firmware" and "certs" name the sets above, and a name preceded by '-' is
+ * removed from the set ("all,-http").  A list that starts with a removal
+ * starts from "all".
+ *
+ * @return true if every name was recognized.
+ */
+bool flash_region_set_parse(const char *spec, flash_region_set_t *set);
+
+/**
+ * @brief Write a description of set into buf, in the form that
+ * flash_region_set_parse() accepts.
+ */
+void flash_region_set_format(flash_region_set_t set, char *buf, size_t size);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _FLASH_REGIONS_H_ */
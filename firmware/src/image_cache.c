@@ -0,0 +1,486 @@
+/**
+ * @file image_cache.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "image_cache.h"
+
+#include "crc32.h"
+#include "definitions.h"
+#include "image_plan.h"
+#include "trace.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+#define IMAGE_CACHE_MAGIC 0x48434957 // "WICH" when read as little-endian bytes
+#define IMAGE_CACHE_VERSION 1
+#define IMAGE_CACHE_NAME_LEN 64
+
+// The header occupies the first erase block, the data follows.
+#define HEADER_ADDRESS IMAGE_CACHE_ADDRESS
+#define DATA_ADDRESS (IMAGE_CACHE_ADDRESS + NVMCTRL_FLASH_BLOCKSIZE)
+#define DATA_SIZE (IMAGE_CACHE_SIZE - NVMCTRL_FLASH_BLOCKSIZE)
+
+#define NVM_ERROR_MASK                                                         \
+  (NVMCTRL_INTFLAG_ADDRE_Msk | NVMCTRL_INTFLAG_PROGE_Msk |                     \
+   NVMCTRL_INTFLAG_LOCKE_Msk | NVMCTRL_INTFLAG_NVME_Msk)
+
+#define STATES(M)                                                              \
+  M(IMAGE_CACHE_STATE_IDLE)                                                    \
+  M(IMAGE_CACHE_STATE_ERASING)                                                 \
+  M(IMAGE_CACHE_STATE_COPYING)                                                 \
+  M(IMAGE_CACHE_STATE_COMPLETE)                                                \
+  M(IMAGE_CACHE_STATE_ERROR)
+
+#define EXPAND_STATE_IDS(_name) _name,
+typedef enum { STATES(EXPAND_STATE_IDS) } image_cache_state_t;
+
+typedef struct {
+  image_cache_state_t state;
+  SYS_FS_HANDLE file_handle;
+  uint32_t erase_address; // next block to erase
+  uint16_t idx;           // index of the next sector to copy
+  bool cancel_requested;
+} image_cache_ctx_t;
+
+typedef struct {
+  uint32_t offset;      // offset of the sector's first stored page in data
+  uint32_t crc;         // CRC-32 of the whole sector
+  uint16_t blank_pages; // bit n set if page n is all 0xff (and not stored)
+  uint16_t reserved;
+} cache_sector_t;
+
+typedef struct {
+  uint32_t magic; // IMAGE_CACHE_MAGIC, written last
+  uint16_t version;
+  uint16_t n_sectors;
+  uint32_t image_size;
+  uint32_t image_crc;
+  uint32_t data_size; // bytes used in the data area
+  char name[IMAGE_CACHE_NAME_LEN];
+  cache_sector_t sectors[IMAGE_PLAN_MAX_SECTORS];
+} cache_header_t;
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+static void set_state(image_cache_state_t state);
+
+/**
+ * @brief Copy sector ctx->idx of the image into the cache.
+ */
+static bool stage_sector(void);
+
+/**
+ * @brief Write the header, which marks the cache as valid.
+ */
+static bool write_header(void);
+
+/**
+ * @brief Close the image and go to the COMPLETE or ERROR state.
+ */
+static void finish(bool ok);
+
+static bool append(const uint8_t *src, size_t n_bytes);
+
+static bool flush_page(void);
+
+static bool program_page(uint32_t address);
+
+static bool wait_for_nvm(void);
+
+static uint16_t blank_pages(const uint8_t *sector);
+
+static const cache_header_t *cached_header(void);
+
+// *****************************************************************************
+// Private (static) storage
+
+// Reserve the upper flash bank so the linker never places code there.
+static const uint8_t s_cache_region[IMAGE_CACHE_SIZE]
+    __attribute__((address(IMAGE_CACHE_ADDRESS), noload, used));
+
+static image_cache_ctx_t s_image_cache_ctx;
+
+static cache_header_t s_header; // built in RAM while staging
+
+static uint8_t s_sector_buf[FLASH_SECTOR_SZ];
+
+static uint32_t s_nvm_page[NVMCTRL_FLASH_PAGESIZE / sizeof(uint32_t)];
+static size_t s_nvm_fill;      // bytes in s_nvm_page
+static uint32_t s_nvm_address; // where s_nvm_page will be programmed
+
+// *****************************************************************************
+// Public code
+
+void image_cache_init(void) {
+  s_image_cache_ctx.state = IMAGE_CACHE_STATE_IDLE;
+  SYS_ASSERT(s_cache_region == (const uint8_t *)IMAGE_CACHE_ADDRESS,
+             "image cache not placed in upper flash bank");
+  if (image_cache_is_valid()) {
+    SYS_DEBUG_PRINT(SYS_ERROR_INFO,
+                    "\nImage cache holds %s",
+                    image_cache_image_name());
+  }
+}
+
+bool image_cache_stage(const char *filename) {
+  image_cache_ctx_t *ctx = &s_image_cache_ctx;
+  int32_t n_bytes;
+
+  if (image_cache_is_busy()) {
+    SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\nimage_cache is busy");
+    return false;
+  }
+  ctx->file_handle = SYS_FS_FileOpen(filename, SYS_FS_FILE_OPEN_READ);
+  if (ctx->file_handle == SYS_FS_HANDLE_INVALID) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nCould not open file %s", filename);
+    set_state(IMAGE_CACHE_STATE_ERROR);
+    return false;
+  }
+  n_bytes = SYS_FS_FileSize(ctx->file_handle);
+  if ((n_bytes <= 0) || (n_bytes % FLASH_SECTOR_SZ != 0) ||
+      (n_bytes / FLASH_SECTOR_SZ > IMAGE_PLAN_MAX_SECTORS)) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\n%s has unsupported size %ld",
+                    filename,
+                    n_bytes);
+    SYS_FS_FileClose(ctx->file_handle);
+    set_state(IMAGE_CACHE_STATE_ERROR);
+    return false;
+  }
+
+  memset(&s_header, 0, sizeof(s_header));
+  s_header.version = IMAGE_CACHE_VERSION;
+  s_header.n_sectors = n_bytes / FLASH_SECTOR_SZ;
+  s_header.image_size = n_bytes;
+  strncpy(s_header.name, filename, IMAGE_CACHE_NAME_LEN - 1);
+  ctx->erase_address = IMAGE_CACHE_ADDRESS;
+  ctx->idx = 0;
+  ctx->cancel_requested = false;
+
+  SYS_CONSOLE_PRINT("\nStaging %s into bank %c of internal flash\n",
+                    filename,
+                    (NVMCTRL_REGS->NVMCTRL_STATUS & NVMCTRL_STATUS_AFIRST_Msk)
+                        ? 'B'
+                        : 'A');
+  set_state(IMAGE_CACHE_STATE_ERASING);
+  return true;
+}
+
+void image_cache_step(void) {
+  image_cache_ctx_t *ctx = &s_image_cache_ctx;
+
+  if (!image_cache_is_busy()) {
+    return;
+  }
+  if (ctx->cancel_requested) {
+    SYS_CONSOLE_MESSAGE("\nStaging cancelled");
+    finish(false);
+    return;
+  }
+
+  switch (ctx->state) {
+  case IMAGE_CACHE_STATE_ERASING: {
+    // Erase one block per step, header block first: the cache is invalid
+    // from the first step on.
+    NVMCTRL_BlockErase(ctx->erase_address);
+    if (!wait_for_nvm()) {
+      SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                      "\nFailed to erase internal flash at 0x%lx",
+                      ctx->erase_address);
+      finish(false);
+      break;
+    }
+    ctx->erase_address += NVMCTRL_FLASH_BLOCKSIZE;
+    if (ctx->erase_address >= IMAGE_CACHE_ADDRESS + IMAGE_CACHE_SIZE) {
+      s_nvm_fill = 0;
+      s_nvm_address = DATA_ADDRESS;
+      set_state(IMAGE_CACHE_STATE_COPYING);
+    }
+  } break;
+
+  case IMAGE_CACHE_STATE_COPYING: {
+    if (ctx->idx < s_header.n_sectors) {
+      if (!stage_sector()) {
+        finish(false);
+      }
+    } else {
+      finish(flush_page() && write_header());
+    }
+  } break;
+
+  default: {
+    // not staging
+  } break;
+  } // switch
+}
+
+void image_cache_cancel(void) {
+  if (image_cache_is_busy()) {
+    s_image_cache_ctx.cancel_requested = true;
+  }
+}
+
+bool image_cache_is_busy(void) {
+  return (s_image_cache_ctx.state == IMAGE_CACHE_STATE_ERASING) ||
+         (s_image_cache_ctx.state == IMAGE_CACHE_STATE_COPYING);
+}
+
+bool image_cache_is_complete(void) {
+  return s_image_cache_ctx.state == IMAGE_CACHE_STATE_COMPLETE;
+}
+
+bool image_cache_is_valid(void) {
+  const cache_header_t *header = cached_header();
+  return (header->magic == IMAGE_CACHE_MAGIC) &&
+         (header->version == IMAGE_CACHE_VERSION) &&
+         (header->n_sectors <= IMAGE_PLAN_MAX_SECTORS) &&
+         (header->data_size <= DATA_SIZE);
+}
+
+const char *image_cache_image_name(void) {
+  return image_cache_is_valid() ? cached_header()->name : NULL;
+}
+
+uint32_t image_cache_image_size(void) {
+  return image_cache_is_valid() ? cached_header()->image_size : 0;
+}
+
+bool image_cache_read(uint8_t *dst, uint32_t addr, size_t n_bytes) {
+  const cache_header_t *header = cached_header();
+
+  if (!image_cache_is_valid() || (addr % FLASH_PAGE_SZ != 0) ||
+      (n_bytes % FLASH_PAGE_SZ != 0) ||
+      (addr + n_bytes > header->image_size)) {
+    return false;
+  }
+  while (n_bytes > 0) {
+    const cache_sector_t *sector = &header->sectors[addr / FLASH_SECTOR_SZ];
+    uint32_t page = (addr % FLASH_SECTOR_SZ) / FLASH_PAGE_SZ;
+
+    if (sector->blank_pages & (1ul << page)) {
+      memset(dst, 0xff, FLASH_PAGE_SZ);
+    } else {
+      // Stored pages are packed: skip over the stored pages before this one.
+      uint32_t offset = sector->offset;
+      for (uint32_t p = 0; p < page; p++) {
+        if ((sector->blank_pages & (1ul << p)) == 0) {
+          offset += FLASH_PAGE_SZ;
+        }
+      }
+      memcpy(dst, (const uint8_t *)(DATA_ADDRESS + offset), FLASH_PAGE_SZ);
+    }
+    dst += FLASH_PAGE_SZ;
+    addr += FLASH_PAGE_SZ;
+    n_bytes -= FLASH_PAGE_SZ;
+  }
+  return true;
+}
+
+bool image_cache_get_plan(image_plan_t *plan) {
+  const cache_header_t *header = cached_header();
+
+  if (!image_cache_is_valid()) {
+    return false;
+  }
+  memset(plan, 0, sizeof(*plan));
+  plan->magic = IMAGE_PLAN_MAGIC;
+  plan->version = IMAGE_PLAN_VERSION;
+  plan->n_sectors = header->n_sectors;
+  plan->image_size = header->image_size;
+  plan->image_crc = header->image_crc;
+  for (uint16_t idx = 0; idx < header->n_sectors; idx++) {
+    plan->sectors[idx].crc = header->sectors[idx].crc;
+    plan->sectors[idx].blank_pages = header->sectors[idx].blank_pages;
+  }
+  image_plan_build_layout(plan);
+  return true;
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static void set_state(image_cache_state_t state) {
+  if (s_image_cache_ctx.state != state) {
+    TRACE2(TRACE_IMAGE_CACHE_STATE, s_image_cache_ctx.state, state);
+    s_image_cache_ctx.state = state;
+  }
+}
+
+static bool stage_sector(void) {
+  image_cache_ctx_t *ctx = &s_image_cache_ctx;
+  cache_sector_t *sector = &s_header.sectors[ctx->idx];
+
+  if (SYS_FS_FileRead(ctx->file_handle, s_sector_buf, FLASH_SECTOR_SZ) !=
+      FLASH_SECTOR_SZ) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\nFailed to read %ld bytes from file",
+                    FLASH_SECTOR_SZ);
+    return false;
+  }
+  sector->offset = s_header.data_size;
+  sector->crc = crc32_compute(s_sector_buf, FLASH_SECTOR_SZ);
+  sector->blank_pages = blank_pages(s_sector_buf);
+  s_header.image_crc =
+      crc32_update(s_header.image_crc, s_sector_buf, FLASH_SECTOR_SZ);
+
+  for (uint32_t page = 0; page < IMAGE_PLAN_PAGES_PER_SECTOR; page++) {
+    if ((sector->blank_pages & (1ul << page)) == 0) {
+      if (s_header.data_size + FLASH_PAGE_SZ > DATA_SIZE) {
+        SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\nImage too large for cache");
+        return false;
+      }
+      if (!append(&s_sector_buf[page * FLASH_PAGE_SZ], FLASH_PAGE_SZ)) {
+        return false;
+      }
+      s_header.data_size += FLASH_PAGE_SZ;
+    }
+  }
+  SYS_CONSOLE_MESSAGE(sector->blank_pages == IMAGE_PLAN_ALL_PAGES_BLANK
+                          ? "_"
+                          : ".");
+  ctx->idx += 1;
+  return true;
+}
+
+static bool write_header(void) {
+  // Write the header last: the magic number marks the cache as complete.  It
+  // spans several NVM pages, so the page holding the magic goes last of all,
+  // and a stage interrupted before then leaves the cache invalid.
+  const uint8_t *header = (const uint8_t *)&s_header;
+  size_t first_page = sizeof(s_header);
+  if (first_page > NVMCTRL_FLASH_PAGESIZE) {
+    first_page = NVMCTRL_FLASH_PAGESIZE;
+  }
+  s_header.magic = IMAGE_CACHE_MAGIC;
+  s_nvm_address = HEADER_ADDRESS + first_page;
+  if (!append(&header[first_page], sizeof(s_header) - first_page) ||
+      !flush_page()) {
+    return false;
+  }
+  s_nvm_address = HEADER_ADDRESS;
+  return append(header, first_page) && flush_page();
+}
+
+static void finish(bool ok) {
+  SYS_FS_FileClose(s_image_cache_ctx.file_handle);
+
+  // The CPU may have cached stale contents of the region.
+  CMCC_InvalidateAll();
+
+  if (ok) {
+    SYS_DEBUG_PRINT(SYS_ERROR_INFO,
+                    "\nSuccessfully staged %s (%lu of %lu bytes stored)",
+                    s_header.name,
+                    s_header.data_size,
+                    s_header.image_size);
+  }
+  set_state(ok ? IMAGE_CACHE_STATE_COMPLETE : IMAGE_CACHE_STATE_ERROR);
+}
+
+static bool append(const uint8_t *src, size_t n_bytes) {
+  while (n_bytes > 0) {
+    size_t n = sizeof(s_nvm_page) - s_nvm_fill;
+    if (n > n_bytes) {
+      n = n_bytes;
+    }
+    memcpy((uint8_t *)s_nvm_page + s_nvm_fill, src, n);
+    s_nvm_fill += n;
+    src += n;
+    n_bytes -= n;
+    if ((s_nvm_fill == sizeof(s_nvm_page)) && !flush_page()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool flush_page(void) {
+  if (s_nvm_fill == 0) {
+    return true;
+  }
+  // pad a partial page with the erased value
+  memset((uint8_t *)s_nvm_page + s_nvm_fill, 0xff,
+         sizeof(s_nvm_page) - s_nvm_fill);
+  if (!program_page(s_nvm_address)) {
+    return false;
+  }
+  s_nvm_address += sizeof(s_nvm_page);
+  s_nvm_fill = 0;
+  return true;
+}
+
+static bool program_page(uint32_t address) {
+  NVMCTRL_PageBufferWrite(s_nvm_page, address);
+  NVMCTRL_PageBufferCommit(address);
+  if (!wait_for_nvm()) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\nFailed to program internal flash at 0x%lx",
+                    address);
+    return false;
+  }
+  return true;
+}
+
+static bool wait_for_nvm(void) {
+  while (NVMCTRL_IsBusy()) {
+    // The cache lives in the bank we are not executing from, so the CPU
+    // keeps running while the bank is busy.
+  }
+  return (NVMCTRL_ErrorGet() & NVM_ERROR_MASK) == 0;
+}
+
+static uint16_t blank_pages(const uint8_t *sector) {
+  uint16_t mask = 0;
+  for (uint32_t page = 0; page < IMAGE_PLAN_PAGES_PER_SECTOR; page++) {
+    const uint8_t *p = &sector[page * FLASH_PAGE_SZ];
+    uint32_t i;
+    for (i = 0; i < FLASH_PAGE_SZ; i++) {
+      if (p[i] != 0xff) {
+        break;
+      }
+    }
+    if (i == FLASH_PAGE_SZ) {
+      mask |= (1u << page);
+    }
+  }
+  return mask;
+}
+
+static const cache_header_t *cached_header(void) {
+  return (const cache_header_t *)HEADER_ADDRESS;
+}
+
+// *****************************************************************************
+// End of file
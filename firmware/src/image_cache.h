@@ -0,0 +1,152 @@
+/**
+ * @file image_cache.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief image_cache keeps a "golden" WINC image in SAM E54 internal flash.
+ *
+ * On a production line the same image is programmed into many modules.
+ * image_cache_stage() copies an image from the card into the upper bank of
+ * internal flash once; afterwards winc_cloner_update() and
+ * winc_cloner_compare() accept IMAGE_CACHE_NAME in place of a filename and
+ * read the image straight from memory-mapped flash without touching the card.
+ *
+ * Blank (all 0xff) WINC pages are not stored, which lets a full 8 Mbit image
+ * fit in the 512 KB flash bank.  The upper half of the flash address space is
+ * always the bank that is not executing, so staging never stalls the CPU
+ * (read-while-write), and the cache is never bank-swapped.
+ */
+
+#ifndef _IMAGE_CACHE_H_
+#define _IMAGE_CACHE_H_
+
+// *****************************************************************************
+// Includes
+
+#include "image_plan.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+/**
+ * @brief Pass this name in place of a filename to use the cached image.
+ */
+#define IMAGE_CACHE_NAME "@cache"
+
+// The upper flash bank of the ATSAME54P20A.
+#define IMAGE_CACHE_ADDRESS 0x00080000ul
+#define IMAGE_CACHE_SIZE 0x00080000ul
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Initialize the image_cache.  Called once at startup.
+ */
+void image_cache_init(void);
+
+/**
+ * @brief Start copying an image file into the internal flash cache.  The
+ * work is done in image_cache_step().
+ *
+ * Any previously cached image is erased first.  The cache is marked valid
+ * only after the last byte has been programmed.
+ *
+ * @return true if staging was started.
+ */
+bool image_cache_stage(const char *filename);
+
+/**
+ * @brief Erase the next block or copy the next sector.  Called frequently.
+ */
+void image_cache_step(void);
+
+/**
+ * @brief Cancel staging after the current block or sector.
+ *
+ * Note: a cancelled stage leaves the cache invalid once erasing has begun.
+ */
+void image_cache_cancel(void);
+
+/**
+ * @brief Return true if an image is being staged.
+ */
+bool image_cache_is_busy(void);
+
+/**
+ * @brief Return true if the last image was staged successfully.
+ */
+bool image_cache_is_complete(void);
+
+/**
+ * @brief Return true if the cache holds a complete image.
+ */
+bool image_cache_is_valid(void);
+
+/**
+ * @brief Return the filename the cached image was staged from, or NULL.
+ */
+const char *image_cache_image_name(void);
+
+/**
+ * @brief Return the size in bytes of the cached image, or 0.
+ */
+uint32_t image_cache_image_size(void);
+
+/**
+ * @brief Copy n_bytes of the cached image starting at addr into dst.
+ *
+ * NOTE: addr and n_bytes must be multiples of FLASH_PAGE_SZ.
+ *
+ * @return true on success
+ */
+bool image_cache_read(uint8_t *dst, uint32_t addr, size_t n_bytes);
+
+/**
+ * @brief Fill plan with the per-sector CRCs and blank page masks of the
+ * cached image so it can drive a planned update.
+ *
+ * @return true if the cache is valid.
+ */
+bool image_cache_get_plan(image_plan_t *plan);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _IMAGE_CACHE_H_ */
@@ -0,0 +1,190 @@
+/**
+ * @file image_manifest.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "image_manifest.h"
+
+#include "crc32.h"
+#include "definitions.h"
+#include "ota_control.h"
+#include "sha256.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+#define MAX_MANIFEST_NAME_LENGTH                                               \
+  (IMAGE_MANIFEST_NAME_LEN + sizeof(IMAGE_MANIFEST_SUFFIX))
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+static void manifest_name(char *dst, size_t size, const char *image_name);
+
+// *****************************************************************************
+// Private (static) storage
+
+static SYS_FS_FSTAT s_stat; // too big for the stack
+
+// *****************************************************************************
+// Public code
+
+void image_manifest_builder_init(image_manifest_builder_t *builder,
+                                 const char *image_name) {
+  image_manifest_t *manifest = &builder->manifest;
+
+  memset(manifest, 0, sizeof(*manifest));
+  manifest->magic = IMAGE_MANIFEST_MAGIC;
+  manifest->version = IMAGE_MANIFEST_VERSION;
+  strncpy(manifest->image_name, image_name, IMAGE_MANIFEST_NAME_LEN - 1);
+  sha256_init(&builder->sha);
+}
+
+uint32_t image_manifest_builder_add(image_manifest_builder_t *builder,
+                                    const uint8_t *sector) {
+  image_manifest_t *manifest = &builder->manifest;
+  uint32_t crc;
+
+  if (manifest->n_sectors >= IMAGE_MANIFEST_MAX_SECTORS) {
+    return 0;
+  }
+  crc = crc32_compute(sector, FLASH_SECTOR_SZ);
+  sha256_update(&builder->sha, sector, FLASH_SECTOR_SZ);
+  if (manifest->image_size == M2M_CONTROL_FLASH_OFFSET) {
+    const tstrOtaControlSec *control = (const tstrOtaControlSec *)sector;
+    if (ota_control_is_valid(control)) {
+      manifest->fw_version = control->u32OtaCurrentworkingImagFirmwareVer;
+    }
+  }
+  manifest->sector_crc[manifest->n_sectors++] = crc;
+  manifest->image_size += FLASH_SECTOR_SZ;
+  return crc;
+}
+
+const image_manifest_t *
+image_manifest_builder_finish(image_manifest_builder_t *builder) {
+  sha256_final(&builder->sha, builder->manifest.sha256);
+  return &builder->manifest;
+}
+
+bool image_manifest_read(const char *image_name, image_manifest_t *manifest) {
+  char filename[MAX_MANIFEST_NAME_LENGTH];
+  SYS_FS_HANDLE file_handle;
+  uint32_t size;
+  uint32_t stamp;
+  bool ret;
+
+  manifest_name(filename, sizeof(filename), image_name);
+  file_handle = SYS_FS_FileOpen(filename, SYS_FS_FILE_OPEN_READ);
+  if (file_handle == SYS_FS_HANDLE_INVALID) {
+    // no manifest: not an error
+    return false;
+  }
+  ret = (SYS_FS_FileRead(file_handle, manifest, sizeof(*manifest)) ==
+         sizeof(*manifest)) &&
+        (manifest->magic == IMAGE_MANIFEST_MAGIC) &&
+        (manifest->version == IMAGE_MANIFEST_VERSION) &&
+        (manifest->n_sectors <= IMAGE_MANIFEST_MAX_SECTORS) &&
+        (manifest->image_size == manifest->n_sectors * FLASH_SECTOR_SZ);
+  SYS_FS_FileClose(file_handle);
+
+  if (!ret) {
+    SYS_DEBUG_PRINT(
+        SYS_ERROR_WARNING, "\nIgnoring invalid manifest %s", filename);
+  } else if (!image_manifest_stamp(image_name, &size, &stamp) ||
+             (size != manifest->image_size) ||
+             (stamp != manifest->image_stamp)) {
+    // the image was replaced after the manifest was written
+    SYS_DEBUG_PRINT(
+        SYS_ERROR_WARNING, "\nIgnoring out of date manifest %s", filename);
+    ret = false;
+  }
+  return ret;
+}
+
+bool image_manifest_write(image_manifest_t *manifest) {
+  char filename[MAX_MANIFEST_NAME_LENGTH];
+  SYS_FS_HANDLE file_handle;
+  uint32_t size;
+  bool ret;
+
+  if (!image_manifest_stamp(
+          manifest->image_name, &size, &manifest->image_stamp)) {
+    SYS_DEBUG_PRINT(
+        SYS_ERROR_ERROR, "\nCould not stat %s", manifest->image_name);
+    return false;
+  }
+  manifest_name(filename, sizeof(filename), manifest->image_name);
+  file_handle = SYS_FS_FileOpen(filename, SYS_FS_FILE_OPEN_WRITE);
+  if (file_handle == SYS_FS_HANDLE_INVALID) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nCould not open file %s", filename);
+    return false;
+  }
+  ret = SYS_FS_FileWrite(file_handle, manifest, sizeof(*manifest)) ==
+        sizeof(*manifest);
+  SYS_FS_FileClose(file_handle);
+
+  if (!ret) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nFailed to write %s", filename);
+  }
+  return ret;
+}
+
+bool image_manifest_stamp(const char *image_name,
+                          uint32_t *size,
+                          uint32_t *stamp) {
+  s_stat.lfname = NULL;
+  if (SYS_FS_FileStat(image_name, &s_stat) != SYS_FS_RES_SUCCESS) {
+    return false;
+  }
+  *size = s_stat.fsize;
+  *stamp = ((uint32_t)s_stat.fdate << 16) | s_stat.ftime;
+  return true;
+}
+
+void image_manifest_print_digest(const image_manifest_t *manifest) {
+  SYS_CONSOLE_MESSAGE("\nsha256 ");
+  for (int i = 0; i < SHA256_DIGEST_SIZE; i++) {
+    SYS_CONSOLE_PRINT("%02x", manifest->sha256[i]);
+  }
+  SYS_CONSOLE_PRINT("  %s", manifest->image_name);
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static void manifest_name(char *dst, size_t size, const char *image_name) {
+  snprintf(dst, size, "%s%s", image_name, IMAGE_MANIFEST_SUFFIX);
+}
+
+// *****************************************************************************
+// End of file
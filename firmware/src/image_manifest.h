@@ -0,0 +1,154 @@
+/**
+ * @file image_manifest.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief image_manifest records the per-sector CRC-32s and the SHA-256 of a
+ * WINC image.
+ *
+ * winc_cloner builds a manifest as image data streams through extract and
+ * update, and saves it next to the image as "<image>" IMAGE_MANIFEST_SUFFIX.
+ * With a manifest on hand, update verifies each written sector's readback
+ * inline and compare checks the WINC without reading the image at all, so no
+ * separate verification pass is needed.  The manifest also records the
+ * firmware version that the image's control sector boots, which the boot
+ * check (see winc_cloner_set_boot_check()) expects the WINC to report.
+ *
+ * Every WINC image is the same size, so the manifest also records the
+ * image's FAT date and time when it was written.  A manifest whose image has
+ * since been replaced is ignored, and rebuilt by the next update or extract.
+ */
+
+#ifndef _IMAGE_MANIFEST_H_
+#define _IMAGE_MANIFEST_H_
+
+// *****************************************************************************
+// Includes
+
+#include "sha256.h"
+#include "spi_flash_map.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+#define IMAGE_MANIFEST_MAGIC 0x464e4d57 // "WMNF" when read as little-endian
+#define IMAGE_MANIFEST_VERSION 3
+#define IMAGE_MANIFEST_SUFFIX ".manifest"
+
+#define IMAGE_MANIFEST_MAX_SECTORS (FLASH_8M_TOTAL_SZ / FLASH_SECTOR_SZ)
+#define IMAGE_MANIFEST_NAME_LEN 64
+
+typedef struct {
+  uint32_t magic;       // IMAGE_MANIFEST_MAGIC
+  uint16_t version;     // IMAGE_MANIFEST_VERSION
+  uint16_t n_sectors;   // # of valid entries in sector_crc[]
+  uint32_t image_size;  // in bytes
+  uint32_t fw_version;  // version word of the image's control sector, or 0
+  uint32_t image_stamp; // FAT date << 16 | time of the image, when written
+  uint8_t sha256[SHA256_DIGEST_SIZE]; // SHA-256 of the whole image
+  char image_name[IMAGE_MANIFEST_NAME_LEN];
+  uint32_t sector_crc[IMAGE_MANIFEST_MAX_SECTORS];
+} image_manifest_t;
+
+/**
+ * @brief State for building a manifest one sector at a time.
+ */
+typedef struct {
+  image_manifest_t manifest;
+  sha256_ctx_t sha;
+} image_manifest_builder_t;
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Start building a manifest for image_name.
+ */
+void image_manifest_builder_init(image_manifest_builder_t *builder,
+                                 const char *image_name);
+
+/**
+ * @brief Add the next FLASH_SECTOR_SZ bytes of the image to the manifest.
+ *
+ * @return the CRC-32 of the sector, or 0 if the manifest is full.
+ */
+uint32_t image_manifest_builder_add(image_manifest_builder_t *builder,
+                                    const uint8_t *sector);
+
+/**
+ * @brief Finish the SHA-256 and return the completed manifest.
+ */
+const image_manifest_t *
+image_manifest_builder_finish(image_manifest_builder_t *builder);
+
+/**
+ * @brief Read the manifest for image_name into manifest.
+ *
+ * @return true if a valid manifest was found and image_name has not changed
+ * since it was written.
+ */
+bool image_manifest_read(const char *image_name, image_manifest_t *manifest);
+
+/**
+ * @brief Stamp manifest with its image's date and time and write it next to
+ * the image.  Call once the image is closed.
+ *
+ * @return true on success.
+ */
+bool image_manifest_write(image_manifest_t *manifest);
+
+/**
+ * @brief Fill in the size of image_name and its FAT date << 16 | time, as
+ * recorded in image_stamp.  Programming plans are tied to their image the
+ * same way.
+ *
+ * @return true on success.
+ */
+bool image_manifest_stamp(const char *image_name,
+                          uint32_t *size,
+                          uint32_t *stamp);
+
+/**
+ * @brief Print the SHA-256 of manifest as hex on the console.
+ */
+void image_manifest_print_digest(const image_manifest_t *manifest);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _IMAGE_MANIFEST_H_ */
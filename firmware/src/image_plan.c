@@ -0,0 +1,170 @@
+/**
+ * @file image_plan.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "image_plan.h"
+
+#include "flash_regions.h"
+#include "spi_flash_map.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+/**
+ * @brief Return true if the erase block that starts at sector idx lies within
+ * one region, other than the PLL and gain tables, and set *id to it.
+ */
+static bool is_erasable_block(uint16_t idx, flash_region_id_t *id);
+
+/**
+ * @brief Find the first erase run of an image of n_sectors at or after sector
+ * *idx, and advance *idx beyond it.
+ *
+ * @return false if there is none.
+ */
+static bool next_run(uint16_t n_sectors, uint16_t *idx, image_plan_run_t *run);
+
+// *****************************************************************************
+// Public code
+
+void image_plan_build_layout(image_plan_t *plan) {
+  uint32_t image_size = plan->n_sectors * FLASH_SECTOR_SZ;
+  uint16_t idx = 0;
+
+  memset(plan->regions, 0, sizeof(plan->regions));
+  memset(plan->runs, 0, sizeof(plan->runs));
+  plan->n_regions = 0;
+  for (int id = 0; id < FLASH_REGION_COUNT; id++) {
+    const flash_region_t *region = flash_region_get(id);
+    if (region->offset >= image_size) {
+      break;
+    }
+    image_plan_region_t *dst = &plan->regions[plan->n_regions++];
+    strncpy(dst->name, region->name, sizeof(dst->name) - 1);
+    dst->offset = region->offset;
+    dst->size = region->size;
+  }
+  plan->n_runs = 0;
+  while ((plan->n_runs < IMAGE_PLAN_MAX_RUNS) &&
+         next_run(plan->n_sectors, &idx, &plan->runs[plan->n_runs])) {
+    plan->n_runs += 1;
+  }
+}
+
+bool image_plan_layout_is_valid(const image_plan_t *plan) {
+  uint32_t image_size = plan->n_sectors * FLASH_SECTOR_SZ;
+  uint16_t n_regions = 0;
+  uint16_t n_runs = 0;
+  uint16_t idx = 0;
+  image_plan_run_t run;
+
+  for (int id = 0; id < FLASH_REGION_COUNT; id++) {
+    const flash_region_t *region = flash_region_get(id);
+    if (region->offset >= image_size) {
+      break;
+    }
+    const image_plan_region_t *planned = &plan->regions[n_regions++];
+    if ((n_regions > plan->n_regions) ||
+        (strncmp(planned->name,
+                 region->name,
+                 IMAGE_PLAN_REGION_NAME_LEN - 1) != 0) ||
+        (planned->offset != region->offset) ||
+        (planned->size != region->size)) {
+      return false;
+    }
+  }
+  if (n_regions != plan->n_regions) {
+    return false;
+  }
+  while (next_run(plan->n_sectors, &idx, &run)) {
+    const image_plan_run_t *planned = &plan->runs[n_runs++];
+    if ((n_runs > plan->n_runs) ||
+        (planned->first_sector != run.first_sector) ||
+        (planned->n_sectors != run.n_sectors)) {
+      return false;
+    }
+  }
+  return n_runs == plan->n_runs;
+}
+
+const image_plan_run_t *image_plan_find_run(const image_plan_t *plan,
+                                            uint16_t idx) {
+  for (uint16_t i = 0; i < plan->n_runs; i++) {
+    const image_plan_run_t *run = &plan->runs[i];
+    if ((idx >= run->first_sector) &&
+        (idx - run->first_sector < run->n_sectors)) {
+      return run;
+    }
+  }
+  return NULL;
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static bool is_erasable_block(uint16_t idx, flash_region_id_t *id) {
+  uint32_t addr = idx * FLASH_SECTOR_SZ;
+
+  *id = flash_region_find(addr);
+  return (*id != FLASH_REGION_COUNT) && (*id != FLASH_REGION_PLL_GAIN) &&
+         (flash_region_find(addr + FLASH_BLOCK_SIZE - 1) == *id);
+}
+
+static bool next_run(uint16_t n_sectors, uint16_t *idx, image_plan_run_t *run) {
+  flash_region_id_t run_id;
+  flash_region_id_t id;
+
+  // Runs are made of whole blocks, on block boundaries.
+  *idx += (IMAGE_PLAN_SECTORS_PER_BLOCK - *idx % IMAGE_PLAN_SECTORS_PER_BLOCK) %
+          IMAGE_PLAN_SECTORS_PER_BLOCK;
+  while ((*idx + IMAGE_PLAN_SECTORS_PER_BLOCK <= n_sectors) &&
+         !is_erasable_block(*idx, &run_id)) {
+    *idx += IMAGE_PLAN_SECTORS_PER_BLOCK;
+  }
+  if (*idx + IMAGE_PLAN_SECTORS_PER_BLOCK > n_sectors) {
+    return false;
+  }
+  run->first_sector = *idx;
+  run->n_sectors = 0;
+  do {
+    run->n_sectors += IMAGE_PLAN_SECTORS_PER_BLOCK;
+    *idx += IMAGE_PLAN_SECTORS_PER_BLOCK;
+  } while ((*idx + IMAGE_PLAN_SECTORS_PER_BLOCK <= n_sectors) &&
+           is_erasable_block(*idx, &id) && (id == run_id));
+  return true;
+}
+
+// *****************************************************************************
+// End of file
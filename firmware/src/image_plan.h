@@ -0,0 +1,151 @@
+/**
+ * @file image_plan.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief image_plan describes the precomputed programming plan for an image.
+ *
+ * A plan file is produced offline by tools/image_plan from a WINC .img file
+ * and is stored next to it on the card as "<image>.img" IMAGE_PLAN_SUFFIX.
+ * When winc_cloner_update() finds a plan that matches the image, it uses the
+ * per-sector CRCs and blank page masks instead of analyzing each sector at
+ * runtime: sectors whose WINC CRC already matches are never read from the
+ * card, blank sectors are only erased, and blank pages are never programmed.
+ *
+ * The plan also lists the flash regions that the image covers and its erase
+ * runs: runs of whole FLASH_BLOCK_SIZE blocks, each within one region and
+ * clear of the PLL and gain tables.  A block of an erase run whose sectors
+ * all differ from the WINC is erased with one block erase rather than a
+ * sector erase apiece.  Both are derived from the flash map, by
+ * image_plan_build_layout(), and a plan whose layout does not match the
+ * firmware's is ignored.
+ *
+ * A plan is tied to its image by the image's size and FAT date and time, as
+ * a manifest is (see image_manifest.h): a plan whose image has since been
+ * replaced is ignored.  Build the plan from the image where it sits on the
+ * card, or copy both keeping their modification times.  Each sector read
+ * from the card is still checked against its planned CRC.
+ *
+ * The plan is a single fixed-size image_plan_t, stored little-endian.  This
+ * module depends only on spi_flash_map.h and flash_regions so it can be
+ * shared with host tools.
+ */
+
+#ifndef _IMAGE_PLAN_H_
+#define _IMAGE_PLAN_H_
+
+// *****************************************************************************
+// Includes
+
+#include "spi_flash_map.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+#define IMAGE_PLAN_MAGIC 0x4e4c5057 // "WPLN" when read as little-endian bytes
+#define IMAGE_PLAN_VERSION 4
+#define IMAGE_PLAN_SUFFIX ".plan"
+
+#define IMAGE_PLAN_MAX_SECTORS (FLASH_8M_TOTAL_SZ / FLASH_SECTOR_SZ)
+#define IMAGE_PLAN_PAGES_PER_SECTOR (FLASH_SECTOR_SZ / FLASH_PAGE_SZ)
+#define IMAGE_PLAN_ALL_PAGES_BLANK ((1ul << IMAGE_PLAN_PAGES_PER_SECTOR) - 1)
+#define IMAGE_PLAN_SECTORS_PER_BLOCK (FLASH_BLOCK_SIZE / FLASH_SECTOR_SZ)
+
+#define IMAGE_PLAN_MAX_REGIONS 16
+#define IMAGE_PLAN_REGION_NAME_LEN 16
+
+// Each run lies within one region.
+#define IMAGE_PLAN_MAX_RUNS IMAGE_PLAN_MAX_REGIONS
+
+typedef struct {
+  uint32_t crc;         // CRC-32 of the sector
+  uint16_t blank_pages; // bit n set if page n of the sector is all 0xff
+  uint16_t reserved;
+} image_plan_sector_t;
+
+typedef struct {
+  char name[IMAGE_PLAN_REGION_NAME_LEN];
+  uint32_t offset;
+  uint32_t size;
+} image_plan_region_t;
+
+typedef struct {
+  uint16_t first_sector; // first sector of a run of whole erase blocks
+  uint16_t n_sectors;    // a multiple of IMAGE_PLAN_SECTORS_PER_BLOCK
+} image_plan_run_t;
+
+typedef struct {
+  uint32_t magic;       // IMAGE_PLAN_MAGIC
+  uint16_t version;     // IMAGE_PLAN_VERSION
+  uint16_t n_sectors;   // # of valid entries in sectors[]
+  uint32_t image_size;  // in bytes
+  uint32_t image_crc;   // CRC-32 of the whole image
+  uint32_t image_stamp; // FAT date << 16 | time of the image, when built
+  uint16_t n_regions;   // # of valid entries in regions[]
+  uint16_t n_runs;      // # of valid entries in runs[]
+  image_plan_region_t regions[IMAGE_PLAN_MAX_REGIONS];
+  image_plan_run_t runs[IMAGE_PLAN_MAX_RUNS];
+  image_plan_sector_t sectors[IMAGE_PLAN_MAX_SECTORS];
+} image_plan_t;
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Fill in the regions and erase runs of plan, which must have its
+ * n_sectors set, from the flash map.
+ */
+void image_plan_build_layout(image_plan_t *plan);
+
+/**
+ * @brief Return true if the regions and erase runs of plan are the ones that
+ * image_plan_build_layout() gives.  A plan built for another flash map could
+ * erase the PLL and gain tables.
+ */
+bool image_plan_layout_is_valid(const image_plan_t *plan);
+
+/**
+ * @brief Return the erase run of plan that holds sector idx, or NULL.
+ */
+const image_plan_run_t *image_plan_find_run(const image_plan_t *plan,
+                                            uint16_t idx);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _IMAGE_PLAN_H_ */
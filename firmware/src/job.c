@@ -0,0 +1,586 @@
+/**
+ * @file job.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "job.h"
+
+#include "definitions.h"
+#include "flash_regions.h"
+#include "sched.h"
+#include "trace.h"
+#include "winc_cloner.h"
+#include "winc_gang.h"
+#include <ctype.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+#define STATES(M)                                                              \
+  M(JOB_STATE_IDLE)                                                            \
+  M(JOB_STATE_STARTING_OP)                                                     \
+  M(JOB_STATE_RUNNING_OP)                                                      \
+  M(JOB_STATE_COMPLETE)                                                        \
+  M(JOB_STATE_ERROR)
+
+#define EXPAND_STATE_IDS(_name) _name,
+typedef enum { STATES(EXPAND_STATE_IDS) } job_state_t;
+
+#define MAX_FILENAME_LENGTH 80
+
+// Longest job script, and longest line in one.
+#define JOB_MAX_SCRIPT_LENGTH 2048
+#define JOB_MAX_LINE_LENGTH 100
+
+#define JOB_MAX_LOG_LENGTH 200
+
+/**
+ * @brief A job command.  Operations that complete in start have no step.
+ */
+typedef struct {
+  const char *name;
+  bool needs_arg;
+  bool (*start)(const char *arg);
+  void (*step)(void);
+  bool (*is_busy)(void);
+  bool (*is_complete)(void);
+} job_cmd_t;
+
+typedef struct {
+  job_state_t state;
+  char filename[MAX_FILENAME_LENGTH];
+  size_t pos;              // offset of the next line in s_script
+  uint16_t line_no;        // of the current line
+  uint16_t n_ops;          // operations completed
+  bool cancel_requested;
+  const job_cmd_t *cmd;    // the current operation
+  char arg[MAX_FILENAME_LENGTH];
+  uint32_t started_ms;     // when the current operation started
+} job_ctx_t;
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+static void set_state(job_state_t state);
+
+/**
+ * @brief Parse the next operation and start it.  Return false if it cannot
+ * be started.  At the end of the script, go to JOB_STATE_COMPLETE.
+ */
+static bool start_op(void);
+
+/**
+ * @brief Log the result of the current operation.
+ */
+static void finish_op(bool ok);
+
+/**
+ * @brief Copy the next line that is not blank or a comment into line, with
+ * leading and trailing white space removed.  Return false at the end.
+ */
+static bool next_line(char *line, size_t size);
+
+static const job_cmd_t *find_cmd(const char *name);
+
+/**
+ * @brief Replace the first run of '#' in filename with the lowest serial
+ * number that does not name an existing file.  Return false if every number
+ * is taken.
+ */
+static bool expand_serial(char *filename, size_t size);
+
+static bool file_exists(const char *filename);
+
+static bool rebuild_pll(const char *arg);
+
+static bool select_regions(const char *arg);
+
+static bool set_quick_check(const char *arg);
+
+static bool set_boot_check(const char *arg);
+
+/**
+ * @brief Parse arg as "on" or "off" into is_on.
+ */
+static bool parse_on_off(const char *arg, bool *is_on);
+
+/**
+ * @brief Append text to JOB_LOG_NAME.
+ */
+static void append_log(const char *text);
+
+// *****************************************************************************
+// Private (static) storage
+
+static const job_cmd_t s_cmds[] = {
+    {"extract",
+     true,
+     winc_cloner_extract,
+     winc_cloner_step,
+     winc_cloner_is_busy,
+     winc_cloner_is_complete},
+    {"update",
+     true,
+     winc_cloner_update,
+     winc_cloner_step,
+     winc_cloner_is_busy,
+     winc_cloner_is_complete},
+    {"compare",
+     true,
+     winc_cloner_compare,
+     winc_cloner_step,
+     winc_cloner_is_busy,
+     winc_cloner_is_complete},
+    {"patch",
+     true,
+     winc_cloner_apply_delta,
+     winc_cloner_step,
+     winc_cloner_is_busy,
+     winc_cloner_is_complete},
+    {"slot_update",
+     true,
+     winc_cloner_slot_update,
+     winc_cloner_step,
+     winc_cloner_is_busy,
+     winc_cloner_is_complete},
+    {"gang",
+     true,
+     winc_gang_update,
+     winc_gang_step,
+     winc_gang_is_busy,
+     winc_gang_is_complete},
+    {"rebuild_pll", false, rebuild_pll, NULL, NULL, NULL},
+    {"regions", true, select_regions, NULL, NULL, NULL},
+    {"quick_check", true, set_quick_check, NULL, NULL, NULL},
+    {"boot_check", true, set_boot_check, NULL, NULL, NULL},
+};
+
+#define N_CMDS (sizeof(s_cmds) / sizeof(s_cmds[0]))
+
+static job_ctx_t s_job_ctx;
+
+static char s_script[JOB_MAX_SCRIPT_LENGTH + 1];
+
+static char s_log_buf[JOB_MAX_LOG_LENGTH];
+
+// *****************************************************************************
+// Public code
+
+void job_init(void) { s_job_ctx.state = JOB_STATE_IDLE; }
+
+bool job_start(const char *filename) {
+  job_ctx_t *ctx = &s_job_ctx;
+  SYS_FS_HANDLE handle;
+  int32_t size;
+
+  if (job_is_busy() || winc_cloner_is_busy() || winc_gang_is_busy()) {
+    SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\njob is busy");
+    return false;
+  }
+  handle = SYS_FS_FileOpen(filename, SYS_FS_FILE_OPEN_READ);
+  if (handle == SYS_FS_HANDLE_INVALID) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nCould not open file %s", filename);
+    return false;
+  }
+  size = SYS_FS_FileSize(handle);
+  if ((size < 0) || (size > JOB_MAX_SCRIPT_LENGTH) ||
+      (SYS_FS_FileRead(handle, s_script, size) != (size_t)size)) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\nCould not read %s (at most %d bytes)",
+                    filename,
+                    JOB_MAX_SCRIPT_LENGTH);
+    SYS_FS_FileClose(handle);
+    return false;
+  }
+  SYS_FS_FileClose(handle);
+  s_script[size] = '\0';
+
+  strncpy(ctx->filename, filename, MAX_FILENAME_LENGTH - 1);
+  ctx->filename[MAX_FILENAME_LENGTH - 1] = '\0';
+  ctx->pos = 0;
+  ctx->line_no = 0;
+  ctx->n_ops = 0;
+  ctx->cancel_requested = false;
+  ctx->cmd = NULL;
+  snprintf(s_log_buf, sizeof(s_log_buf), "%s: started\n", ctx->filename);
+  append_log(s_log_buf);
+  set_state(JOB_STATE_STARTING_OP);
+  return true;
+}
+
+bool job_autorun(void) {
+  if (!file_exists(JOB_AUTORUN_NAME)) {
+    return false;
+  }
+  SYS_CONSOLE_PRINT("\nRunning %s (ESC to cancel)", JOB_AUTORUN_NAME);
+  return job_start(JOB_AUTORUN_NAME);
+}
+
+void job_step(void) {
+  job_ctx_t *ctx = &s_job_ctx;
+
+  switch (ctx->state) {
+  case JOB_STATE_IDLE: {
+    // wait here for job_start()
+  } break;
+
+  case JOB_STATE_STARTING_OP: {
+    if (ctx->cancel_requested || !start_op()) {
+      finish_op(false);
+    }
+  } break;
+
+  case JOB_STATE_RUNNING_OP: {
+    ctx->cmd->step();
+    if (!ctx->cmd->is_busy()) {
+      finish_op(ctx->cmd->is_complete());
+    }
+  } break;
+
+  case JOB_STATE_COMPLETE: {
+    // here on complete state
+  } break;
+
+  case JOB_STATE_ERROR: {
+    // here on error state
+  } break;
+  } // switch
+}
+
+void job_cancel(void) {
+  if (job_is_busy()) {
+    // the operation in progress stops after its current sector
+    s_job_ctx.cancel_requested = true;
+    winc_cloner_cancel();
+    winc_gang_cancel();
+  }
+}
+
+bool job_is_busy(void) {
+  return (s_job_ctx.state == JOB_STATE_STARTING_OP) ||
+         (s_job_ctx.state == JOB_STATE_RUNNING_OP);
+}
+
+bool job_is_complete(void) { return s_job_ctx.state == JOB_STATE_COMPLETE; }
+
+bool job_has_error(void) { return s_job_ctx.state == JOB_STATE_ERROR; }
+
+// *****************************************************************************
+// Private (static) code
+
+static void set_state(job_state_t state) {
+  if (s_job_ctx.state != state) {
+    TRACE2(TRACE_JOB_STATE, s_job_ctx.state, state);
+    s_job_ctx.state = state;
+  }
+}
+
+static bool start_op(void) {
+  job_ctx_t *ctx = &s_job_ctx;
+  char line[JOB_MAX_LINE_LENGTH];
+  char *arg;
+
+  ctx->cmd = NULL;
+  ctx->arg[0] = '\0';
+  if (!next_line(line, sizeof(line))) {
+    SYS_CONSOLE_PRINT("\n%s: %u operations done", ctx->filename, ctx->n_ops);
+    snprintf(s_log_buf,
+             sizeof(s_log_buf),
+             "%s: %u operations done\n",
+             ctx->filename,
+             ctx->n_ops);
+    append_log(s_log_buf);
+    set_state(JOB_STATE_COMPLETE);
+    return true;
+  }
+
+  // split the line into the command word and its argument
+  for (arg = line; (*arg != '\0') && !isspace((unsigned char)*arg); arg++) {
+  }
+  if (*arg != '\0') {
+    *arg++ = '\0';
+    while (isspace((unsigned char)*arg)) {
+      arg++;
+    }
+  }
+  strncpy(ctx->arg, arg, MAX_FILENAME_LENGTH - 1);
+  ctx->arg[MAX_FILENAME_LENGTH - 1] = '\0';
+
+  ctx->cmd = find_cmd(line);
+  if (ctx->cmd == NULL) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\n%s:%u: unknown command %s",
+                    ctx->filename,
+                    ctx->line_no,
+                    line);
+    return false;
+  }
+  if (ctx->cmd->needs_arg && (ctx->arg[0] == '\0')) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\n%s:%u: %s needs an argument",
+                    ctx->filename,
+                    ctx->line_no,
+                    ctx->cmd->name);
+    return false;
+  }
+  if (!ctx->cmd->needs_arg && (ctx->arg[0] != '\0')) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\n%s:%u: %s takes no argument",
+                    ctx->filename,
+                    ctx->line_no,
+                    ctx->cmd->name);
+    return false;
+  }
+  if ((ctx->cmd->start == winc_cloner_extract) &&
+      !expand_serial(ctx->arg, sizeof(ctx->arg))) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nNo serial number left for %s",
+                    ctx->arg);
+    return false;
+  }
+
+  SYS_CONSOLE_PRINT("\n[%s:%u] %s %s", ctx->filename, ctx->line_no,
+                    ctx->cmd->name, ctx->arg);
+  ctx->started_ms = sched_now_ms();
+  if (!ctx->cmd->start(ctx->arg)) {
+    return false;
+  }
+  if (ctx->cmd->step == NULL) {
+    // completed in start
+    finish_op(true);
+  } else {
+    set_state(JOB_STATE_RUNNING_OP);
+  }
+  return true;
+}
+
+static void finish_op(bool ok) {
+  job_ctx_t *ctx = &s_job_ctx;
+  uint32_t elapsed_ms = sched_now_ms() - ctx->started_ms;
+  char detail[32] = "";
+
+  if (ctx->cancel_requested) {
+    ok = false;
+    snprintf(detail, sizeof(detail), ", cancelled");
+  } else if (ok && (ctx->cmd->start == winc_cloner_compare)) {
+    // a WINC that differs from the file fails the job, as at the station
+    uint16_t n_differ = winc_cloner_differ_count();
+    ok = (n_differ == 0);
+    snprintf(detail, sizeof(detail), ", %u sectors differ", n_differ);
+  }
+  snprintf(s_log_buf,
+           sizeof(s_log_buf),
+           "%s:%u: %s %s: %s%s, %lu ms\n",
+           ctx->filename,
+           ctx->line_no,
+           (ctx->cmd == NULL) ? "?" : ctx->cmd->name,
+           ctx->arg,
+           ok ? "ok" : "FAILED",
+           detail,
+           elapsed_ms);
+  append_log(s_log_buf);
+  if (ok) {
+    ctx->n_ops += 1;
+    set_state(JOB_STATE_STARTING_OP);
+  } else {
+    SYS_CONSOLE_PRINT("\n%s: stopped at line %u", ctx->filename,
+                      ctx->line_no);
+    set_state(JOB_STATE_ERROR);
+  }
+}
+
+static bool next_line(char *line, size_t size) {
+  job_ctx_t *ctx = &s_job_ctx;
+
+  while (s_script[ctx->pos] != '\0') {
+    const char *start = &s_script[ctx->pos];
+    size_t len = strcspn(start, "\r\n");
+
+    // step over the line and its CR, LF or CRLF ending
+    ctx->pos += len;
+    if (s_script[ctx->pos] == '\r') {
+      ctx->pos += 1;
+    }
+    if (s_script[ctx->pos] == '\n') {
+      ctx->pos += 1;
+    }
+    ctx->line_no += 1;
+
+    while ((len > 0) && isspace((unsigned char)*start)) {
+      start++;
+      len--;
+    }
+    while ((len > 0) && isspace((unsigned char)start[len - 1])) {
+      len--;
+    }
+    if ((len == 0) || (*start == '#')) {
+      continue; // blank or comment
+    }
+    if (len >= size) {
+      len = size - 1;
+    }
+    memcpy(line, start, len);
+    line[len] = '\0';
+    return true;
+  }
+  return false;
+}
+
+static const job_cmd_t *find_cmd(const char *name) {
+  for (size_t i = 0; i < N_CMDS; i++) {
+    if (strcmp(s_cmds[i].name, name) == 0) {
+      return &s_cmds[i];
+    }
+  }
+  return NULL;
+}
+
+static bool expand_serial(char *filename, size_t size) {
+  char pattern[MAX_FILENAME_LENGTH];
+  char *hashes = strchr(filename, '#');
+  size_t n_digits;
+  uint32_t limit = 1;
+
+  if (hashes == NULL) {
+    return true; // nothing to expand
+  }
+  n_digits = strspn(hashes, "#");
+  for (size_t i = 0; (i < n_digits) && (limit < 100000); i++) {
+    limit *= 10;
+  }
+  strncpy(pattern, filename, sizeof(pattern) - 1);
+  pattern[sizeof(pattern) - 1] = '\0';
+  hashes = &pattern[hashes - filename];
+  *hashes = '\0';
+
+  for (uint32_t serial = 1; serial < limit; serial++) {
+    snprintf(filename,
+             size,
+             "%s%0*lu%s",
+             pattern,
+             (int)n_digits,
+             serial,
+             hashes + n_digits);
+    if (!file_exists(filename)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool file_exists(const char *filename) {
+  SYS_FS_HANDLE handle = SYS_FS_FileOpen(filename, SYS_FS_FILE_OPEN_READ);
+
+  if (handle == SYS_FS_HANDLE_INVALID) {
+    return false;
+  }
+  SYS_FS_FileClose(handle);
+  return true;
+}
+
+static bool rebuild_pll(const char *arg) {
+  (void)arg;
+  return winc_cloner_rebuild_pll();
+}
+
+static bool select_regions(const char *arg) {
+  flash_region_set_t regions;
+
+  if (!flash_region_set_parse(arg, &regions) || (regions == 0)) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nUnknown regions %s", arg);
+    return false;
+  }
+  winc_cloner_set_regions(regions);
+  return true;
+}
+
+static bool set_quick_check(const char *arg) {
+  bool is_on;
+  char *end;
+  unsigned long stride;
+
+  if (isdigit((unsigned char)arg[0])) {
+    // a stride turns the quick check on
+    stride = strtoul(arg, &end, 10);
+    if ((*end != '\0') || (stride == 0) || (stride > UINT16_MAX)) {
+      SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nBad quick check stride %s", arg);
+      return false;
+    }
+    winc_cloner_set_quick_check_stride(stride);
+    is_on = true;
+  } else if (!parse_on_off(arg, &is_on)) {
+    return false;
+  }
+  winc_cloner_set_quick_check(is_on);
+  return true;
+}
+
+static bool set_boot_check(const char *arg) {
+  bool is_on;
+
+  if (!parse_on_off(arg, &is_on)) {
+    return false;
+  }
+  winc_cloner_set_boot_check(is_on);
+  return true;
+}
+
+static bool parse_on_off(const char *arg, bool *is_on) {
+  if (strcmp(arg, "on") == 0) {
+    *is_on = true;
+  } else if (strcmp(arg, "off") == 0) {
+    *is_on = false;
+  } else {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nExpected on or off, not %s", arg);
+    return false;
+  }
+  return true;
+}
+
+static void append_log(const char *text) {
+  SYS_FS_HANDLE handle = SYS_FS_FileOpen(JOB_LOG_NAME, SYS_FS_FILE_OPEN_APPEND);
+  size_t len = strlen(text);
+
+  // Opened and closed for each entry, so the log survives a power cut.
+  if ((handle == SYS_FS_HANDLE_INVALID) ||
+      (SYS_FS_FileWrite(handle, text, len) != len)) {
+    SYS_DEBUG_PRINT(SYS_ERROR_WARNING, "\nCould not append to %s",
+                    JOB_LOG_NAME);
+  }
+  if (handle != SYS_FS_HANDLE_INVALID) {
+    SYS_FS_FileClose(handle);
+  }
+}
+
+// *****************************************************************************
+// End of file
@@ -0,0 +1,130 @@
+/**
+ * @file job.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief job runs a script of winc_cloner operations from the SD card.
+ *
+ * A job script is a text file with one operation per line: a command word
+ * and, for most commands, an argument.  Blank lines and lines starting with
+ * '#' are ignored.  The commands are:
+ *
+ *   extract <file>    extract the WINC into file
+ *   update <file>     update the WINC from file
+ *   compare <file>    compare the WINC against file (a difference is a
+ *                     failure)
+ *   patch <file>      patch the WINC from a delta file
+ *   gang <file>       update every WINC on the winc_bus from file
+ *   rebuild_pll       recompute and rebuild the PLL tables
+ *   regions <list>    work on only these flash regions from here on (see
+ *                     flash_region_set_parse())
+ *
+ * A run of '#' in an extract filename is replaced by the lowest serial number
+ * (zero padded to the length of the run) that does not name an existing file,
+ * e.g. "extract unit####.img" writes unit0001.img, then unit0002.img, etc.
+ *
+ * Operations run back to back and the job stops at the first one that fails.
+ * The result and duration of each is appended to JOB_LOG_NAME.  A script named
+ * JOB_AUTORUN_NAME runs by itself once the card is mounted.
+ */
+
+#ifndef _JOB_H_
+#define _JOB_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stdbool.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+#define JOB_AUTORUN_NAME "autorun.job"
+#define JOB_LOG_NAME "job.log"
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Initialize the job module.  Called once at startup.
+ */
+void job_init(void);
+
+/**
+ * @brief Start running the job script in filename.  The work is done in
+ * job_step().
+ *
+ * @return true if the script was read and started.
+ */
+bool job_start(const char *filename);
+
+/**
+ * @brief Start JOB_AUTORUN_NAME if the card has one.
+ *
+ * @return true if the script was read and started.
+ */
+bool job_autorun(void);
+
+/**
+ * @brief Run the current operation of the job.  Called frequently.
+ */
+void job_step(void);
+
+/**
+ * @brief Cancel the job after the current sector of the current operation.
+ */
+void job_cancel(void);
+
+/**
+ * @brief Return true while a job is running.
+ */
+bool job_is_busy(void);
+
+/**
+ * @brief Return true if the last job ran every operation successfully.
+ */
+bool job_is_complete(void);
+
+/**
+ * @brief Return true if the last job stopped at a failed operation or was
+ * cancelled.
+ */
+bool job_has_error(void);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _JOB_H_ */
@@ -31,6 +31,7 @@
 #include "line_reader.h"
 
 #include "definitions.h"
+#include "sched.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -40,6 +41,11 @@
 
 #define MAX_CHARS 100
 
+#define LINE_READER_TASK_PRIORITY 1
+
+// How often to poll the console while waiting for the rest of a line.
+#define CONSOLE_POLL_MS 10
+
 #define STATES(M)                                                              \
   M(LINE_READER_STATE_INIT)                                                    \
   M(LINE_READER_STATE_START_READING)                                           \
@@ -52,6 +58,9 @@ typedef enum { STATES(EXPAND_STATE_IDS) } line_reader_state_t;
 
 typedef struct {
   line_reader_state_t state;
+  line_reader_callback_fn callback_fn;
+  uintptr_t callback_arg;
+  sched_task_id_t task;
   uint8_t linebuf[MAX_CHARS];
   uint8_t n_read;
 } line_reader_ctx_t;
@@ -69,6 +78,11 @@ static void set_state(line_reader_state_t state);
  */
 static const char *state_name(line_reader_state_t state);
 
+/**
+ * @brief Set the state to final_state and invoke callback.
+ */
+static void endgame(line_reader_state_t final_state);
+
 // *****************************************************************************
 // Private (static) storage
 
@@ -84,16 +98,20 @@ static line_reader_ctx_t s_line_reader_ctx;
 
 void line_reader_init(void) {
   s_line_reader_ctx.state = LINE_READER_STATE_INIT;
+  s_line_reader_ctx.task = sched_task_create(
+      "line_reader", line_reader_step, LINE_READER_TASK_PRIORITY);
 }
 
 /**
- * @brief Step the demo task internal state.  Called frequently.
+ * @brief Step the line_reader internal state.  Registered as a sched task.
  */
 void line_reader_step(void) {
+  (void)sched_take_events();
   switch (s_line_reader_ctx.state) {
 
   case LINE_READER_STATE_INIT: {
     // wait here for a call to line_reader_start()
+    sched_wait_ms(SCHED_FOREVER);
   } break;
 
   case LINE_READER_STATE_START_READING: {
@@ -108,12 +126,16 @@ void line_reader_step(void) {
                                      dst,
                                      MAX_CHARS - s_line_reader_ctx.n_read);
     if (n_read < 0) {
-      set_state(LINE_READER_STATE_ERROR);
+      endgame(LINE_READER_STATE_ERROR);
 
     } else if (s_line_reader_ctx.n_read == MAX_CHARS) {
       // line buffer full without EOL seen.  Just terminate it and continue.
       s_line_reader_ctx.linebuf[MAX_CHARS-1] = '\0';
-      set_state(LINE_READER_STATE_SUCCESS);
+      endgame(LINE_READER_STATE_SUCCESS);
+
+    } else if (n_read == 0) {
+      // nothing typed yet -- remain in this state, but don't spin.
+      sched_sleep_ms(CONSOLE_POLL_MS);
 
     } else {
       // Zero or more chars were read.  Was EOL seen (either \r or \n)?
@@ -121,12 +143,12 @@ void line_reader_step(void) {
       for (int i=0; i<n_read; i++) {
         if (dst[i] == '\r' || dst[i] == '\n') {
           dst[i] = '\0';  // null terminate
-          set_state(LINE_READER_STATE_SUCCESS);
+          endgame(LINE_READER_STATE_SUCCESS);
           break;
         } else if (dst[i] == '\e') {
           // User typed escape -- abort this command.
           dst[i] = '\0';
-          set_state(LINE_READER_STATE_ERROR);
+          endgame(LINE_READER_STATE_ERROR);
           break;
         }
       }
@@ -137,16 +159,25 @@ void line_reader_step(void) {
 
   case LINE_READER_STATE_SUCCESS: {
     // here once a line successfully read in.  Fetch via line_reader_get_line().
+    sched_wait_ms(SCHED_FOREVER);
   } break;
 
   case LINE_READER_STATE_ERROR: {
     // here on error state
+    sched_wait_ms(SCHED_FOREVER);
   } break;
   } // switch
 }
 
+void line_reader_set_callback(line_reader_callback_fn callback_fn,
+                              uintptr_t callback_arg) {
+  s_line_reader_ctx.callback_fn = callback_fn;
+  s_line_reader_ctx.callback_arg = callback_arg;
+}
+
 void line_reader_start(void) {
   s_line_reader_ctx.state = LINE_READER_STATE_START_READING;
+  sched_signal(s_line_reader_ctx.task, 1);
 }
 
 const char *line_reader_get_line(void) {
@@ -179,5 +210,12 @@ static const char *state_name(line_reader_state_t state) {
   return s_state_names[state];
 }
 
+static void endgame(line_reader_state_t final_state) {
+  set_state(final_state);
+  if (s_line_reader_ctx.callback_fn) {
+    s_line_reader_ctx.callback_fn(s_line_reader_ctx.callback_arg);
+  }
+}
+
 // *****************************************************************************
 // End of file
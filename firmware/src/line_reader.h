@@ -57,15 +57,24 @@ typedef void (*line_reader_callback_fn)(uintptr_t arg);
 // Public declarations
 
 /**
- * @brief Initialize the line_reader.  Called once at startup.
+ * @brief Initialize the line_reader and register it as a sched task.  Call
+ * after sched_init().
  */
 void line_reader_init(void);
 
 /**
- * @brief Step the line_reader internal state.  Called frequently.
+ * @brief Step the line_reader internal state.  Registered as a sched task by
+ * line_reader_init().
  */
 void line_reader_step(void);
 
+/**
+ * @brief Set a callback to be triggered when the line_reader completes, with
+ * or without error.
+ */
+void line_reader_set_callback(line_reader_callback_fn callback_fn,
+                              uintptr_t callback_arg);
+
 /**
  * @brief Start reading a line from the console.
  */
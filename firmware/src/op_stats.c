@@ -0,0 +1,147 @@
+/**
+ * @file op_stats.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "op_stats.h"
+
+#include "definitions.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+#define N_PHASES (sizeof(s_phase_names) / sizeof(s_phase_names[0]))
+#define N_COUNTERS (sizeof(s_counter_names) / sizeof(s_counter_names[0]))
+
+typedef struct {
+  uint64_t ticks;
+  uint32_t calls;
+  uint32_t n_bytes;
+} op_stats_phase_stats_t;
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+/**
+ * @brief Convert SYS_TIME ticks to microseconds.
+ */
+static uint64_t ticks_to_us(uint64_t ticks);
+
+/**
+ * @brief Print n_bytes / us in MB/s with three decimals.
+ */
+static void print_rate(uint32_t n_bytes, uint64_t us);
+
+// *****************************************************************************
+// Private (static) storage
+
+#define EXPAND_OP_STATS_NAMES(_id, _name) _name,
+static const char *s_phase_names[] = {OP_STATS_PHASES(EXPAND_OP_STATS_NAMES)};
+static const char *s_counter_names[] = {
+    OP_STATS_COUNTERS(EXPAND_OP_STATS_NAMES)};
+
+static op_stats_phase_stats_t s_phases[N_PHASES];
+static uint32_t s_counters[N_COUNTERS];
+static uint64_t s_started_at;
+
+// *****************************************************************************
+// Public code
+
+void op_stats_reset(void) {
+  memset(s_phases, 0, sizeof(s_phases));
+  memset(s_counters, 0, sizeof(s_counters));
+  s_started_at = SYS_TIME_Counter64Get();
+}
+
+uint32_t op_stats_start(void) { return SYS_TIME_CounterGet(); }
+
+void op_stats_stop(op_stats_phase_t phase, uint32_t start, size_t n_bytes) {
+  op_stats_phase_stats_t *stats = &s_phases[phase];
+  // unsigned arithmetic handles counter wrap
+  stats->ticks += (uint32_t)(SYS_TIME_CounterGet() - start);
+  stats->calls += 1;
+  stats->n_bytes += n_bytes;
+}
+
+void op_stats_count(op_stats_counter_t counter, uint32_t n) {
+  s_counters[counter] += n;
+}
+
+void op_stats_print(const char *op_name, size_t n_bytes) {
+  uint64_t total_us = ticks_to_us(SYS_TIME_Counter64Get() - s_started_at);
+
+  SYS_CONSOLE_PRINT("\n%s: %lu bytes in %lu.%03lu s, ",
+                    op_name,
+                    n_bytes,
+                    (uint32_t)(total_us / 1000000),
+                    (uint32_t)(total_us / 1000 % 1000));
+  print_rate(n_bytes, total_us);
+  SYS_CONSOLE_MESSAGE(" MB/s");
+  SYS_CONSOLE_MESSAGE("\n  phase              ms   calls     bytes    MB/s");
+  for (size_t i = 0; i < N_PHASES; i++) {
+    op_stats_phase_stats_t *stats = &s_phases[i];
+    uint64_t us = ticks_to_us(stats->ticks);
+    if (stats->calls == 0) {
+      continue;
+    }
+    SYS_CONSOLE_PRINT("\n  %-14s %6lu %7lu %9lu ",
+                      s_phase_names[i],
+                      (uint32_t)(us / 1000),
+                      stats->calls,
+                      stats->n_bytes);
+    print_rate(stats->n_bytes, us);
+  }
+  SYS_CONSOLE_MESSAGE("\n ");
+  for (size_t i = 0; i < N_COUNTERS; i++) {
+    SYS_CONSOLE_PRINT(" %lu %s%s",
+                      s_counters[i],
+                      s_counter_names[i],
+                      (i + 1 < N_COUNTERS) ? "," : "");
+  }
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static uint64_t ticks_to_us(uint64_t ticks) {
+  return ticks * 1000000 / SYS_TIME_FrequencyGet();
+}
+
+static void print_rate(uint32_t n_bytes, uint64_t us) {
+  // bytes per microsecond == MB/s
+  uint64_t milli_mbps = (us == 0) ? 0 : (uint64_t)n_bytes * 1000 / us;
+  SYS_CONSOLE_PRINT("%lu.%03lu",
+                    (uint32_t)(milli_mbps / 1000),
+                    (uint32_t)(milli_mbps % 1000));
+}
+
+// *****************************************************************************
+// End of file
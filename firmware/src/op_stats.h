@@ -0,0 +1,115 @@
+/**
+ * @file op_stats.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief op_stats accumulates where the time goes during a winc_cloner
+ * operation and prints a summary when it ends.
+ *
+ * Each phase of work (WINC read, erase, program, SD read / write, compare,
+ * hashing and console output) is bracketed with op_stats_start() and
+ * op_stats_stop(), which accumulate SYS_TIME ticks, calls and bytes for that
+ * phase.  Sector outcomes are tallied with op_stats_count().
+ */
+
+#ifndef _OP_STATS_H_
+#define _OP_STATS_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stddef.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+#define OP_STATS_PHASES(M)                                                     \
+  M(OP_STATS_WINC_READ, "WINC read")                                           \
+  M(OP_STATS_WINC_ERASE, "WINC erase")                                         \
+  M(OP_STATS_WINC_PROGRAM, "WINC program")                                     \
+  M(OP_STATS_WINC_BOOT, "WINC boot")                                           \
+  M(OP_STATS_SD_READ, "SD read")                                               \
+  M(OP_STATS_SD_WRITE, "SD write")                                             \
+  M(OP_STATS_COMPARE, "compare")                                               \
+  M(OP_STATS_HASH, "CRC / SHA")                                                \
+  M(OP_STATS_CONSOLE, "console")
+
+#define OP_STATS_COUNTERS(M)                                                   \
+  M(OP_STATS_SECTORS, "sectors")                                               \
+  M(OP_STATS_SECTORS_EQUAL, "equal")                                           \
+  M(OP_STATS_SECTORS_DIFFER, "differ")                                         \
+  M(OP_STATS_SECTORS_SKIPPED, "skipped")                                       \
+  M(OP_STATS_SECTORS_ERASED, "erased")                                         \
+  M(OP_STATS_PAGES_PROGRAMMED, "pages programmed")
+
+#define EXPAND_OP_STATS_IDS(_id, _name) _id,
+typedef enum { OP_STATS_PHASES(EXPAND_OP_STATS_IDS) } op_stats_phase_t;
+typedef enum { OP_STATS_COUNTERS(EXPAND_OP_STATS_IDS) } op_stats_counter_t;
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Clear all statistics and note the start time of an operation.
+ */
+void op_stats_reset(void);
+
+/**
+ * @brief Return a timestamp to be passed to op_stats_stop().
+ */
+uint32_t op_stats_start(void);
+
+/**
+ * @brief Charge the time since start (and n_bytes) to phase.
+ */
+void op_stats_stop(op_stats_phase_t phase, uint32_t start, size_t n_bytes);
+
+/**
+ * @brief Add n to counter.
+ */
+void op_stats_count(op_stats_counter_t counter, uint32_t n);
+
+/**
+ * @brief Print the per-phase times and the totals for an operation that
+ * processed n_bytes.
+ */
+void op_stats_print(const char *op_name, size_t n_bytes);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _OP_STATS_H_ */
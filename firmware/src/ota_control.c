@@ -0,0 +1,120 @@
+/**
+ * @file ota_control.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "ota_control.h"
+
+#include "m2m_types.h"
+#include "spi_flash_map.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+// The CRC covers every field but the CRC itself.
+#define CRC_COVERAGE (sizeof(tstrOtaControlSec) - sizeof(uint32_t))
+
+#define CRC7_SEED 0x7f
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+/**
+ * @brief The 7 bit CRC used by the boot firmware (_WDRV_WINC_NVMCRC7()).
+ */
+static uint8_t crc7(uint8_t crc, const uint8_t *buf, size_t n_bytes);
+
+// *****************************************************************************
+// Public code
+
+bool ota_control_is_valid(const tstrOtaControlSec *control) {
+  return (control->u32OtaMagicValue == OTA_MAGIC_VALUE) &&
+         (control->u32OtaControlSecCrc ==
+          crc7(CRC7_SEED, (const uint8_t *)control, CRC_COVERAGE));
+}
+
+uint32_t ota_control_inactive_slot(const tstrOtaControlSec *control) {
+  switch (control->u32OtaCurrentWorkingImagOffset) {
+  case M2M_OTA_IMAGE1_OFFSET:
+    return M2M_OTA_IMAGE2_OFFSET;
+  case M2M_OTA_IMAGE2_OFFSET:
+    return M2M_OTA_IMAGE1_OFFSET;
+  default:
+    return OTA_CONTROL_NO_SLOT;
+  }
+}
+
+void ota_control_switch(tstrOtaControlSec *control, uint32_t version) {
+  uint32_t inactive = ota_control_inactive_slot(control);
+
+  control->u32OtaRollbackImageOffset = control->u32OtaCurrentWorkingImagOffset;
+  control->u32OtaRollbackImagFirmwareVer =
+      control->u32OtaCurrentworkingImagFirmwareVer;
+  control->u32OtaRollbackImageValidStatus = OTA_STATUS_VALID;
+  control->u32OtaCurrentWorkingImagOffset = inactive;
+  control->u32OtaCurrentworkingImagFirmwareVer = version;
+  control->u32OtaSequenceNumber += 1;
+  control->u32OtaControlSecCrc =
+      crc7(CRC7_SEED, (const uint8_t *)control, CRC_COVERAGE);
+}
+
+void ota_control_invalidate_rollback(tstrOtaControlSec *control) {
+  control->u32OtaRollbackImageValidStatus = OTA_STATUS_INVALID;
+  control->u32OtaSequenceNumber += 1;
+  control->u32OtaControlSecCrc =
+      crc7(CRC7_SEED, (const uint8_t *)control, CRC_COVERAGE);
+}
+
+void ota_control_format_version(uint32_t version, char *buf, size_t size) {
+  snprintf(buf,
+           size,
+           "%d.%d.%d",
+           M2M_GET_FW_MAJOR(version),
+           M2M_GET_FW_MINOR(version),
+           M2M_GET_FW_PATCH(version));
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static uint8_t crc7(uint8_t crc, const uint8_t *buf, size_t n_bytes) {
+  for (size_t i = 0; i < n_bytes; i++) {
+    for (int bit = 0; bit < 8; bit++) {
+      uint8_t inv = (((buf[i] << bit) & 0x80) >> 7) ^ ((crc >> 6) & 1);
+      crc = ((crc << 1) & 0x7f) ^ (9 * inv);
+    }
+  }
+  return crc;
+}
+
+// *****************************************************************************
+// End of file
@@ -0,0 +1,106 @@
+/**
+ * @file ota_control.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief ota_control reads and rewrites the WINC control sector
+ * (tstrOtaControlSec), which tells the boot firmware which of the two OTA
+ * image slots to run.
+ *
+ * The boot firmware reads the control sector at M2M_CONTROL_FLASH_OFFSET and
+ * falls back to the copy at M2M_CONTROL_FLASH_BKP_OFFSET if the first is not
+ * valid.  The checks here are the ones made by _WDRV_WINC_NVMVerifyCtrlSec()
+ * in wdrv_winc_nvm.c.
+ */
+
+#ifndef _OTA_CONTROL_H_
+#define _OTA_CONTROL_H_
+
+// *****************************************************************************
+// Includes
+
+#include "m2m_types.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+// Returned by ota_control_inactive_slot() for a control sector that does not
+// boot from either OTA slot.
+#define OTA_CONTROL_NO_SLOT 0xffffffff
+
+// Room for ota_control_format_version(): "255.255.255"
+#define OTA_CONTROL_VERSION_SIZE 12
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Return true if control holds the magic value and a correct CRC.
+ */
+bool ota_control_is_valid(const tstrOtaControlSec *control);
+
+/**
+ * @brief Return the offset of the OTA slot that control does not boot from,
+ * or OTA_CONTROL_NO_SLOT.
+ */
+uint32_t ota_control_inactive_slot(const tstrOtaControlSec *control);
+
+/**
+ * @brief Make control boot firmware version from the inactive slot.  The
+ * slot it booted from becomes the (valid) rollback image.  The sequence
+ * number and CRC are updated to match.
+ */
+void ota_control_switch(tstrOtaControlSec *control, uint32_t version);
+
+/**
+ * @brief Mark the rollback image of control invalid, so that the boot
+ * firmware does not fall back to the inactive slot while it is rewritten.
+ * The sequence number and CRC are updated to match.
+ */
+void ota_control_invalidate_rollback(tstrOtaControlSec *control);
+
+/**
+ * @brief Write a firmware version word as "major.minor.patch" into buf.
+ */
+void ota_control_format_version(uint32_t version, char *buf, size_t size);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _OTA_CONTROL_H_ */
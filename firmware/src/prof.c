@@ -0,0 +1,181 @@
+/**
+ * @file prof.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "prof.h"
+
+#include "definitions.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+#define CYCLES_PER_US (CPU_CLOCK_FREQUENCY / 1000000)
+
+// Percentile reported alongside min and max, in tenths of a percent.
+#define TAIL_PERMILLE 990
+
+typedef struct {
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t total;
+  uint32_t buckets[PROF_N_BUCKETS];
+} prof_region_stats_t;
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+/**
+ * @brief Return the histogram bucket for a duration.
+ */
+static uint32_t bucket_of(uint32_t cycles);
+
+/**
+ * @brief Return the upper bound of the bucket holding the given permille of
+ * the region's samples.
+ */
+static uint64_t percentile_cycles(const prof_region_stats_t *stats,
+                                  uint32_t permille);
+
+/**
+ * @brief Print cycles as microseconds with two decimals, right aligned in
+ * width characters.
+ */
+static void print_us(uint64_t cycles, int width);
+
+// *****************************************************************************
+// Private (static) storage
+
+#define EXPAND_PROF_NAMES(_id, _name) _name,
+static const char *s_region_names[] = {PROF_REGIONS(EXPAND_PROF_NAMES)};
+
+static prof_region_stats_t s_regions[PROF_N_REGIONS];
+
+// *****************************************************************************
+// Public code
+
+uint32_t prof_start_cycles[PROF_N_REGIONS];
+
+void prof_init(void) {
+#if PROF_ENABLED
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+  prof_reset();
+}
+
+void prof_reset(void) { memset(s_regions, 0, sizeof(s_regions)); }
+
+void prof_record(prof_region_t region, uint32_t cycles) {
+  prof_region_stats_t *stats = &s_regions[region];
+
+  if (stats->count == 0 || cycles < stats->min) {
+    stats->min = cycles;
+  }
+  if (cycles > stats->max) {
+    stats->max = cycles;
+  }
+  stats->count += 1;
+  stats->total += cycles;
+  stats->buckets[bucket_of(cycles)] += 1;
+}
+
+void prof_print(void) {
+  bool is_empty = true;
+
+  if (!PROF_ENABLED) {
+    SYS_CONSOLE_MESSAGE("\nProfiling is compiled out: build with "
+                        "PROF_ENABLED=1");
+    return;
+  }
+  SYS_CONSOLE_MESSAGE("\n  region              count    min us    max us"
+                      "   mean us    p99 us <");
+  for (size_t i = 0; i < PROF_N_REGIONS; i++) {
+    prof_region_stats_t *stats = &s_regions[i];
+    if (stats->count == 0) {
+      continue;
+    }
+    is_empty = false;
+    SYS_CONSOLE_PRINT("\n  %-16s %8lu", s_region_names[i], stats->count);
+    print_us(stats->min, 10);
+    print_us(stats->max, 10);
+    print_us(stats->total / stats->count, 10);
+    print_us(percentile_cycles(stats, TAIL_PERMILLE), 10);
+    // The histogram, as "<upper bound in us>:count" for non-empty buckets.
+    SYS_CONSOLE_MESSAGE("\n   ");
+    for (uint32_t b = 0; b < PROF_N_BUCKETS; b++) {
+      if (stats->buckets[b] == 0) {
+        continue;
+      }
+      SYS_CONSOLE_MESSAGE(" <");
+      print_us((uint64_t)1 << b, 0);
+      SYS_CONSOLE_PRINT(":%lu", stats->buckets[b]);
+    }
+  }
+  if (is_empty) {
+    SYS_CONSOLE_MESSAGE("\n  (no samples)");
+  }
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static uint32_t bucket_of(uint32_t cycles) {
+  uint32_t bucket = (cycles == 0) ? 0 : 32 - __builtin_clz(cycles);
+  return (bucket < PROF_N_BUCKETS) ? bucket : PROF_N_BUCKETS - 1;
+}
+
+static uint64_t percentile_cycles(const prof_region_stats_t *stats,
+                                  uint32_t permille) {
+  uint64_t wanted = ((uint64_t)stats->count * permille + 999) / 1000;
+  uint64_t seen = 0;
+
+  for (uint32_t b = 0; b < PROF_N_BUCKETS; b++) {
+    seen += stats->buckets[b];
+    if (seen >= wanted) {
+      return (b == PROF_N_BUCKETS - 1) ? stats->max : (uint64_t)1 << b;
+    }
+  }
+  return stats->max;
+}
+
+static void print_us(uint64_t cycles, int width) {
+  uint64_t centi_us = cycles * 100 / CYCLES_PER_US;
+  SYS_CONSOLE_PRINT("%*lu.%02lu",
+                    width ? width - 3 : 0,
+                    (uint32_t)(centi_us / 100),
+                    (uint32_t)(centi_us % 100));
+}
+
+// *****************************************************************************
+// End of file
@@ -0,0 +1,151 @@
+/**
+ * @file prof.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief Cycle-level profiling of hot regions in the drivers.
+ *
+ * PROF_BEGIN(region) and PROF_END(region) bracket a region.  Each region
+ * keeps a count, the min and max, and a log2 histogram of its duration in
+ * CPU cycles, read from the Cortex-M4 DWT cycle counter.  Time spent in an
+ * interrupt handler is included.
+ *
+ * The start time is kept per region rather than on the stack, so a region may
+ * begin in one call and end in another (as in the SD driver's state
+ * machines).  Regions must not nest within themselves.  A region that is
+ * begun but never ended (an error path) is simply not recorded.
+ *
+ * Profiling is compiled out unless PROF_ENABLED is defined as 1 (add
+ * PROF_ENABLED=1 to the project's preprocessor macros); then the macros
+ * expand to nothing.
+ */
+
+#ifndef _PROF_H_
+#define _PROF_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stdint.h>
+
+#ifndef PROF_ENABLED
+#define PROF_ENABLED 0
+#endif
+
+#if PROF_ENABLED
+#include "device.h"
+#endif
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+// spi rsp poll:   nmspi.c, polling for the command and state response bytes
+// spi data poll:  nmspi.c, polling for a data packet's response header
+// nm reg r/w:     nmbus.c, one register read or write
+// nm block ...:   nmbus.c, one block transfer (up to 2040 bytes)
+// flash ... wait: spi_flash.c, waiting on a flash DMA, page program or erase
+// sd read token:  drv_sdspi.c, polling for a data block's start token
+// sd busy:        drv_sdspi.c, the card busy after a block write, or
+//                 drv_sdmmc.c, waiting for the CMD and DAT lines to free up
+// SYS_FS ...:     sys_fs.c, the native (FatFs) read, write and sync calls
+#define PROF_REGIONS(M)                                                        \
+  M(PROF_SPI_RSP_POLL, "spi rsp poll")                                         \
+  M(PROF_SPI_DATA_POLL, "spi data poll")                                       \
+  M(PROF_NM_REG, "nm reg r/w")                                                 \
+  M(PROF_NM_BLOCK_READ, "nm block read")                                       \
+  M(PROF_NM_BLOCK_WRITE, "nm block write")                                     \
+  M(PROF_FLASH_DMA_WAIT, "flash dma wait")                                     \
+  M(PROF_FLASH_PROGRAM_WAIT, "flash prog wait")                                \
+  M(PROF_FLASH_ERASE_WAIT, "flash erase wait")                                 \
+  M(PROF_SD_READ_TOKEN, "sd read token")                                       \
+  M(PROF_SD_BUSY, "sd busy")                                                   \
+  M(PROF_FS_READ, "SYS_FS read")                                               \
+  M(PROF_FS_WRITE, "SYS_FS write")                                             \
+  M(PROF_FS_SYNC, "SYS_FS sync")
+
+#define EXPAND_PROF_IDS(_id, _name) _id,
+typedef enum { PROF_REGIONS(EXPAND_PROF_IDS) PROF_N_REGIONS } prof_region_t;
+
+// Bucket i counts durations of less than 2^i cycles (and at least 2^(i-1));
+// the last bucket also counts everything longer.  2^24 cycles is 140 ms.
+#define PROF_N_BUCKETS 25
+
+#if PROF_ENABLED
+
+#define PROF_BEGIN(region) (prof_start_cycles[(region)] = DWT->CYCCNT)
+#define PROF_END(region)                                                       \
+  prof_record((region), DWT->CYCCNT - prof_start_cycles[(region)])
+
+#else
+
+#define PROF_BEGIN(region) ((void)0)
+#define PROF_END(region) ((void)0)
+
+#endif
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Start times, written by PROF_BEGIN().
+ */
+extern uint32_t prof_start_cycles[PROF_N_REGIONS];
+
+/**
+ * @brief Start the DWT cycle counter and clear the table.
+ */
+void prof_init(void);
+
+/**
+ * @brief Clear the table.
+ */
+void prof_reset(void);
+
+/**
+ * @brief Add one duration to a region.  Called by PROF_END().
+ */
+void prof_record(prof_region_t region, uint32_t cycles);
+
+/**
+ * @brief Print the table: count, min, max, mean and approximate 99th
+ * percentile of each region that was entered, and its histogram.
+ */
+void prof_print(void);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _PROF_H_ */
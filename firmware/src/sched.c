@@ -0,0 +1,215 @@
+/**
+ * @file sched.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "sched.h"
+
+#include "definitions.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+typedef struct {
+  const char *name;
+  sched_step_fn step_fn;
+  uint8_t priority;
+  bool is_sleeping;   // true if waiting for wake_at_ms
+  bool wake_on_event; // true if an event ends the sleep early
+  uint32_t wake_at_ms;
+  volatile uint32_t events;
+} sched_task_t;
+
+typedef struct {
+  sched_task_t tasks[SCHED_MAX_TASKS];
+  uint8_t n_tasks;
+  sched_task_id_t current; // task being run, if any
+  uint8_t last_run;        // for round-robin among equal priorities
+} sched_ctx_t;
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+/**
+ * @brief Return true if task may run at time now.
+ */
+static bool is_ready(sched_task_t *task, uint32_t now);
+
+/**
+ * @brief Idle the CPU for at most ms milliseconds or until an interrupt.
+ */
+static void idle(uint32_t ms);
+
+// *****************************************************************************
+// Private (static) storage
+
+static sched_ctx_t s_sched_ctx;
+
+// Wakes the CPU from idle().  Periodic, since SYS_TIME destroys a single shot
+// timer with a callback when it expires.
+static SYS_TIME_HANDLE s_wake_timer;
+
+// *****************************************************************************
+// Public code
+
+void sched_init(void) {
+  s_sched_ctx.n_tasks = 0;
+  s_sched_ctx.current = SCHED_TASK_ID_INVALID;
+  s_sched_ctx.last_run = 0;
+  s_wake_timer = SYS_TIME_TimerCreate(
+      0, SYS_TIME_MSToCount(SCHED_MAX_IDLE_MS), NULL, 0, SYS_TIME_PERIODIC);
+  if (s_wake_timer == SYS_TIME_HANDLE_INVALID) {
+    SYS_DEBUG_PRINT(SYS_ERROR_WARNING, "\nNo wake timer: idle will not sleep");
+  }
+}
+
+sched_task_id_t sched_task_create(const char *name,
+                                  sched_step_fn step_fn,
+                                  uint8_t priority) {
+  sched_task_t *task;
+
+  if (s_sched_ctx.n_tasks >= SCHED_MAX_TASKS) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nNo room for task %s", name);
+    return SCHED_TASK_ID_INVALID;
+  }
+  task = &s_sched_ctx.tasks[s_sched_ctx.n_tasks];
+  task->name = name;
+  task->step_fn = step_fn;
+  task->priority = priority;
+  task->is_sleeping = false;
+  task->wake_on_event = false;
+  task->wake_at_ms = 0;
+  task->events = 0;
+  return s_sched_ctx.n_tasks++;
+}
+
+void sched_run(void) {
+  uint32_t now = sched_now_ms();
+  uint32_t next_wake = SCHED_MAX_IDLE_MS;
+  int best = -1;
+
+  // Pick the highest priority ready task, starting after the last one run so
+  // that tasks of equal priority take turns.
+  for (uint8_t i = 1; i <= s_sched_ctx.n_tasks; i++) {
+    uint8_t idx = (s_sched_ctx.last_run + i) % s_sched_ctx.n_tasks;
+    sched_task_t *task = &s_sched_ctx.tasks[idx];
+    if (is_ready(task, now)) {
+      if ((best < 0) || (task->priority > s_sched_ctx.tasks[best].priority)) {
+        best = idx;
+      }
+    } else if (task->wake_at_ms - now < next_wake) {
+      next_wake = task->wake_at_ms - now;
+    }
+  }
+
+  if (best < 0) {
+    // nothing to do until the next wake time (or an interrupt)
+    idle(next_wake);
+    return;
+  }
+  s_sched_ctx.last_run = best;
+  s_sched_ctx.current = best;
+  s_sched_ctx.tasks[best].is_sleeping = false;
+  s_sched_ctx.tasks[best].step_fn();
+  s_sched_ctx.current = SCHED_TASK_ID_INVALID;
+}
+
+void sched_sleep_ms(uint32_t ms) {
+  SYS_ASSERT(s_sched_ctx.current != SCHED_TASK_ID_INVALID,
+             "sched_sleep_ms() called outside of a task");
+  sched_task_t *task = &s_sched_ctx.tasks[s_sched_ctx.current];
+  task->is_sleeping = true;
+  task->wake_on_event = false;
+  task->wake_at_ms = sched_now_ms() + ms;
+}
+
+void sched_wait_ms(uint32_t ms) {
+  SYS_ASSERT(s_sched_ctx.current != SCHED_TASK_ID_INVALID,
+             "sched_wait_ms() called outside of a task");
+  sched_task_t *task = &s_sched_ctx.tasks[s_sched_ctx.current];
+  task->is_sleeping = true;
+  task->wake_on_event = true;
+  // "forever" is as far ahead as the wrap-safe comparison allows (~24 days)
+  task->wake_at_ms = sched_now_ms() + ((ms > INT32_MAX) ? INT32_MAX : ms);
+}
+
+void sched_signal(sched_task_id_t id, uint32_t events) {
+  if ((id >= 0) && (id < s_sched_ctx.n_tasks)) {
+    __atomic_fetch_or(&s_sched_ctx.tasks[id].events, events, __ATOMIC_RELAXED);
+  }
+}
+
+uint32_t sched_take_events(void) {
+  SYS_ASSERT(s_sched_ctx.current != SCHED_TASK_ID_INVALID,
+             "sched_take_events() called outside of a task");
+  sched_task_t *task = &s_sched_ctx.tasks[s_sched_ctx.current];
+  return __atomic_exchange_n(&task->events, 0, __ATOMIC_RELAXED);
+}
+
+uint32_t sched_now_ms(void) {
+  return (uint32_t)(SYS_TIME_Counter64Get() /
+                    (SYS_TIME_FrequencyGet() / 1000));
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static bool is_ready(sched_task_t *task, uint32_t now) {
+  if (!task->is_sleeping) {
+    return true;
+  }
+  if (task->wake_on_event && (task->events != 0)) {
+    return true;
+  }
+  // wrap-safe comparison: has wake_at_ms arrived?
+  return (int32_t)(now - task->wake_at_ms) >= 0;
+}
+
+static void idle(uint32_t ms) {
+  if (ms == 0) {
+    return;
+  }
+  // Restart the wake timer so that WFI returns no later than ms from now.
+  // The console, SD and WINC interrupts also wake the CPU.
+  if ((s_wake_timer != SYS_TIME_HANDLE_INVALID) &&
+      (SYS_TIME_TimerReload(s_wake_timer,
+                            0,
+                            SYS_TIME_MSToCount(ms),
+                            NULL,
+                            0,
+                            SYS_TIME_PERIODIC) == SYS_TIME_SUCCESS)) {
+    __WFI();
+    SYS_TIME_TimerStop(s_wake_timer);
+  }
+}
+
+// *****************************************************************************
+// End of file
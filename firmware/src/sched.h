@@ -0,0 +1,141 @@
+/**
+ * @file sched.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief sched is a small run-to-completion scheduler for step functions.
+ *
+ * Each task is an existing `void foo_step(void)` function registered with a
+ * priority.  sched_run() calls the step function of the highest priority task
+ * that is ready.  A task is ready unless it has put itself to sleep with
+ * sched_sleep_ms() (or sched_wait_ms()) and its wake time has not arrived.
+ * Signalling events to a sleeping task wakes it early.  When no task is
+ * ready, sched_run() idles the CPU until the next wake time.
+ *
+ * Tasks that never sleep behave exactly as if polled from the superloop, so
+ * existing tasks port over unchanged and only need to add a sleep where they
+ * would otherwise spin.
+ */
+
+#ifndef _SCHED_H_
+#define _SCHED_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+#define SCHED_MAX_TASKS 8
+
+// Wait indefinitely (until signalled).
+#define SCHED_FOREVER UINT32_MAX
+
+// Never idle longer than this, so that the polled Harmony drivers in
+// SYS_Tasks() keep running.
+#define SCHED_MAX_IDLE_MS 10
+
+typedef int8_t sched_task_id_t;
+
+#define SCHED_TASK_ID_INVALID ((sched_task_id_t)-1)
+
+/**
+ * @brief Signature for a task's step function.
+ */
+typedef void (*sched_step_fn)(void);
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Initialize the scheduler.  Called once at startup.
+ */
+void sched_init(void);
+
+/**
+ * @brief Register a task.  Higher priority tasks run first; tasks of equal
+ * priority take turns.
+ *
+ * @return the task id, or SCHED_TASK_ID_INVALID if the task table is full.
+ */
+sched_task_id_t sched_task_create(const char *name,
+                                  sched_step_fn step_fn,
+                                  uint8_t priority);
+
+/**
+ * @brief Run the highest priority ready task once, or idle if none is ready.
+ * Called from the superloop.
+ */
+void sched_run(void);
+
+/**
+ * @brief Called from within a step function: do not run the current task
+ * again for ms milliseconds.  Events signalled meanwhile are kept but do not
+ * end the sleep.
+ */
+void sched_sleep_ms(uint32_t ms);
+
+/**
+ * @brief Called from within a step function: do not run the current task
+ * again until it is signalled or ms milliseconds pass.
+ */
+void sched_wait_ms(uint32_t ms);
+
+/**
+ * @brief Set event flags on a task, making it ready.  Safe to call from an
+ * interrupt.
+ */
+void sched_signal(sched_task_id_t id, uint32_t events);
+
+/**
+ * @brief Called from within a step function: return and clear the current
+ * task's event flags.
+ */
+uint32_t sched_take_events(void);
+
+/**
+ * @brief Return the current time in milliseconds.
+ */
+uint32_t sched_now_ms(void);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _SCHED_H_ */
@@ -0,0 +1,203 @@
+/**
+ * @file sha256.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "sha256.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define CH(x, y, z) (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define BSIG0(x) (ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define BSIG1(x) (ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+#define SSIG0(x) (ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))
+#define SSIG1(x) (ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+/**
+ * @brief Fold one SHA256_BLOCK_SIZE block into the running state.
+ */
+static void compress(uint32_t state[8], const uint8_t *block);
+
+// *****************************************************************************
+// Private (static) storage
+
+// Round constants, lives in flash.
+static const uint32_t s_k[64] = {
+    0x428a2f98ul, 0x71374491ul, 0xb5c0fbcful, 0xe9b5dba5ul,
+    0x3956c25bul, 0x59f111f1ul, 0x923f82a4ul, 0xab1c5ed5ul,
+    0xd807aa98ul, 0x12835b01ul, 0x243185beul, 0x550c7dc3ul,
+    0x72be5d74ul, 0x80deb1feul, 0x9bdc06a7ul, 0xc19bf174ul,
+    0xe49b69c1ul, 0xefbe4786ul, 0x0fc19dc6ul, 0x240ca1ccul,
+    0x2de92c6ful, 0x4a7484aaul, 0x5cb0a9dcul, 0x76f988daul,
+    0x983e5152ul, 0xa831c66dul, 0xb00327c8ul, 0xbf597fc7ul,
+    0xc6e00bf3ul, 0xd5a79147ul, 0x06ca6351ul, 0x14292967ul,
+    0x27b70a85ul, 0x2e1b2138ul, 0x4d2c6dfcul, 0x53380d13ul,
+    0x650a7354ul, 0x766a0abbul, 0x81c2c92eul, 0x92722c85ul,
+    0xa2bfe8a1ul, 0xa81a664bul, 0xc24b8b70ul, 0xc76c51a3ul,
+    0xd192e819ul, 0xd6990624ul, 0xf40e3585ul, 0x106aa070ul,
+    0x19a4c116ul, 0x1e376c08ul, 0x2748774cul, 0x34b0bcb5ul,
+    0x391c0cb3ul, 0x4ed8aa4aul, 0x5b9cca4ful, 0x682e6ff3ul,
+    0x748f82eeul, 0x78a5636ful, 0x84c87814ul, 0x8cc70208ul,
+    0x90befffaul, 0xa4506cebul, 0xbef9a3f7ul, 0xc67178f2ul,
+};
+
+// *****************************************************************************
+// Public code
+
+void sha256_init(sha256_ctx_t *ctx) {
+  ctx->state[0] = 0x6a09e667ul;
+  ctx->state[1] = 0xbb67ae85ul;
+  ctx->state[2] = 0x3c6ef372ul;
+  ctx->state[3] = 0xa54ff53aul;
+  ctx->state[4] = 0x510e527ful;
+  ctx->state[5] = 0x9b05688cul;
+  ctx->state[6] = 0x1f83d9abul;
+  ctx->state[7] = 0x5be0cd19ul;
+  ctx->n_bytes = 0;
+  ctx->block_fill = 0;
+}
+
+void sha256_update(sha256_ctx_t *ctx, const uint8_t *buf, size_t n_bytes) {
+  ctx->n_bytes += n_bytes;
+
+  // top off a partially filled block
+  if (ctx->block_fill > 0) {
+    size_t n = SHA256_BLOCK_SIZE - ctx->block_fill;
+    if (n > n_bytes) {
+      n = n_bytes;
+    }
+    memcpy(&ctx->block[ctx->block_fill], buf, n);
+    ctx->block_fill += n;
+    buf += n;
+    n_bytes -= n;
+    if (ctx->block_fill < SHA256_BLOCK_SIZE) {
+      return;
+    }
+    compress(ctx->state, ctx->block);
+    ctx->block_fill = 0;
+  }
+  // whole blocks straight from buf
+  while (n_bytes >= SHA256_BLOCK_SIZE) {
+    compress(ctx->state, buf);
+    buf += SHA256_BLOCK_SIZE;
+    n_bytes -= SHA256_BLOCK_SIZE;
+  }
+  // save the remainder for next time
+  memcpy(ctx->block, buf, n_bytes);
+  ctx->block_fill = n_bytes;
+}
+
+void sha256_final(sha256_ctx_t *ctx, uint8_t digest[SHA256_DIGEST_SIZE]) {
+  uint64_t n_bits = ctx->n_bytes * 8;
+
+  // append the 0x80 terminator, pad with zeros and append the bit length
+  ctx->block[ctx->block_fill++] = 0x80;
+  if (ctx->block_fill > SHA256_BLOCK_SIZE - 8) {
+    memset(&ctx->block[ctx->block_fill],
+           0,
+           SHA256_BLOCK_SIZE - ctx->block_fill);
+    compress(ctx->state, ctx->block);
+    ctx->block_fill = 0;
+  }
+  memset(&ctx->block[ctx->block_fill],
+         0,
+         SHA256_BLOCK_SIZE - 8 - ctx->block_fill);
+  for (int i = 0; i < 8; i++) {
+    ctx->block[SHA256_BLOCK_SIZE - 1 - i] = (uint8_t)(n_bits >> (8 * i));
+  }
+  compress(ctx->state, ctx->block);
+
+  for (int i = 0; i < 8; i++) {
+    digest[4 * i + 0] = (uint8_t)(ctx->state[i] >> 24);
+    digest[4 * i + 1] = (uint8_t)(ctx->state[i] >> 16);
+    digest[4 * i + 2] = (uint8_t)(ctx->state[i] >> 8);
+    digest[4 * i + 3] = (uint8_t)(ctx->state[i]);
+  }
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static void compress(uint32_t state[8], const uint8_t *block) {
+  uint32_t w[64];
+  uint32_t a, b, c, d, e, f, g, h;
+
+  for (int i = 0; i < 16; i++) {
+    w[i] = ((uint32_t)block[4 * i] << 24) |
+           ((uint32_t)block[4 * i + 1] << 16) |
+           ((uint32_t)block[4 * i + 2] << 8) | ((uint32_t)block[4 * i + 3]);
+  }
+  for (int i = 16; i < 64; i++) {
+    w[i] = SSIG1(w[i - 2]) + w[i - 7] + SSIG0(w[i - 15]) + w[i - 16];
+  }
+
+  a = state[0];
+  b = state[1];
+  c = state[2];
+  d = state[3];
+  e = state[4];
+  f = state[5];
+  g = state[6];
+  h = state[7];
+
+  for (int i = 0; i < 64; i++) {
+    uint32_t t1 = h + BSIG1(e) + CH(e, f, g) + s_k[i] + w[i];
+    uint32_t t2 = BSIG0(a) + MAJ(a, b, c);
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+// *****************************************************************************
+// End of file
@@ -0,0 +1,90 @@
+/**
+ * @file sha256.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief sha256 computes the FIPS 180-4 SHA-256 digest of a byte stream.
+ *
+ * sha256 is used to fingerprint whole WINC images as they stream through
+ * winc_cloner, so a manifest can prove end-to-end which image a device holds.
+ */
+
+#ifndef _SHA256_H_
+#define _SHA256_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stddef.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+#define SHA256_DIGEST_SIZE 32
+#define SHA256_BLOCK_SIZE 64
+
+typedef struct {
+  uint32_t state[8];
+  uint64_t n_bytes; // total bytes hashed so far
+  uint8_t block[SHA256_BLOCK_SIZE];
+  size_t block_fill; // bytes in block
+} sha256_ctx_t;
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Prepare ctx for a new digest.
+ */
+void sha256_init(sha256_ctx_t *ctx);
+
+/**
+ * @brief Extend the running digest with n_bytes of buf.
+ */
+void sha256_update(sha256_ctx_t *ctx, const uint8_t *buf, size_t n_bytes);
+
+/**
+ * @brief Finish the digest and write SHA256_DIGEST_SIZE bytes to digest.
+ *
+ * ctx must be re-initialized with sha256_init() before it is used again.
+ */
+void sha256_final(sha256_ctx_t *ctx, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _SHA256_H_ */
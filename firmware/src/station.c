@@ -0,0 +1,299 @@
+/**
+ * @file station.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "station.h"
+
+#include "definitions.h"
+#include "nmasic.h"
+#include "sched.h"
+#include "trace.h"
+#include "winc_cloner.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+#define STATES(M)                                                              \
+  M(STATION_STATE_IDLE)                                                        \
+  M(STATION_STATE_AWAIT_INSERT)                                                \
+  M(STATION_STATE_UPDATING)                                                    \
+  M(STATION_STATE_VERIFYING)                                                   \
+  M(STATION_STATE_AWAIT_REMOVAL)                                               \
+  M(STATION_STATE_STOPPING)
+
+#define EXPAND_STATE_IDS(_name) _name,
+typedef enum { STATES(EXPAND_STATE_IDS) } station_state_t;
+
+#define MAX_FILENAME_LENGTH 80
+
+// How often to look for a WINC being inserted or removed.
+#define STATION_POLL_MS 250
+
+// Consecutive polls that must agree before a WINC counts as inserted (so its
+// contacts and supply have settled) or removed.
+#define STATION_DEBOUNCE_POLLS 2
+
+// LED blink period while programming.
+#define STATION_BUSY_BLINK_MS 500
+
+// Boards without a user LED (see bsp.h) report on the console only.
+#ifndef LED_On
+#define LED_On()
+#define LED_Off()
+#define LED_Toggle()
+#endif
+
+typedef struct {
+  station_state_t state;
+  char filename[MAX_FILENAME_LENGTH];
+  uint8_t n_agree;     // consecutive polls that saw the awaited change
+  uint32_t chip_id;    // of the WINC in the socket, or 0
+  bool passed;         // result for the WINC in the socket
+  uint16_t n_passed;   // since station_start()
+  uint16_t n_failed;   // since station_start()
+  uint32_t started_ms; // when programming started
+  uint32_t blink_ms;   // when the LED last toggled
+} station_ctx_t;
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+static void set_state(station_state_t state);
+
+/**
+ * @brief Return true if a WINC answers with a plausible chip ID.  If reset is
+ * true, first reset the WINC and put it into download mode, as a newly
+ * inserted WINC requires.
+ */
+static bool winc_is_present(bool reset);
+
+/**
+ * @brief Count a poll that saw (or did not see) the awaited change and return
+ * true once STATION_DEBOUNCE_POLLS polls in a row have.
+ */
+static bool debounce(bool changed);
+
+static void finish(bool passed);
+
+static void blink(uint32_t period_ms);
+
+// *****************************************************************************
+// Private (static) storage
+
+static station_ctx_t s_station_ctx;
+
+// *****************************************************************************
+// Public code
+
+void station_init(void) { s_station_ctx.state = STATION_STATE_IDLE; }
+
+bool station_start(const char *filename) {
+  station_ctx_t *ctx = &s_station_ctx;
+
+  if (station_is_busy() || winc_cloner_is_busy()) {
+    SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\nstation is busy");
+    return false;
+  }
+  strncpy(ctx->filename, filename, MAX_FILENAME_LENGTH - 1);
+  ctx->filename[MAX_FILENAME_LENGTH - 1] = '\0';
+  ctx->n_agree = 0;
+  ctx->chip_id = 0;
+  ctx->n_passed = 0;
+  ctx->n_failed = 0;
+  LED_Off();
+  SYS_CONSOLE_MESSAGE("\nInsert a WINC");
+  set_state(STATION_STATE_AWAIT_INSERT);
+  return true;
+}
+
+void station_step(void) {
+  station_ctx_t *ctx = &s_station_ctx;
+
+  switch (ctx->state) {
+  case STATION_STATE_IDLE: {
+    // wait here for station_start()
+  } break;
+
+  case STATION_STATE_AWAIT_INSERT: {
+    if (!debounce(winc_is_present(true))) {
+      sched_sleep_ms(STATION_POLL_MS);
+      break;
+    }
+    SYS_CONSOLE_PRINT("\nWINC %06lx inserted, updating from %s",
+                      ctx->chip_id,
+                      ctx->filename);
+    ctx->started_ms = sched_now_ms();
+    ctx->blink_ms = ctx->started_ms;
+    if (winc_cloner_update(ctx->filename)) {
+      set_state(STATION_STATE_UPDATING);
+    } else {
+      finish(false);
+    }
+  } break;
+
+  case STATION_STATE_UPDATING: {
+    winc_cloner_step();
+    blink(STATION_BUSY_BLINK_MS);
+    if (winc_cloner_is_busy()) {
+      // remain in this state until the update completes
+    } else if (winc_cloner_is_complete() && winc_cloner_get_boot_check()) {
+      // Written sectors were read back and the WINC booted the image's
+      // firmware: no need to compare every sector.
+      finish(true);
+    } else if (winc_cloner_is_complete() &&
+               winc_cloner_compare(ctx->filename)) {
+      set_state(STATION_STATE_VERIFYING);
+    } else {
+      finish(false);
+    }
+  } break;
+
+  case STATION_STATE_VERIFYING: {
+    winc_cloner_step();
+    blink(STATION_BUSY_BLINK_MS);
+    if (!winc_cloner_is_busy()) {
+      finish(winc_cloner_is_complete() && (winc_cloner_differ_count() == 0));
+    }
+  } break;
+
+  case STATION_STATE_AWAIT_REMOVAL: {
+    if (!ctx->passed) {
+      LED_Toggle();
+    }
+    if (!debounce(!winc_is_present(false))) {
+      sched_sleep_ms(STATION_POLL_MS);
+      break;
+    }
+    LED_Off();
+    SYS_CONSOLE_MESSAGE("\nWINC removed.  Insert the next WINC");
+    set_state(STATION_STATE_AWAIT_INSERT);
+  } break;
+
+  case STATION_STATE_STOPPING: {
+    // let a cancelled update finish its current sector
+    winc_cloner_step();
+    if (!winc_cloner_is_busy()) {
+      LED_Off();
+      winc_cloner_close_winc();
+      SYS_CONSOLE_PRINT("\nLeft station mode: %u passed, %u failed",
+                        ctx->n_passed,
+                        ctx->n_failed);
+      set_state(STATION_STATE_IDLE);
+    }
+  } break;
+  } // switch
+}
+
+void station_stop(void) {
+  if (station_is_busy()) {
+    winc_cloner_cancel();
+    set_state(STATION_STATE_STOPPING);
+  }
+}
+
+bool station_is_busy(void) {
+  return s_station_ctx.state != STATION_STATE_IDLE;
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static void set_state(station_state_t state) {
+  if (s_station_ctx.state != state) {
+    TRACE2(TRACE_STATION_STATE, s_station_ctx.state, state);
+    s_station_ctx.state = state;
+    s_station_ctx.n_agree = 0;
+  }
+}
+
+static bool winc_is_present(bool reset) {
+  SYS_ERROR_LEVEL level = SYS_DEBUG_ErrorLevelGet();
+  uint32_t chip_id;
+
+  // An empty socket makes the driver complain on every poll.
+  SYS_DEBUG_ErrorLevelSet(SYS_ERROR_FATAL);
+  if (reset) {
+    winc_cloner_close_winc();
+    winc_cloner_open_winc();
+  } else {
+    nmi_set_chipid_cache(0);
+  }
+  chip_id = nmi_get_chipid();
+  SYS_DEBUG_ErrorLevelSet(level);
+
+  // A floating MISO line reads as all ones.
+  s_station_ctx.chip_id = ((chip_id >> 24) == 0) ? chip_id : 0;
+  return s_station_ctx.chip_id != 0;
+}
+
+static bool debounce(bool changed) {
+  station_ctx_t *ctx = &s_station_ctx;
+
+  ctx->n_agree = changed ? ctx->n_agree + 1 : 0;
+  return ctx->n_agree >= STATION_DEBOUNCE_POLLS;
+}
+
+static void finish(bool passed) {
+  station_ctx_t *ctx = &s_station_ctx;
+  uint32_t elapsed_ms = sched_now_ms() - ctx->started_ms;
+
+  ctx->passed = passed;
+  if (passed) {
+    ctx->n_passed += 1;
+    LED_On();
+  } else {
+    ctx->n_failed += 1;
+    LED_Off();
+  }
+  SYS_CONSOLE_PRINT("\n%s: WINC %06lx in %lu.%01lu s (%u passed, %u failed)",
+                    passed ? "PASS" : "FAIL",
+                    ctx->chip_id,
+                    elapsed_ms / 1000,
+                    elapsed_ms / 100 % 10,
+                    ctx->n_passed,
+                    ctx->n_failed);
+  SYS_CONSOLE_MESSAGE("\nRemove the WINC");
+  set_state(STATION_STATE_AWAIT_REMOVAL);
+}
+
+static void blink(uint32_t period_ms) {
+  uint32_t now = sched_now_ms();
+
+  if (now - s_station_ctx.blink_ms >= period_ms) {
+    LED_Toggle();
+    s_station_ctx.blink_ms = now;
+  }
+}
+
+// *****************************************************************************
+// End of file
@@ -0,0 +1,97 @@
+/**
+ * @file station.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief station turns winc-cloner into a hands-free production station.
+ *
+ * Once started with an image, station polls for a WINC module by reading its
+ * chip ID.  When one is inserted, it updates the module from the image,
+ * verifies it with a compare, reports PASS or FAIL on the console and the
+ * board LED, then waits for the module to be removed before re-arming.
+ *
+ * The LED is off while waiting for a module, blinks slowly while programming,
+ * is on for PASS and blinks quickly for FAIL.  Boards without a user LED
+ * report on the console only.
+ */
+
+#ifndef _STATION_H_
+#define _STATION_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stdbool.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Initialize the station module.  Called once at startup.
+ */
+void station_init(void);
+
+/**
+ * @brief Start station mode: program every WINC inserted from now on from
+ * filename.  The work is done in station_step().
+ *
+ * @return true if station mode was started.
+ */
+bool station_start(const char *filename);
+
+/**
+ * @brief Poll for a WINC or program one.  Called frequently.
+ */
+void station_step(void);
+
+/**
+ * @brief Leave station mode.  A WINC being programmed is left partially
+ * updated.
+ */
+void station_stop(void);
+
+/**
+ * @brief Return true while in station mode.
+ */
+bool station_is_busy(void);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _STATION_H_ */
@@ -0,0 +1,175 @@
+/**
+ * @file stream_frame.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "stream_frame.h"
+
+#include "crc32.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+// Offsets within the header
+#define TYPE_OFFSET 1
+#define SEQ_OFFSET 2
+#define LEN_OFFSET 4
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+/**
+ * @brief Return the CRC of a frame: its header after the SOF, then payload.
+ */
+static uint32_t frame_crc(const uint8_t *header,
+                          const uint8_t *payload,
+                          uint16_t len);
+
+// *****************************************************************************
+// Public code
+
+size_t stream_frame_encode(uint8_t *dst,
+                           stream_frame_type_t type,
+                           uint16_t seq,
+                           const uint8_t *payload,
+                           uint16_t len) {
+  uint8_t *crc = &dst[STREAM_FRAME_HEADER_SZ + len];
+
+  dst[0] = STREAM_FRAME_SOF;
+  dst[TYPE_OFFSET] = type;
+  stream_frame_put_u16(&dst[SEQ_OFFSET], seq);
+  stream_frame_put_u16(&dst[LEN_OFFSET], len);
+  if (len > 0) {
+    memcpy(&dst[STREAM_FRAME_HEADER_SZ], payload, len);
+  }
+  stream_frame_put_u32(crc, frame_crc(dst, &dst[STREAM_FRAME_HEADER_SZ], len));
+  return STREAM_FRAME_HEADER_SZ + len + STREAM_FRAME_CRC_SZ;
+}
+
+void stream_frame_decoder_init(stream_frame_decoder_t *decoder) {
+  decoder->n_have = 0;
+}
+
+size_t stream_frame_decoder_needs(const stream_frame_decoder_t *decoder) {
+  if (decoder->n_have == 0) {
+    return 1;
+  } else if (decoder->n_have < STREAM_FRAME_HEADER_SZ) {
+    return STREAM_FRAME_HEADER_SZ - decoder->n_have;
+  }
+  return STREAM_FRAME_HEADER_SZ + decoder->frame.len + STREAM_FRAME_CRC_SZ -
+         decoder->n_have;
+}
+
+stream_frame_result_t stream_frame_decode(stream_frame_decoder_t *decoder,
+                                          uint8_t byte) {
+  stream_frame_t *frame = &decoder->frame;
+  uint16_t n = decoder->n_have;
+
+  if (n == 0) {
+    if (byte != STREAM_FRAME_SOF) {
+      return STREAM_FRAME_NOISE;
+    }
+    decoder->header[0] = byte;
+    decoder->n_have = 1;
+    return STREAM_FRAME_NONE;
+  }
+  if (n < STREAM_FRAME_HEADER_SZ) {
+    decoder->header[n] = byte;
+    decoder->n_have += 1;
+    if (decoder->n_have < STREAM_FRAME_HEADER_SZ) {
+      return STREAM_FRAME_NONE;
+    }
+    frame->type = decoder->header[TYPE_OFFSET];
+    frame->seq = stream_frame_get_u16(&decoder->header[SEQ_OFFSET]);
+    frame->len = stream_frame_get_u16(&decoder->header[LEN_OFFSET]);
+    if ((frame->type < STREAM_FRAME_HELLO) ||
+        (frame->type > STREAM_FRAME_ABORT) ||
+        (frame->len > STREAM_FRAME_MAX_PAYLOAD)) {
+      // not a frame after all: look for the next SOF
+      decoder->n_have = 0;
+      return STREAM_FRAME_BAD;
+    }
+    return STREAM_FRAME_NONE;
+  }
+  n -= STREAM_FRAME_HEADER_SZ;
+  if (n < frame->len) {
+    frame->payload[n] = byte;
+    decoder->n_have += 1;
+    return STREAM_FRAME_NONE;
+  }
+  n -= frame->len;
+  decoder->crc[n] = byte;
+  if (n + 1 < STREAM_FRAME_CRC_SZ) {
+    decoder->n_have += 1;
+    return STREAM_FRAME_NONE;
+  }
+  decoder->n_have = 0;
+  if (stream_frame_get_u32(decoder->crc) !=
+      frame_crc(decoder->header, frame->payload, frame->len)) {
+    return STREAM_FRAME_BAD;
+  }
+  return STREAM_FRAME_OK;
+}
+
+void stream_frame_put_u16(uint8_t *dst, uint16_t value) {
+  dst[0] = value & 0xff;
+  dst[1] = value >> 8;
+}
+
+void stream_frame_put_u32(uint8_t *dst, uint32_t value) {
+  stream_frame_put_u16(&dst[0], value & 0xffff);
+  stream_frame_put_u16(&dst[2], value >> 16);
+}
+
+uint16_t stream_frame_get_u16(const uint8_t *src) {
+  return (uint16_t)(src[0] | (src[1] << 8));
+}
+
+uint32_t stream_frame_get_u32(const uint8_t *src) {
+  return stream_frame_get_u16(&src[0]) |
+         ((uint32_t)stream_frame_get_u16(&src[2]) << 16);
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static uint32_t frame_crc(const uint8_t *header,
+                          const uint8_t *payload,
+                          uint16_t len) {
+  uint32_t crc = crc32_update(CRC32_INITIAL_VALUE,
+                              &header[TYPE_OFFSET],
+                              STREAM_FRAME_HEADER_SZ - TYPE_OFFSET);
+  return crc32_update(crc, payload, len);
+}
+
+// *****************************************************************************
+// End of file
@@ -0,0 +1,157 @@
+/**
+ * @file stream_frame.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief stream_frame encodes and decodes the frames of the image streaming
+ * protocol that `s` speaks over the console UART (see uart_stream.h).
+ *
+ * Every frame is:
+ *
+ *   0xa5 | type (1) | seq (2) | len (2) | payload (len) | CRC-32 (4)
+ *
+ * with multi-byte fields little-endian and the CRC covering type through the
+ * end of the payload.  A decoder skips anything that is not a well-formed
+ * frame, so frames can share the wire with console text.
+ *
+ * stream_frame has no Harmony dependencies: the host sender in
+ * tools/uart_stream uses it too.
+ */
+
+#ifndef _STREAM_FRAME_H_
+#define _STREAM_FRAME_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+#define STREAM_FRAME_SOF 0xa5
+
+#define STREAM_FRAME_HEADER_SZ 6 // SOF, type, seq, len
+#define STREAM_FRAME_CRC_SZ 4
+#define STREAM_FRAME_MAX_PAYLOAD 512
+#define STREAM_FRAME_MAX_SZ                                                    \
+  (STREAM_FRAME_HEADER_SZ + STREAM_FRAME_MAX_PAYLOAD + STREAM_FRAME_CRC_SZ)
+
+typedef enum {
+  STREAM_FRAME_HELLO = 1, // board to host: version, payload size, window, baud
+  STREAM_FRAME_START,     // host to board: image size and CRC-32
+  STREAM_FRAME_DATA,      // host to board: packet seq of the image
+  STREAM_FRAME_ACK,       // board to host: seq received, send up to limit
+  STREAM_FRAME_NAK,       // board to host: resend from seq
+  STREAM_FRAME_DONE,      // board to host: status and bytes received
+  STREAM_FRAME_ABORT,     // either way: give up
+} stream_frame_type_t;
+
+typedef struct {
+  uint8_t type; // stream_frame_type_t
+  uint16_t seq;
+  uint16_t len; // # of valid bytes in payload[]
+  uint8_t payload[STREAM_FRAME_MAX_PAYLOAD];
+} stream_frame_t;
+
+typedef enum {
+  STREAM_FRAME_NONE,  // byte consumed, no frame yet
+  STREAM_FRAME_OK,    // frame is complete and valid
+  STREAM_FRAME_BAD,   // a frame failed its CRC or length check
+  STREAM_FRAME_NOISE, // byte is not part of a frame (e.g. console text)
+} stream_frame_result_t;
+
+typedef struct {
+  stream_frame_t frame; // being decoded, valid after STREAM_FRAME_OK
+  uint16_t n_have;      // bytes of the current frame seen so far
+  uint8_t header[STREAM_FRAME_HEADER_SZ];
+  uint8_t crc[STREAM_FRAME_CRC_SZ];
+} stream_frame_decoder_t;
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Encode a frame into dst, which must hold STREAM_FRAME_MAX_SZ bytes.
+ *
+ * @return the number of bytes encoded.
+ */
+size_t stream_frame_encode(uint8_t *dst,
+                           stream_frame_type_t type,
+                           uint16_t seq,
+                           const uint8_t *payload,
+                           uint16_t len);
+
+/**
+ * @brief Reset decoder to look for the start of a frame.
+ */
+void stream_frame_decoder_init(stream_frame_decoder_t *decoder);
+
+/**
+ * @brief Return the number of bytes that would finish the frame decoder is
+ * working on (1 while it looks for the start of a frame).
+ *
+ * A receiver that reads no more than this never reads past the end of a
+ * frame, so it can stop reading while it holds a frame it has no room for.
+ */
+size_t stream_frame_decoder_needs(const stream_frame_decoder_t *decoder);
+
+/**
+ * @brief Feed one received byte to decoder.
+ *
+ * After STREAM_FRAME_OK, decoder->frame holds the frame until the next call.
+ */
+stream_frame_result_t stream_frame_decode(stream_frame_decoder_t *decoder,
+                                          uint8_t byte);
+
+/**
+ * @brief Store a 16 or 32 bit value little-endian at dst.
+ */
+void stream_frame_put_u16(uint8_t *dst, uint16_t value);
+void stream_frame_put_u32(uint8_t *dst, uint32_t value);
+
+/**
+ * @brief Load a little-endian 16 or 32 bit value from src.
+ */
+uint16_t stream_frame_get_u16(const uint8_t *src);
+uint32_t stream_frame_get_u32(const uint8_t *src);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _STREAM_FRAME_H_ */
@@ -0,0 +1,224 @@
+/**
+ * @file trace.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "trace.h"
+
+#include "definitions.h"
+#include "sched.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+#define TRACE_TASK_PRIORITY 0
+
+// How long to wait for the console to drain when it is full.
+#define CONSOLE_POLL_MS 5
+
+typedef struct {
+  uint32_t n_recorded;  // total # of events recorded since trace_reset()
+  uint32_t n_echoed;    // events before this one have been echoed (or lost)
+  bool is_echoing;
+  sched_task_id_t task;
+} trace_ctx_t;
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+/**
+ * @brief Return true if the console can take a full SYS_CONSOLE_PRINT().
+ */
+static bool console_has_room(void);
+
+/**
+ * @brief Print one event on the console.
+ */
+static void echo_entry(const trace_entry_t *entry);
+
+/**
+ * @brief Write n entries from the ring, starting at index first.
+ */
+static bool write_entries(SYS_FS_HANDLE handle, uint32_t first, uint32_t n);
+
+// *****************************************************************************
+// Private (static) storage
+
+#define EXPAND_TRACE_FORMATS(_id, _fmt) _fmt,
+static const char *s_trace_formats[] = {TRACE_EVENTS(EXPAND_TRACE_FORMATS)};
+
+static trace_entry_t s_entries[TRACE_N_ENTRIES];
+
+static trace_ctx_t s_trace_ctx;
+
+// *****************************************************************************
+// Public code
+
+void trace_init(void) {
+  s_trace_ctx.is_echoing = false;
+  trace_reset();
+  s_trace_ctx.task =
+      sched_task_create("trace", trace_step, TRACE_TASK_PRIORITY);
+}
+
+void trace_reset(void) {
+  s_trace_ctx.n_recorded = 0;
+  s_trace_ctx.n_echoed = 0;
+}
+
+void trace_event(trace_id_t id,
+                 uint32_t a0,
+                 uint32_t a1,
+                 uint32_t a2,
+                 uint32_t a3) {
+  trace_entry_t *entry =
+      &s_entries[s_trace_ctx.n_recorded & (TRACE_N_ENTRIES - 1)];
+
+  entry->ticks = SYS_TIME_CounterGet();
+  entry->id = id;
+  entry->args[0] = a0;
+  entry->args[1] = a1;
+  entry->args[2] = a2;
+  entry->args[3] = a3;
+  s_trace_ctx.n_recorded += 1;
+  if (s_trace_ctx.is_echoing) {
+    sched_signal(s_trace_ctx.task, 1);
+  }
+}
+
+void trace_step(void) {
+  trace_ctx_t *ctx = &s_trace_ctx;
+  uint32_t n_pending;
+
+  (void)sched_take_events();
+  n_pending = ctx->n_recorded - ctx->n_echoed;
+  if (!ctx->is_echoing || (n_pending == 0)) {
+    // nothing to do until trace_event() signals
+    sched_wait_ms(SCHED_FOREVER);
+    return;
+  }
+  if (!console_has_room()) {
+    // let the console drain rather than drop output
+    sched_sleep_ms(CONSOLE_POLL_MS);
+    return;
+  }
+  if (n_pending > TRACE_N_ENTRIES) {
+    SYS_CONSOLE_PRINT("\n(%lu trace events lost)",
+                      n_pending - TRACE_N_ENTRIES);
+    ctx->n_echoed = ctx->n_recorded - TRACE_N_ENTRIES;
+    return;
+  }
+  // One event per step: any other ready task runs in between.
+  echo_entry(&s_entries[ctx->n_echoed & (TRACE_N_ENTRIES - 1)]);
+  ctx->n_echoed += 1;
+}
+
+void trace_set_echo(bool on) {
+  s_trace_ctx.is_echoing = on;
+  s_trace_ctx.n_echoed = s_trace_ctx.n_recorded;
+}
+
+bool trace_is_echoing(void) { return s_trace_ctx.is_echoing; }
+
+int32_t trace_dump(const char *filename) {
+  trace_file_header_t header;
+  SYS_FS_HANDLE handle;
+  uint32_t n_recorded = s_trace_ctx.n_recorded;
+  uint32_t n_entries = n_recorded;
+  uint32_t first;
+  uint32_t n_older;
+  bool ret;
+
+  if (n_entries > TRACE_N_ENTRIES) {
+    n_entries = TRACE_N_ENTRIES;
+  }
+  first = (n_recorded - n_entries) & (TRACE_N_ENTRIES - 1);
+  n_older = TRACE_N_ENTRIES - first;
+  if (n_older > n_entries) {
+    n_older = n_entries;
+  }
+
+  header.magic = TRACE_MAGIC;
+  header.version = TRACE_VERSION;
+  header.n_events = TRACE_N_EVENTS;
+  header.ticks_per_sec = SYS_TIME_FrequencyGet();
+  header.n_entries = n_entries;
+  header.n_lost = n_recorded - n_entries;
+
+  handle = SYS_FS_FileOpen(filename, SYS_FS_FILE_OPEN_WRITE);
+  if (handle == SYS_FS_HANDLE_INVALID) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nCould not open %s", filename);
+    return -1;
+  }
+  // The ring wraps at most once: write the older part, then the newer.
+  ret = (SYS_FS_FileWrite(handle, &header, sizeof(header)) ==
+         sizeof(header)) &&
+        write_entries(handle, first, n_older) &&
+        write_entries(handle, 0, n_entries - n_older);
+  SYS_FS_FileClose(handle);
+  if (!ret) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nCould not write %s", filename);
+    return -1;
+  }
+  return n_entries;
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static bool console_has_room(void) {
+  return SYS_CONSOLE_WriteFreeBufferCountGet(
+             SYS_CONSOLE_HandleGet(SYS_CONSOLE_INDEX_0)) >=
+         SYS_CONSOLE_PRINT_BUFFER_SIZE;
+}
+
+static void echo_entry(const trace_entry_t *entry) {
+  uint32_t ticks_per_us = SYS_TIME_FrequencyGet() / 1000000;
+
+  SYS_CONSOLE_PRINT("\n%10lu us: ", entry->ticks / ticks_per_us);
+  if (entry->id < TRACE_N_EVENTS) {
+    SYS_CONSOLE_PRINT(s_trace_formats[entry->id],
+                      entry->args[0],
+                      entry->args[1],
+                      entry->args[2],
+                      entry->args[3]);
+  }
+}
+
+static bool write_entries(SYS_FS_HANDLE handle, uint32_t first, uint32_t n) {
+  size_t n_bytes = n * sizeof(trace_entry_t);
+
+  return (n == 0) ||
+         (SYS_FS_FileWrite(handle, &s_entries[first], n_bytes) == n_bytes);
+}
+
+// *****************************************************************************
+// End of file
@@ -0,0 +1,180 @@
+/**
+ * @file trace.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief trace is a compact binary event log for the hot paths.
+ *
+ * TRACE() records a timestamp, an event id and up to four uint32_t arguments
+ * in a RAM ring buffer: a few dozen cycles and no formatting, so leaving it
+ * in does not perturb the timing it records.  The newest TRACE_N_ENTRIES
+ * events are kept.
+ *
+ * The events are turned into text later, in one of two ways:
+ * - trace_step() runs as the lowest priority sched task, so it only gets the
+ *   CPU when every other task is idle.  When echo is on, it formats pending
+ *   events onto the console, and only while the console has room for them.
+ * - trace_dump() writes the raw buffer to a file on the SD card, which
+ *   tools/trace_decode turns into text on the host.
+ *
+ * Each event's format string takes its arguments in order and may only use
+ * long conversions (%lu, %lx, %ld) so that the same strings work on the host.
+ * State numbers are positions in the module's STATES() list, starting at 0.
+ *
+ * The dump file is a trace_file_header_t followed by n_entries trace_entry_t,
+ * oldest first, stored little-endian.  This header depends only on stdint.h
+ * so it can be shared with host tools.
+ *
+ * TRACE() is not reentrant: call it from task context, not from interrupts.
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+// cmd_task / winc_cloner / bench state: from, to
+// sd read:      image offset, # of bytes (file or image cache)
+// winc read:    WINC address of a sector read
+// winc program: WINC address, mask of blank (skipped) pages
+// sector done:  result (0 okay, 2 equal, 3 differ, 4 skipped), bytes so far
+// flash erase:  spi_flash.c, offset and size of an erase
+// uart_stream nak: DATA frame expected, DATA frame received (0xffff if bad)
+#define TRACE_EVENTS(M)                                                        \
+  M(TRACE_CMD_TASK_STATE, "cmd_task state %lu => %lu")                         \
+  M(TRACE_WINC_CLONER_STATE, "winc_cloner state %lu => %lu")                   \
+  M(TRACE_BENCH_STATE, "bench state %lu => %lu")                               \
+  M(TRACE_WINC_GANG_STATE, "winc_gang state %lu => %lu")                       \
+  M(TRACE_STATION_STATE, "station state %lu => %lu")                           \
+  M(TRACE_JOB_STATE, "job state %lu => %lu")                                   \
+  M(TRACE_SD_READ, "sd read 0x%06lx, %lu bytes")                               \
+  M(TRACE_WINC_READ, "winc read 0x%06lx")                                      \
+  M(TRACE_WINC_PROGRAM, "winc program 0x%06lx, blank pages 0x%04lx")           \
+  M(TRACE_SECTOR_DONE, "sector done, result %lu, %lu bytes")                   \
+  M(TRACE_FLASH_ERASE, "flash erase 0x%06lx, %lu bytes")                       \
+  M(TRACE_WINC_BOOT, "winc boot for 0x%08lx, error %lu")                       \
+  M(TRACE_UART_STREAM_STATE, "uart_stream state %lu => %lu")                   \
+  M(TRACE_UART_STREAM_NAK, "uart_stream nak: expected %lu, got %lu")           \
+  M(TRACE_DELTA_IMAGE_STATE, "delta_image state %lu => %lu")                   \
+  M(TRACE_IMAGE_CACHE_STATE, "image_cache state %lu => %lu")
+
+#define EXPAND_TRACE_IDS(_id, _fmt) _id,
+typedef enum { TRACE_EVENTS(EXPAND_TRACE_IDS) TRACE_N_EVENTS } trace_id_t;
+
+#define TRACE_MAX_ARGS 4
+
+// Must be a power of two.
+#define TRACE_N_ENTRIES 512
+
+#define TRACE_MAGIC 0x31435254 // "TRC1" when read as little-endian bytes
+#define TRACE_VERSION 1
+#define TRACE_DUMP_NAME "trace.bin"
+
+typedef struct {
+  uint32_t ticks; // SYS_TIME_CounterGet() when recorded
+  uint32_t id;    // trace_id_t
+  uint32_t args[TRACE_MAX_ARGS];
+} trace_entry_t;
+
+typedef struct {
+  uint32_t magic;         // TRACE_MAGIC
+  uint16_t version;       // TRACE_VERSION
+  uint16_t n_events;      // TRACE_N_EVENTS of the firmware that wrote it
+  uint32_t ticks_per_sec; // SYS_TIME_FrequencyGet()
+  uint32_t n_entries;     // # of trace_entry_t that follow
+  uint32_t n_lost;        // # of older events overwritten before the dump
+} trace_file_header_t;
+
+#define TRACE0(id) trace_event((id), 0, 0, 0, 0)
+#define TRACE1(id, a0) trace_event((id), (a0), 0, 0, 0)
+#define TRACE2(id, a0, a1) trace_event((id), (a0), (a1), 0, 0)
+#define TRACE3(id, a0, a1, a2) trace_event((id), (a0), (a1), (a2), 0)
+#define TRACE4(id, a0, a1, a2, a3) trace_event((id), (a0), (a1), (a2), (a3))
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Clear the log and register the formatter as a sched task.  Call
+ * after sched_init().
+ */
+void trace_init(void);
+
+/**
+ * @brief Discard every recorded event.
+ */
+void trace_reset(void);
+
+/**
+ * @brief Record an event.  Normally called through TRACE0() .. TRACE4().
+ */
+void trace_event(trace_id_t id,
+                 uint32_t a0,
+                 uint32_t a1,
+                 uint32_t a2,
+                 uint32_t a3);
+
+/**
+ * @brief Format pending events onto the console while echo is on and the
+ * CPU is otherwise idle.  Registered as a sched task by trace_init().
+ */
+void trace_step(void);
+
+/**
+ * @brief Turn echoing of events to the console on or off.  Off at startup.
+ * Turning it on starts from the next event recorded.
+ */
+void trace_set_echo(bool on);
+
+bool trace_is_echoing(void);
+
+/**
+ * @brief Write the recorded events to filename on the SD card and return
+ * the number written, or -1 on error.  The log is not cleared.
+ */
+int32_t trace_dump(const char *filename);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _TRACE_H_ */
@@ -0,0 +1,427 @@
+/**
+ * @file uart_stream.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "uart_stream.h"
+
+#include "crc32.h"
+#include "definitions.h"
+#include "spi_flash_map.h"
+#include "stream_frame.h"
+#include "trace.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+#define STATES(M)                                                              \
+  M(UART_STREAM_STATE_IDLE)                                                    \
+  M(UART_STREAM_STATE_AWAIT_START)                                             \
+  M(UART_STREAM_STATE_RECEIVING)                                               \
+  M(UART_STREAM_STATE_ERROR)
+
+#define EXPAND_STATE_IDS(_name) _name,
+typedef enum { STATES(EXPAND_STATE_IDS) } uart_stream_state_t;
+
+// Recorded in the trace for a NAK of a frame that failed its CRC.
+#define BAD_SEQ 0xffff
+
+typedef struct {
+  uart_stream_state_t state;
+  stream_frame_decoder_t decoder;
+  bool has_pending;     // decoder.frame is a DATA frame awaiting room
+  uint32_t image_size;  // from START
+  uint32_t image_crc;   // from START
+  uint32_t crc;         // of the image bytes received so far
+  uint32_t n_received;  // image bytes received so far
+  uint16_t next_seq;    // the DATA frame expected next
+  uint16_t acked_seq;   // next_seq as last ACKed
+  uint16_t limit;       // as last ACKed
+  bool nak_sent;        // a NAK for next_seq is outstanding
+  uint32_t base;        // image offset of s_sector[0]
+  size_t n_have;        // bytes in s_sector[]
+  uint32_t last_heard;  // SYS_TIME counter at the last good frame
+} uart_stream_ctx_t;
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+static void set_state(uart_stream_state_t state);
+
+/**
+ * @brief Read what has arrived, a frame at a time, until the UART is empty
+ * or a DATA frame has no room to go.
+ */
+static void receive(void);
+
+static void handle_frame(const stream_frame_t *frame);
+
+/**
+ * @brief Move a pending DATA frame into s_sector[], if it has room.
+ */
+static bool place_data(const stream_frame_t *frame);
+
+/**
+ * @brief Return the size of the sector at base: less than FLASH_SECTOR_SZ
+ * only at the end of an image that does not fill its last sector.
+ */
+static size_t sector_size(uint32_t base);
+
+/**
+ * @brief ACK if next_seq or the limit has moved since the last ACK, or
+ * always if force is set.
+ */
+static void send_ack(bool force);
+
+static void send_nak(uint16_t got_seq);
+
+static void send_frame(stream_frame_type_t type,
+                       uint16_t seq,
+                       const uint8_t *payload,
+                       uint16_t len);
+
+static void set_baud(uint32_t baud);
+
+/**
+ * @brief Wait for everything queued for the UART to go out.
+ */
+static void drain(void);
+
+static uint32_t ms_since(uint32_t then);
+
+static void fail(const char *why);
+
+// *****************************************************************************
+// Private (static) storage
+
+static uart_stream_ctx_t s_uart_stream_ctx;
+
+static uint8_t s_sector[FLASH_SECTOR_SZ];
+
+static uint8_t s_rx_buf[STREAM_FRAME_MAX_SZ];
+
+static uint8_t s_tx_buf[STREAM_FRAME_HEADER_SZ + UART_STREAM_HELLO_SZ +
+                        STREAM_FRAME_CRC_SZ];
+
+// *****************************************************************************
+// Public code
+
+void uart_stream_listen(void) {
+  uart_stream_ctx_t *ctx = &s_uart_stream_ctx;
+  uint8_t hello[UART_STREAM_HELLO_SZ];
+
+  memset(ctx, 0, sizeof(*ctx));
+  stream_frame_decoder_init(&ctx->decoder);
+
+  stream_frame_put_u16(&hello[0], UART_STREAM_VERSION);
+  stream_frame_put_u16(&hello[2], UART_STREAM_PAYLOAD_SZ);
+  stream_frame_put_u16(&hello[4], UART_STREAM_MAX_WINDOW);
+  stream_frame_put_u16(&hello[6], 0);
+  stream_frame_put_u32(&hello[8], UART_STREAM_BAUD);
+  send_frame(STREAM_FRAME_HELLO, 0, hello, sizeof(hello));
+  // The host switches baud rate once it has HELLO, and so must we.
+  drain();
+  set_baud(UART_STREAM_BAUD);
+  while (SERCOM2_USART_Read(s_rx_buf, sizeof(s_rx_buf)) > 0) {
+    // drop whatever arrived at the old baud rate
+  }
+  ctx->last_heard = SYS_TIME_CounterGet();
+  set_state(UART_STREAM_STATE_AWAIT_START);
+}
+
+void uart_stream_step(void) {
+  uart_stream_ctx_t *ctx = &s_uart_stream_ctx;
+
+  if ((ctx->state != UART_STREAM_STATE_AWAIT_START) &&
+      (ctx->state != UART_STREAM_STATE_RECEIVING)) {
+    return;
+  }
+  receive();
+  if (ctx->state == UART_STREAM_STATE_RECEIVING) {
+    send_ack(false);
+  }
+  // Once the whole image is in, the host has nothing more to say.
+  if ((ctx->state != UART_STREAM_STATE_ERROR) &&
+      ((ctx->state == UART_STREAM_STATE_AWAIT_START) ||
+       (ctx->n_received < ctx->image_size)) &&
+      (ms_since(ctx->last_heard) > UART_STREAM_TIMEOUT_MS)) {
+    fail("Timed out waiting for the host");
+  }
+}
+
+bool uart_stream_is_started(void) {
+  return s_uart_stream_ctx.state == UART_STREAM_STATE_RECEIVING;
+}
+
+bool uart_stream_has_error(void) {
+  return s_uart_stream_ctx.state == UART_STREAM_STATE_ERROR;
+}
+
+uint32_t uart_stream_image_size(void) {
+  return s_uart_stream_ctx.image_size;
+}
+
+bool uart_stream_is_ready(uint32_t addr, size_t n_bytes) {
+  uart_stream_ctx_t *ctx = &s_uart_stream_ctx;
+
+  uart_stream_step();
+  // Drop the sectors that the caller skips, as they fill.
+  while ((ctx->base < addr) && (ctx->n_have == sector_size(ctx->base)) &&
+         (ctx->state == UART_STREAM_STATE_RECEIVING)) {
+    ctx->base += FLASH_SECTOR_SZ;
+    ctx->n_have = 0;
+    uart_stream_step();
+  }
+  return (ctx->state == UART_STREAM_STATE_RECEIVING) &&
+         (ctx->base == addr) && (ctx->n_have >= n_bytes);
+}
+
+bool uart_stream_read(uint8_t *dst, uint32_t addr, size_t n_bytes) {
+  uart_stream_ctx_t *ctx = &s_uart_stream_ctx;
+
+  if (!uart_stream_is_ready(addr, n_bytes)) {
+    return false;
+  }
+  memcpy(dst, s_sector, n_bytes);
+  // The sector is in the update pipeline now: open the window again.
+  ctx->base += FLASH_SECTOR_SZ;
+  ctx->n_have = 0;
+  uart_stream_step();
+  return true;
+}
+
+void uart_stream_close(bool ok) {
+  uart_stream_ctx_t *ctx = &s_uart_stream_ctx;
+  uint8_t done[UART_STREAM_DONE_SZ];
+
+  if (ctx->state == UART_STREAM_STATE_IDLE) {
+    return;
+  }
+  stream_frame_put_u32(&done[0],
+                       ok ? UART_STREAM_STATUS_OK : UART_STREAM_STATUS_FAILED);
+  stream_frame_put_u32(&done[4], ctx->n_received);
+  send_frame(STREAM_FRAME_DONE, ctx->next_seq, done, sizeof(done));
+  drain();
+  set_baud(UART_STREAM_CONSOLE_BAUD);
+  set_state(UART_STREAM_STATE_IDLE);
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static void set_state(uart_stream_state_t state) {
+  if (s_uart_stream_ctx.state != state) {
+    TRACE2(TRACE_UART_STREAM_STATE, s_uart_stream_ctx.state, state);
+    s_uart_stream_ctx.state = state;
+  }
+}
+
+static void receive(void) {
+  uart_stream_ctx_t *ctx = &s_uart_stream_ctx;
+  size_t n_read;
+
+  if (ctx->has_pending) {
+    if (!place_data(&ctx->decoder.frame)) {
+      // still no room: leave the rest in the UART
+      return;
+    }
+    ctx->has_pending = false;
+  }
+  while (ctx->state != UART_STREAM_STATE_ERROR) {
+    n_read = SERCOM2_USART_Read(s_rx_buf,
+                                stream_frame_decoder_needs(&ctx->decoder));
+    if (n_read == 0) {
+      return;
+    }
+    for (size_t i = 0; i < n_read; i++) {
+      stream_frame_result_t res =
+          stream_frame_decode(&ctx->decoder, s_rx_buf[i]);
+      if (res == STREAM_FRAME_OK) {
+        handle_frame(&ctx->decoder.frame);
+      } else if ((res == STREAM_FRAME_BAD) &&
+                 (ctx->state == UART_STREAM_STATE_RECEIVING)) {
+        send_nak(BAD_SEQ);
+      }
+    }
+    if (ctx->has_pending) {
+      return;
+    }
+  }
+}
+
+static void handle_frame(const stream_frame_t *frame) {
+  uart_stream_ctx_t *ctx = &s_uart_stream_ctx;
+
+  if (frame->type == STREAM_FRAME_ABORT) {
+    fail("Host aborted the image stream");
+    return;
+  }
+  if (ctx->state == UART_STREAM_STATE_AWAIT_START) {
+    if ((frame->type == STREAM_FRAME_START) &&
+        (frame->len == UART_STREAM_START_SZ)) {
+      ctx->image_size = stream_frame_get_u32(&frame->payload[0]);
+      ctx->image_crc = stream_frame_get_u32(&frame->payload[4]);
+      ctx->crc = CRC32_INITIAL_VALUE;
+      ctx->last_heard = SYS_TIME_CounterGet();
+      set_state(UART_STREAM_STATE_RECEIVING);
+      send_ack(true);
+    }
+    return;
+  }
+  if (frame->type == STREAM_FRAME_START) {
+    // the host missed our first ACK
+    send_ack(true);
+  } else if (frame->type != STREAM_FRAME_DATA) {
+    // nothing else is meant for us
+  } else if (frame->seq == ctx->next_seq) {
+    ctx->last_heard = SYS_TIME_CounterGet();
+    ctx->has_pending = !place_data(frame);
+  } else if ((int16_t)(frame->seq - ctx->next_seq) < 0) {
+    // a frame resent after we had it: the host missed an ACK
+    ctx->last_heard = SYS_TIME_CounterGet();
+    send_ack(true);
+  } else {
+    // a frame went missing
+    send_nak(frame->seq);
+  }
+}
+
+static bool place_data(const stream_frame_t *frame) {
+  uart_stream_ctx_t *ctx = &s_uart_stream_ctx;
+  uint32_t offset = (uint32_t)frame->seq * UART_STREAM_PAYLOAD_SZ;
+  uint32_t expected = ctx->image_size - offset;
+
+  if (expected > UART_STREAM_PAYLOAD_SZ) {
+    expected = UART_STREAM_PAYLOAD_SZ;
+  }
+  if ((offset >= ctx->image_size) || (frame->len != expected)) {
+    fail("Image stream frame does not fit the image");
+    return true;
+  }
+  if ((ctx->n_have == FLASH_SECTOR_SZ) ||
+      (offset != ctx->base + ctx->n_have)) {
+    // s_sector[] holds an earlier sector that has yet to be taken
+    return false;
+  }
+  memcpy(&s_sector[ctx->n_have], frame->payload, frame->len);
+  ctx->n_have += frame->len;
+  ctx->n_received += frame->len;
+  ctx->crc = crc32_update(ctx->crc, frame->payload, frame->len);
+  ctx->next_seq += 1;
+  ctx->nak_sent = false;
+  if ((ctx->n_received == ctx->image_size) && (ctx->crc != ctx->image_crc)) {
+    fail("Image stream does not match its CRC");
+  }
+  return true;
+}
+
+static size_t sector_size(uint32_t base) {
+  uint32_t n_left = s_uart_stream_ctx.image_size - base;
+  return (n_left < FLASH_SECTOR_SZ) ? n_left : FLASH_SECTOR_SZ;
+}
+
+static void send_ack(bool force) {
+  uart_stream_ctx_t *ctx = &s_uart_stream_ctx;
+  uint8_t ack[UART_STREAM_ACK_SZ];
+  uint16_t window;
+  uint16_t limit;
+
+  // While the board is busy with the WINC, every frame granted lands in the
+  // UART's receive ring, whatever room s_sector[] has: grant no more than
+  // the ring holds.
+  window = (SERCOM2_USART_ReadBufferSizeGet() - 1) / STREAM_FRAME_MAX_SZ;
+  if (window > UART_STREAM_MAX_WINDOW) {
+    window = UART_STREAM_MAX_WINDOW;
+  }
+  limit = ctx->next_seq + window;
+  if ((int16_t)(limit - ctx->limit) < 0) {
+    // never take back what was granted
+    limit = ctx->limit;
+  }
+  if (!force && (ctx->next_seq == ctx->acked_seq) && (limit == ctx->limit)) {
+    return;
+  }
+  ctx->acked_seq = ctx->next_seq;
+  ctx->limit = limit;
+  stream_frame_put_u16(ack, limit);
+  send_frame(STREAM_FRAME_ACK, ctx->next_seq, ack, sizeof(ack));
+}
+
+static void send_nak(uint16_t got_seq) {
+  uart_stream_ctx_t *ctx = &s_uart_stream_ctx;
+
+  if (ctx->nak_sent) {
+    // the host is already going back: the frames in flight will miss too
+    return;
+  }
+  TRACE2(TRACE_UART_STREAM_NAK, ctx->next_seq, got_seq);
+  ctx->nak_sent = true;
+  send_frame(STREAM_FRAME_NAK, ctx->next_seq, NULL, 0);
+}
+
+static void send_frame(stream_frame_type_t type,
+                       uint16_t seq,
+                       const uint8_t *payload,
+                       uint16_t len) {
+  size_t n_bytes = stream_frame_encode(s_tx_buf, type, seq, payload, len);
+  SERCOM2_USART_Write(s_tx_buf, n_bytes);
+}
+
+static void set_baud(uint32_t baud) {
+  USART_SERIAL_SETUP setup = {.baudRate = baud,
+                              .parity = USART_PARITY_NONE,
+                              .dataWidth = USART_DATA_8_BIT,
+                              .stopBits = USART_STOP_1_BIT};
+
+  SERCOM2_USART_SerialSetup(&setup, SERCOM2_USART_FrequencyGet());
+}
+
+static void drain(void) {
+  while ((SERCOM2_USART_WriteCountGet() > 0) ||
+         !SERCOM2_USART_TransmitComplete()) {
+    // at most a full write ring: 180 ms at the console baud rate
+  }
+}
+
+static uint32_t ms_since(uint32_t then) {
+  // unsigned arithmetic handles counter wrap
+  return (uint32_t)(SYS_TIME_CounterGet() - then) /
+         (SYS_TIME_FrequencyGet() / 1000);
+}
+
+static void fail(const char *why) {
+  SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\n%s", why);
+  set_state(UART_STREAM_STATE_ERROR);
+}
+
+// *****************************************************************************
+// End of file
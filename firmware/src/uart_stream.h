@@ -0,0 +1,171 @@
+/**
+ * @file uart_stream.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief uart_stream receives a WINC image from a host over the console UART
+ * (SERCOM2, the EDBG virtual COM port), so that `s` can update a WINC without
+ * an image on the SD card.
+ *
+ * The host (tools/uart_stream) sends UART_STREAM_COMMAND at the console baud
+ * rate.  The board answers with a HELLO frame and switches to
+ * UART_STREAM_BAUD; the host follows and sends START with the image's size
+ * and CRC-32, then the image in DATA frames of UART_STREAM_PAYLOAD_SZ bytes
+ * (see stream_frame.h).
+ *
+ * The window slides: every ACK carries the next frame expected and a limit
+ * on the frames the host may send, no further past the next than the UART
+ * receive ring can hold.  The next frame is taken only once the update
+ * pipeline has room for it, which it makes when the WINC is done erasing and
+ * programming, so the ring never overflows while the board is busy with the
+ * WINC.  A frame that fails its CRC or arrives out of order draws a NAK, and
+ * the host resends from the frame expected (go back N).  The host also
+ * resends from the last ACK if it hears nothing for a while.
+ *
+ * winc_cloner pulls the image through uart_stream_is_ready() and
+ * uart_stream_read() in place of reading a file: sectors are decoded into a
+ * single sector buffer and handed straight to the update pipeline.  The
+ * board finishes with a DONE frame and goes back to the console baud rate.
+ * Console output shares the wire throughout; the host prints it.
+ *
+ * The protocol definitions here have no Harmony dependencies: the host
+ * sender includes this file too.
+ */
+
+#ifndef _UART_STREAM_H_
+#define _UART_STREAM_H_
+
+// *****************************************************************************
+// Includes
+
+#include "stream_frame.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+/**
+ * @brief Pass this name in place of a filename to update from the stream.
+ */
+#define UART_STREAM_NAME "@uart"
+
+#define UART_STREAM_COMMAND 's' // console command that starts a stream
+#define UART_STREAM_VERSION 1
+
+#define UART_STREAM_CONSOLE_BAUD 115200
+#define UART_STREAM_BAUD 921600
+
+// Image bytes per DATA frame.  A sector holds a whole number of them.
+#define UART_STREAM_PAYLOAD_SZ STREAM_FRAME_MAX_PAYLOAD
+
+// The most DATA frames the board lets the host have in flight.
+#define UART_STREAM_MAX_WINDOW 16
+
+// Give up when the host is silent this long.
+#define UART_STREAM_TIMEOUT_MS 5000
+
+// HELLO: version (2), payload size (2), window (2), reserved (2), baud (4)
+#define UART_STREAM_HELLO_SZ 12
+// START: image size (4), image CRC-32 (4)
+#define UART_STREAM_START_SZ 8
+// ACK: limit (2), the first DATA frame that the host may not send yet
+#define UART_STREAM_ACK_SZ 2
+// DONE: status (4), image bytes received (4)
+#define UART_STREAM_DONE_SZ 8
+
+#define UART_STREAM_STATUS_OK 0
+#define UART_STREAM_STATUS_FAILED 1
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Send HELLO, switch the UART to UART_STREAM_BAUD and wait for the
+ * host to START.
+ */
+void uart_stream_listen(void);
+
+/**
+ * @brief Receive and act on frames from the host.  Called frequently while
+ * waiting for START; afterwards uart_stream_is_ready() calls it.
+ */
+void uart_stream_step(void);
+
+/**
+ * @brief Return true once the host has sent START.
+ */
+bool uart_stream_is_started(void);
+
+/**
+ * @brief Return true if the host aborted, went silent or sent an image that
+ * does not match its CRC.
+ */
+bool uart_stream_has_error(void);
+
+/**
+ * @brief Return the size of the image that the host is sending.
+ */
+uint32_t uart_stream_image_size(void);
+
+/**
+ * @brief Return true once n_bytes of the image at addr have arrived.
+ *
+ * Addresses must not go backwards.  Sectors before addr are received and
+ * dropped.  NOTE: addr must be a multiple of FLASH_SECTOR_SZ and n_bytes
+ * must not exceed it.
+ */
+bool uart_stream_is_ready(uint32_t addr, size_t n_bytes);
+
+/**
+ * @brief Copy n_bytes of the image at addr into dst and make room for the
+ * next sector.
+ *
+ * @return false unless uart_stream_is_ready(addr, n_bytes).
+ */
+bool uart_stream_read(uint8_t *dst, uint32_t addr, size_t n_bytes);
+
+/**
+ * @brief Tell the host how the update went and switch the UART back to the
+ * console baud rate.
+ */
+void uart_stream_close(bool ok);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _UART_STREAM_H_ */
@@ -0,0 +1,209 @@
+/**
+ * @file update_journal.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "update_journal.h"
+
+#include "crc32.h"
+#include "definitions.h"
+#include "nmasic.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+// The CRC covers every field before it.
+#define JOURNAL_CRC_SIZE offsetof(update_journal_t, crc)
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+/**
+ * @brief Fill in the chip ID and OTP MAC address of the open WINC.
+ */
+static void identify_winc(uint32_t *chip_id, uint8_t *mac);
+
+static uint32_t journal_crc(const update_journal_t *journal);
+
+// *****************************************************************************
+// Private (static) storage
+
+static SYS_FS_FSTAT s_stat; // too big for the stack
+
+// *****************************************************************************
+// Public code
+
+bool update_journal_init(update_journal_t *journal,
+                         const char *image_name,
+                         flash_region_set_t regions) {
+  memset(journal, 0, sizeof(*journal));
+  s_stat.lfname = NULL;
+  if (SYS_FS_FileStat(image_name, &s_stat) != SYS_FS_RES_SUCCESS) {
+    return false;
+  }
+  journal->magic = UPDATE_JOURNAL_MAGIC;
+  journal->version = UPDATE_JOURNAL_VERSION;
+  journal->kind = UPDATE_JOURNAL_UPDATE;
+  strncpy(journal->image_name, image_name, IMAGE_MANIFEST_NAME_LEN - 1);
+  journal->image_size = s_stat.fsize;
+  journal->image_stamp = ((uint32_t)s_stat.fdate << 16) | s_stat.ftime;
+  identify_winc(&journal->chip_id, journal->mac);
+  journal->regions = regions;
+  journal->committed_addr = 0;
+  journal->in_flight_addr = UPDATE_JOURNAL_NONE;
+  return true;
+}
+
+bool update_journal_mark_writing(const char *source, bool all_wincs) {
+  update_journal_t journal;
+
+  memset(&journal, 0, sizeof(journal));
+  journal.magic = UPDATE_JOURNAL_MAGIC;
+  journal.version = UPDATE_JOURNAL_VERSION;
+  journal.kind = UPDATE_JOURNAL_WRITING;
+  strncpy(journal.image_name, source, IMAGE_MANIFEST_NAME_LEN - 1);
+  if (!all_wincs) {
+    identify_winc(&journal.chip_id, journal.mac);
+  }
+  journal.regions = FLASH_REGION_SET_ALL;
+  journal.committed_addr = 0;
+  journal.in_flight_addr = 0;
+  return update_journal_write(&journal);
+}
+
+bool update_journal_read(update_journal_t *journal) {
+  SYS_FS_HANDLE file_handle;
+  bool ret;
+
+  file_handle = SYS_FS_FileOpen(UPDATE_JOURNAL_NAME, SYS_FS_FILE_OPEN_READ);
+  if (file_handle == SYS_FS_HANDLE_INVALID) {
+    // no journal: not an error
+    return false;
+  }
+  ret = (SYS_FS_FileRead(file_handle, journal, sizeof(*journal)) ==
+         sizeof(*journal)) &&
+        (journal->magic == UPDATE_JOURNAL_MAGIC) &&
+        (journal->version == UPDATE_JOURNAL_VERSION) &&
+        (journal->crc == journal_crc(journal));
+  SYS_FS_FileClose(file_handle);
+
+  if (!ret) {
+    SYS_DEBUG_PRINT(SYS_ERROR_WARNING,
+                    "\nIgnoring invalid journal %s",
+                    UPDATE_JOURNAL_NAME);
+  }
+  return ret;
+}
+
+bool update_journal_write(update_journal_t *journal) {
+  SYS_FS_HANDLE file_handle;
+  bool ret;
+
+  journal->crc = journal_crc(journal);
+  // Overwrite the existing record in place: the file keeps its size and
+  // clusters, so each update is a single SD block write.
+  file_handle =
+      SYS_FS_FileOpen(UPDATE_JOURNAL_NAME, SYS_FS_FILE_OPEN_READ_PLUS);
+  if (file_handle == SYS_FS_HANDLE_INVALID) {
+    file_handle = SYS_FS_FileOpen(UPDATE_JOURNAL_NAME, SYS_FS_FILE_OPEN_WRITE);
+  }
+  if (file_handle == SYS_FS_HANDLE_INVALID) {
+    SYS_DEBUG_PRINT(
+        SYS_ERROR_ERROR, "\nCould not open file %s", UPDATE_JOURNAL_NAME);
+    return false;
+  }
+  ret = SYS_FS_FileWrite(file_handle, journal, sizeof(*journal)) ==
+        sizeof(*journal);
+  SYS_FS_FileClose(file_handle);
+
+  if (!ret) {
+    SYS_DEBUG_PRINT(
+        SYS_ERROR_ERROR, "\nFailed to write %s", UPDATE_JOURNAL_NAME);
+  }
+  return ret;
+}
+
+void update_journal_clear(void) {
+  SYS_FS_FileDirectoryRemove(UPDATE_JOURNAL_NAME);
+}
+
+bool update_journal_matches(const update_journal_t *a,
+                            const update_journal_t *b) {
+  return (a->kind == UPDATE_JOURNAL_UPDATE) &&
+         (b->kind == UPDATE_JOURNAL_UPDATE) &&
+         (strncmp(a->image_name, b->image_name, IMAGE_MANIFEST_NAME_LEN) ==
+          0) &&
+         (a->image_size == b->image_size) &&
+         (a->image_stamp == b->image_stamp) && (a->chip_id == b->chip_id) &&
+         (memcmp(a->mac, b->mac, UPDATE_JOURNAL_MAC_LEN) == 0) &&
+         (a->regions == b->regions);
+}
+
+bool update_journal_is_dirty(const update_journal_t *journal) {
+  uint32_t chip_id;
+  uint8_t mac[UPDATE_JOURNAL_MAC_LEN];
+
+  if ((journal->kind == UPDATE_JOURNAL_UPDATE) &&
+      (journal->committed_addr == 0) &&
+      (journal->in_flight_addr == UPDATE_JOURNAL_NONE)) {
+    // an update that stopped before it wrote anything
+    return false;
+  }
+  if (journal->chip_id == 0) {
+    // written to every WINC on the winc_bus
+    return true;
+  }
+  identify_winc(&chip_id, mac);
+  return (journal->chip_id == chip_id) &&
+         (memcmp(journal->mac, mac, UPDATE_JOURNAL_MAC_LEN) == 0);
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static void identify_winc(uint32_t *chip_id, uint8_t *mac) {
+  uint8_t mac_is_valid = 0;
+
+  *chip_id = nmi_get_chipid();
+  if ((nmi_get_otp_mac_address(mac, &mac_is_valid) != M2M_SUCCESS) ||
+      !mac_is_valid) {
+    // an unprogrammed WINC is known by its chip ID alone
+    memset(mac, 0, UPDATE_JOURNAL_MAC_LEN);
+  }
+}
+
+static uint32_t journal_crc(const update_journal_t *journal) {
+  return crc32_compute((const uint8_t *)journal, JOURNAL_CRC_SIZE);
+}
+
+// *****************************************************************************
+// End of file
@@ -0,0 +1,159 @@
+/**
+ * @file update_journal.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief update_journal records the progress of a WINC update in a small file
+ * on the SD card, so that an update interrupted by a power failure or a
+ * pulled cable can resume where it stopped rather than at sector 0.
+ *
+ * The journal names the image (name, size and FAT time stamp), the WINC
+ * (chip ID and OTP MAC address) and the regions being updated, and holds two
+ * addresses: every sector below committed_addr has been written and verified,
+ * and in_flight_addr is the sector that was being erased or programmed, if
+ * any.  The record carries a CRC-32, so a write torn by a power failure reads
+ * back as no journal and the next update simply starts from the beginning.
+ *
+ * Operations that cannot be resumed (a patch, a slot update, a streamed
+ * update or a gang update) leave a journal of their own while they write, and
+ * clear it when they finish.  Either kind of journal, left behind, tells the
+ * next update that the WINC may be part written, so that update skips its
+ * quick check and compares every sector.
+ */
+
+#ifndef _UPDATE_JOURNAL_H_
+#define _UPDATE_JOURNAL_H_
+
+// *****************************************************************************
+// Includes
+
+#include "flash_regions.h"
+#include "image_manifest.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+#define UPDATE_JOURNAL_NAME "update.jnl"
+#define UPDATE_JOURNAL_MAGIC 0x4c4e4a57 // "WJNL" when read as little-endian
+#define UPDATE_JOURNAL_VERSION 3
+
+// in_flight_addr when no sector is being written
+#define UPDATE_JOURNAL_NONE 0xffffffff
+
+#define UPDATE_JOURNAL_MAC_LEN 6
+
+typedef enum {
+  UPDATE_JOURNAL_UPDATE,  // an update from image_name, which can be resumed
+  UPDATE_JOURNAL_WRITING, // another operation writing from image_name
+} update_journal_kind_t;
+
+typedef struct {
+  uint32_t magic;   // UPDATE_JOURNAL_MAGIC
+  uint16_t version; // UPDATE_JOURNAL_VERSION
+  uint16_t kind;    // an update_journal_kind_t
+  char image_name[IMAGE_MANIFEST_NAME_LEN];
+  uint32_t image_size;  // in bytes
+  uint32_t image_stamp; // FAT date (high half) and time of the image file
+  uint32_t chip_id;     // of the WINC being updated, or 0 for every WINC
+  uint8_t mac[UPDATE_JOURNAL_MAC_LEN];
+  uint8_t reserved2[2];
+  flash_region_set_t regions; // the regions being updated
+  uint32_t committed_addr; // sectors below this are written and verified
+  uint32_t in_flight_addr; // sector being written, or UPDATE_JOURNAL_NONE
+  uint32_t crc;            // CRC-32 of all the preceding fields
+} update_journal_t;
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Fill in the identity of image_name and of the open WINC, for an
+ * update of regions with nothing committed.
+ *
+ * @return false if image_name cannot be found.
+ */
+bool update_journal_init(update_journal_t *journal,
+                         const char *image_name,
+                         flash_region_set_t regions);
+
+/**
+ * @brief Record that an operation which cannot be resumed is about to write
+ * from source to the open WINC, or to every WINC on the winc_bus if
+ * all_wincs.  Call update_journal_clear() once it has finished.
+ *
+ * @return true on success.
+ */
+bool update_journal_mark_writing(const char *source, bool all_wincs);
+
+/**
+ * @brief Read the journal from the card.
+ *
+ * @return true if there is a valid journal.
+ */
+bool update_journal_read(update_journal_t *journal);
+
+/**
+ * @brief Write journal to the card, overwriting the previous record in place.
+ *
+ * @return true on success.
+ */
+bool update_journal_write(update_journal_t *journal);
+
+/**
+ * @brief Remove the journal from the card once its update has completed.
+ */
+void update_journal_clear(void);
+
+/**
+ * @brief Return true if a and b describe updates of the same image, WINC and
+ * regions.
+ */
+bool update_journal_matches(const update_journal_t *a,
+                            const update_journal_t *b);
+
+/**
+ * @brief Return true if journal shows that the open WINC was left part
+ * written: by an operation that cannot be resumed, or by an update that had
+ * started writing.
+ */
+bool update_journal_is_dirty(const update_journal_t *journal);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _UPDATE_JOURNAL_H_ */
@@ -0,0 +1,131 @@
+/**
+ * @file winc_boot.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "winc_boot.h"
+
+#include "definitions.h"
+#include "m2m_types.h"
+#include "nmdrv.h"
+#include "op_stats.h"
+#include "ota_control.h"
+#include "trace.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+/**
+ * @brief Print the versions and build that rev describes.
+ */
+static void print_rev(const tstrM2mRev *rev);
+
+// *****************************************************************************
+// Private (static) storage
+
+// *****************************************************************************
+// Public code
+
+bool winc_boot_check(uint32_t expected_version) {
+  char expected[OTA_CONTROL_VERSION_SIZE];
+  tstrM2mRev rev;
+  uint16_t fw_ver;
+  uint16_t drv_ver;
+  uint32_t t0 = op_stats_start();
+  int8_t err;
+  bool ok;
+
+  ota_control_format_version(expected_version, expected, sizeof(expected));
+  SYS_CONSOLE_PRINT("\nBooting WINC to check for firmware %s", expected);
+
+  // nm_drv_init() resets the WINC, which leaves download mode, then waits for
+  // the boot ROM and for the firmware to finish initializing.
+  err = nm_drv_init(NULL);
+  op_stats_stop(OP_STATS_WINC_BOOT, t0, 0);
+  TRACE2(TRACE_WINC_BOOT, expected_version, (uint32_t)-err);
+  if (err != M2M_SUCCESS) {
+    SYS_DEBUG_PRINT(
+        SYS_ERROR_ERROR, "\nWINC firmware did not start (%d)", err);
+    return false;
+  }
+
+  // A driver / firmware version mismatch only matters to a host that will
+  // run the firmware: the versions are read all the same.
+  err = nm_get_firmware_full_info(&rev);
+  if ((err != M2M_SUCCESS) && (err != M2M_ERR_FW_VER_MISMATCH)) {
+    SYS_DEBUG_PRINT(
+        SYS_ERROR_ERROR, "\nCould not read WINC firmware version (%d)", err);
+    return false;
+  }
+  print_rev(&rev);
+
+  fw_ver = M2M_MAKE_VERSION(
+      rev.u8FirmwareMajor, rev.u8FirmwareMinor, rev.u8FirmwarePatch);
+  drv_ver = M2M_MAKE_VERSION(
+      rev.u8DriverMajor, rev.u8DriverMinor, rev.u8DriverPatch);
+  ok = (fw_ver == M2M_GET_FW_VER(expected_version)) &&
+       (drv_ver == M2M_GET_DRV_VER(expected_version));
+  if (!ok) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\nWINC runs the wrong firmware: expected %s for driver "
+                    "%d.%d.%d",
+                    expected,
+                    M2M_GET_DRV_MAJOR(expected_version),
+                    M2M_GET_DRV_MINOR(expected_version),
+                    M2M_GET_DRV_PATCH(expected_version));
+  }
+  return ok;
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static void print_rev(const tstrM2mRev *rev) {
+  SYS_CONSOLE_PRINT("\nWINC %lx runs firmware %d.%d.%d (svn %d, built %.*s "
+                    "%.*s) for driver %d.%d.%d or later",
+                    rev->u32Chipid,
+                    rev->u8FirmwareMajor,
+                    rev->u8FirmwareMinor,
+                    rev->u8FirmwarePatch,
+                    rev->u16FirmwareSvnNum,
+                    (int)sizeof(rev->BuildDate),
+                    rev->BuildDate,
+                    (int)sizeof(rev->BuildTime),
+                    rev->BuildTime,
+                    rev->u8DriverMajor,
+                    rev->u8DriverMinor,
+                    rev->u8DriverPatch);
+}
+
+// *****************************************************************************
+// End of file
@@ -0,0 +1,81 @@
+/**
+ * @file winc_boot.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief winc_boot releases the WINC from download mode, lets its boot ROM
+ * start the firmware that the control sector selects and checks the versions
+ * that the running firmware reports.
+ *
+ * After an update has read back every sector it wrote, a successful boot into
+ * the expected firmware shows that the image is complete and bootable without
+ * reading the whole flash again.  The firmware reports its version, the
+ * minimum driver version it accepts and its build date, time and SVN
+ * revision; it keeps no checksum of its own build.
+ */
+
+#ifndef _WINC_BOOT_H_
+#define _WINC_BOOT_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Reset the WINC, wait for its firmware to start and check that it
+ * reports the firmware and minimum driver versions packed in
+ * expected_version (a control sector version word).
+ *
+ * The WINC is left running its firmware, so the caller must reset it back
+ * into download mode (see winc_cloner_close_winc()) before touching its flash
+ * again.
+ *
+ * @return true if the firmware started and reported expected_version.
+ */
+bool winc_boot_check(uint32_t expected_version);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _WINC_BOOT_H_ */
@@ -0,0 +1,187 @@
+/**
+ * @file winc_bus.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "winc_bus.h"
+
+#include "definitions.h"
+#include "m2m_wifi.h"
+#include "nm_common.h"
+#include "nmasic.h"
+#include "nmspi.h"
+#include "spi_flash.h"
+#include "wdrv_winc_gpio.h"
+#include "winc_cloner.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+// SPI clock for slots 1 and up (slot 0 is set up by WDRV_WINC).
+#define WINC_BUS_SPI_BAUD_HZ 30000000
+
+typedef struct {
+  WDRV_WINC_SPI_CFG spi_cfg;
+  SYS_PORT_PIN resetn_pin;
+  SYS_PORT_PIN chip_en_pin;
+} winc_bus_slot_cfg_t;
+
+/**
+ * @brief What the WINC driver knows about the WINC in one slot, saved while
+ * another slot is selected.
+ */
+typedef struct {
+  bool spi_is_open;    // slots 1 and up open their SPI driver on first use
+  uint8_t crc_off;     // see nm_spi_get_crc_off()
+  uint32_t chip_id;    // see nmi_get_chipid_cache()
+  uint32_t flash_size; // see spi_flash_get_size_cache()
+} winc_bus_slot_t;
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+/**
+ * @brief Save the driver state of the selected slot.
+ */
+static void save_slot(winc_bus_slot_t *slot);
+
+/**
+ * @brief Restore the driver state of a slot.
+ */
+static void restore_slot(const winc_bus_slot_t *slot);
+
+// *****************************************************************************
+// Private (static) storage
+
+static const winc_bus_slot_cfg_t s_slot_cfgs[] = {
+    // slot 0: the WINC that WDRV_WINC brings up
+    {{DRV_SPI_INDEX_0, WINC_BUS_SPI_BAUD_HZ, SYS_PORT_PIN_NONE},
+     (SYS_PORT_PIN)WDRV_WINC_RESETN_PIN,
+     (SYS_PORT_PIN)WDRV_WINC_CHIP_EN_PIN},
+#if defined(DRV_SPI_INDEX_1) && defined(WINC_BUS1_RESETN_PIN)
+    {{DRV_SPI_INDEX_1, WINC_BUS_SPI_BAUD_HZ, SYS_PORT_PIN_NONE},
+     (SYS_PORT_PIN)WINC_BUS1_RESETN_PIN,
+     (SYS_PORT_PIN)WINC_BUS1_CHIP_EN_PIN},
+#if defined(DRV_SPI_INDEX_2) && defined(WINC_BUS2_RESETN_PIN)
+    {{DRV_SPI_INDEX_2, WINC_BUS_SPI_BAUD_HZ, SYS_PORT_PIN_NONE},
+     (SYS_PORT_PIN)WINC_BUS2_RESETN_PIN,
+     (SYS_PORT_PIN)WINC_BUS2_CHIP_EN_PIN},
+#if defined(DRV_SPI_INDEX_3) && defined(WINC_BUS3_RESETN_PIN)
+    {{DRV_SPI_INDEX_3, WINC_BUS_SPI_BAUD_HZ, SYS_PORT_PIN_NONE},
+     (SYS_PORT_PIN)WINC_BUS3_RESETN_PIN,
+     (SYS_PORT_PIN)WINC_BUS3_CHIP_EN_PIN},
+#endif
+#endif
+#endif
+};
+
+#define N_SLOTS (sizeof(s_slot_cfgs) / sizeof(s_slot_cfgs[0]))
+
+static winc_bus_slot_t s_slots[N_SLOTS];
+
+static uint8_t s_selected;
+
+// *****************************************************************************
+// Public code
+
+void winc_bus_init(void) {
+  SYS_ASSERT((N_SLOTS <= WINC_BUS_MAX_SLOTS) &&
+                 (N_SLOTS <= WDRV_WINC_SPI_MAX_TARGETS),
+             "too many winc_bus slots");
+  for (uint8_t i = 0; i < N_SLOTS; i++) {
+    s_slots[i] = (winc_bus_slot_t){0};
+  }
+  s_slots[0].spi_is_open = true; // by WDRV_WINC
+  s_selected = 0;
+}
+
+uint8_t winc_bus_slot_count(void) { return N_SLOTS; }
+
+bool winc_bus_select(uint8_t slot) {
+  if (slot >= N_SLOTS) {
+    return false;
+  }
+  if (slot == s_selected) {
+    return true;
+  }
+  save_slot(&s_slots[s_selected]);
+  WDRV_WINC_SPITargetSelect(slot);
+  WDRV_WINC_GPIOSelect(s_slot_cfgs[slot].resetn_pin,
+                       s_slot_cfgs[slot].chip_en_pin);
+  restore_slot(&s_slots[slot]);
+  s_selected = slot;
+  return true;
+}
+
+uint8_t winc_bus_selected(void) { return s_selected; }
+
+bool winc_bus_open(uint8_t slot) {
+  winc_bus_slot_t *state = &s_slots[slot];
+
+  if (!winc_bus_select(slot)) {
+    return false;
+  }
+  if (slot == 0) {
+    // shared with the rest of the firmware
+    return winc_cloner_open_winc();
+  }
+  if (!state->spi_is_open) {
+    if (!WDRV_WINC_SPITargetInitialize(slot, &s_slot_cfgs[slot].spi_cfg) ||
+        !WDRV_WINC_SPIOpen()) {
+      SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nCould not open SPI for slot %d",
+                      slot);
+      return false;
+    }
+    state->spi_is_open = true;
+  }
+  // Power cycle the module and forget what was known about its predecessor.
+  nm_reset();
+  *state = (winc_bus_slot_t){.spi_is_open = true};
+  restore_slot(state);
+  return m2m_wifi_download_mode() == M2M_SUCCESS;
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static void save_slot(winc_bus_slot_t *slot) {
+  slot->crc_off = nm_spi_get_crc_off();
+  slot->chip_id = nmi_get_chipid_cache();
+  slot->flash_size = spi_flash_get_size_cache();
+}
+
+static void restore_slot(const winc_bus_slot_t *slot) {
+  nm_spi_set_crc_off(slot->crc_off);
+  nmi_set_chipid_cache(slot->chip_id);
+  spi_flash_set_size_cache(slot->flash_size);
+}
+
+// *****************************************************************************
+// End of file
@@ -0,0 +1,105 @@
+/**
+ * @file winc_bus.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief winc_bus lets the firmware address more than one WINC, each on its
+ * own SPI bus with its own reset and chip enable lines.
+ *
+ * The WINC driver (nmspi.c, nmasic.c, spi_flash.c and wdrv_winc_spi.c) is
+ * written for a single WINC: it keeps the SPI descriptor, the negotiated CRC
+ * mode, the chip ID and the flash size in globals.  winc_bus keeps a copy of
+ * that state for each slot of a programming fixture and swaps it in when a
+ * slot is selected, so that every nm_* and spi_flash_* call that follows
+ * reaches the selected WINC.
+ *
+ * Slot 0 is the WINC that WDRV_WINC brings up and that the rest of the
+ * firmware uses.  Slots 1 to 3 exist only if the configuration provides a
+ * SPI driver instance (DRV_SPI_INDEX_n) and the WINC_BUSn_RESETN and
+ * WINC_BUSn_CHIP_EN pins for them.
+ */
+
+#ifndef _WINC_BUS_H_
+#define _WINC_BUS_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+#define WINC_BUS_MAX_SLOTS 4
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Initialize the winc_bus.  Called once at startup.
+ */
+void winc_bus_init(void);
+
+/**
+ * @brief Return the number of slots wired in this configuration (at least 1).
+ */
+uint8_t winc_bus_slot_count(void);
+
+/**
+ * @brief Route subsequent nm_* and spi_flash_* calls to the WINC in slot.
+ *
+ * @return false if there is no such slot.
+ */
+bool winc_bus_select(uint8_t slot);
+
+/**
+ * @brief Return the selected slot.
+ */
+uint8_t winc_bus_selected(void);
+
+/**
+ * @brief Select slot and put its WINC into download mode.  Slots other than
+ * 0 are reset first, since their module may have been swapped.
+ *
+ * @return true on success.
+ */
+bool winc_bus_open(uint8_t slot);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _WINC_BUS_H_ */
@@ -98,15 +98,31 @@ int main() {
 
 #include "winc_cloner.h"
 
+#include "crc32.h"
 #include "definitions.h"
+#include "delta_image.h"
+#include "device_record.h"
 #include "efuse.h"
+#include "flash_regions.h"
+#include "image_cache.h"
+#include "image_manifest.h"
+#include "image_plan.h"
 #include "m2m_wifi.h"
+#include "nmasic.h"
+#include "op_stats.h"
+#include "ota_control.h"
 #include "spi_flash.h"
+#include "sha256.h"
 #include "spi_flash_map.h"
+#include "trace.h"
+#include "uart_stream.h"
+#include "update_journal.h"
+#include "winc_boot.h"
 #include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 
 // *****************************************************************************
@@ -116,6 +132,8 @@ int main() {
 #define NUM_CHANNELS 14
 #define NUM_FREQS 84
 
+#define MAX_PLAN_NAME_LENGTH 120
+
 typedef struct {
   uint32_t u32PllInternal1;
   uint32_t u32PllInternal4;
@@ -135,6 +153,124 @@ typedef enum {
   SECTOR_SKIPPED,
 } sector_result_t;
 
+#define MAX_FILENAME_LENGTH 80
+
+// # of sector buffers between the SD and WINC stages of an update: the card
+// reads the next sector while the WINC erases the current one.
+#define N_XFER_BUFS 2
+
+// Sectors between journal checkpoints when no sector needs to be written.
+#define JOURNAL_INTERVAL 16
+
+// # of sectors in an OTA image slot
+#define SLOT_SECTORS (OTA_IMAGE_SIZE / FLASH_SECTOR_SZ)
+
+// By default the quick check samples every Nth sector, plus the control
+// sectors and the first sector of each region.  See quick_check_step() and
+// winc_cloner_set_quick_check_stride().
+#define QUICK_CHECK_STRIDE 32
+
+#define STATES(M)                                                              \
+  M(WINC_CLONER_STATE_IDLE)                                                    \
+  M(WINC_CLONER_STATE_OPENING)                                                 \
+  M(WINC_CLONER_STATE_RUNNING)                                                 \
+  M(WINC_CLONER_STATE_PAUSED)                                                  \
+  M(WINC_CLONER_STATE_CLOSING)                                                 \
+  M(WINC_CLONER_STATE_COMPLETE)                                                \
+  M(WINC_CLONER_STATE_ERROR)
+
+#define EXPAND_STATE_IDS(_name) _name,
+typedef enum { STATES(EXPAND_STATE_IDS) } winc_cloner_state_t;
+
+typedef enum {
+  STEP_CONTINUE, // more work to do
+  STEP_DONE,     // operation completed successfully
+  STEP_ERROR,    // operation failed
+} step_result_t;
+
+// Passes of a slot update.
+typedef enum {
+  SLOT_PASS_CHECK,  // compare the running slot with the image
+  SLOT_PASS_WRITE,  // write the image into the inactive slot
+  SLOT_PASS_VERIFY, // read back the inactive slot and check its digest
+  SLOT_PASS_SWITCH, // point the control sector at the inactive slot
+} slot_pass_t;
+
+// Passes of a planned update.
+typedef enum {
+  PLAN_PASS_WRITE,       // write the image sector by sector
+  PLAN_PASS_BLOCK_CHECK, // read an erase block to see if all of it differs
+} plan_pass_t;
+
+/**
+ * @brief One sector of an update, between the SD and WINC stages.
+ */
+typedef struct {
+  uint8_t *buf;         // FLASH_SECTOR_SZ bytes
+  uint32_t addr;        // WINC address of buf[0]
+  size_t n_bytes;       // # of valid bytes in buf
+  uint32_t crc;         // CRC-32 of the valid bytes
+  bool is_erasing;      // the WINC stage has started erasing the sector
+  uint32_t erase_start; // op_stats_start() when the erase started
+} xfer_desc_t;
+
+/**
+ * @brief State of a slot update (see winc_cloner_slot_update()).
+ */
+typedef struct {
+  tstrOtaControlSec control; // as read from the WINC
+  uint32_t src;              // slot of the image holding its firmware
+  uint32_t dst;              // the WINC's inactive slot
+  uint32_t version;          // of the image's firmware
+  sha256_ctx_t sha;
+  uint8_t digest[SHA256_DIGEST_SIZE]; // of the image's slot
+} slot_update_t;
+
+/**
+ * @brief An operation is broken into a begin, a series of steps (typically
+ * one sector each) and a finish.  begin and finish may be NULL.
+ */
+typedef struct {
+  const char *name;        // for the timing summary
+  const char *success_fmt; // printed with the filename on success
+  SYS_FS_FILE_OPEN_ATTRIBUTES file_mode;
+  bool (*begin)(void);         // called after the file is opened
+  step_result_t (*step)(void); // called once per winc_cloner_step()
+  bool (*finish)(void);        // called after the file is closed
+} cloner_op_t;
+
+typedef struct {
+  winc_cloner_state_t state;
+  winc_cloner_callback_fn callback_fn;
+  uintptr_t callback_arg;
+  const cloner_op_t *op;
+  char filename[MAX_FILENAME_LENGTH];
+  SYS_FS_HANDLE file_handle; // SYS_FS_HANDLE_INVALID for the image cache
+  bool file_is_open;
+  bool cancel_requested;
+  size_t n_bytes;    // bytes remaining
+  uint32_t addr;     // WINC address of the next sector
+  uint16_t idx;      // index of the next sector or delta record
+  uint8_t pass;      // for operations that make more than one pass
+  uint16_t n_differ; // # of sectors found to differ
+  size_t n_done;     // bytes processed, for the timing summary
+  uint32_t resume_addr;       // where an interrupted update resumed, or 0
+  bool resume_only;           // fail unless the journal matches
+  flash_region_set_t regions; // sectors outside of these are left alone
+  bool quick_check;           // sampling sectors before the full pass
+  uint16_t sample_stride;     // the quick check samples every Nth sector
+  bool is_current;            // the samples all matched: nothing to write
+  uint32_t sample_addr;       // WINC address of the next candidate sample
+  uint32_t sample_end;        // no samples at or beyond this address
+  uint16_t n_sampled;         // # of sectors sampled by the quick check
+  uint32_t winc_version;      // from the WINC control sector, or 0
+  bool boot_check;            // boot the WINC once the update is written
+  bool revisit;               // s_record vouches for the unchanging regions
+  uint32_t image_version;     // the version the boot check expects
+  uint16_t block_end;         // end of the erase block a planned update chose
+  bool block_is_erased;       // ... and the whole block was erased at once
+} winc_cloner_ctx_t;
+
 // *****************************************************************************
 // Private (static, forward) declarations
 
@@ -159,14 +295,317 @@ static sector_result_t winc_sector_read(uint8_t *dst, uint32_t src_addr);
  */
 static sector_result_t winc_sector_write(uint8_t *src, uint32_t dst_addr);
 
-static bool cloner_aux(const char *filename,
-                       SYS_FS_FILE_OPEN_ATTRIBUTES file_mode,
-                       bool (*inner_loop)(SYS_FS_HANDLE file_handle,
-                                          size_t n_bytes));
+/**
+ * @brief Erase one sector of WINC flash memory and program it from src.
+ *
+ * NOTE: addr must fall on a FLASH_SECTOR_SZ boundary.
+ * NOTE: src must be at least FLASH_SECTOR_SZ bytes big.
+ *
+ * Unlike winc_sector_write(), this does not read the sector first.  Pages
+ * whose bit is set in blank_pages are known to be all 0xff in src and are
+ * left erased rather than programmed.
+ */
+static sector_result_t winc_sector_program(uint8_t *src,
+                                           uint32_t dst_addr,
+                                           uint16_t blank_pages);
+
+/**
+ * @brief Program one erased sector of WINC flash memory from src, leaving
+ * the pages whose bit is set in blank_pages erased.
+ */
+static sector_result_t winc_pages_program(uint8_t *src,
+                                          uint32_t dst_addr,
+                                          uint16_t blank_pages);
+
+/**
+ * @brief Erase the FLASH_BLOCK_SIZE block of WINC flash memory at dst_addr,
+ * which must fall on a block boundary.
+ */
+static bool winc_block_erase(uint32_t dst_addr);
+
+/**
+ * @brief Set the internal state.
+ */
+static void set_state(winc_cloner_state_t state);
+
+/**
+ * @brief Set the state to final_state and invoke callback.
+ */
+static void endgame(winc_cloner_state_t final_state);
+
+/**
+ * @brief Return true if no operation is in progress.  Prints an error if one
+ * is.
+ */
+static bool can_start(void);
+
+/**
+ * @brief Start op on filename.  The work is done in winc_cloner_step().
+ */
+static bool start(const cloner_op_t *op, const char *filename);
+
+/**
+ * @brief Open the WINC and the file for the current operation.
+ */
+static bool open_op(void);
+
+/**
+ * @brief Close the file for the current operation, if open.
+ */
+static void close_op(void);
+
+/**
+ * @brief Start an update of filename, planned if it has a plan.  If
+ * resume_only is set, refuse to start over on a different image or WINC.
+ */
+static bool start_update(const char *filename, bool resume_only);
+
+static bool extract_begin(void);
+static step_result_t extract_step(void);
+static bool update_begin(void);
+static step_result_t update_step(void);
+
+/**
+ * @brief Read the next image sector into the next empty buffer, for the WINC
+ * stage.
+ */
+static step_result_t update_sd_stage(void);
+
+/**
+ * @brief Write the oldest filled buffer to the WINC and return it to the
+ * SD stage.
+ */
+static step_result_t update_winc_stage(void);
+
+/**
+ * @brief Return the buffer that the SD stage fills next, or NULL if every
+ * buffer is waiting for the WINC stage.
+ */
+static xfer_desc_t *xfer_empty(void);
+
+/**
+ * @brief Return the buffer that the WINC stage writes next, or NULL if none
+ * has been filled.
+ */
+static xfer_desc_t *xfer_filled(void);
+
+static bool planned_update_begin(void);
+static step_result_t planned_update_step(void);
+
+/**
+ * @brief Return true if the planned update should consider a block erase at
+ * sector idx: the start of a block of one of the plan's erase runs, and in
+ * the selected regions.
+ */
+static bool starts_erase_block(uint16_t idx);
+
+/**
+ * @brief Read one sector of the erase block that starts at ctx->idx.  Once
+ * every sector has been found to differ from the plan, erase the block.
+ */
+static step_result_t plan_block_check_step(void);
+
+static step_result_t compare_step(void);
+static bool manifest_compare_begin(void);
+static step_result_t manifest_compare_step(void);
+static bool apply_delta_begin(void);
+static step_result_t apply_delta_step(void);
+static bool slot_update_begin(void);
+static bool stream_update_begin(void);
+
+/**
+ * @brief Set up the update pipeline to carry ctx->n_bytes from ctx->addr.
+ */
+static void pipeline_begin(void);
+static step_result_t slot_update_step(void);
+
+/**
+ * @brief Read the control sector (or, failing that, its backup) of the image
+ * (from_winc false) or of the WINC (from_winc true) into control.
+ */
+static bool read_control(bool from_winc, tstrOtaControlSec *control);
+
+/**
+ * @brief Write control into the backup and then the main control sector,
+ * so that one of them is valid at any moment.
+ */
+static bool write_control(const tstrOtaControlSec *control);
+
+/**
+ * @brief Finish an update: check or save its manifest, remove the journal
+ * and run the boot check if it is on.
+ */
+static bool finish_update(void);
+
+/**
+ * @brief Finish a streamed update: remove its journal and run the boot check
+ * (if it is on) for the firmware version in the control sector that was
+ * streamed.
+ */
+static bool finish_stream_update(void);
+
+/**
+ * @brief Finish a slot update: remove its journal and run the boot check if
+ * it is on.
+ */
+static bool finish_slot_update(void);
+
+/**
+ * @brief Finish applying a delta: remove its journal.
+ */
+static bool finish_apply_delta(void);
+
+/**
+ * @brief Look for a record of the open WINC having been updated from the
+ * current image, and if there is one (and the quick check is on), set
+ * ctx->revisit.
+ */
+static void revisit_begin(void);
+
+/**
+ * @brief Record the image and sector CRCs that an update left on the WINC,
+ * if this pass read or wrote every sector that the record covers.
+ */
+static void record_device(void);
+
+/**
+ * @brief Remove the open WINC's device record.
+ */
+static void forget_device(void);
+
+static bool compare_begin(void);
+
+/**
+ * @brief If the boot check is on, note the firmware version that the image
+ * boots: from its manifest, or failing that, from its control sector.
+ */
+static bool boot_check_begin(void);
+
+/**
+ * @brief If the boot check is on, boot the WINC, check that it runs the
+ * version noted by boot_check_begin() and return it to download mode.
+ */
+static bool finish_boot_check(void);
+
+/**
+ * @brief Arrange for an update to start with a quick check of the sectors up
+ * to end_addr, unless it is disabled or the update is resuming.
+ */
+static void quick_check_begin(uint32_t end_addr);
+
+/**
+ * @brief Compare one sampled sector with the image.  Returns STEP_DONE when
+ * every sample matches, or turns the quick check off when one differs so that
+ * the update carries on with its full pass.
+ */
+static step_result_t quick_check_step(void);
+
+/**
+ * @brief Return true if the quick check compares the sector at addr.
+ */
+static bool is_sample_sector(uint32_t addr);
+
+/**
+ * @brief Look up (or compute) the image's CRC for the sector at addr.
+ */
+static bool image_sector_crc(uint32_t addr, uint32_t *crc);
+
+/**
+ * @brief Start journaling the current update.  If the journal shows that
+ * this image was being written to this WINC, set resume_addr to the first
+ * sector that was not committed.
+ */
+static bool journal_begin(void);
+
+/**
+ * @brief Turn off the quick check if prev shows that the WINC was left part
+ * written: the samples say nothing of the sectors between them.
+ */
+static void check_dirty_journal(const update_journal_t *prev);
+
+/**
+ * @brief Record that an operation that cannot be resumed is about to write
+ * the WINC from ctx->filename.
+ */
+static void journal_mark_writing(void);
+
+/**
+ * @brief Record that the sector at addr is about to be erased: every sector
+ * below it has been written and verified.
+ */
+static void journal_mark_in_flight(uint32_t addr);
+
+/**
+ * @brief Note that every sector below next_addr is done, writing a checkpoint
+ * every JOURNAL_INTERVAL sectors.
+ */
+static void journal_commit(uint32_t next_addr);
+
+static void journal_write(void);
+
+static bool is_pll_sector(uint32_t addr);
+
+/**
+ * @brief Return true if the sector at addr lies in the selected regions.
+ */
+static bool is_selected(uint32_t addr);
+
+/**
+ * @brief Advance ctx->addr and ctx->n_bytes past sectors that are not
+ * selected.
+ */
+static void skip_unselected(void);
+
+/**
+ * @brief Print the progress character for a sector of n_bytes with the given
+ * outcome and tally it.
+ */
+static void report_sector(sector_result_t res, size_t n_bytes);
+
+/**
+ * @brief Return the CRC-32 of a sector, timed as hashing.
+ */
+static uint32_t sector_crc(const uint8_t *buf);
+
+/**
+ * @brief Read back the WINC sector at addr and check it against crc.
+ */
+static bool winc_sector_verify(uint32_t addr, uint32_t crc);
+
+/**
+ * @brief Finish the manifest built while streaming filename.  If filename
+ * already has a manifest, check the streamed image against it, otherwise
+ * save the new one.
+ */
+static bool finish_manifest(void);
+
+/**
+ * @brief Return true if filename refers to the internal flash image cache.
+ */
+static bool is_image_cache(const char *filename);
+
+static bool is_uart_stream(const char *filename);
+
+/**
+ * @brief Read n_bytes of the source image starting at addr into dst.  The
+ * source is the open file, or the image cache if file_handle is
+ * SYS_FS_HANDLE_INVALID.
+ */
+static bool image_read(SYS_FS_HANDLE file_handle,
+                       uint8_t *dst,
+                       uint32_t addr,
+                       size_t n_bytes);
+
+/**
+ * @brief Return the size of the source image (see image_read()).
+ */
+static int32_t image_size(SYS_FS_HANDLE file_handle);
 
-static bool extract_loop(SYS_FS_HANDLE file_handle, size_t n_bytes);
-static bool update_loop(SYS_FS_HANDLE file_handle, size_t n_bytes);
-static bool compare_loop(SYS_FS_HANDLE file_handle, size_t n_bytes);
+/**
+ * @brief Load "<filename>.plan" into s_plan.  Return true if a valid plan was
+ * found.
+ */
+static bool load_plan(const char *filename);
 
 static bool buffers_are_equal(uint8_t *buf_a, uint8_t *buf_b, size_t n_bytes);
 
@@ -187,100 +626,1330 @@ uint8_t pllFlashSector[M2M_PLL_FLASH_SZ] = {0};
 
 static bool s_winc_is_opened;
 
+static delta_image_header_t s_delta_header;
+
+static image_plan_t s_plan;
+
+static slot_update_t s_slot;
+
+static char s_plan_name[MAX_PLAN_NAME_LENGTH];
+
+static image_manifest_builder_t s_builder; // built while streaming an image
+
+static image_manifest_t s_manifest; // read from the card
+
+static bool s_has_manifest; // true if s_manifest is valid
+
+static flash_region_set_t s_regions; // see winc_cloner_set_regions()
+
+static update_journal_t s_journal; // progress of the current update
+static bool s_journal_is_active;   // true while s_journal is being kept
+
+static bool s_quick_check; // see winc_cloner_set_quick_check()
+static uint16_t s_quick_check_stride; // the quick check samples every Nth
+
+static bool s_boot_check; // see winc_cloner_set_boot_check()
+
+static device_record_t s_record; // of the open WINC
+
+static uint8_t s_winc_mac[DEVICE_RECORD_MAC_LEN]; // of the open WINC
+static bool s_winc_has_mac; // false for a WINC with no MAC address in OTP
+
+// a ring of buffers connecting the SD and WINC stages of an update: filled
+// and written in order
+static uint8_t s_pipe_bufs[N_XFER_BUFS - 1][FLASH_SECTOR_SZ];
+static xfer_desc_t s_xfer_descs[N_XFER_BUFS];
+static uint8_t s_xfer_head;     // the filled buffer to write next
+static uint8_t s_xfer_n_filled; // # of filled buffers
+
+static winc_cloner_ctx_t s_winc_cloner_ctx;
+
+static const cloner_op_t s_extract_op = {
+    .name = "extract",
+    .success_fmt = "\nSuccessfully extracted WINC contents into %s",
+    .file_mode = SYS_FS_FILE_OPEN_WRITE,
+    .begin = extract_begin,
+    .step = extract_step,
+    .finish = finish_manifest,
+};
+
+static const cloner_op_t s_update_op = {
+    .name = "update",
+    .success_fmt = "\nSuccessfully updated WINC contents from %s",
+    .file_mode = SYS_FS_FILE_OPEN_READ,
+    .begin = update_begin,
+    .step = update_step,
+    .finish = finish_update,
+};
+
+static const cloner_op_t s_planned_update_op = {
+    .name = "planned update",
+    .success_fmt = "\nSuccessfully updated WINC contents from %s",
+    .file_mode = SYS_FS_FILE_OPEN_READ,
+    .begin = planned_update_begin,
+    .step = planned_update_step,
+    .finish = finish_update,
+};
+
+static const cloner_op_t s_compare_op = {
+    .name = "compare",
+    .success_fmt = "\nSuccessfully compared WINC contents to %s",
+    .file_mode = SYS_FS_FILE_OPEN_READ,
+    .begin = compare_begin,
+    .step = compare_step,
+    .finish = NULL,
+};
+
+static const cloner_op_t s_manifest_compare_op = {
+    .name = "manifest compare",
+    .success_fmt = "\nSuccessfully compared WINC contents to %s",
+    .file_mode = SYS_FS_FILE_OPEN_READ,
+    .begin = manifest_compare_begin,
+    .step = manifest_compare_step,
+    .finish = NULL,
+};
+
+static const cloner_op_t s_apply_delta_op = {
+    .name = "apply delta",
+    .success_fmt = "\nSuccessfully applied delta %s to WINC contents",
+    .file_mode = SYS_FS_FILE_OPEN_READ,
+    .begin = apply_delta_begin,
+    .step = apply_delta_step,
+    .finish = finish_apply_delta,
+};
+
+static const cloner_op_t s_slot_update_op = {
+    .name = "slot update",
+    .success_fmt = "\nSuccessfully updated the WINC firmware slot from %s",
+    .file_mode = SYS_FS_FILE_OPEN_READ,
+    .begin = slot_update_begin,
+    .step = slot_update_step,
+    .finish = finish_slot_update,
+};
+
+static const cloner_op_t s_stream_update_op = {
+    .name = "stream update",
+    .success_fmt = "\nSuccessfully updated WINC contents from %s",
+    .file_mode = SYS_FS_FILE_OPEN_READ,
+    .begin = stream_update_begin,
+    .step = update_step,
+    .finish = finish_stream_update,
+};
+
 // *****************************************************************************
 // Public code
 
 void winc_cloner_init(void) {
   s_winc_is_opened = false;
+  s_winc_cloner_ctx.state = WINC_CLONER_STATE_IDLE;
+  s_winc_cloner_ctx.file_is_open = false;
+  s_regions = FLASH_REGION_SET_ALL;
+  s_quick_check = true;
+  s_quick_check_stride = QUICK_CHECK_STRIDE;
+  s_boot_check = false;
+}
+
+void winc_cloner_step(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+
+  switch (ctx->state) {
+  case WINC_CLONER_STATE_IDLE: {
+    // wait here for an operation to be started
+  } break;
+
+  case WINC_CLONER_STATE_OPENING: {
+    if (open_op() && ((ctx->op->begin == NULL) || ctx->op->begin())) {
+      set_state(WINC_CLONER_STATE_RUNNING);
+    } else {
+      close_op();
+      endgame(WINC_CLONER_STATE_ERROR);
+    }
+  } break;
+
+  case WINC_CLONER_STATE_RUNNING: {
+    // Do one unit of work per call so other tasks run in between.
+    step_result_t res;
+    if (ctx->cancel_requested) {
+      SYS_CONSOLE_MESSAGE("\nCancelled");
+      res = STEP_ERROR;
+    } else {
+      res = ctx->op->step();
+    }
+    if (res == STEP_DONE) {
+      set_state(WINC_CLONER_STATE_CLOSING);
+    } else if (res == STEP_ERROR) {
+      close_op();
+      endgame(WINC_CLONER_STATE_ERROR);
+    } else {
+      // remain in this state until the operation completes
+    }
+  } break;
+
+  case WINC_CLONER_STATE_PAUSED: {
+    // remain in this state until resumed or cancelled
+    if (ctx->cancel_requested) {
+      set_state(WINC_CLONER_STATE_RUNNING);
+    }
+  } break;
+
+  case WINC_CLONER_STATE_CLOSING: {
+    close_op();
+    if ((ctx->op->finish == NULL) || ctx->op->finish()) {
+      SYS_DEBUG_PRINT(SYS_ERROR_INFO, ctx->op->success_fmt, ctx->filename);
+      endgame(WINC_CLONER_STATE_COMPLETE);
+    } else {
+      endgame(WINC_CLONER_STATE_ERROR);
+    }
+  } break;
+
+  case WINC_CLONER_STATE_COMPLETE: {
+    // here on complete state
+  } break;
+
+  case WINC_CLONER_STATE_ERROR: {
+    // here on error state
+  } break;
+  } // switch
+}
+
+void winc_cloner_set_callback(winc_cloner_callback_fn callback_fn,
+                              uintptr_t callback_arg) {
+  s_winc_cloner_ctx.callback_fn = callback_fn;
+  s_winc_cloner_ctx.callback_arg = callback_arg;
 }
 
 bool winc_cloner_extract(const char *filename) {
-  bool ret = cloner_aux(filename, SYS_FS_FILE_OPEN_WRITE, extract_loop);
-  if (ret) {
-    SYS_DEBUG_PRINT(SYS_ERROR_INFO,
-                    "\nSuccessfully extracted WINC contents into %s",
-                    filename);
+  return can_start() && start(&s_extract_op, filename);
+}
+
+bool winc_cloner_update(const char *filename) {
+  return can_start() && start_update(filename, false);
+}
+
+bool winc_cloner_resume_update(void) {
+  update_journal_t journal;
+
+  if (winc_cloner_is_busy() || !update_journal_read(&journal) ||
+      (journal.kind != UPDATE_JOURNAL_UPDATE)) {
+    // nothing to resume
+    return false;
   }
-  return ret;
+  journal.image_name[IMAGE_MANIFEST_NAME_LEN - 1] = '\0';
+  SYS_CONSOLE_PRINT("\nResuming interrupted update from %s",
+                    journal.image_name);
+  if (!start_update(journal.image_name, true)) {
+    return false;
+  }
+  // finish the regions that the interrupted update was working on
+  s_winc_cloner_ctx.regions = journal.regions;
+  return true;
+}
+
+bool winc_cloner_compare(const char *filename) {
+  if (!can_start()) {
+    return false;
+  }
+  s_has_manifest =
+      !is_image_cache(filename) && image_manifest_read(filename, &s_manifest);
+  if (s_has_manifest) {
+    // The manifest holds every sector's CRC: no need to read the image.
+    SYS_CONSOLE_PRINT("\nUsing manifest for %s", filename);
+  }
+  if (!start(s_has_manifest ? &s_manifest_compare_op : &s_compare_op,
+             filename)) {
+    return false;
+  }
+  if (s_regions == FLASH_REGION_SET_ALL) {
+    // The WINC rewrites these in operation: they would always differ.
+    s_winc_cloner_ctx.regions &= ~FLASH_REGION_SET_VOLATILE;
+  }
+  return true;
+}
+
+bool winc_cloner_apply_delta(const char *filename) {
+  return can_start() && start(&s_apply_delta_op, filename);
+}
+
+bool winc_cloner_slot_update(const char *filename) {
+  return can_start() && start(&s_slot_update_op, filename);
 }
 
-bool winc_cloner_update(const char *filename) {
-  bool ret = cloner_aux(filename, SYS_FS_FILE_OPEN_READ, update_loop);
-  if (ret) {
-    SYS_DEBUG_PRINT(SYS_ERROR_INFO,
-                    "\nSuccessfully updated WINC contents from %s",
-                    filename);
+bool winc_cloner_stream_update(void) {
+  return can_start() && start(&s_stream_update_op, UART_STREAM_NAME);
+}
+
+void winc_cloner_pause(void) {
+  if (s_winc_cloner_ctx.state == WINC_CLONER_STATE_RUNNING) {
+    SYS_CONSOLE_MESSAGE("\nPaused");
+    set_state(WINC_CLONER_STATE_PAUSED);
+  }
+}
+
+void winc_cloner_resume(void) {
+  if (s_winc_cloner_ctx.state == WINC_CLONER_STATE_PAUSED) {
+    SYS_CONSOLE_MESSAGE("\nResumed\n");
+    set_state(WINC_CLONER_STATE_RUNNING);
+  }
+}
+
+void winc_cloner_cancel(void) {
+  if (winc_cloner_is_busy()) {
+    // acted upon at the next step, after the current sector is finished
+    s_winc_cloner_ctx.cancel_requested = true;
+  }
+}
+
+bool winc_cloner_is_busy(void) {
+  winc_cloner_state_t state = s_winc_cloner_ctx.state;
+  return (state != WINC_CLONER_STATE_IDLE) &&
+         (state != WINC_CLONER_STATE_COMPLETE) &&
+         (state != WINC_CLONER_STATE_ERROR);
+}
+
+bool winc_cloner_is_paused(void) {
+  return s_winc_cloner_ctx.state == WINC_CLONER_STATE_PAUSED;
+}
+
+bool winc_cloner_is_complete(void) {
+  return s_winc_cloner_ctx.state == WINC_CLONER_STATE_COMPLETE;
+}
+
+bool winc_cloner_has_error(void) {
+  return s_winc_cloner_ctx.state == WINC_CLONER_STATE_ERROR;
+}
+bool winc_cloner_open_winc(void) { return open_winc(); }
+
+void winc_cloner_close_winc(void) {
+  // The next WINC may be a different one.
+  s_winc_is_opened = false;
+  s_winc_has_mac = false;
+  nmi_set_chipid_cache(0);
+  spi_flash_set_size_cache(0);
+}
+
+uint16_t winc_cloner_differ_count(void) {
+  return s_winc_cloner_ctx.n_differ;
+}
+
+void winc_cloner_set_regions(flash_region_set_t regions) {
+  s_regions = regions;
+}
+
+flash_region_set_t winc_cloner_get_regions(void) { return s_regions; }
+
+void winc_cloner_set_quick_check(bool enabled) { s_quick_check = enabled; }
+
+bool winc_cloner_get_quick_check(void) { return s_quick_check; }
+
+void winc_cloner_set_quick_check_stride(uint16_t stride) {
+  s_quick_check_stride = (stride == 0) ? QUICK_CHECK_STRIDE : stride;
+}
+
+uint16_t winc_cloner_get_quick_check_stride(void) {
+  return s_quick_check_stride;
+}
+
+void winc_cloner_set_boot_check(bool enabled) { s_boot_check = enabled; }
+
+bool winc_cloner_get_boot_check(void) { return s_boot_check; }
+
+bool winc_cloner_rebuild_pll(void) {
+
+  if (!open_winc()) {
+    SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\nCould not open WINC");
+    return false;
+  }
+
+  // fetch a copy of the PLL / GAIN tables
+  if (winc_sector_read(s_xfer_buf, M2M_PLL_FLASH_OFFSET) != SECTOR_OKAY) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "Could not read existing PLL / GAIN sector from WINC\r\n");
+    return false;
+  }
+
+  dump_pll_data(s_xfer_buf, "before");
+
+  // Read XO offset
+  if (read_efuse_struct(&efuseStruct, 0) != EFUSE_SUCCESS) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "Failed to read the efuse table\r\n");
+    return false;
+  }
+
+  int32_t ret = 0;
+  // Overwrite the PLL section of in-RAM sector with newly computed PLL data.
+  ret = winc3400_pll_table_build(s_xfer_buf, efuseStruct.FreqOffset);
+  if (ret <= 0) {
+    SYS_DEBUG_PRINT(
+        SYS_ERROR_ERROR, "Failed to construct PLL table, err=%d\r\n", ret);
+    return false;
+  } else {
+    SYS_DEBUG_PRINT(SYS_ERROR_INFO,
+                    "Successfully constructed PLL table with size %d bytes\r\n",
+                    ret);
+  }
+
+  dump_pll_data(s_xfer_buf, "after");
+
+  // Write the PLL / DATA sector to the WINC
+  sector_result_t res = winc_sector_write(s_xfer_buf, M2M_PLL_FLASH_OFFSET);
+  if (res == SECTOR_ERROR) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "Failed to write PLL / DATA sector to the WINC\r\n");
+    return false;
+
+  } else if (res == SECTOR_EQUAL) {
+    SYS_DEBUG_PRINT(SYS_ERROR_INFO, "PLL / DATA sector up to date\r\n");
+
+  } else if (res == SECTOR_DIFFER) {
+    SYS_DEBUG_PRINT(SYS_ERROR_INFO, "PLL / DATA sector updated\r\n");
+  }
+
+  return true;
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static void set_state(winc_cloner_state_t state) {
+  if (s_winc_cloner_ctx.state != state) {
+    TRACE2(TRACE_WINC_CLONER_STATE, s_winc_cloner_ctx.state, state);
+    s_winc_cloner_ctx.state = state;
+  }
+}
+
+static void endgame(winc_cloner_state_t final_state) {
+  // An unfinished update leaves its journal on the card to resume from.
+  s_journal_is_active = false;
+  set_state(final_state);
+  op_stats_print(s_winc_cloner_ctx.op->name, s_winc_cloner_ctx.n_done);
+  if (s_winc_cloner_ctx.callback_fn) {
+    s_winc_cloner_ctx.callback_fn(s_winc_cloner_ctx.callback_arg);
+  }
+}
+
+static bool can_start(void) {
+  if (winc_cloner_is_busy()) {
+    SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\nwinc_cloner is busy");
+    return false;
+  }
+  return true;
+}
+
+static bool start(const cloner_op_t *op, const char *filename) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+
+  ctx->op = op;
+  strncpy(ctx->filename, filename, MAX_FILENAME_LENGTH - 1);
+  ctx->filename[MAX_FILENAME_LENGTH - 1] = '\0';
+  ctx->file_handle = SYS_FS_HANDLE_INVALID;
+  ctx->file_is_open = false;
+  ctx->cancel_requested = false;
+  ctx->n_bytes = 0;
+  ctx->addr = 0;
+  ctx->idx = 0;
+  ctx->pass = 0;
+  ctx->n_differ = 0;
+  ctx->n_done = 0;
+  ctx->resume_addr = 0;
+  ctx->resume_only = false;
+  ctx->regions = s_regions;
+  ctx->quick_check = s_quick_check;
+  ctx->sample_stride = s_quick_check_stride;
+  ctx->is_current = false;
+  ctx->n_sampled = 0;
+  ctx->winc_version = 0;
+  ctx->boot_check = s_boot_check;
+  ctx->image_version = 0;
+  ctx->revisit = false;
+  s_journal_is_active = false;
+  op_stats_reset();
+  set_state(WINC_CLONER_STATE_OPENING);
+  return true;
+}
+
+static bool start_update(const char *filename, bool resume_only) {
+  const cloner_op_t *op = &s_update_op;
+
+  if (load_plan(filename)) {
+    SYS_CONSOLE_PRINT("\nUsing programming plan %s", s_plan_name);
+    op = &s_planned_update_op;
+  }
+  if (!start(op, filename)) {
+    return false;
+  }
+  s_winc_cloner_ctx.resume_only = resume_only;
+  return true;
+}
+
+static bool open_op(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+
+  if (!open_winc()) {
+    SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\nCould not open WINC");
+    return false;
+  }
+
+  ctx->n_bytes = spi_flash_get_size() << 17; // convert megabits to bytes
+
+  if (is_image_cache(ctx->filename)) {
+    // Source the image from internal flash rather than from a file.
+    if ((ctx->op->file_mode != SYS_FS_FILE_OPEN_READ) ||
+        !image_cache_is_valid()) {
+      SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\nImage cache is not available");
+      return false;
+    }
+  } else if (is_uart_stream(ctx->filename)) {
+    // Source the image from the host over the console UART.
+    if ((ctx->op != &s_stream_update_op) || !uart_stream_is_started()) {
+      SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\nImage stream is not available");
+      return false;
+    }
+  } else {
+    ctx->file_handle = SYS_FS_FileOpen(ctx->filename, ctx->op->file_mode);
+    if (ctx->file_handle == SYS_FS_HANDLE_INVALID) {
+      // Could not open file
+      SYS_DEBUG_PRINT(
+          SYS_ERROR_ERROR, "\nCould not open file %s", ctx->filename);
+      return false;
+    }
+    ctx->file_is_open = true;
+  }
+  if ((ctx->regions != FLASH_REGION_SET_ALL) &&
+      (ctx->op != &s_apply_delta_op) && (ctx->op != &s_slot_update_op)) {
+    char regions[FLASH_REGION_SET_FORMAT_SIZE];
+    flash_region_set_format(ctx->regions, regions, sizeof(regions));
+    SYS_CONSOLE_PRINT("\nRegions: %s", regions);
+  }
+  SYS_CONSOLE_MESSAGE("\n");
+  return true;
+}
+
+static void close_op(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+
+  if (ctx->file_is_open) {
+    SYS_FS_FileClose(ctx->file_handle); // assure that the file is closed
+    ctx->file_is_open = false;
+  }
+  ctx->file_handle = SYS_FS_HANDLE_INVALID;
+}
+
+static bool extract_begin(void) {
+  s_has_manifest = false;
+  image_manifest_builder_init(&s_builder, s_winc_cloner_ctx.filename);
+  return true;
+}
+
+static step_result_t extract_step(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+  size_t to_xfer = ctx->n_bytes;
+
+  if (to_xfer == 0) {
+    // success
+    return STEP_DONE;
+  }
+  if (to_xfer > FLASH_SECTOR_SZ) {
+    to_xfer = FLASH_SECTOR_SZ;
+  }
+  if (!is_selected(ctx->addr)) {
+    // Keep the file laid out like the WINC, with unselected sectors erased.
+    memset(s_xfer_buf, 0xff, FLASH_SECTOR_SZ);
+  } else if (winc_sector_read(s_xfer_buf, ctx->addr) != SECTOR_OKAY) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\nFailed to read %ld bytes at 0x%ld from WINC",
+                    to_xfer,
+                    ctx->addr);
+    return STEP_ERROR;
+  }
+  uint32_t t0 = op_stats_start();
+  image_manifest_builder_add(&s_builder, s_xfer_buf);
+  op_stats_stop(OP_STATS_HASH, t0, to_xfer);
+  t0 = op_stats_start();
+  if (SYS_FS_FileWrite(ctx->file_handle, s_xfer_buf, to_xfer) != to_xfer) {
+    // file write failed
+    SYS_DEBUG_PRINT(
+        SYS_ERROR_ERROR, "\nFailed to write %ld bytes to file", to_xfer);
+    return STEP_ERROR;
+  }
+  op_stats_stop(OP_STATS_SD_WRITE, t0, to_xfer);
+  ctx->n_bytes -= to_xfer;
+  ctx->addr += to_xfer;
+  report_sector(SECTOR_OKAY, to_xfer);
+  return STEP_CONTINUE;
+}
+
+static bool update_begin(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+
+  s_has_manifest = !is_image_cache(ctx->filename) &&
+                   image_manifest_read(ctx->filename, &s_manifest);
+  image_manifest_builder_init(&s_builder, ctx->filename);
+  if (!journal_begin() || !boot_check_begin()) {
+    return false;
+  }
+  revisit_begin();
+  if (!ctx->revisit) {
+    // The record no longer holds once the WINC is written.
+    forget_device();
+  }
+  quick_check_begin(ctx->n_bytes);
+  // Committed sectors are neither read from the card nor compared.
+  ctx->addr = ctx->resume_addr;
+  ctx->n_bytes -= ctx->resume_addr;
+  pipeline_begin();
+  return true;
+}
+
+static bool stream_update_begin(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+
+  if (uart_stream_image_size() < ctx->n_bytes) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\nStreamed image is %ld bytes but WINC holds %ld",
+                    uart_stream_image_size(),
+                    ctx->n_bytes);
+    return false;
+  }
+  // The stream can only be read once, in order.
+  s_has_manifest = false;
+  image_manifest_builder_init(&s_builder, ctx->filename);
+  ctx->quick_check = false;
+  journal_mark_writing();
+  forget_device();
+  pipeline_begin();
+  return true;
+}
+
+static void pipeline_begin(void) {
+  // All buffers start out empty.
+  for (int i = 0; i < N_XFER_BUFS; i++) {
+    s_xfer_descs[i].buf = (i == 0) ? s_xfer_buf : s_pipe_bufs[i - 1];
+  }
+  s_xfer_head = 0;
+  s_xfer_n_filled = 0;
+}
+
+static step_result_t update_step(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+
+  if (ctx->quick_check) {
+    return quick_check_step();
+  }
+  // The WINC stage starts an erase and returns.  Once it finishes a sector,
+  // let it go on to start erasing the next before the SD stage refills the
+  // freed buffer: the card is then read while the WINC erases.
+  uint8_t n_filled;
+  do {
+    n_filled = s_xfer_n_filled;
+    if (update_winc_stage() == STEP_ERROR) {
+      return STEP_ERROR;
+    }
+  } while ((s_xfer_n_filled < n_filled) && (s_xfer_n_filled > 0));
+  if (update_sd_stage() == STEP_ERROR) {
+    return STEP_ERROR;
+  }
+  if ((ctx->n_bytes == 0) && (s_xfer_n_filled == 0)) {
+    // success
+    return STEP_DONE;
+  }
+  return STEP_CONTINUE;
+}
+
+static step_result_t update_sd_stage(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+  size_t to_xfer;
+  xfer_desc_t *desc;
+
+  skip_unselected();
+  to_xfer = ctx->n_bytes;
+  if (to_xfer == 0) {
+    // all sectors have been read
+    return STEP_CONTINUE;
+  }
+  if (to_xfer > FLASH_SECTOR_SZ) {
+    to_xfer = FLASH_SECTOR_SZ;
+  }
+  if ((ctx->op == &s_stream_update_op) &&
+      !uart_stream_is_ready(ctx->addr, to_xfer)) {
+    // wait for the host to send the rest of the sector
+    return uart_stream_has_error() ? STEP_ERROR : STEP_CONTINUE;
+  }
+  desc = xfer_empty();
+  if (desc == NULL) {
+    // no empty buffer: wait for the WINC stage to catch up
+    return STEP_CONTINUE;
+  }
+  if (!image_read(ctx->file_handle, desc->buf, ctx->addr, to_xfer)) {
+    // file read failed.
+    SYS_DEBUG_PRINT(
+        SYS_ERROR_ERROR, "\nFailed to read %ld bytes from file", to_xfer);
+    return STEP_ERROR;
+  }
+  // Sectors are read in order, so the manifest is built in order.
+  uint16_t idx = ctx->addr / FLASH_SECTOR_SZ;
+  uint32_t t0 = op_stats_start();
+  desc->crc = image_manifest_builder_add(&s_builder, desc->buf);
+  op_stats_stop(OP_STATS_HASH, t0, to_xfer);
+  if (s_has_manifest && ((idx >= s_manifest.n_sectors) ||
+                         (desc->crc != s_manifest.sector_crc[idx]))) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\nImage does not match its manifest at 0x%lx",
+                    ctx->addr);
+    return STEP_ERROR;
+  }
+  desc->addr = ctx->addr;
+  desc->n_bytes = to_xfer;
+  desc->is_erasing = false;
+  s_xfer_n_filled += 1;
+
+  // advance to next sector
+  ctx->n_bytes -= to_xfer;
+  ctx->addr += to_xfer;
+  return STEP_CONTINUE;
+}
+
+static step_result_t update_winc_stage(void) {
+  xfer_desc_t *desc = xfer_filled();
+  sector_result_t res;
+
+  if (desc == NULL) {
+    // nothing to write yet
+    return STEP_CONTINUE;
+  }
+  // Compare the buffer with the WINC sector.  If they differ, start erasing
+  // the sector and come back to program it once the erase is done.
+  if (desc->is_erasing) {
+    uint8_t busy;
+    if (spi_flash_is_busy(&busy) != M2M_SUCCESS) {
+      res = SECTOR_ERROR;
+    } else if (busy) {
+      return STEP_CONTINUE;
+    } else {
+      op_stats_stop(OP_STATS_WINC_ERASE, desc->erase_start, FLASH_SECTOR_SZ);
+      op_stats_count(OP_STATS_SECTORS_ERASED, 1);
+      desc->is_erasing = false;
+      res = winc_pages_program(desc->buf, desc->addr, 0);
+    }
+  } else if (is_pll_sector(desc->addr)) {
+    // do not overwrite PLL and GAIN settings: see spi_flash_map.h
+    res = SECTOR_SKIPPED;
+  } else if (winc_sector_read(s_xfer_buf2, desc->addr) != SECTOR_OKAY) {
+    res = SECTOR_ERROR;
+  } else if (buffers_are_equal(desc->buf, s_xfer_buf2, FLASH_SECTOR_SZ)) {
+    res = SECTOR_EQUAL;
+  } else {
+    journal_mark_in_flight(desc->addr);
+    desc->erase_start = op_stats_start();
+    if (spi_flash_erase_start(desc->addr) != M2M_SUCCESS) {
+      res = SECTOR_ERROR;
+    } else {
+      desc->is_erasing = true;
+      return STEP_CONTINUE;
+    }
+  }
+
+  if (res == SECTOR_ERROR) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\nFailed to write %ld bytes at address 0x%ld to WINC",
+                    desc->n_bytes,
+                    desc->addr);
+    return STEP_ERROR;
+
+  } else if ((res == SECTOR_DIFFER) &&
+             !winc_sector_verify(desc->addr, desc->crc)) {
+    return STEP_ERROR;
+  }
+  report_sector(res, desc->n_bytes);
+  journal_commit(desc->addr + desc->n_bytes);
+
+  // return the buffer to the SD stage
+  s_xfer_head = (s_xfer_head + 1) % N_XFER_BUFS;
+  s_xfer_n_filled -= 1;
+  return STEP_CONTINUE;
+}
+
+static xfer_desc_t *xfer_empty(void) {
+  if (s_xfer_n_filled == N_XFER_BUFS) {
+    return NULL;
+  }
+  return &s_xfer_descs[(s_xfer_head + s_xfer_n_filled) % N_XFER_BUFS];
+}
+
+static xfer_desc_t *xfer_filled(void) {
+  if (s_xfer_n_filled == 0) {
+    return NULL;
+  }
+  return &s_xfer_descs[s_xfer_head];
+}
+
+static bool planned_update_begin(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+  const image_plan_t *plan = &s_plan;
+
+  if (((int32_t)plan->image_size != image_size(ctx->file_handle)) ||
+      (plan->image_size > ctx->n_bytes)) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\nPlan is for a %ld byte image",
+                    plan->image_size);
+    return false;
+  }
+  s_has_manifest = !is_image_cache(ctx->filename) &&
+                   image_manifest_read(ctx->filename, &s_manifest);
+  if (!journal_begin() || !boot_check_begin()) {
+    return false;
+  }
+  revisit_begin();
+  if (!ctx->revisit) {
+    // The record no longer holds once the WINC is written.
+    forget_device();
+  }
+  quick_check_begin(plan->n_sectors * FLASH_SECTOR_SZ);
+  ctx->idx = ctx->resume_addr / FLASH_SECTOR_SZ;
+  ctx->pass = PLAN_PASS_WRITE;
+  ctx->block_end = 0;
+  ctx->block_is_erased = false;
+  return true;
+}
+
+static step_result_t planned_update_step(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+  const image_plan_t *plan = &s_plan;
+
+  if (ctx->quick_check) {
+    return quick_check_step();
+  }
+  if (ctx->pass == PLAN_PASS_BLOCK_CHECK) {
+    return plan_block_check_step();
+  }
+  if (ctx->idx >= plan->n_sectors) {
+    // success
+    return STEP_DONE;
+  }
+  if ((ctx->idx >= ctx->block_end) && starts_erase_block(ctx->idx)) {
+    ctx->block_end = ctx->idx + IMAGE_PLAN_SECTORS_PER_BLOCK;
+    ctx->block_is_erased = false;
+    ctx->addr = ctx->idx * FLASH_SECTOR_SZ;
+    ctx->pass = PLAN_PASS_BLOCK_CHECK;
+    return STEP_CONTINUE;
+  }
+
+  const image_plan_sector_t *sector = &plan->sectors[ctx->idx];
+  uint32_t dst_addr = ctx->idx * FLASH_SECTOR_SZ;
+  bool is_erased = ctx->block_is_erased && (ctx->idx < ctx->block_end);
+  ctx->idx += 1;
+
+  if (!is_selected(dst_addr)) {
+    return STEP_CONTINUE;
+  }
+
+  if (is_pll_sector(dst_addr)) {
+    // do not overwrite PLL and GAIN settings: see spi_flash_map.h
+    report_sector(SECTOR_SKIPPED, FLASH_SECTOR_SZ);
+    journal_commit(dst_addr + FLASH_SECTOR_SZ);
+    return STEP_CONTINUE;
+  }
+
+  // Compare the WINC sector against the planned CRC: the file is only read
+  // when the sector actually needs to be written.  The sectors of an erased
+  // block were all found to differ before it was erased.
+  if (!is_erased) {
+    if (winc_sector_read(s_xfer_buf2, dst_addr) != SECTOR_OKAY) {
+      return STEP_ERROR;
+    }
+    if (sector_crc(s_xfer_buf2) == sector->crc) {
+      report_sector(SECTOR_EQUAL, FLASH_SECTOR_SZ);
+      journal_commit(dst_addr + FLASH_SECTOR_SZ);
+      return STEP_CONTINUE;
+    }
+  }
+
+  if (sector->blank_pages != IMAGE_PLAN_ALL_PAGES_BLANK) {
+    if (!image_read(ctx->file_handle, s_xfer_buf, dst_addr, FLASH_SECTOR_SZ)) {
+      SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                      "\nFailed to read %ld bytes from file",
+                      FLASH_SECTOR_SZ);
+      return STEP_ERROR;
+    }
+    if (sector_crc(s_xfer_buf) != sector->crc) {
+      SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                      "\nImage does not match %s at 0x%lx: rebuild the plan",
+                      s_plan_name,
+                      dst_addr);
+      return STEP_ERROR;
+    }
+  }
+  sector_result_t res;
+  if (is_erased) {
+    res = winc_pages_program(s_xfer_buf, dst_addr, sector->blank_pages);
+  } else {
+    res = winc_sector_program(s_xfer_buf, dst_addr, sector->blank_pages);
+  }
+  if ((res == SECTOR_ERROR) || !winc_sector_verify(dst_addr, sector->crc)) {
+    return STEP_ERROR;
+  }
+  report_sector(SECTOR_DIFFER, FLASH_SECTOR_SZ);
+  journal_commit(dst_addr + FLASH_SECTOR_SZ);
+  return STEP_CONTINUE;
+}
+
+static bool starts_erase_block(uint16_t idx) {
+  return (idx % IMAGE_PLAN_SECTORS_PER_BLOCK == 0) &&
+         (image_plan_find_run(&s_plan, idx) != NULL) &&
+         is_selected(idx * FLASH_SECTOR_SZ);
+}
+
+static step_result_t plan_block_check_step(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+  uint16_t idx = ctx->addr / FLASH_SECTOR_SZ;
+
+  if (idx < ctx->block_end) {
+    if (winc_sector_read(s_xfer_buf2, ctx->addr) != SECTOR_OKAY) {
+      return STEP_ERROR;
+    }
+    if (sector_crc(s_xfer_buf2) == s_plan.sectors[idx].crc) {
+      // Part of the block is already written: go sector by sector.
+      ctx->pass = PLAN_PASS_WRITE;
+    }
+    ctx->addr += FLASH_SECTOR_SZ;
+    return STEP_CONTINUE;
+  }
+  // Every sector differs: one block erase instead of a sector erase apiece.
+  if (!winc_block_erase(ctx->idx * FLASH_SECTOR_SZ)) {
+    return STEP_ERROR;
+  }
+  ctx->block_is_erased = true;
+  ctx->pass = PLAN_PASS_WRITE;
+  return STEP_CONTINUE;
+}
+
+static step_result_t compare_step(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+  skip_unselected();
+  uint32_t dst_addr = ctx->addr;
+  size_t to_xfer = ctx->n_bytes;
+
+  if (to_xfer == 0) {
+    // success
+    return STEP_DONE;
+  }
+  if (to_xfer > FLASH_SECTOR_SZ) {
+    to_xfer = FLASH_SECTOR_SZ;
+  }
+
+  // Read a sector of data from the file and from the WINC and compare them.
+  if (!image_read(ctx->file_handle, s_xfer_buf, dst_addr, to_xfer)) {
+    // file read failed.
+    SYS_DEBUG_PRINT(
+        SYS_ERROR_ERROR, "\nFailed to read %ld bytes from file", to_xfer);
+    return STEP_ERROR;
+  }
+  if (winc_sector_read(s_xfer_buf2, dst_addr) != SECTOR_OKAY) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\nFailed to read %ld bytes at 0x%lx from WINC",
+                    to_xfer,
+                    dst_addr);
+    return STEP_ERROR;
+  }
+  if (buffers_are_equal(s_xfer_buf, s_xfer_buf2, to_xfer)) {
+    // buffers are identical
+    report_sector(SECTOR_EQUAL, to_xfer);
+  } else if (is_pll_sector(dst_addr)) {
+    // PLL and GAIN settings are specific to each WINC
+    report_sector(SECTOR_SKIPPED, to_xfer);
+  } else {
+    // buffers differ
+    report_sector(SECTOR_DIFFER, to_xfer);
+    ctx->n_differ += 1;
+  }
+  // advance to next sector
+  ctx->n_bytes -= to_xfer;
+  ctx->addr += to_xfer;
+  return STEP_CONTINUE;
+}
+
+static bool compare_begin(void) {
+  // Compare only reads, so a WINC that is not revisited keeps its record.
+  revisit_begin();
+  return true;
+}
+
+static bool manifest_compare_begin(void) {
+  // the image itself is not read
+  if (s_manifest.image_size > s_winc_cloner_ctx.n_bytes) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\nManifest is for a %ld byte image",
+                    s_manifest.image_size);
+    return false;
+  }
+  return compare_begin();
+}
+
+static step_result_t manifest_compare_step(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+  const image_manifest_t *manifest = &s_manifest;
+
+  while ((ctx->idx < manifest->n_sectors) &&
+         !is_selected(ctx->idx * FLASH_SECTOR_SZ)) {
+    ctx->idx += 1;
+  }
+  if (ctx->idx >= manifest->n_sectors) {
+    if (ctx->n_differ == 0) {
+      SYS_CONSOLE_MESSAGE("\nWINC matches");
+      image_manifest_print_digest(manifest);
+    } else {
+      SYS_CONSOLE_PRINT("\n%d sector%s differ%s",
+                        ctx->n_differ,
+                        ctx->n_differ == 1 ? "" : "s",
+                        ctx->n_differ == 1 ? "s" : "");
+    }
+    // success
+    return STEP_DONE;
+  }
+
+  uint32_t addr = ctx->idx * FLASH_SECTOR_SZ;
+  if (winc_sector_read(s_xfer_buf2, addr) != SECTOR_OKAY) {
+    return STEP_ERROR;
+  }
+  if (sector_crc(s_xfer_buf2) == manifest->sector_crc[ctx->idx]) {
+    report_sector(SECTOR_EQUAL, FLASH_SECTOR_SZ);
+  } else if (is_pll_sector(addr)) {
+    // PLL and GAIN settings are specific to each WINC
+    report_sector(SECTOR_SKIPPED, FLASH_SECTOR_SZ);
+  } else {
+    report_sector(SECTOR_DIFFER, FLASH_SECTOR_SZ);
+    ctx->n_differ += 1;
+  }
+  ctx->idx += 1;
+  return STEP_CONTINUE;
+}
+
+static bool apply_delta_begin(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+  delta_image_header_t *header = &s_delta_header;
+
+  if (!ctx->file_is_open ||
+      (SYS_FS_FileRead(ctx->file_handle, header, sizeof(*header)) !=
+       sizeof(*header)) ||
+      !delta_image_header_is_valid(header)) {
+    SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\nNot a valid delta file");
+    return false;
+  }
+  if (header->n_sectors * FLASH_SECTOR_SZ > ctx->n_bytes) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\nDelta covers %d sectors but WINC holds %ld",
+                    header->n_sectors,
+                    ctx->n_bytes / FLASH_SECTOR_SZ);
+    return false;
+  }
+  SYS_CONSOLE_PRINT("Delta from %s to %s: %d of %d sectors changed\n",
+                    header->base_name,
+                    header->target_name,
+                    header->n_changed,
+                    header->n_sectors);
+  ctx->pass = 1;
+  ctx->idx = 0;
+  return true;
+}
+
+static step_result_t apply_delta_step(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+  delta_image_header_t *header = &s_delta_header;
+  delta_image_record_t record;
+  uint32_t addr;
+  uint32_t crc;
+
+  if (ctx->pass == 1) {
+    // Pass 1: before touching anything, confirm that every changed sector on
+    // the WINC holds either the base contents or (from an earlier,
+    // interrupted run) the target contents.  Unchanged sectors are not read.
+    while ((ctx->idx < header->n_sectors) &&
+           (!delta_image_is_changed(header, ctx->idx) ||
+            is_pll_sector(ctx->idx * FLASH_SECTOR_SZ))) {
+      ctx->idx += 1;
+    }
+    if (ctx->idx >= header->n_sectors) {
+      // The WINC is about to be patched, after which it no longer matches any
+      // interrupted update or record.  A delta that was refused leaves both.
+      journal_mark_writing();
+      forget_device();
+      ctx->pass = 2;
+      ctx->idx = 0;
+      ctx->addr = 0; // records must start at or beyond this address
+      return STEP_CONTINUE;
+    }
+    addr = ctx->idx * FLASH_SECTOR_SZ;
+    if (winc_sector_read(s_xfer_buf2, addr) != SECTOR_OKAY) {
+      return STEP_ERROR;
+    }
+    crc = sector_crc(s_xfer_buf2);
+    if ((crc != header->base_crc[ctx->idx]) &&
+        (crc != header->target_crc[ctx->idx])) {
+      SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                      "\nWINC sector at 0x%lx matches neither %s nor %s",
+                      addr,
+                      header->base_name,
+                      header->target_name);
+      return STEP_ERROR;
+    }
+    ctx->idx += 1;
+    return STEP_CONTINUE;
+  }
+
+  // Pass 2: stream the changed sectors from the file into the WINC.
+  if (ctx->idx >= header->n_changed) {
+    // success
+    return STEP_DONE;
+  }
+  ctx->idx += 1;
+  uint32_t t0 = op_stats_start();
+  if ((SYS_FS_FileRead(ctx->file_handle, &record, sizeof(record)) !=
+       sizeof(record)) ||
+      (SYS_FS_FileRead(ctx->file_handle, s_xfer_buf, FLASH_SECTOR_SZ) !=
+       FLASH_SECTOR_SZ)) {
+    SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\nFailed to read delta record");
+    return STEP_ERROR;
+  }
+  op_stats_stop(OP_STATS_SD_READ, t0, sizeof(record) + FLASH_SECTOR_SZ);
+  addr = record.sector * FLASH_SECTOR_SZ;
+  // Records must be in strictly ascending order: a sector already passed is
+  // never written again.
+  if ((record.sector >= header->n_sectors) || (addr < ctx->addr) ||
+      !delta_image_is_changed(header, record.sector)) {
+    SYS_DEBUG_PRINT(
+        SYS_ERROR_ERROR, "\nUnexpected delta record %ld", record.sector);
+    return STEP_ERROR;
+  }
+  ctx->addr = addr + FLASH_SECTOR_SZ;
+
+  if (is_pll_sector(addr)) {
+    // do not overwrite PLL and GAIN settings: see spi_flash_map.h
+    report_sector(SECTOR_SKIPPED, FLASH_SECTOR_SZ);
+    return STEP_CONTINUE;
   }
-  return ret;
+  if (winc_sector_read(s_xfer_buf2, addr) != SECTOR_OKAY) {
+    return STEP_ERROR;
+  }
+  if (buffers_are_equal(s_xfer_buf, s_xfer_buf2, FLASH_SECTOR_SZ)) {
+    // already holds the target contents
+    report_sector(SECTOR_EQUAL, FLASH_SECTOR_SZ);
+    return STEP_CONTINUE;
+  }
+  // Write and verify the sector against the expected CRC.
+  if ((winc_sector_program(s_xfer_buf, addr, 0) == SECTOR_ERROR) ||
+      !winc_sector_verify(addr, header->target_crc[record.sector])) {
+    return STEP_ERROR;
+  }
+  report_sector(SECTOR_DIFFER, FLASH_SECTOR_SZ);
+  return STEP_CONTINUE;
 }
-
-bool winc_cloner_compare(const char *filename) {
-  bool ret = cloner_aux(filename, SYS_FS_FILE_OPEN_READ, compare_loop);
-  if (ret) {
-    SYS_DEBUG_PRINT(SYS_ERROR_INFO,
-                    "\nSuccessfully compared WINC contents to %s",
-                    filename);
+static bool slot_update_begin(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+  slot_update_t *slot = &s_slot;
+  tstrOtaControlSec image_control;
+  char winc_version[OTA_CONTROL_VERSION_SIZE];
+  char image_version[OTA_CONTROL_VERSION_SIZE];
+
+  if (!read_control(false, &image_control) ||
+      (ota_control_inactive_slot(&image_control) == OTA_CONTROL_NO_SLOT)) {
+    SYS_DEBUG_PRINT(
+        SYS_ERROR_ERROR, "\n%s has no valid control sector", ctx->filename);
+    return false;
   }
-  return ret;
+  if (!read_control(true, &slot->control) ||
+      (ota_control_inactive_slot(&slot->control) == OTA_CONTROL_NO_SLOT)) {
+    SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR,
+                      "\nWINC has no valid control sector: use u instead");
+    return false;
+  }
+  // The slots swap roles, so the WINC no longer matches any interrupted
+  // update or record.
+  journal_mark_writing();
+  forget_device();
+  s_has_manifest = !is_image_cache(ctx->filename) &&
+                   image_manifest_read(ctx->filename, &s_manifest);
+  if (!boot_check_begin()) {
+    return false;
+  }
+  slot->src = image_control.u32OtaCurrentWorkingImagOffset;
+  slot->dst = ota_control_inactive_slot(&slot->control);
+  slot->version = image_control.u32OtaCurrentworkingImagFirmwareVer;
+  ota_control_format_version(slot->control.u32OtaCurrentworkingImagFirmwareVer,
+                             winc_version,
+                             sizeof(winc_version));
+  ota_control_format_version(
+      slot->version, image_version, sizeof(image_version));
+  SYS_CONSOLE_PRINT("WINC runs %s from 0x%lx; %s goes into 0x%lx\n",
+                    winc_version,
+                    slot->control.u32OtaCurrentWorkingImagOffset,
+                    image_version,
+                    slot->dst);
+  // Only the same version can already be running.
+  ctx->pass =
+      (slot->version == slot->control.u32OtaCurrentworkingImagFirmwareVer)
+          ? SLOT_PASS_CHECK
+          : SLOT_PASS_WRITE;
+  ctx->idx = 0;
+  sha256_init(&slot->sha);
+  return true;
 }
 
-bool winc_cloner_rebuild_pll(void) {
+static step_result_t slot_update_step(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+  slot_update_t *slot = &s_slot;
+  uint32_t offset = ctx->idx * FLASH_SECTOR_SZ;
+
+  if ((ctx->pass == SLOT_PASS_SWITCH) || (ctx->idx >= SLOT_SECTORS)) {
+    // end of a pass
+    switch (ctx->pass) {
+    case SLOT_PASS_CHECK:
+      SYS_CONSOLE_PRINT("\nWINC is already running %s", ctx->filename);
+      return STEP_DONE;
+
+    case SLOT_PASS_WRITE:
+      sha256_final(&slot->sha, slot->digest);
+      sha256_init(&slot->sha);
+      ctx->pass = SLOT_PASS_VERIFY;
+      ctx->idx = 0;
+      return STEP_CONTINUE;
+
+    case SLOT_PASS_VERIFY: {
+      uint8_t digest[SHA256_DIGEST_SIZE];
+      sha256_final(&slot->sha, digest);
+      if (memcmp(digest, slot->digest, SHA256_DIGEST_SIZE) != 0) {
+        SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                        "\nSlot at 0x%lx does not match %s: not switching",
+                        slot->dst,
+                        ctx->filename);
+        return STEP_ERROR;
+      }
+      ctx->pass = SLOT_PASS_SWITCH;
+      return STEP_CONTINUE;
+    }
 
-  if (!open_winc()) {
-    SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\nCould not open WINC");
-    return false;
+    case SLOT_PASS_SWITCH:
+      ota_control_switch(&slot->control, slot->version);
+      if (!write_control(&slot->control)) {
+        return STEP_ERROR;
+      }
+      SYS_CONSOLE_PRINT("\nWINC now boots from 0x%lx, with 0x%lx for rollback",
+                        slot->control.u32OtaCurrentWorkingImagOffset,
+                        slot->control.u32OtaRollbackImageOffset);
+      return STEP_DONE;
+    }
   }
+  if ((ctx->pass == SLOT_PASS_WRITE) && (ctx->idx == 0) &&
+      (slot->control.u32OtaRollbackImageValidStatus != OTA_STATUS_INVALID)) {
+    // The inactive slot is the rollback image: take it away from the boot
+    // firmware before it is part written.  write_control() uses s_xfer_buf.
+    ota_control_invalidate_rollback(&slot->control);
+    if (!write_control(&slot->control)) {
+      return STEP_ERROR;
+    }
+  }
+  ctx->idx += 1;
 
-  // fetch a copy of the PLL / GAIN tables
-  if (winc_sector_read(s_xfer_buf, M2M_PLL_FLASH_OFFSET) != SECTOR_OKAY) {
+  if ((ctx->pass != SLOT_PASS_VERIFY) &&
+      !image_read(
+          ctx->file_handle, s_xfer_buf, slot->src + offset, FLASH_SECTOR_SZ)) {
     SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
-                    "Could not read existing PLL / GAIN sector from WINC\r\n");
-    return false;
+                    "\nFailed to read %ld bytes from file",
+                    FLASH_SECTOR_SZ);
+    return STEP_ERROR;
   }
+  switch (ctx->pass) {
+  case SLOT_PASS_CHECK: {
+    uint32_t running = slot->control.u32OtaCurrentWorkingImagOffset;
+    if (winc_sector_read(s_xfer_buf2, running + offset) != SECTOR_OKAY) {
+      return STEP_ERROR;
+    }
+    if (!buffers_are_equal(s_xfer_buf, s_xfer_buf2, FLASH_SECTOR_SZ)) {
+      // not running this image after all: write the inactive slot
+      ctx->pass = SLOT_PASS_WRITE;
+      ctx->idx = 0;
+    }
+  } break;
 
-  dump_pll_data(s_xfer_buf, "before");
+  case SLOT_PASS_WRITE: {
+    uint32_t crc = sector_crc(s_xfer_buf);
+    uint16_t src_idx = (slot->src + offset) / FLASH_SECTOR_SZ;
+    if (s_has_manifest && ((src_idx >= s_manifest.n_sectors) ||
+                           (crc != s_manifest.sector_crc[src_idx]))) {
+      SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                      "\nImage does not match its manifest at 0x%lx",
+                      slot->src + offset);
+      return STEP_ERROR;
+    }
+    uint32_t t0 = op_stats_start();
+    sha256_update(&slot->sha, s_xfer_buf, FLASH_SECTOR_SZ);
+    op_stats_stop(OP_STATS_HASH, t0, FLASH_SECTOR_SZ);
+    sector_result_t res = winc_sector_write(s_xfer_buf, slot->dst + offset);
+    if ((res == SECTOR_ERROR) ||
+        ((res == SECTOR_DIFFER) &&
+         !winc_sector_verify(slot->dst + offset, crc))) {
+      return STEP_ERROR;
+    }
+    report_sector(res, FLASH_SECTOR_SZ);
+  } break;
 
-  // Read XO offset
-  if (read_efuse_struct(&efuseStruct, 0) != EFUSE_SUCCESS) {
-    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "Failed to read the efuse table\r\n");
-    return false;
+  case SLOT_PASS_VERIFY: {
+    if (winc_sector_read(s_xfer_buf2, slot->dst + offset) != SECTOR_OKAY) {
+      return STEP_ERROR;
+    }
+    uint32_t t0 = op_stats_start();
+    sha256_update(&slot->sha, s_xfer_buf2, FLASH_SECTOR_SZ);
+    op_stats_stop(OP_STATS_HASH, t0, FLASH_SECTOR_SZ);
+  } break;
+
+  case SLOT_PASS_SWITCH:
+    break; // handled above
   }
+  return STEP_CONTINUE;
+}
 
-  int32_t ret = 0;
-  // Overwrite the PLL section of in-RAM sector with newly computed PLL data.
-  ret = winc3400_pll_table_build(s_xfer_buf, efuseStruct.FreqOffset);
-  if (ret <= 0) {
-    SYS_DEBUG_PRINT(
-        SYS_ERROR_ERROR, "Failed to construct PLL table, err=%d\r\n", ret);
-    return false;
-  } else {
-    SYS_DEBUG_PRINT(SYS_ERROR_INFO,
-                    "Successfully constructed PLL table with size %d bytes\r\n",
-                    ret);
+static bool read_control(bool from_winc, tstrOtaControlSec *control) {
+  static const uint32_t addrs[] = {M2M_CONTROL_FLASH_OFFSET,
+                                   M2M_CONTROL_FLASH_BKP_OFFSET};
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+
+  for (size_t i = 0; i < sizeof(addrs) / sizeof(addrs[0]); i++) {
+    bool ok = from_winc
+                  ? (winc_sector_read(s_xfer_buf2, addrs[i]) == SECTOR_OKAY)
+                  : image_read(ctx->file_handle,
+                               s_xfer_buf2,
+                               addrs[i],
+                               FLASH_SECTOR_SZ);
+    memcpy(control, s_xfer_buf2, sizeof(*control));
+    if (ok && ota_control_is_valid(control)) {
+      return true;
+    }
   }
+  return false;
+}
 
-  dump_pll_data(s_xfer_buf, "after");
+static bool write_control(const tstrOtaControlSec *control) {
+  // Backup first: if power fails while the main copy is being rewritten, the
+  // boot firmware falls back to the backup, which is already switched.
+  static const uint32_t addrs[] = {M2M_CONTROL_FLASH_BKP_OFFSET,
+                                   M2M_CONTROL_FLASH_OFFSET};
+  uint32_t crc;
 
-  // Write the PLL / DATA sector to the WINC
-  sector_result_t res = winc_sector_write(s_xfer_buf, M2M_PLL_FLASH_OFFSET);
-  if (res == SECTOR_ERROR) {
-    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
-                    "Failed to write PLL / DATA sector to the WINC\r\n");
+  // The rest of the control sector is kept as it is on the WINC.
+  if (winc_sector_read(s_xfer_buf, M2M_CONTROL_FLASH_OFFSET) != SECTOR_OKAY) {
     return false;
-
-  } else if (res == SECTOR_EQUAL) {
-    SYS_DEBUG_PRINT(SYS_ERROR_INFO, "PLL / DATA sector up to date\r\n");
-
-  } else if (res == SECTOR_DIFFER) {
-    SYS_DEBUG_PRINT(SYS_ERROR_INFO, "PLL / DATA sector updated\r\n");
   }
-
+  memcpy(s_xfer_buf, control, sizeof(*control));
+  crc = sector_crc(s_xfer_buf);
+  for (size_t i = 0; i < sizeof(addrs) / sizeof(addrs[0]); i++) {
+    sector_result_t res = winc_sector_write(s_xfer_buf, addrs[i]);
+    if ((res == SECTOR_ERROR) ||
+        ((res == SECTOR_DIFFER) && !winc_sector_verify(addrs[i], crc))) {
+      return false;
+    }
+    report_sector(res, FLASH_SECTOR_SZ);
+  }
   return true;
 }
 
-// *****************************************************************************
-// Private (static) code
-
 static sector_result_t winc_sector_read(uint8_t *dst, uint32_t src_addr) {
   if ((src_addr % FLASH_SECTOR_SZ) != 0) {
     SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
@@ -288,7 +1957,10 @@ static sector_result_t winc_sector_read(uint8_t *dst, uint32_t src_addr) {
                     src_addr);
     return SECTOR_ERROR;
   }
+  TRACE1(TRACE_WINC_READ, src_addr);
+  uint32_t t0 = op_stats_start();
   uint8_t ret = spi_flash_read(dst, src_addr, FLASH_SECTOR_SZ);
+  op_stats_stop(OP_STATS_WINC_READ, t0, FLASH_SECTOR_SZ);
   if (ret != M2M_SUCCESS) {
     // WINC read failed.
     SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
@@ -310,7 +1982,10 @@ static sector_result_t winc_sector_write(uint8_t *src, uint32_t dst_addr) {
     return SECTOR_ERROR;
   }
 
+  TRACE1(TRACE_WINC_READ, dst_addr);
+  uint32_t t0 = op_stats_start();
   uint8_t ret = spi_flash_read(buf2, dst_addr, FLASH_SECTOR_SZ);
+  op_stats_stop(OP_STATS_WINC_READ, t0, FLASH_SECTOR_SZ);
   if (ret != M2M_SUCCESS) {
     SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
                     "\nFailed to read %ld WINC bytes at 0x%lx",
@@ -325,6 +2000,21 @@ static sector_result_t winc_sector_write(uint8_t *src, uint32_t dst_addr) {
   }
 
   // buffer differ: erase the sector and write from src
+  return winc_sector_program(src, dst_addr, 0);
+}
+
+static sector_result_t winc_sector_program(uint8_t *src,
+                                           uint32_t dst_addr,
+                                           uint16_t blank_pages) {
+  if ((dst_addr % FLASH_SECTOR_SZ) != 0) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\nAddress 0x%lx not aligned with FLASH_SECTOR_SZ",
+                    dst_addr);
+    return SECTOR_ERROR;
+  }
+
+  journal_mark_in_flight(dst_addr);
+  uint32_t t0 = op_stats_start();
   if (spi_flash_erase(dst_addr, FLASH_SECTOR_SZ) != M2M_SUCCESS) {
     // winc erase failed
     SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
@@ -333,172 +2023,606 @@ static sector_result_t winc_sector_write(uint8_t *src, uint32_t dst_addr) {
                     dst_addr);
     return SECTOR_ERROR;
   }
+  op_stats_stop(OP_STATS_WINC_ERASE, t0, FLASH_SECTOR_SZ);
+  op_stats_count(OP_STATS_SECTORS_ERASED, 1);
+
+  // Sector has been erased.  Now write the data, skipping blank pages.
+  return winc_pages_program(src, dst_addr, blank_pages);
+}
+
+static sector_result_t winc_pages_program(uint8_t *src,
+                                          uint32_t dst_addr,
+                                          uint16_t blank_pages) {
+  TRACE2(TRACE_WINC_PROGRAM, dst_addr, blank_pages);
+  for (uint32_t page = 0; page < IMAGE_PLAN_PAGES_PER_SECTOR; page++) {
+    uint32_t offset = page * FLASH_PAGE_SZ;
+    if (blank_pages & (1ul << page)) {
+      continue;
+    }
+    uint32_t t0 = op_stats_start();
+    if (spi_flash_write(&src[offset], dst_addr + offset, FLASH_PAGE_SZ) !=
+        M2M_SUCCESS) {
+      // winc write failed
+      SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                      "\nFailed to write %d WINC bytes at 0x%lx",
+                      FLASH_PAGE_SZ,
+                      dst_addr + offset);
+      return SECTOR_ERROR;
+    }
+    op_stats_stop(OP_STATS_WINC_PROGRAM, t0, FLASH_PAGE_SZ);
+    op_stats_count(OP_STATS_PAGES_PROGRAMMED, 1);
+  }
+  return SECTOR_DIFFER;
+}
+
+static bool winc_block_erase(uint32_t dst_addr) {
+  uint8_t busy = 1;
 
-  // Sector has been erased.  Now write the data.
-  if (spi_flash_write(src, dst_addr, FLASH_SECTOR_SZ) != M2M_SUCCESS) {
-    // winc write failed
+  // A resume restarts at the block and finds it erased: every sector differs.
+  journal_mark_in_flight(dst_addr);
+  uint32_t t0 = op_stats_start();
+  int8_t err = spi_flash_erase_block_start(dst_addr);
+  while ((err == M2M_SUCCESS) && busy) {
+    err = spi_flash_is_busy(&busy);
+  }
+  if (err != M2M_SUCCESS) {
     SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
-                    "\nFailed to write %ld WINC bytes at 0x%lx",
-                    FLASH_SECTOR_SZ,
+                    "\nFailed to erase %ld WINC bytes at 0x%lx",
+                    FLASH_BLOCK_SIZE,
                     dst_addr);
-    return SECTOR_ERROR;
+    return false;
   }
-  return SECTOR_DIFFER;
+  op_stats_stop(OP_STATS_WINC_ERASE, t0, FLASH_BLOCK_SIZE);
+  op_stats_count(OP_STATS_SECTORS_ERASED, IMAGE_PLAN_SECTORS_PER_BLOCK);
+  return true;
 }
 
-static bool cloner_aux(const char *filename,
-                       SYS_FS_FILE_OPEN_ATTRIBUTES file_mode,
-                       bool (*inner_loop)(SYS_FS_HANDLE file_handle,
-                                          size_t n_bytes)) {
-  SYS_FS_HANDLE file_handle;
-  size_t n_bytes;
-  uint8_t ret;
+static bool finish_update(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
 
-  if (!open_winc()) {
-    SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\nCould not open WINC");
+  // A resumed, partial or up-to-date update did not stream the whole image,
+  // so its manifest is incomplete.  Resumed sectors were verified when
+  // written.
+  if ((ctx->op == &s_update_op) && (ctx->resume_addr == 0) &&
+      (ctx->regions == FLASH_REGION_SET_ALL) && !ctx->is_current) {
+    if (!finish_manifest()) {
+      return false;
+    }
+    s_manifest = s_builder.manifest;
+    s_has_manifest = true;
+  }
+  update_journal_clear();
+  if (!ctx->is_current) {
+    // An up-to-date WINC had only its samples read: its other sectors are
+    // not known to match the image.
+    record_device();
+  }
+  return finish_boot_check();
+}
+
+static bool finish_stream_update(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+
+  update_journal_clear();
+  ctx->image_version = s_builder.manifest.fw_version;
+  if (ctx->boot_check && (ctx->image_version == 0)) {
+    SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR,
+                      "\nNo valid control sector was streamed: "
+                      "cannot boot check");
     return false;
   }
+  return finish_boot_check();
+}
+
+static bool finish_slot_update(void) {
+  update_journal_clear();
+  return finish_boot_check();
+}
+
+static bool finish_apply_delta(void) {
+  update_journal_clear();
+  return true;
+}
+
+static void revisit_begin(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+
+  // A WINC with no record, or one written from another image or for fewer
+  // regions, is checked as usual.
+  ctx->revisit = ctx->quick_check && (ctx->resume_addr == 0) &&
+                 s_winc_has_mac && !is_image_cache(ctx->filename) &&
+                 device_record_read(s_winc_mac, &s_record) &&
+                 device_record_is_for_image(&s_record, ctx->filename) &&
+                 ((ctx->regions & ~s_record.regions) == 0);
+  if (ctx->revisit) {
+    SYS_CONSOLE_PRINT("\nWINC %02x:%02x:%02x:%02x:%02x:%02x was last updated "
+                      "from %s: spot checking its unchanging regions",
+                      s_winc_mac[0],
+                      s_winc_mac[1],
+                      s_winc_mac[2],
+                      s_winc_mac[3],
+                      s_winc_mac[4],
+                      s_winc_mac[5],
+                      ctx->filename);
+  }
+}
 
-  n_bytes = spi_flash_get_size() << 17; // convert megabits to bytes
+static void record_device(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+  uint16_t n_sectors;
+  uint32_t t0;
+  bool ok;
+
+  // A revisit read only samples of the unchanging regions (its record still
+  // holds), and a resumed update cannot tell whether the interrupted pass
+  // below resume_addr was a revisit.
+  if (!s_winc_has_mac || is_image_cache(ctx->filename) || ctx->revisit ||
+      (ctx->resume_addr != 0)) {
+    return;
+  }
+  if (ctx->op == &s_planned_update_op) {
+    n_sectors = s_plan.n_sectors;
+  } else if (s_has_manifest) {
+    n_sectors = s_manifest.n_sectors;
+  } else {
+    // Without the image's sector CRCs there is nothing to record.
+    forget_device();
+    return;
+  }
+  if (!device_record_init(&s_record, s_winc_mac, ctx->filename, ctx->regions)) {
+    forget_device();
+    return;
+  }
+  s_record.n_sectors = n_sectors;
+  for (uint16_t idx = 0; idx < n_sectors; idx++) {
+    s_record.sector_crc[idx] = (ctx->op == &s_planned_update_op)
+                                   ? s_plan.sectors[idx].crc
+                                   : s_manifest.sector_crc[idx];
+  }
+  t0 = op_stats_start();
+  ok = device_record_write(&s_record);
+  op_stats_stop(OP_STATS_SD_WRITE, t0, sizeof(s_record));
+  if (!ok) {
+    SYS_DEBUG_MESSAGE(SYS_ERROR_WARNING, "\nCould not write device record");
+    forget_device();
+  }
+}
 
-  file_handle = SYS_FS_FileOpen(filename, file_mode);
-  if (file_handle == SYS_FS_HANDLE_INVALID) {
-    // Could not open file
-    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nCould not open file %s", filename);
+static void forget_device(void) {
+  if (s_winc_has_mac) {
+    device_record_remove(s_winc_mac);
+  }
+}
+
+static bool boot_check_begin(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+  tstrOtaControlSec control;
+
+  if (!ctx->boot_check) {
+    return true;
+  }
+  if (s_has_manifest && (s_manifest.fw_version != 0)) {
+    ctx->image_version = s_manifest.fw_version;
+  } else if (read_control(false, &control)) {
+    // The manifest has yet to be built.
+    ctx->image_version = control.u32OtaCurrentworkingImagFirmwareVer;
+  } else {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\n%s has no valid control sector: cannot boot check",
+                    ctx->filename);
     return false;
   }
-  SYS_CONSOLE_MESSAGE("\n");
-  ret = inner_loop(file_handle, n_bytes);
-  SYS_FS_FileClose(file_handle); // assure that the file is closed
+  return true;
+}
 
-  return ret;
+static bool finish_boot_check(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+  bool ok;
+
+  if (!ctx->boot_check) {
+    return true;
+  }
+  ok = winc_boot_check(ctx->image_version);
+  // Reset the WINC back into download mode, as it was before the boot.
+  winc_cloner_close_winc();
+  return open_winc() && ok;
 }
 
-static bool extract_loop(SYS_FS_HANDLE file_handle, size_t n_bytes) {
-  uint32_t src_addr = 0;
+static void quick_check_begin(uint32_t end_addr) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
 
-  while (n_bytes > 0) {
-    size_t to_xfer = n_bytes;
-    if (to_xfer > FLASH_SECTOR_SZ) {
-      to_xfer = FLASH_SECTOR_SZ;
-    }
-    if (winc_sector_read(s_xfer_buf, src_addr) != SECTOR_OKAY) {
-      SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
-                      "\nFailed to read %ld bytes at 0x%ld from WINC",
-                      to_xfer,
-                      src_addr);
-      return false;
+  // An interrupted update is known not to be current.
+  ctx->quick_check = ctx->quick_check && (ctx->resume_addr == 0);
+  ctx->sample_addr = 0;
+  ctx->sample_end = end_addr;
+}
+
+static step_result_t quick_check_step(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+  uint32_t addr;
+  uint32_t crc;
+
+  while ((ctx->sample_addr < ctx->sample_end) &&
+         !is_sample_sector(ctx->sample_addr)) {
+    ctx->sample_addr += FLASH_SECTOR_SZ;
+  }
+  if ((ctx->sample_addr >= ctx->sample_end) && ctx->revisit) {
+    // The unchanging regions are as recorded: check the rest in full.
+    SYS_CONSOLE_PRINT("\nWINC matches %s in %u sampled sectors: checking the "
+                      "regions that change in the field",
+                      ctx->filename,
+                      ctx->n_sampled);
+    ctx->quick_check = false;
+    ctx->regions &= FLASH_REGION_SET_MUTABLE;
+    return STEP_CONTINUE;
+  }
+  if (ctx->sample_addr >= ctx->sample_end) {
+    // Every sample matched: take the WINC to be current.
+    uint32_t ver = ctx->winc_version;
+    SYS_CONSOLE_PRINT("\nWINC firmware %d.%d.%d matches %s in %u sampled "
+                      "sectors: already up to date",
+                      M2M_GET_FW_MAJOR(ver),
+                      M2M_GET_FW_MINOR(ver),
+                      M2M_GET_FW_PATCH(ver),
+                      ctx->filename,
+                      ctx->n_sampled);
+    ctx->quick_check = false;
+    ctx->is_current = true;
+    return STEP_DONE;
+  }
+  addr = ctx->sample_addr;
+  ctx->sample_addr += FLASH_SECTOR_SZ;
+
+  if (!image_sector_crc(addr, &crc) ||
+      (winc_sector_read(s_xfer_buf2, addr) != SECTOR_OKAY)) {
+    return STEP_ERROR;
+  }
+  ctx->n_sampled += 1;
+  ctx->n_done += FLASH_SECTOR_SZ;
+  if (addr == M2M_CONTROL_FLASH_OFFSET) {
+    // The version that the firmware would report, read without booting it.
+    const tstrOtaControlSec *control = (const tstrOtaControlSec *)s_xfer_buf2;
+    if (control->u32OtaMagicValue == OTA_MAGIC_VALUE) {
+      ctx->winc_version = control->u32OtaCurrentworkingImagFirmwareVer;
     }
-    if (SYS_FS_FileWrite(file_handle, s_xfer_buf, to_xfer) < 0) {
-      // file write failed
-      SYS_DEBUG_PRINT(
-          SYS_ERROR_ERROR, "\nFailed to write %ld bytes to file", to_xfer);
-      return false;
+  }
+  if (sector_crc(s_xfer_buf2) != crc) {
+    SYS_CONSOLE_PRINT("\nWINC differs from %s at 0x%lx: checking every sector",
+                      ctx->filename,
+                      addr);
+    ctx->quick_check = false;
+    if (ctx->revisit) {
+      // The record is no longer to be trusted.
+      ctx->revisit = false;
+      forget_device();
     }
-    n_bytes -= to_xfer;
-    src_addr += to_xfer;
-    SYS_DEBUG_PRINT(SYS_ERROR_INFO, ".");
   }
-  // success
+  return STEP_CONTINUE;
+}
+
+static bool is_sample_sector(uint32_t addr) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+  flash_region_id_t id = flash_region_find(addr);
+
+  // PLL tables differ from WINC to WINC, and volatile regions from day to day.
+  // A revisited WINC has its changing regions checked in full instead.
+  if (!flash_region_set_contains(ctx->regions, addr) ||
+      (id == FLASH_REGION_PLL_GAIN) ||
+      ((FLASH_REGION_SET_VOLATILE & FLASH_REGION_BIT(id)) != 0) ||
+      (ctx->revisit &&
+       ((FLASH_REGION_SET_MUTABLE & FLASH_REGION_BIT(id)) != 0))) {
+    return false;
+  }
+  return (id == FLASH_REGION_CONTROL) || (addr == 0) ||
+         (flash_region_find(addr - FLASH_SECTOR_SZ) != id) ||
+         ((addr / FLASH_SECTOR_SZ) % ctx->sample_stride == 0);
+}
+
+static bool image_sector_crc(uint32_t addr, uint32_t *crc) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+  uint16_t idx = addr / FLASH_SECTOR_SZ;
+
+  if (ctx->op == &s_planned_update_op) {
+    *crc = s_plan.sectors[idx].crc;
+    return true;
+  }
+  if (ctx->revisit && (idx < s_record.n_sectors)) {
+    *crc = s_record.sector_crc[idx];
+    return true;
+  }
+  if (s_has_manifest && (idx < s_manifest.n_sectors)) {
+    *crc = s_manifest.sector_crc[idx];
+    return true;
+  }
+  if (!image_read(ctx->file_handle, s_xfer_buf, addr, FLASH_SECTOR_SZ)) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\nFailed to read %ld bytes from file",
+                    FLASH_SECTOR_SZ);
+    return false;
+  }
+  *crc = sector_crc(s_xfer_buf);
   return true;
 }
 
-static bool update_loop(SYS_FS_HANDLE file_handle, size_t n_bytes) {
-  uint32_t dst_addr = 0;
-  sector_result_t res;
+static bool journal_begin(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+  update_journal_t prev;
+  bool has_prev = update_journal_read(&prev);
 
-  while (n_bytes > 0) {
-    size_t to_xfer = n_bytes;
-    if (to_xfer > FLASH_SECTOR_SZ) {
-      to_xfer = FLASH_SECTOR_SZ;
+  if (is_image_cache(ctx->filename) ||
+      !update_journal_init(&s_journal, ctx->filename, ctx->regions)) {
+    // updates from the image cache are not journaled
+    if (has_prev) {
+      check_dirty_journal(&prev);
     }
-    // Read a sector of data from the file and from the WINC.  If they differ,
-    // erase the sector and write the file data to the WINC.
-    if (SYS_FS_FileRead(file_handle, s_xfer_buf, to_xfer) < 0) {
-      // file read failed.
-      SYS_DEBUG_PRINT(
-          SYS_ERROR_ERROR, "\nFailed to read %ld bytes from file", to_xfer);
-      return false;
+    return !ctx->resume_only;
+  }
+  if (has_prev && update_journal_matches(&prev, &s_journal) &&
+      (prev.committed_addr % FLASH_SECTOR_SZ == 0) &&
+      (prev.committed_addr < ctx->n_bytes)) {
+    ctx->resume_addr = prev.committed_addr;
+    SYS_CONSOLE_PRINT("\nResuming at 0x%lx: %lu sectors already written",
+                      ctx->resume_addr,
+                      ctx->resume_addr / FLASH_SECTOR_SZ);
+    if (prev.in_flight_addr != UPDATE_JOURNAL_NONE) {
+      SYS_CONSOLE_PRINT(", re-verifying 0x%lx", prev.in_flight_addr);
     }
+    SYS_CONSOLE_MESSAGE("\n");
+  } else if (ctx->resume_only) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\nNot the WINC or image of the interrupted update: "
+                    "use u to update from %s",
+                    ctx->filename);
+    return false;
+  } else if (has_prev) {
+    check_dirty_journal(&prev);
+  }
+  s_journal.committed_addr = ctx->resume_addr;
+  if (has_prev && update_journal_is_dirty(&prev)) {
+    // Stay dirty until this update has written or checked a sector.
+    s_journal.in_flight_addr = 0;
+  }
+  s_journal_is_active = true;
+  journal_write();
+  return true;
+}
 
-    if ((dst_addr >= M2M_PLL_FLASH_OFFSET) &&
-        (dst_addr < M2M_PLL_FLASH_OFFSET + M2M_CONFIG_SECT_TOTAL_SZ)) {
-      // do not overwrite PLL and GAIN settings: see spi_flash_map.h
-      res = SECTOR_SKIPPED;
-    } else {
-      res = winc_sector_write(s_xfer_buf, dst_addr);
-    }
+static void check_dirty_journal(const update_journal_t *prev) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
 
-    if (res == SECTOR_ERROR) {
-      SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
-                      "\nFailed to write %ld bytes at address 0x%ld to WINC",
-                      to_xfer,
-                      dst_addr);
-      return false;
+  if (ctx->quick_check && update_journal_is_dirty(prev)) {
+    SYS_CONSOLE_PRINT("\nWINC was left part written from %.*s: checking "
+                      "every sector",
+                      IMAGE_MANIFEST_NAME_LEN,
+                      prev->image_name);
+    ctx->quick_check = false;
+  }
+}
 
-    } else if (res == SECTOR_EQUAL) {
-      SYS_CONSOLE_MESSAGE("=");
+static void journal_mark_writing(void) {
+  uint32_t t0 = op_stats_start();
 
-    } else if (res == SECTOR_DIFFER) {
-      SYS_CONSOLE_MESSAGE("!");
+  update_journal_mark_writing(s_winc_cloner_ctx.filename, false);
+  op_stats_stop(OP_STATS_SD_WRITE, t0, sizeof(update_journal_t));
+}
 
-    } else if (res == SECTOR_SKIPPED) {
-      SYS_CONSOLE_MESSAGE("x");
-    }
+static void journal_mark_in_flight(uint32_t addr) {
+  if (s_journal_is_active) {
+    s_journal.committed_addr = addr;
+    s_journal.in_flight_addr = addr;
+    journal_write();
+  }
+}
 
-    // advance to next sector
-    n_bytes -= to_xfer;
-    dst_addr += to_xfer;
+static void journal_commit(uint32_t next_addr) {
+  if (!s_journal_is_active) {
+    return;
+  }
+  s_journal.committed_addr = next_addr;
+  s_journal.in_flight_addr = UPDATE_JOURNAL_NONE;
+  // A sector that was written needs no checkpoint of its own: if power
+  // fails, the in-flight record makes the resumed update re-verify it.
+  if ((next_addr / FLASH_SECTOR_SZ) % JOURNAL_INTERVAL == 0) {
+    journal_write();
   }
-  // success
-  return true;
 }
 
-static bool compare_loop(SYS_FS_HANDLE file_handle, size_t n_bytes) {
-  uint32_t dst_addr = 0;
+static void journal_write(void) {
+  uint32_t t0 = op_stats_start();
 
-  while (n_bytes > 0) {
-    size_t to_xfer = n_bytes;
-    if (to_xfer > FLASH_SECTOR_SZ) {
-      to_xfer = FLASH_SECTOR_SZ;
-    }
+  if (!update_journal_write(&s_journal)) {
+    // Carry on without it, and make sure a stale journal cannot be resumed.
+    s_journal_is_active = false;
+    update_journal_clear();
+  }
+  op_stats_stop(OP_STATS_SD_WRITE, t0, sizeof(s_journal));
+}
 
-    // Read a sector of data from the file and from the WINC and compare them.
-    if (SYS_FS_FileRead(file_handle, s_xfer_buf, to_xfer) < 0) {
-      // file read failed.
-      SYS_DEBUG_PRINT(
-          SYS_ERROR_ERROR, "\nFailed to read %ld bytes from file", to_xfer);
-      return false;
-    }
-    if (winc_sector_read(s_xfer_buf2, dst_addr) != SECTOR_OKAY) {
-      SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
-                      "\nFailed to read %ld bytes at 0x%lx from WINC",
-                      to_xfer,
-                      dst_addr);
-      return false;
-    }
-    if (buffers_are_equal(s_xfer_buf, s_xfer_buf2, to_xfer)) {
-      // buffers are identical
-      SYS_CONSOLE_MESSAGE("=");
-    } else {
-      // buffers differ
-      SYS_CONSOLE_MESSAGE("!");
-    }
-    // advance to next sector
-    n_bytes -= to_xfer;
-    dst_addr += to_xfer;
+static bool is_pll_sector(uint32_t addr) {
+  return flash_region_find(addr) == FLASH_REGION_PLL_GAIN;
+}
+
+static bool is_selected(uint32_t addr) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+
+  // Of a revisited WINC's unchanging regions, only the samples are read.
+  return flash_region_set_contains(ctx->regions, addr) &&
+         (!ctx->revisit ||
+          ((FLASH_REGION_SET_MUTABLE &
+            FLASH_REGION_BIT(flash_region_find(addr))) != 0) ||
+          is_sample_sector(addr));
+}
+
+static void skip_unselected(void) {
+  winc_cloner_ctx_t *ctx = &s_winc_cloner_ctx;
+
+  while ((ctx->n_bytes > 0) && !is_selected(ctx->addr)) {
+    size_t n_skip = (ctx->n_bytes < FLASH_SECTOR_SZ) ? ctx->n_bytes
+                                                      : FLASH_SECTOR_SZ;
+    ctx->n_bytes -= n_skip;
+    ctx->addr += n_skip;
+  }
+}
+
+static void report_sector(sector_result_t res, size_t n_bytes) {
+  uint32_t t0 = op_stats_start();
+
+  switch (res) {
+  case SECTOR_OKAY:
+    SYS_CONSOLE_MESSAGE(".");
+    break;
+  case SECTOR_EQUAL:
+    SYS_CONSOLE_MESSAGE("=");
+    op_stats_count(OP_STATS_SECTORS_EQUAL, 1);
+    break;
+  case SECTOR_DIFFER:
+    SYS_CONSOLE_MESSAGE("!");
+    op_stats_count(OP_STATS_SECTORS_DIFFER, 1);
+    break;
+  case SECTOR_SKIPPED:
+    SYS_CONSOLE_MESSAGE("x");
+    op_stats_count(OP_STATS_SECTORS_SKIPPED, 1);
+    break;
+  case SECTOR_ERROR:
+    break;
+  }
+  op_stats_stop(OP_STATS_CONSOLE, t0, 1);
+  op_stats_count(OP_STATS_SECTORS, 1);
+  s_winc_cloner_ctx.n_done += n_bytes;
+  TRACE2(TRACE_SECTOR_DONE, res, s_winc_cloner_ctx.n_done);
+}
+
+static uint32_t sector_crc(const uint8_t *buf) {
+  uint32_t t0 = op_stats_start();
+  uint32_t crc = crc32_compute(buf, FLASH_SECTOR_SZ);
+  op_stats_stop(OP_STATS_HASH, t0, FLASH_SECTOR_SZ);
+  return crc;
+}
+
+static bool winc_sector_verify(uint32_t addr, uint32_t crc) {
+  if (winc_sector_read(s_xfer_buf2, addr) != SECTOR_OKAY) {
+    return false;
+  }
+  if (sector_crc(s_xfer_buf2) != crc) {
+    SYS_DEBUG_PRINT(
+        SYS_ERROR_ERROR, "\nVerify failed for sector at 0x%lx", addr);
+    return false;
+  }
+  return true;
+}
+
+static bool finish_manifest(void) {
+  image_manifest_t *manifest = &s_builder.manifest;
+
+  image_manifest_builder_finish(&s_builder);
+  if (!s_has_manifest) {
+    image_manifest_print_digest(manifest);
+    return image_manifest_write(manifest);
+  }
+  if ((manifest->n_sectors != s_manifest.n_sectors) ||
+      (memcmp(manifest->sha256, s_manifest.sha256, SHA256_DIGEST_SIZE) != 0)) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\n%s does not match its manifest",
+                    manifest->image_name);
+    return false;
   }
-  // success
+  image_manifest_print_digest(manifest);
   return true;
 }
 
+static bool is_image_cache(const char *filename) {
+  return strcmp(filename, IMAGE_CACHE_NAME) == 0;
+}
+
+static bool is_uart_stream(const char *filename) {
+  return strcmp(filename, UART_STREAM_NAME) == 0;
+}
+
+static bool image_read(SYS_FS_HANDLE file_handle,
+                       uint8_t *dst,
+                       uint32_t addr,
+                       size_t n_bytes) {
+  uint32_t t0 = op_stats_start();
+  bool ret;
+
+  TRACE2(TRACE_SD_READ, addr, n_bytes);
+  // Reads from the image cache and the UART stream are charged to SD read
+  // too.
+  if (is_uart_stream(s_winc_cloner_ctx.filename)) {
+    ret = uart_stream_read(dst, addr, n_bytes);
+  } else if (file_handle == SYS_FS_HANDLE_INVALID) {
+    ret = image_cache_read(dst, addr, n_bytes);
+  } else {
+    ret = ((SYS_FS_FileTell(file_handle) == (int32_t)addr) ||
+           (SYS_FS_FileSeek(file_handle, addr, SYS_FS_SEEK_SET) ==
+            (int32_t)addr)) &&
+          (SYS_FS_FileRead(file_handle, dst, n_bytes) == n_bytes);
+  }
+  op_stats_stop(OP_STATS_SD_READ, t0, n_bytes);
+  return ret;
+}
+
+static int32_t image_size(SYS_FS_HANDLE file_handle) {
+  if (file_handle == SYS_FS_HANDLE_INVALID) {
+    return image_cache_image_size();
+  }
+  return SYS_FS_FileSize(file_handle);
+}
+
+static bool load_plan(const char *filename) {
+  SYS_FS_HANDLE plan_handle;
+  uint32_t size;
+  uint32_t stamp;
+  bool ret;
+
+  if (is_image_cache(filename)) {
+    // The cache carries its own per-sector CRCs and blank page masks.
+    snprintf(s_plan_name, sizeof(s_plan_name), "%s", IMAGE_CACHE_NAME);
+    return image_cache_get_plan(&s_plan);
+  }
+
+  snprintf(
+      s_plan_name, sizeof(s_plan_name), "%s%s", filename, IMAGE_PLAN_SUFFIX);
+  plan_handle = SYS_FS_FileOpen(s_plan_name, SYS_FS_FILE_OPEN_READ);
+  if (plan_handle == SYS_FS_HANDLE_INVALID) {
+    // no plan: not an error
+    return false;
+  }
+  ret = (SYS_FS_FileRead(plan_handle, &s_plan, sizeof(s_plan)) ==
+         sizeof(s_plan)) &&
+        (s_plan.magic == IMAGE_PLAN_MAGIC) &&
+        (s_plan.version == IMAGE_PLAN_VERSION) &&
+        (s_plan.n_sectors <= IMAGE_PLAN_MAX_SECTORS) &&
+        (s_plan.image_size == s_plan.n_sectors * FLASH_SECTOR_SZ) &&
+        image_plan_layout_is_valid(&s_plan);
+  SYS_FS_FileClose(plan_handle);
+
+  if (!ret) {
+    SYS_DEBUG_PRINT(
+        SYS_ERROR_WARNING, "\nIgnoring invalid plan %s", s_plan_name);
+  } else if (!image_manifest_stamp(filename, &size, &stamp) ||
+             (size != s_plan.image_size) || (stamp != s_plan.image_stamp)) {
+    // the image was replaced after the plan was built
+    SYS_DEBUG_PRINT(SYS_ERROR_WARNING,
+                    "\nIgnoring out of date plan %s: rebuild it",
+                    s_plan_name);
+    ret = false;
+  }
+  return ret;
+}
+
 static bool buffers_are_equal(uint8_t *buf_a, uint8_t *buf_b, size_t n_bytes) {
+  uint32_t t0 = op_stats_start();
+  bool ret = true;
+
   for (size_t i = 0; i < n_bytes; i++) {
     if (buf_a[i] != buf_b[i]) {
-      return false;
+      ret = false;
+      break;
     }
   }
-  return true;
+  op_stats_stop(OP_STATS_COMPARE, t0, n_bytes);
+  return ret;
 }
 
 static int32_t winc3400_pll_table_build(uint8_t *pBuffer, uint32_t freqOffset) {
@@ -609,8 +2733,13 @@ static bool open_winc(void) {
       SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\nCould not access WINC");
       s_winc_is_opened = true;
     } else {
+      uint8_t mac_is_valid = 0;
       SYS_DEBUG_MESSAGE(SYS_ERROR_INFO, "\nWINC opened");
       s_winc_is_opened = true;
+      s_winc_has_mac =
+          (nmi_get_otp_mac_address(s_winc_mac, &mac_is_valid) ==
+           M2M_SUCCESS) &&
+          mac_is_valid;
     }
   }
   return s_winc_is_opened;
@@ -26,6 +26,13 @@
 
 /**
  * @brief winc_cloner extracts, updates, or compares a WINC1500 flash image.
+ *
+ * Operations are started by winc_cloner_extract(), winc_cloner_update(),
+ * winc_cloner_compare(), winc_cloner_apply_delta(), winc_cloner_slot_update()
+ * or winc_cloner_stream_update() and carried out by winc_cloner_step(), which
+ * processes (at most) one sector per call so that the rest of the system keeps
+ * running.  An operation in progress may be
+ * paused, resumed or cancelled.
  */
 
 #ifndef _WINC_CLONER_H_
@@ -34,7 +41,9 @@
 // *****************************************************************************
 // Includes
 
+#include "flash_regions.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 // *****************************************************************************
 // C++ compatibility
@@ -46,6 +55,11 @@ extern "C" {
 // *****************************************************************************
 // Public types and definitions
 
+/**
+ * @brief Signature for the callback function.
+ */
+typedef void (*winc_cloner_callback_fn)(uintptr_t arg);
+
 // *****************************************************************************
 // Public declarations
 
@@ -55,36 +69,218 @@ extern "C" {
 void winc_cloner_init(void);
 
 /**
- * @brief Extract the entire contents of the WINC firmware image into a file.
+ * @brief Step the winc_cloner internal state.  Called frequently.
+ */
+void winc_cloner_step(void);
+
+/**
+ * @brief Set a callback to be triggered when an operation completes.
+ */
+void winc_cloner_set_callback(winc_cloner_callback_fn callback_fn,
+                              uintptr_t callback_arg);
+
+/**
+ * @brief Start extracting the entire contents of the WINC firmware image into
+ * a file.
  *
- * @return true on success
+ * @return true if the operation was started.
  */
 bool winc_cloner_extract(const char *filename);
 
 /**
- * @brief Update the contents of the WINC firmware image from a file.
+ * @brief Start updating the contents of the WINC firmware image from a file.
+ *
+ * Unless winc_cloner_set_quick_check() turned it off, the update starts by
+ * comparing a sample of sectors (the control sectors among them) with the
+ * image's manifest, plan or file.  If they all match, the WINC is taken to be
+ * up to date and nothing more is read or written.  There is no quick check of
+ * a WINC that an earlier operation left part written (see update_journal.h).
  *
  * Note: winc_cloner_update() does not touch the PLL and GAIN tables.
  *
- * @return true on success
+ * @return true if the operation was started.
  */
 bool winc_cloner_update(const char *filename);
 
 /**
- * @brief Compare the entire contents of the WINC firmware image with a file.
+ * @brief If an update was interrupted (by a power failure, say), start it
+ * again from the first sector that it had not finished.  Fails if the WINC is
+ * not the one that was being updated.
+ *
+ * Note: winc_cloner_update() resumes on its own when it finds that the same
+ * image was being written to the same WINC.
+ *
+ * @return true if the operation was started.
+ */
+bool winc_cloner_resume_update(void);
+
+/**
+ * @brief Start comparing the entire contents of the WINC firmware image with
+ * a file.
  *
- * @return true on if the WINC firmware is identical to the file contents.
+ * @return true if the operation was started.
  */
 bool winc_cloner_compare(const char *filename);
 
+/**
+ * @brief Start applying a sector-delta file (see delta_image.h) to the WINC.
+ *
+ * Only the sectors recorded in the delta are read from the file and from the
+ * WINC, and each is first checked against the base image CRC.  Like
+ * winc_cloner_update(), this does not touch the PLL and GAIN tables.
+ *
+ * @return true if the operation was started.
+ */
+bool winc_cloner_apply_delta(const char *filename);
+
+/**
+ * @brief Start writing the firmware of an image into the WINC's inactive OTA
+ * slot, leaving the running slot untouched.  The slot is first taken away
+ * from the boot firmware as a rollback image.  Once the whole slot reads back
+ * with the image's SHA-256 digest, the control sector is rewritten to boot
+ * from it, with the old slot kept for rollback.
+ *
+ * Only the OTA slot and the control sector are written; the boot firmware,
+ * certificates and other regions are left as they are.  If the update is
+ * interrupted, the WINC still boots its old firmware.
+ *
+ * @return true if the operation was started.
+ */
+bool winc_cloner_slot_update(const char *filename);
+
+/**
+ * @brief Start updating the WINC from the image that the host is streaming
+ * over the console UART (see uart_stream.h), once uart_stream_is_started().
+ *
+ * The stream runs through the same pipeline as winc_cloner_update(), but it
+ * can only be read once and in order, so there is no quick check, manifest
+ * or device record, and it cannot be resumed.
+ *
+ * @return true if the operation was started.
+ */
+bool winc_cloner_stream_update(void);
+
+/**
+ * @brief Pause the operation in progress after the current sector.
+ */
+void winc_cloner_pause(void);
+
+/**
+ * @brief Resume a paused operation.
+ */
+void winc_cloner_resume(void);
+
+/**
+ * @brief Cancel the operation in progress after the current sector.
+ *
+ * Note: a cancelled update leaves the WINC partially updated.
+ */
+void winc_cloner_cancel(void);
+
+/**
+ * @brief Return true if an operation is in progress (including paused).
+ */
+bool winc_cloner_is_busy(void);
+
+/**
+ * @brief Return true if the operation in progress is paused.
+ */
+bool winc_cloner_is_paused(void);
+
+/**
+ * @brief Return true if the last operation completed successfully.
+ */
+bool winc_cloner_is_complete(void);
+
+/**
+ * @brief Return true if the last operation failed or was cancelled.
+ */
+bool winc_cloner_has_error(void);
+
 /**
  * @brief Rebuild the PLL tables.  Required if gain table have changed, or if
  * the PLL tables were clobbered by winc-cloner v 0.0.3 or earlier.
  *
+ * Note: unlike the operations above, this completes before returning.
+ *
  * @return true on success
  */
 bool winc_cloner_rebuild_pll(void);
 
+/**
+ * @brief Put the WINC into download mode so that its flash can be accessed
+ * directly.  Does nothing if already done.  Return false on failure.
+ */
+bool winc_cloner_open_winc(void);
+
+/**
+ * @brief Forget that the WINC is in download mode, and what was learned about
+ * it, so that the next operation opens it afresh.  Call when the WINC may have
+ * been swapped for another.
+ */
+void winc_cloner_close_winc(void);
+
+/**
+ * @brief Return the number of sectors that the last compare found to differ,
+ * not counting the PLL and GAIN tables.
+ */
+uint16_t winc_cloner_differ_count(void);
+
+/**
+ * @brief Select the regions of WINC flash that extract, update and compare
+ * work on: FLASH_REGION_SET_ALL to begin with.  Extract writes unselected
+ * sectors to the file as erased (0xff), so the file keeps the layout of the
+ * WINC.  Unless regions have been selected, compare skips
+ * FLASH_REGION_SET_VOLATILE.
+ */
+void winc_cloner_set_regions(flash_region_set_t regions);
+
+/**
+ * @brief Return the regions selected by winc_cloner_set_regions().
+ */
+flash_region_set_t winc_cloner_get_regions(void);
+
+/**
+ * @brief Enable (the default) or disable the quick check that
+ * winc_cloner_update() makes before comparing every sector.  Disable it to
+ * force the full pass, e.g. on a WINC whose flash may have been corrupted.
+ * The setting is taken when an update starts.
+ */
+void winc_cloner_set_quick_check(bool enabled);
+
+/**
+ * @brief Return the setting made by winc_cloner_set_quick_check().
+ */
+bool winc_cloner_get_quick_check(void);
+
+/**
+ * @brief Set how sparsely the quick check samples: every stride'th sector
+ * (32 by default, or if stride is 0), besides the control sectors and the
+ * first sector of each region.  A smaller stride catches more damage at the
+ * cost of time.  The setting is taken when an update starts.
+ */
+void winc_cloner_set_quick_check_stride(uint16_t stride);
+
+/**
+ * @brief Return the setting made by winc_cloner_set_quick_check_stride().
+ */
+uint16_t winc_cloner_get_quick_check_stride(void);
+
+/**
+ * @brief Enable or disable (the default) the boot check.  With it on,
+ * winc_cloner_update() and winc_cloner_slot_update() end by booting the WINC
+ * and checking that its firmware reports the version recorded in the image's
+ * manifest (see winc_boot.h).  Every sector that an update writes is already
+ * read back and checked, so a passing boot check stands in for a separate
+ * winc_cloner_compare() pass.  The setting is taken when an update starts.
+ */
+void winc_cloner_set_boot_check(bool enabled);
+
+/**
+ * @brief Return the setting made by winc_cloner_set_boot_check().
+ */
+bool winc_cloner_get_boot_check(void);
+
 // *****************************************************************************
 // End of file
 
@@ -0,0 +1,570 @@
+/**
+ * @file winc_gang.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "winc_gang.h"
+
+#include "crc32.h"
+#include "definitions.h"
+#include "image_manifest.h"
+#include "image_plan.h"
+#include "op_stats.h"
+#include "spi_flash.h"
+#include "spi_flash_map.h"
+#include "trace.h"
+#include "update_journal.h"
+#include "winc_bus.h"
+#include "winc_cloner.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+#define STATES(M)                                                              \
+  M(WINC_GANG_STATE_IDLE)                                                      \
+  M(WINC_GANG_STATE_OPENING)                                                   \
+  M(WINC_GANG_STATE_RUNNING)                                                   \
+  M(WINC_GANG_STATE_CLOSING)                                                   \
+  M(WINC_GANG_STATE_COMPLETE)                                                  \
+  M(WINC_GANG_STATE_ERROR)
+
+#define EXPAND_STATE_IDS(_name) _name,
+typedef enum { STATES(EXPAND_STATE_IDS) } winc_gang_state_t;
+
+#define MAX_FILENAME_LENGTH 80
+
+// Longest a sector erase or page program may keep a WINC busy.
+#define WINC_GANG_BUSY_TIMEOUT_MS 1000
+
+typedef struct {
+  bool failed;
+  bool dirty;           // current sector differs and is being written
+  uint32_t failed_addr; // address of the sector that failed
+  uint16_t n_equal;
+  uint16_t n_written;
+  uint16_t n_skipped;
+} winc_gang_slot_t;
+
+typedef struct {
+  winc_gang_state_t state;
+  char filename[MAX_FILENAME_LENGTH];
+  SYS_FS_HANDLE file_handle;
+  bool file_is_open;
+  bool cancel_requested;
+  bool has_manifest;
+  uint8_t n_slots;
+  uint32_t image_size; // in bytes
+  uint32_t addr;       // address of the next sector
+  uint16_t idx;        // index of the next sector
+  size_t n_done;       // bytes processed, for the timing summary
+  winc_gang_slot_t slots[WINC_BUS_MAX_SLOTS];
+} winc_gang_ctx_t;
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+static void set_state(winc_gang_state_t state);
+
+/**
+ * @brief Open the file and every WINC.  Return false if the file cannot be
+ * used or no WINC can be opened.
+ */
+static bool open_gang(void);
+
+/**
+ * @brief Update the next sector on every WINC that has not failed.  Return
+ * false if the update cannot continue.
+ */
+static bool update_sector(void);
+
+/**
+ * @brief Erase the sector on every dirty WINC, then program its non-blank
+ * pages on every dirty WINC, one page at a time.
+ */
+static void program_sector(const uint8_t *src, uint32_t addr);
+
+/**
+ * @brief Wait until no dirty WINC is busy, failing those that stay busy.
+ */
+static void wait_idle(uint32_t addr);
+
+static void close_gang(void);
+
+static void print_summary(void);
+
+static bool slot_is_live(uint8_t slot);
+
+static void fail_slot(uint8_t slot, uint32_t addr);
+
+static bool read_sector(uint8_t *dst, uint32_t addr);
+
+static uint16_t blank_pages(const uint8_t *sector);
+
+static bool is_pll_sector(uint32_t addr);
+
+// *****************************************************************************
+// Private (static) storage
+
+static winc_gang_ctx_t s_winc_gang_ctx;
+
+static image_manifest_t s_manifest;
+
+static uint8_t s_src_buf[FLASH_SECTOR_SZ]; // from the file
+
+static uint8_t s_winc_buf[FLASH_SECTOR_SZ]; // from a WINC
+
+// *****************************************************************************
+// Public code
+
+void winc_gang_init(void) {
+  s_winc_gang_ctx.state = WINC_GANG_STATE_IDLE;
+  s_winc_gang_ctx.file_handle = SYS_FS_HANDLE_INVALID;
+  s_winc_gang_ctx.file_is_open = false;
+}
+
+bool winc_gang_update(const char *filename) {
+  winc_gang_ctx_t *ctx = &s_winc_gang_ctx;
+
+  if (winc_gang_is_busy() || winc_cloner_is_busy()) {
+    SYS_DEBUG_MESSAGE(SYS_ERROR_ERROR, "\nwinc_gang is busy");
+    return false;
+  }
+  strncpy(ctx->filename, filename, MAX_FILENAME_LENGTH - 1);
+  ctx->filename[MAX_FILENAME_LENGTH - 1] = '\0';
+  ctx->cancel_requested = false;
+  ctx->n_slots = winc_bus_slot_count();
+  ctx->addr = 0;
+  ctx->idx = 0;
+  ctx->n_done = 0;
+  memset(ctx->slots, 0, sizeof(ctx->slots));
+  // Every WINC is about to change under any interrupted winc_cloner update,
+  // and is part written until the gang update passes.
+  update_journal_mark_writing(filename, true);
+  op_stats_reset();
+  set_state(WINC_GANG_STATE_OPENING);
+  return true;
+}
+
+void winc_gang_step(void) {
+  winc_gang_ctx_t *ctx = &s_winc_gang_ctx;
+
+  switch (ctx->state) {
+  case WINC_GANG_STATE_IDLE: {
+    // wait here for winc_gang_update()
+  } break;
+
+  case WINC_GANG_STATE_OPENING: {
+    if (open_gang()) {
+      set_state(WINC_GANG_STATE_RUNNING);
+    } else {
+      close_gang();
+      set_state(WINC_GANG_STATE_ERROR);
+    }
+  } break;
+
+  case WINC_GANG_STATE_RUNNING: {
+    // one sector per call
+    if (ctx->cancel_requested) {
+      SYS_CONSOLE_MESSAGE("\nUpdate cancelled");
+      set_state(WINC_GANG_STATE_CLOSING);
+    } else if (ctx->addr >= ctx->image_size) {
+      set_state(WINC_GANG_STATE_CLOSING);
+    } else if (!update_sector()) {
+      set_state(WINC_GANG_STATE_CLOSING);
+    }
+  } break;
+
+  case WINC_GANG_STATE_CLOSING: {
+    bool passed = !ctx->cancel_requested && (ctx->addr >= ctx->image_size);
+
+    close_gang();
+    print_summary();
+    for (uint8_t slot = 0; slot < ctx->n_slots; slot++) {
+      passed &= !ctx->slots[slot].failed;
+    }
+    op_stats_print("gang update", ctx->n_done);
+    if (passed) {
+      update_journal_clear();
+      SYS_CONSOLE_PRINT("\nUpdated %d WINCs from %s", ctx->n_slots,
+                        ctx->filename);
+      set_state(WINC_GANG_STATE_COMPLETE);
+    } else {
+      set_state(WINC_GANG_STATE_ERROR);
+    }
+  } break;
+
+  case WINC_GANG_STATE_COMPLETE: {
+    // here on complete state
+  } break;
+
+  case WINC_GANG_STATE_ERROR: {
+    // here on error state
+  } break;
+  } // switch
+}
+
+void winc_gang_cancel(void) {
+  if (winc_gang_is_busy()) {
+    s_winc_gang_ctx.cancel_requested = true;
+  }
+}
+
+bool winc_gang_is_busy(void) {
+  return (s_winc_gang_ctx.state == WINC_GANG_STATE_OPENING) ||
+         (s_winc_gang_ctx.state == WINC_GANG_STATE_RUNNING) ||
+         (s_winc_gang_ctx.state == WINC_GANG_STATE_CLOSING);
+}
+
+bool winc_gang_is_complete(void) {
+  return s_winc_gang_ctx.state == WINC_GANG_STATE_COMPLETE;
+}
+
+bool winc_gang_has_error(void) {
+  return s_winc_gang_ctx.state == WINC_GANG_STATE_ERROR;
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static void set_state(winc_gang_state_t state) {
+  if (s_winc_gang_ctx.state != state) {
+    TRACE2(TRACE_WINC_GANG_STATE, s_winc_gang_ctx.state, state);
+    s_winc_gang_ctx.state = state;
+  }
+}
+
+static bool open_gang(void) {
+  winc_gang_ctx_t *ctx = &s_winc_gang_ctx;
+  int32_t file_size;
+  uint8_t n_live = 0;
+
+  ctx->file_handle = SYS_FS_FileOpen(ctx->filename, SYS_FS_FILE_OPEN_READ);
+  if (ctx->file_handle == SYS_FS_HANDLE_INVALID) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nCould not open file %s", ctx->filename);
+    return false;
+  }
+  ctx->file_is_open = true;
+  file_size = SYS_FS_FileSize(ctx->file_handle);
+  if ((file_size <= 0) || ((file_size % FLASH_SECTOR_SZ) != 0)) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                    "\n%s is not a whole number of sectors",
+                    ctx->filename);
+    return false;
+  }
+  ctx->image_size = file_size;
+  ctx->has_manifest = image_manifest_read(ctx->filename, &s_manifest);
+
+  for (uint8_t slot = 0; slot < ctx->n_slots; slot++) {
+    if (!winc_bus_open(slot)) {
+      SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nCould not open WINC in slot %d",
+                      slot);
+      fail_slot(slot, 0);
+    } else if ((spi_flash_get_size() << 17) < ctx->image_size) {
+      SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                      "\nWINC flash in slot %d is smaller than %s",
+                      slot,
+                      ctx->filename);
+      fail_slot(slot, 0);
+    } else {
+      n_live += 1;
+    }
+  }
+  SYS_CONSOLE_MESSAGE("\n");
+  return n_live > 0;
+}
+
+static bool update_sector(void) {
+  winc_gang_ctx_t *ctx = &s_winc_gang_ctx;
+  uint32_t addr = ctx->addr;
+  bool any_dirty = false;
+  bool any_live = false;
+
+  if (!read_sector(s_src_buf, addr)) {
+    return false;
+  }
+
+  for (uint8_t slot = 0; slot < ctx->n_slots; slot++) {
+    winc_gang_slot_t *s = &ctx->slots[slot];
+    s->dirty = false;
+    if (!slot_is_live(slot)) {
+      continue;
+    }
+    if (is_pll_sector(addr)) {
+      // do not overwrite PLL and GAIN settings: see spi_flash_map.h
+      s->n_skipped += 1;
+      continue;
+    }
+    winc_bus_select(slot);
+    TRACE1(TRACE_WINC_READ, addr);
+    uint32_t t0 = op_stats_start();
+    int8_t ret = spi_flash_read(s_winc_buf, addr, FLASH_SECTOR_SZ);
+    op_stats_stop(OP_STATS_WINC_READ, t0, FLASH_SECTOR_SZ);
+    if (ret != M2M_SUCCESS) {
+      fail_slot(slot, addr);
+      continue;
+    }
+    t0 = op_stats_start();
+    bool is_equal = memcmp(s_src_buf, s_winc_buf, FLASH_SECTOR_SZ) == 0;
+    op_stats_stop(OP_STATS_COMPARE, t0, FLASH_SECTOR_SZ);
+    if (is_equal) {
+      s->n_equal += 1;
+    } else {
+      s->dirty = true;
+      any_dirty = true;
+    }
+  }
+
+  if (any_dirty) {
+    program_sector(s_src_buf, addr);
+    // Read back what was written.
+    uint32_t crc = crc32_compute(s_src_buf, FLASH_SECTOR_SZ);
+    for (uint8_t slot = 0; slot < ctx->n_slots; slot++) {
+      if (!slot_is_live(slot) || !ctx->slots[slot].dirty) {
+        continue;
+      }
+      winc_bus_select(slot);
+      uint32_t t0 = op_stats_start();
+      int8_t ret = spi_flash_read(s_winc_buf, addr, FLASH_SECTOR_SZ);
+      op_stats_stop(OP_STATS_WINC_READ, t0, FLASH_SECTOR_SZ);
+      t0 = op_stats_start();
+      bool is_verified =
+          (ret == M2M_SUCCESS) &&
+          (crc32_compute(s_winc_buf, FLASH_SECTOR_SZ) == crc);
+      op_stats_stop(OP_STATS_HASH, t0, FLASH_SECTOR_SZ);
+      if (is_verified) {
+        ctx->slots[slot].n_written += 1;
+      } else {
+        fail_slot(slot, addr);
+      }
+    }
+  }
+
+  // One character per WINC per sector, as winc_cloner does for one WINC.
+  uint32_t t0 = op_stats_start();
+  for (uint8_t slot = 0; slot < ctx->n_slots; slot++) {
+    const winc_gang_slot_t *s = &ctx->slots[slot];
+    if (!slot_is_live(slot)) {
+      SYS_CONSOLE_MESSAGE("-");
+      continue;
+    }
+    any_live = true;
+    if (is_pll_sector(addr)) {
+      SYS_CONSOLE_MESSAGE("x");
+      op_stats_count(OP_STATS_SECTORS_SKIPPED, 1);
+    } else if (s->dirty) {
+      SYS_CONSOLE_MESSAGE("!");
+      op_stats_count(OP_STATS_SECTORS_DIFFER, 1);
+    } else {
+      SYS_CONSOLE_MESSAGE("=");
+      op_stats_count(OP_STATS_SECTORS_EQUAL, 1);
+    }
+  }
+  if (ctx->n_slots > 1) {
+    SYS_CONSOLE_MESSAGE(" ");
+  }
+  op_stats_stop(OP_STATS_CONSOLE, t0, 1);
+  op_stats_count(OP_STATS_SECTORS, 1);
+
+  ctx->addr += FLASH_SECTOR_SZ;
+  ctx->idx += 1;
+  ctx->n_done += FLASH_SECTOR_SZ;
+  TRACE2(TRACE_SECTOR_DONE, any_dirty, ctx->n_done);
+  return any_live;
+}
+
+static void program_sector(const uint8_t *src, uint32_t addr) {
+  winc_gang_ctx_t *ctx = &s_winc_gang_ctx;
+  uint16_t blank = blank_pages(src);
+
+  uint32_t t0 = op_stats_start();
+  for (uint8_t slot = 0; slot < ctx->n_slots; slot++) {
+    if (slot_is_live(slot) && ctx->slots[slot].dirty) {
+      winc_bus_select(slot);
+      if (spi_flash_erase_start(addr) != M2M_SUCCESS) {
+        fail_slot(slot, addr);
+      } else {
+        op_stats_count(OP_STATS_SECTORS_ERASED, 1);
+      }
+    }
+  }
+  wait_idle(addr);
+  op_stats_stop(OP_STATS_WINC_ERASE, t0, FLASH_SECTOR_SZ);
+
+  TRACE2(TRACE_WINC_PROGRAM, addr, blank);
+  for (uint32_t page = 0; page < IMAGE_PLAN_PAGES_PER_SECTOR; page++) {
+    uint32_t offset = page * FLASH_PAGE_SZ;
+    if (blank & (1ul << page)) {
+      continue;
+    }
+    t0 = op_stats_start();
+    for (uint8_t slot = 0; slot < ctx->n_slots; slot++) {
+      if (slot_is_live(slot) && ctx->slots[slot].dirty) {
+        winc_bus_select(slot);
+        if (spi_flash_page_program_start((uint8_t *)&src[offset],
+                                         addr + offset,
+                                         FLASH_PAGE_SZ) != M2M_SUCCESS) {
+          fail_slot(slot, addr);
+        } else {
+          op_stats_count(OP_STATS_PAGES_PROGRAMMED, 1);
+        }
+      }
+    }
+    wait_idle(addr);
+    op_stats_stop(OP_STATS_WINC_PROGRAM, t0, FLASH_PAGE_SZ);
+  }
+}
+
+static void wait_idle(uint32_t addr) {
+  winc_gang_ctx_t *ctx = &s_winc_gang_ctx;
+  uint64_t t0 = SYS_TIME_Counter64Get();
+  uint64_t timeout =
+      SYS_TIME_FrequencyGet() * (uint64_t)WINC_GANG_BUSY_TIMEOUT_MS / 1000;
+  bool any_busy;
+
+  do {
+    bool timed_out = (SYS_TIME_Counter64Get() - t0) > timeout;
+    any_busy = false;
+    for (uint8_t slot = 0; slot < ctx->n_slots; slot++) {
+      uint8_t busy;
+      if (!slot_is_live(slot) || !ctx->slots[slot].dirty) {
+        continue;
+      }
+      winc_bus_select(slot);
+      if ((spi_flash_is_busy(&busy) != M2M_SUCCESS) || (busy && timed_out)) {
+        fail_slot(slot, addr);
+      } else if (busy) {
+        any_busy = true;
+      }
+    }
+  } while (any_busy);
+}
+
+static void close_gang(void) {
+  winc_gang_ctx_t *ctx = &s_winc_gang_ctx;
+
+  if (ctx->file_is_open) {
+    SYS_FS_FileClose(ctx->file_handle);
+    ctx->file_is_open = false;
+  }
+  ctx->file_handle = SYS_FS_HANDLE_INVALID;
+  // Leave the rest of the firmware talking to the WDRV WINC.
+  winc_bus_select(0);
+}
+
+static void print_summary(void) {
+  winc_gang_ctx_t *ctx = &s_winc_gang_ctx;
+
+  for (uint8_t slot = 0; slot < ctx->n_slots; slot++) {
+    const winc_gang_slot_t *s = &ctx->slots[slot];
+    if (s->failed) {
+      SYS_CONSOLE_PRINT("\nslot %d: FAILED at 0x%06lx", slot, s->failed_addr);
+    } else {
+      SYS_CONSOLE_PRINT("\nslot %d: %u equal, %u written, %u skipped",
+                        slot,
+                        s->n_equal,
+                        s->n_written,
+                        s->n_skipped);
+    }
+  }
+}
+
+static bool slot_is_live(uint8_t slot) {
+  return !s_winc_gang_ctx.slots[slot].failed;
+}
+
+static void fail_slot(uint8_t slot, uint32_t addr) {
+  winc_gang_slot_t *s = &s_winc_gang_ctx.slots[slot];
+
+  if (!s->failed) {
+    s->failed = true;
+    s->failed_addr = addr;
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nWINC in slot %d failed at 0x%lx",
+                    slot, addr);
+  }
+}
+
+static bool read_sector(uint8_t *dst, uint32_t addr) {
+  winc_gang_ctx_t *ctx = &s_winc_gang_ctx;
+  uint32_t t0 = op_stats_start();
+  bool ret;
+
+  TRACE2(TRACE_SD_READ, addr, FLASH_SECTOR_SZ);
+  ret = ((SYS_FS_FileTell(ctx->file_handle) == (int32_t)addr) ||
+         (SYS_FS_FileSeek(ctx->file_handle, addr, SYS_FS_SEEK_SET) ==
+          (int32_t)addr)) &&
+        (SYS_FS_FileRead(ctx->file_handle, dst, FLASH_SECTOR_SZ) ==
+         FLASH_SECTOR_SZ);
+  op_stats_stop(OP_STATS_SD_READ, t0, FLASH_SECTOR_SZ);
+  if (!ret) {
+    SYS_DEBUG_PRINT(SYS_ERROR_ERROR, "\nFailed to read %s at 0x%lx",
+                    ctx->filename, addr);
+    return false;
+  }
+  if (ctx->has_manifest) {
+    t0 = op_stats_start();
+    uint32_t crc = crc32_compute(dst, FLASH_SECTOR_SZ);
+    op_stats_stop(OP_STATS_HASH, t0, FLASH_SECTOR_SZ);
+    if ((ctx->idx >= s_manifest.n_sectors) ||
+        (crc != s_manifest.sector_crc[ctx->idx])) {
+      SYS_DEBUG_PRINT(SYS_ERROR_ERROR,
+                      "\nImage does not match its manifest at 0x%lx",
+                      addr);
+      return false;
+    }
+  }
+  return true;
+}
+
+static uint16_t blank_pages(const uint8_t *sector) {
+  uint16_t mask = 0;
+  for (uint32_t page = 0; page < IMAGE_PLAN_PAGES_PER_SECTOR; page++) {
+    const uint8_t *p = &sector[page * FLASH_PAGE_SZ];
+    uint32_t i;
+    for (i = 0; i < FLASH_PAGE_SZ; i++) {
+      if (p[i] != 0xff) {
+        break;
+      }
+    }
+    if (i == FLASH_PAGE_SZ) {
+      mask |= (1u << page);
+    }
+  }
+  return mask;
+}
+
+static bool is_pll_sector(uint32_t addr) {
+  return (addr >= M2M_PLL_FLASH_OFFSET) &&
+         (addr < M2M_PLL_FLASH_OFFSET + M2M_CONFIG_SECT_TOTAL_SZ);
+}
+
+// *****************************************************************************
+// End of file
@@ -0,0 +1,107 @@
+/**
+ * @file winc_gang.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief winc_gang updates every WINC on the winc_bus from one image file.
+ *
+ * Each sector is read from the SD card once and compared with each WINC.
+ * The sectors that differ are erased on all WINCs at once and then
+ * programmed a page at a time on all WINCs at once: the erase and program
+ * busy time of the flash, which dominates an update, overlaps across WINCs.
+ * A WINC that fails is dropped and the update carries on with the others.
+ *
+ * Like winc_cloner_update(), this does not touch the PLL and GAIN tables.
+ */
+
+#ifndef _WINC_GANG_H_
+#define _WINC_GANG_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stdbool.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Initialize the winc_gang module.  Called once at startup.
+ */
+void winc_gang_init(void);
+
+/**
+ * @brief Start updating every WINC on the winc_bus from a file.  The work is
+ * done in winc_gang_step().
+ *
+ * @return true if the update was started.
+ */
+bool winc_gang_update(const char *filename);
+
+/**
+ * @brief Update the next sector.  Called frequently.
+ */
+void winc_gang_step(void);
+
+/**
+ * @brief Cancel the update after the current sector.
+ *
+ * Note: a cancelled update leaves the WINCs partially updated.
+ */
+void winc_gang_cancel(void);
+
+/**
+ * @brief Return true if an update is in progress.
+ */
+bool winc_gang_is_busy(void);
+
+/**
+ * @brief Return true if the last update succeeded on every WINC.
+ */
+bool winc_gang_is_complete(void);
+
+/**
+ * @brief Return true if the last update failed on any WINC or was cancelled.
+ */
+bool winc_gang_has_error(void);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _WINC_GANG_H_ */
@@ -0,0 +1,389 @@
+/**
+ * @file image_plan.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+Host-side image compiler.
+
+usage: image_plan [-v] [-c] image.img [image.img ...]
+
+For each WINC image, writes image.img.plan containing an image_plan_t (see
+firmware/src/image_plan.h): the image's size, CRC-32 and modification time,
+the regions it covers and its erase runs (see image_plan_build_layout()), and
+the CRC-32 and blank page mask of every sector.  With -v, the plan is also
+printed in human-readable form, with the region (from spi_flash_map.h) of each
+sector.
+
+The firmware ignores a plan whose image's FAT date and time differ from the
+plan's, so run image_plan on the image where it sits on the card (or copy the
+image and plan with their modification times kept, as cp -p does).
+
+With -c, image.img.plan is checked against the image instead: every field is
+recomputed from the image and compared, and the plan must pass the checks
+that the firmware makes when it loads one.
+
+Returns 0 if all plans were written (or all checked out).
+*/
+
+// *****************************************************************************
+// Includes
+
+#include "crc32.h"
+#include "flash_regions.h"
+#include "image_plan.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+#define MAX_PATH_LENGTH 1024
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+static bool compile_image(const char *image_name, bool verbose);
+
+static bool check_image(const char *image_name);
+
+static bool read_image(const char *image_name, size_t *n_bytes);
+
+static void build_plan(image_plan_t *plan, size_t n_bytes, uint32_t stamp);
+
+/**
+ * @brief Fill in the FAT date << 16 | time that the card's file system
+ * records for image_name: its modification time, in local time.
+ */
+static bool image_stamp(const char *image_name, uint32_t *stamp);
+
+static uint16_t blank_pages(const uint8_t *sector);
+
+static bool write_plan(const char *plan_name, const image_plan_t *plan);
+
+static bool read_plan(const char *plan_name, image_plan_t *plan);
+
+static uint16_t count_blank_sectors(const image_plan_t *plan);
+
+static void print_plan(const image_plan_t *plan);
+
+/**
+ * @brief Return the name of the region holding addr, or "-".
+ */
+static const char *region_name(uint32_t addr);
+
+// *****************************************************************************
+// Private (static) storage
+
+static uint8_t s_image[FLASH_8M_TOTAL_SZ];
+
+static image_plan_t s_plan;
+
+static image_plan_t s_loaded_plan;
+
+// *****************************************************************************
+// Public code
+
+int main(int argc, char *argv[]) {
+  bool verbose = false;
+  bool check = false;
+  int n_images = 0;
+  int n_failed = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-v") == 0) {
+      verbose = true;
+    } else if (strcmp(argv[i], "-c") == 0) {
+      check = true;
+    } else {
+      n_images += 1;
+      if (!(check ? check_image(argv[i]) : compile_image(argv[i], verbose))) {
+        n_failed += 1;
+      }
+    }
+  }
+  if (n_images == 0) {
+    fprintf(stderr,
+            "usage: %s [-v] [-c] image.img [image.img ...]\n",
+            argv[0]);
+    return EXIT_FAILURE;
+  }
+  return (n_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static bool compile_image(const char *image_name, bool verbose) {
+  char plan_name[MAX_PATH_LENGTH];
+  size_t n_bytes;
+  uint32_t stamp;
+
+  if (!read_image(image_name, &n_bytes) || !image_stamp(image_name, &stamp)) {
+    return false;
+  }
+  build_plan(&s_plan, n_bytes, stamp);
+
+  snprintf(plan_name, sizeof(plan_name), "%s%s", image_name, IMAGE_PLAN_SUFFIX);
+  if (!write_plan(plan_name, &s_plan)) {
+    return false;
+  }
+  if (verbose) {
+    print_plan(&s_plan);
+  }
+  printf("%s: %d sectors, %d blank, crc %08lx => %s\n",
+         image_name,
+         s_plan.n_sectors,
+         count_blank_sectors(&s_plan),
+         (unsigned long)s_plan.image_crc,
+         plan_name);
+  return true;
+}
+
+static bool check_image(const char *image_name) {
+  const image_plan_t *plan = &s_loaded_plan;
+  char plan_name[MAX_PATH_LENGTH];
+  size_t n_bytes;
+  uint32_t stamp;
+  uint32_t crc = CRC32_INITIAL_VALUE;
+  int n_errors = 0;
+
+  snprintf(plan_name, sizeof(plan_name), "%s%s", image_name, IMAGE_PLAN_SUFFIX);
+  if (!read_image(image_name, &n_bytes) || !image_stamp(image_name, &stamp) ||
+      !read_plan(plan_name, &s_loaded_plan)) {
+    return false;
+  }
+  // As load_plan() and planned_update_begin() in winc_cloner.c.
+  if ((plan->magic != IMAGE_PLAN_MAGIC) ||
+      (plan->version != IMAGE_PLAN_VERSION) ||
+      (plan->n_sectors > IMAGE_PLAN_MAX_SECTORS) ||
+      (plan->image_size != plan->n_sectors * FLASH_SECTOR_SZ) ||
+      !image_plan_layout_is_valid(plan)) {
+    fprintf(stderr, "%s: the firmware would not load this plan\n", plan_name);
+    return false;
+  }
+  if (plan->image_size != n_bytes) {
+    fprintf(stderr,
+            "%s: plan is for %lu bytes, image has %lu\n",
+            plan_name,
+            (unsigned long)plan->image_size,
+            (unsigned long)n_bytes);
+    return false;
+  }
+  // Sector by sector, the whole-image CRC must come out the same.
+  for (uint16_t idx = 0; idx < plan->n_sectors; idx++) {
+    const uint8_t *sector = &s_image[idx * FLASH_SECTOR_SZ];
+    const image_plan_sector_t *planned = &plan->sectors[idx];
+
+    crc = crc32_update(crc, sector, FLASH_SECTOR_SZ);
+    if ((planned->crc != crc32_compute(sector, FLASH_SECTOR_SZ)) ||
+        (planned->blank_pages != blank_pages(sector)) ||
+        (planned->reserved != 0)) {
+      fprintf(stderr,
+              "%s: sector 0x%06lx (%s) does not match the image\n",
+              plan_name,
+              (unsigned long)(idx * FLASH_SECTOR_SZ),
+              region_name(idx * FLASH_SECTOR_SZ));
+      n_errors += 1;
+    }
+  }
+  for (unsigned idx = plan->n_sectors; idx < IMAGE_PLAN_MAX_SECTORS; idx++) {
+    const image_plan_sector_t *unused = &plan->sectors[idx];
+    if ((unused->crc != 0) || (unused->blank_pages != 0)) {
+      fprintf(
+          stderr, "%s: sector entry %u is past the image\n", plan_name, idx);
+      n_errors += 1;
+    }
+  }
+  if (plan->image_crc != crc) {
+    fprintf(stderr, "%s: image CRC does not match the image\n", plan_name);
+    n_errors += 1;
+  }
+  if (plan->image_stamp != stamp) {
+    fprintf(stderr, "%s: the image has changed since the plan\n", plan_name);
+    n_errors += 1;
+  }
+  printf("%s: %s\n", plan_name, (n_errors == 0) ? "ok" : "FAILED");
+  return n_errors == 0;
+}
+
+static bool read_image(const char *image_name, size_t *n_bytes) {
+  FILE *fp = fopen(image_name, "rb");
+  if (fp == NULL) {
+    perror(image_name);
+    return false;
+  }
+  // Read one byte more than the maximum to detect oversized images.
+  *n_bytes = fread(s_image, 1, sizeof(s_image), fp);
+  bool oversized = (fgetc(fp) != EOF);
+  fclose(fp);
+
+  if (oversized || (*n_bytes == 0) || (*n_bytes % FLASH_SECTOR_SZ != 0)) {
+    fprintf(stderr,
+            "%s: size must be a non-zero multiple of %lu up to %lu bytes\n",
+            image_name,
+            (unsigned long)FLASH_SECTOR_SZ,
+            (unsigned long)FLASH_8M_TOTAL_SZ);
+    return false;
+  }
+  return true;
+}
+
+static void build_plan(image_plan_t *plan, size_t n_bytes, uint32_t stamp) {
+  memset(plan, 0, sizeof(*plan));
+  plan->magic = IMAGE_PLAN_MAGIC;
+  plan->version = IMAGE_PLAN_VERSION;
+  plan->n_sectors = n_bytes / FLASH_SECTOR_SZ;
+  plan->image_size = n_bytes;
+  plan->image_crc = crc32_compute(s_image, n_bytes);
+  plan->image_stamp = stamp;
+
+  // Per-sector CRCs and blank page masks.
+  for (uint16_t idx = 0; idx < plan->n_sectors; idx++) {
+    const uint8_t *sector = &s_image[idx * FLASH_SECTOR_SZ];
+    image_plan_sector_t *dst = &plan->sectors[idx];
+
+    dst->crc = crc32_compute(sector, FLASH_SECTOR_SZ);
+    dst->blank_pages = blank_pages(sector);
+  }
+  image_plan_build_layout(plan);
+}
+
+static bool image_stamp(const char *image_name, uint32_t *stamp) {
+  struct stat st;
+  struct tm tm;
+  uint16_t fdate;
+  uint16_t ftime;
+
+  if ((stat(image_name, &st) != 0) ||
+      (localtime_r(&st.st_mtime, &tm) == NULL)) {
+    perror(image_name);
+    return false;
+  }
+  // FAT keeps the date from 1980 and the time to two seconds.
+  fdate = ((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday;
+  ftime = (tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2);
+  *stamp = ((uint32_t)fdate << 16) | ftime;
+  return true;
+}
+
+static uint16_t blank_pages(const uint8_t *sector) {
+  uint16_t mask = 0;
+  for (unsigned page = 0; page < IMAGE_PLAN_PAGES_PER_SECTOR; page++) {
+    const uint8_t *p = &sector[page * FLASH_PAGE_SZ];
+    int i;
+    for (i = 0; i < FLASH_PAGE_SZ; i++) {
+      if (p[i] != 0xff) {
+        break;
+      }
+    }
+    if (i == FLASH_PAGE_SZ) {
+      mask |= (1u << page);
+    }
+  }
+  return mask;
+}
+
+static uint16_t count_blank_sectors(const image_plan_t *plan) {
+  uint16_t n_blank = 0;
+  for (uint16_t idx = 0; idx < plan->n_sectors; idx++) {
+    if (plan->sectors[idx].blank_pages == IMAGE_PLAN_ALL_PAGES_BLANK) {
+      n_blank += 1;
+    }
+  }
+  return n_blank;
+}
+
+static bool read_plan(const char *plan_name, image_plan_t *plan) {
+  FILE *fp = fopen(plan_name, "rb");
+  if (fp == NULL) {
+    perror(plan_name);
+    return false;
+  }
+  // Read one byte more than a plan to detect the wrong kind of file.
+  bool ok = (fread(plan, sizeof(*plan), 1, fp) == 1) && (fgetc(fp) == EOF);
+  fclose(fp);
+  if (!ok) {
+    fprintf(stderr, "%s: not the size of a plan\n", plan_name);
+  }
+  return ok;
+}
+
+static bool write_plan(const char *plan_name, const image_plan_t *plan) {
+  FILE *fp = fopen(plan_name, "wb");
+  if (fp == NULL) {
+    perror(plan_name);
+    return false;
+  }
+  bool ok = (fwrite(plan, sizeof(*plan), 1, fp) == 1);
+  if (fclose(fp) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    fprintf(stderr, "%s: write failed\n", plan_name);
+  }
+  return ok;
+}
+
+static void print_plan(const image_plan_t *plan) {
+  printf("regions:\n");
+  for (int i = 0; i < plan->n_regions; i++) {
+    const image_plan_region_t *region = &plan->regions[i];
+    printf("  0x%06lx %7lu %s\n",
+           (unsigned long)region->offset,
+           (unsigned long)region->size,
+           region->name);
+  }
+  printf("erase runs:\n");
+  for (int i = 0; i < plan->n_runs; i++) {
+    const image_plan_run_t *run = &plan->runs[i];
+    printf("  0x%06lx %2lu blocks %s\n",
+           (unsigned long)(run->first_sector * FLASH_SECTOR_SZ),
+           (unsigned long)(run->n_sectors / IMAGE_PLAN_SECTORS_PER_BLOCK),
+           region_name(run->first_sector * FLASH_SECTOR_SZ));
+  }
+  printf("sectors:\n");
+  for (int i = 0; i < plan->n_sectors; i++) {
+    const image_plan_sector_t *sector = &plan->sectors[i];
+    printf("  0x%06lx crc %08lx blank %04x %s\n",
+           (unsigned long)(i * FLASH_SECTOR_SZ),
+           (unsigned long)sector->crc,
+           sector->blank_pages,
+           region_name(i * FLASH_SECTOR_SZ));
+  }
+}
+
+static const char *region_name(uint32_t addr) {
+  const flash_region_t *region = flash_region_get(flash_region_find(addr));
+  return (region != NULL) ? region->name : "-";
+}
+
+// *****************************************************************************
+// End of file
@@ -0,0 +1,122 @@
+/**
+ * @file mb_cloner.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @brief Cases for the cloner core: buffers_are_equal(), which compares
+ * every sector in update, compare and the PLL check, and
+ * winc3400_pll_table_build().
+ *
+ * winc_cloner.c is included verbatim, built against the winc_sim host shims.
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "microbench.h"
+
+#include "winc_cloner.c"
+
+// *****************************************************************************
+// Private types and definitions
+
+// A typical FreqOffset from the efuse: -2.5 ppm in 1/64 ppm units, 15 bits.
+#define FREQ_OFFSET ((1 << 15) - 160)
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+static void run_equal_sector(uint32_t n_ops);
+static void run_differ_first(uint32_t n_ops);
+static void run_differ_last(uint32_t n_ops);
+static void run_pll_table_build(uint32_t n_ops);
+static void setup_sectors(void);
+static void setup_quiet(void);
+
+// *****************************************************************************
+// Private (static) storage
+
+static const mb_case_t s_cases[] = {
+    {"buffers_are_equal/equal_4K",
+     run_equal_sector,
+     setup_sectors,
+     FLASH_SECTOR_SZ},
+    {"buffers_are_equal/differ_first", run_differ_first, setup_sectors, 0},
+    {"buffers_are_equal/differ_last",
+     run_differ_last,
+     setup_sectors,
+     FLASH_SECTOR_SZ},
+    {"winc3400_pll_table_build", run_pll_table_build, setup_quiet, 0},
+};
+
+// *****************************************************************************
+// Public code
+
+const mb_suite_t mb_cloner_suite = {s_cases,
+                                    sizeof(s_cases) / sizeof(s_cases[0])};
+
+// *****************************************************************************
+// Private (static) code
+
+static void run_equal_sector(uint32_t n_ops) {
+  for (uint32_t i = 0; i < n_ops; i++) {
+    mb_sink += buffers_are_equal(s_xfer_buf, s_xfer_buf2, FLASH_SECTOR_SZ);
+  }
+}
+
+static void run_differ_first(uint32_t n_ops) {
+  s_xfer_buf2[0] ^= 0xff;
+  for (uint32_t i = 0; i < n_ops; i++) {
+    mb_sink += buffers_are_equal(s_xfer_buf, s_xfer_buf2, FLASH_SECTOR_SZ);
+  }
+  s_xfer_buf2[0] ^= 0xff;
+}
+
+static void run_differ_last(uint32_t n_ops) {
+  s_xfer_buf2[FLASH_SECTOR_SZ - 1] ^= 0xff;
+  for (uint32_t i = 0; i < n_ops; i++) {
+    mb_sink += buffers_are_equal(s_xfer_buf, s_xfer_buf2, FLASH_SECTOR_SZ);
+  }
+  s_xfer_buf2[FLASH_SECTOR_SZ - 1] ^= 0xff;
+}
+
+static void run_pll_table_build(uint32_t n_ops) {
+  for (uint32_t i = 0; i < n_ops; i++) {
+    mb_sink += winc3400_pll_table_build(s_xfer_buf, FREQ_OFFSET);
+  }
+}
+
+static void setup_sectors(void) {
+  for (size_t i = 0; i < FLASH_SECTOR_SZ; i++) {
+    s_xfer_buf[i] = (uint8_t)(i * 13 + 5);
+  }
+  memcpy(s_xfer_buf2, s_xfer_buf, FLASH_SECTOR_SZ);
+}
+
+static void setup_quiet(void) {
+  // Leave out the table builder's console messages.
+  host_console_is_quiet = true;
+}
@@ -0,0 +1,267 @@
+/**
+ * @file mb_fatfs.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @brief Cases for the FatFs cluster chain walk, the work behind every
+ * forward f_lseek() and every cluster boundary crossed by f_read().
+ *
+ * ff.c is included, over a RAM disk (ff_host.c is ff.c with f_printf()
+ * made to build on x86-64: see the Makefile).  The synthetic volume is FAT32
+ * with 512 byte clusters and holds one contiguous file and one file whose
+ * clusters alternate with those of a third file, as happens when two files
+ * grow side by side.
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "microbench.h"
+
+#include "diskio.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ff_host.c"
+
+// *****************************************************************************
+// Private types and definitions
+
+#define SECTOR_SZ 512
+#define N_SECTORS (128 * 1024ul) // 64 MB
+#define CLUSTER_SZ SECTOR_SZ
+#define FILE_SZ (1024 * 1024ul)
+#define N_FILE_CLUSTERS (FILE_SZ / CLUSTER_SZ)
+
+#define CONTIGUOUS_FILENAME "contig.bin"
+#define FRAGMENTED_FILENAME "frag.bin"
+#define FILLER_FILENAME "filler.bin"
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+static void run_get_fat_contiguous(uint32_t n_ops);
+static void run_get_fat_fragmented(uint32_t n_ops);
+static void run_lseek_contiguous(uint32_t n_ops);
+static void run_lseek_fragmented(uint32_t n_ops);
+
+/**
+ * @brief Follow the cluster chain of filename for n_ops links, starting over
+ * at the end of the chain.
+ */
+static void walk_chain(const char *filename, uint32_t n_ops);
+
+/**
+ * @brief Seek from the start to the end of filename n_ops times.
+ */
+static void seek_to_end(const char *filename, uint32_t n_ops);
+
+/**
+ * @brief Format the RAM disk and write the files, once.
+ */
+static void build_volume(void);
+
+/**
+ * @brief Append one cluster of filename's own pattern to filename.
+ */
+static bool append_cluster(const char *filename, uint32_t index);
+
+static void fail(const char *what, FRESULT res);
+
+// *****************************************************************************
+// Private (static) storage
+
+static uint8_t *s_disk;
+
+static FATFS s_fs;
+
+static FIL s_fil; // FF_FS_LOCK allows one open file at a time
+
+static const mb_case_t s_cases[] = {
+    {"get_fat/contiguous", run_get_fat_contiguous, build_volume, CLUSTER_SZ},
+    {"get_fat/fragmented", run_get_fat_fragmented, build_volume, CLUSTER_SZ},
+    {"f_lseek/contiguous_1M", run_lseek_contiguous, build_volume, FILE_SZ},
+    {"f_lseek/fragmented_1M", run_lseek_fragmented, build_volume, FILE_SZ},
+};
+
+// *****************************************************************************
+// Public code
+
+const mb_suite_t mb_fatfs_suite = {s_cases,
+                                   sizeof(s_cases) / sizeof(s_cases[0])};
+
+PARTITION VolToPart[FF_VOLUMES] = {{0, 0}};
+
+DSTATUS disk_initialize(uint8_t pdrv) {
+  (void)pdrv; // there is only the one RAM disk
+  return s_disk ? 0 : STA_NOINIT;
+}
+
+DSTATUS disk_status(uint8_t pdrv) {
+  (void)pdrv;
+  return s_disk ? 0 : STA_NOINIT;
+}
+
+DRESULT
+disk_read(uint8_t pdrv, uint8_t *buff, uint32_t sector, uint32_t count) {
+  (void)pdrv;
+  if (sector + count > N_SECTORS) {
+    return RES_PARERR;
+  }
+  memcpy(buff, &s_disk[sector * SECTOR_SZ], count * SECTOR_SZ);
+  return RES_OK;
+}
+
+DRESULT
+disk_write(uint8_t pdrv, const uint8_t *buff, uint32_t sector, uint32_t count) {
+  (void)pdrv;
+  if (sector + count > N_SECTORS) {
+    return RES_PARERR;
+  }
+  memcpy(&s_disk[sector * SECTOR_SZ], buff, count * SECTOR_SZ);
+  return RES_OK;
+}
+
+DRESULT disk_ioctl(uint8_t pdrv, uint8_t cmd, void *buff) {
+  (void)pdrv;
+  switch (cmd) {
+  case CTRL_SYNC:
+    return RES_OK;
+  case GET_SECTOR_COUNT:
+    *(LBA_t *)buff = N_SECTORS;
+    return RES_OK;
+  case GET_BLOCK_SIZE:
+    *(DWORD *)buff = 1;
+    return RES_OK;
+  default:
+    return RES_PARERR;
+  }
+}
+
+DWORD get_fattime(void) {
+  // 2022-01-01 00:00:00
+  return ((DWORD)(2022 - 1980) << 25) | ((DWORD)1 << 21) | ((DWORD)1 << 16);
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static void run_get_fat_contiguous(uint32_t n_ops) {
+  walk_chain(CONTIGUOUS_FILENAME, n_ops);
+}
+
+static void run_get_fat_fragmented(uint32_t n_ops) {
+  walk_chain(FRAGMENTED_FILENAME, n_ops);
+}
+
+static void run_lseek_contiguous(uint32_t n_ops) {
+  seek_to_end(CONTIGUOUS_FILENAME, n_ops);
+}
+
+static void run_lseek_fragmented(uint32_t n_ops) {
+  seek_to_end(FRAGMENTED_FILENAME, n_ops);
+}
+
+static void walk_chain(const char *filename, uint32_t n_ops) {
+  FRESULT res = f_open(&s_fil, filename, FA_READ);
+  if (res != FR_OK) {
+    fail(filename, res);
+  }
+  DWORD clst = s_fil.obj.sclust;
+  for (uint32_t i = 0; i < n_ops; i++) {
+    clst = get_fat(&s_fil.obj, clst);
+    if (clst < 2 || clst >= s_fs.n_fatent) {
+      clst = s_fil.obj.sclust; // end of chain (or error): start over
+    }
+  }
+  mb_sink += clst;
+  f_close(&s_fil);
+}
+
+static void seek_to_end(const char *filename, uint32_t n_ops) {
+  FRESULT res = f_open(&s_fil, filename, FA_READ);
+  if (res != FR_OK) {
+    fail(filename, res);
+  }
+  for (uint32_t i = 0; i < n_ops; i++) {
+    f_lseek(&s_fil, 0);
+    f_lseek(&s_fil, FILE_SZ);
+  }
+  mb_sink += s_fil.clust;
+  f_close(&s_fil);
+}
+
+static void build_volume(void) {
+  static uint8_t work[FF_MAX_SS];
+  const MKFS_PARM opt = {FM_FAT32 | FM_SFD, 1, 0, 0, CLUSTER_SZ};
+  FRESULT res;
+
+  if (s_disk) {
+    return;
+  }
+  s_disk = calloc(N_SECTORS, SECTOR_SZ);
+  if (!s_disk) {
+    fail("RAM disk", FR_NOT_ENOUGH_CORE);
+  }
+  if ((res = f_mkfs("", &opt, work, sizeof(work))) != FR_OK) {
+    fail("f_mkfs", res);
+  }
+  if ((res = f_mount(&s_fs, "", 1)) != FR_OK) {
+    fail("f_mount", res);
+  }
+  for (uint32_t i = 0; i < N_FILE_CLUSTERS; i++) {
+    if (!append_cluster(CONTIGUOUS_FILENAME, i)) {
+      fail(CONTIGUOUS_FILENAME, FR_DISK_ERR);
+    }
+  }
+  for (uint32_t i = 0; i < N_FILE_CLUSTERS; i++) {
+    if (!append_cluster(FRAGMENTED_FILENAME, i) ||
+        !append_cluster(FILLER_FILENAME, i)) {
+      fail(FRAGMENTED_FILENAME, FR_DISK_ERR);
+    }
+  }
+}
+
+static bool append_cluster(const char *filename, uint32_t index) {
+  uint8_t buf[CLUSTER_SZ];
+  UINT written;
+
+  memset(buf, (int)(index + filename[0]), sizeof(buf));
+  if (f_open(&s_fil, filename, FA_WRITE | FA_OPEN_APPEND) != FR_OK) {
+    return false;
+  }
+  bool ok = f_write(&s_fil, buf, sizeof(buf), &written) == FR_OK &&
+            written == sizeof(buf);
+  return (f_close(&s_fil) == FR_OK) && ok;
+}
+
+static void fail(const char *what, FRESULT res) {
+  fprintf(stderr, "mb_fatfs: %s failed, FRESULT %d\n", what, res);
+  exit(2);
+}
@@ -0,0 +1,188 @@
+/**
+ * @file mb_nmspi.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @brief Cases for the WINC SPI protocol layer: crc7() / crc7_byte() and the
+ * command frame building in spi_cmd().
+ *
+ * nmspi.c is included verbatim.  The SPI transfer functions it calls are
+ * stubbed out below; the send stub keeps the last frame so it can be
+ * checked.
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "microbench.h"
+
+#include "definitions.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// nmspi.c wants the full WINC driver headers, which pull in the Harmony
+// configuration.  Declare the little it uses instead.
+#define _WDRV_WINC_COMMON_H
+#define _WDRV_WINC_SPI_H
+
+#include "osal/osal.h"
+#include "wdrv_winc_debug.h"
+
+bool WDRV_WINC_SPISend(void *pTransmitData, size_t txSize);
+bool WDRV_WINC_SPIReceive(void *pReceiveData, size_t rxSize);
+
+#include "nmspi.c"
+
+// *****************************************************************************
+// Private types and definitions
+
+#define FRAME_MAX 9
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+static void run_crc7_byte(uint32_t n_ops);
+static void run_crc7_frame(uint32_t n_ops);
+static void run_crc7_block(uint32_t n_ops);
+static void run_cmd_single_read(uint32_t n_ops);
+static void run_cmd_single_write(uint32_t n_ops);
+static void run_cmd_internal_write(uint32_t n_ops);
+static void run_cmd_dma_ext_read(uint32_t n_ops);
+static void run_cmd_single_write_crc_off(uint32_t n_ops);
+static void setup_block(void);
+
+// *****************************************************************************
+// Private (static) storage
+
+static uint8_t s_frame[FRAME_MAX];
+static size_t s_frame_len;
+
+static uint8_t s_block[DATA_PKT_SZ_4K];
+
+static const mb_case_t s_cases[] = {
+    {"crc7_byte/chain", run_crc7_byte, NULL, 1},
+    {"crc7/frame_8", run_crc7_frame, NULL, 8},
+    {"crc7/block_4K", run_crc7_block, setup_block, DATA_PKT_SZ_4K},
+    {"spi_cmd/single_read", run_cmd_single_read, NULL, 0},
+    {"spi_cmd/single_write", run_cmd_single_write, NULL, 0},
+    {"spi_cmd/internal_write", run_cmd_internal_write, NULL, 0},
+    {"spi_cmd/dma_ext_read", run_cmd_dma_ext_read, NULL, 0},
+    {"spi_cmd/single_write_nocrc", run_cmd_single_write_crc_off, NULL, 0},
+};
+
+// *****************************************************************************
+// Public code
+
+const mb_suite_t mb_nmspi_suite = {s_cases,
+                                   sizeof(s_cases) / sizeof(s_cases[0])};
+
+bool WDRV_WINC_SPISend(void *pTransmitData, size_t txSize) {
+  if (txSize > FRAME_MAX) {
+    return false;
+  }
+  memcpy(s_frame, pTransmitData, txSize);
+  s_frame_len = txSize;
+  return true;
+}
+
+bool WDRV_WINC_SPIReceive(void *pReceiveData, size_t rxSize) {
+  memset(pReceiveData, 0, rxSize);
+  return true;
+}
+
+void nm_sleep(uint32_t u32TimeMsec) { (void)u32TimeMsec; }
+
+// *****************************************************************************
+// Private (static) code
+
+static void run_crc7_byte(uint32_t n_ops) {
+  // Each step depends on the last, as it does inside crc7().
+  uint8_t crc = 0x7f;
+  for (uint32_t i = 0; i < n_ops; i++) {
+    crc = crc7_byte(crc, (uint8_t)i);
+  }
+  mb_sink += crc;
+}
+
+static void run_crc7_frame(uint32_t n_ops) {
+  uint8_t frame[8] = {CMD_SINGLE_WRITE, 0x00, 0x10, 0x84, 0, 0, 0, 0};
+  for (uint32_t i = 0; i < n_ops; i++) {
+    frame[7] = (uint8_t)i;
+    mb_sink += crc7(0x7f, frame, sizeof(frame));
+  }
+}
+
+static void run_crc7_block(uint32_t n_ops) {
+  for (uint32_t i = 0; i < n_ops; i++) {
+    mb_sink += crc7(0x7f, s_block, sizeof(s_block));
+  }
+}
+
+static void run_cmd_single_read(uint32_t n_ops) {
+  for (uint32_t i = 0; i < n_ops; i++) {
+    spi_cmd(CMD_SINGLE_READ, 0x1000 + (i & 0xfc), 0, 4, 0);
+  }
+  mb_sink += s_frame[s_frame_len - 1];
+}
+
+static void run_cmd_single_write(uint32_t n_ops) {
+  for (uint32_t i = 0; i < n_ops; i++) {
+    spi_cmd(CMD_SINGLE_WRITE, 0x1084, i, 4, 0);
+  }
+  mb_sink += s_frame[s_frame_len - 1];
+}
+
+static void run_cmd_internal_write(uint32_t n_ops) {
+  for (uint32_t i = 0; i < n_ops; i++) {
+    spi_cmd(CMD_INTERNAL_WRITE, NMI_SPI_PROTOCOL_OFFSET, i, 4, 0);
+  }
+  mb_sink += s_frame[s_frame_len - 1];
+}
+
+static void run_cmd_dma_ext_read(uint32_t n_ops) {
+  for (uint32_t i = 0; i < n_ops; i++) {
+    spi_cmd(CMD_DMA_EXT_READ, 0xd0000 + (i & 0xffc), 0, DATA_PKT_SZ_4K, 0);
+  }
+  mb_sink += s_frame[s_frame_len - 1];
+}
+
+static void run_cmd_single_write_crc_off(uint32_t n_ops) {
+  gu8Crc_off = 1;
+  for (uint32_t i = 0; i < n_ops; i++) {
+    spi_cmd(CMD_SINGLE_WRITE, 0x1084, i, 4, 0);
+  }
+  gu8Crc_off = 0;
+  mb_sink += s_frame[s_frame_len - 1];
+}
+
+static void setup_block(void) {
+  for (size_t i = 0; i < sizeof(s_block); i++) {
+    s_block[i] = (uint8_t)(i * 7 + 3);
+  }
+}
@@ -0,0 +1,330 @@
+/**
+ * @file microbench.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+Microbenchmarks for the driver hot paths, run on a Linux host.
+
+usage: microbench [-o results.csv] [-b baseline.csv] [-x pct] [-t ms] [-r n]
+                  [filter ...]
+
+Each case is calibrated so that one sample takes about -t milliseconds
+(default 100), then timed -r times (default 5).  The median and the fastest
+sample are reported in ns per operation, with MB/s for cases that process
+bytes.  Only cases whose names contain one of the filters are run.
+
+-o writes the results as CSV, one line per case:
+  name,ops,ns_per_op,min_ns_per_op,mb_per_s
+-b reads an earlier results file and prints the change of each case against
+it.  A case whose median is more than -x percent (default 10) slower counts
+as a regression.
+
+Returns 0, or 1 if there was a regression against the baseline.
+*/
+
+// *****************************************************************************
+// Includes
+
+#include "microbench.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+#define DEFAULT_SAMPLE_MS 100
+#define DEFAULT_REPEATS 5
+#define DEFAULT_THRESHOLD_PCT 10.0
+#define MAX_REPEATS 25
+#define MAX_BASELINE_CASES 64
+#define MAX_NAME_LENGTH 64
+#define MAX_LINE_LENGTH 256
+
+typedef struct {
+  char name[MAX_NAME_LENGTH];
+  double ns_per_op;
+} baseline_t;
+
+typedef struct {
+  uint64_t ops; // per sample
+  double ns_per_op;
+  double min_ns_per_op;
+  double mb_per_s; // at the median, or 0
+} result_t;
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+/**
+ * @brief Calibrate and time one case.
+ */
+static void measure(const mb_case_t *c, result_t *r);
+
+/**
+ * @brief Return the wall time of one run of n_ops operations.
+ */
+static uint64_t time_run(const mb_case_t *c, uint32_t n_ops);
+
+static uint64_t now_ns(void);
+
+static bool is_selected(const char *name, int n_filters, char *filters[]);
+
+/**
+ * @brief Read a results file written with -o.  Return the number of cases,
+ * or -1 if it can't be read.
+ */
+static int read_baseline(const char *filename);
+
+/**
+ * @brief Return the baseline ns_per_op for name, or 0 if there is none.
+ */
+static double baseline_ns_per_op(const char *name);
+
+static int compare_doubles(const void *a, const void *b);
+
+// *****************************************************************************
+// Private (static) storage
+
+static const mb_suite_t *s_suites[] = {
+    &mb_nmspi_suite,
+    &mb_cloner_suite,
+    &mb_fatfs_suite,
+};
+
+static uint32_t s_sample_ms = DEFAULT_SAMPLE_MS;
+static int s_repeats = DEFAULT_REPEATS;
+
+static baseline_t s_baseline[MAX_BASELINE_CASES];
+static int s_n_baseline;
+
+// *****************************************************************************
+// Public code
+
+volatile uint32_t mb_sink;
+
+int main(int argc, char *argv[]) {
+  const char *results_filename = NULL;
+  const char *baseline_filename = NULL;
+  double threshold_pct = DEFAULT_THRESHOLD_PCT;
+  FILE *results = NULL;
+  int n_regressions = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "o:b:x:t:r:")) != -1) {
+    switch (opt) {
+    case 'o':
+      results_filename = optarg;
+      break;
+    case 'b':
+      baseline_filename = optarg;
+      break;
+    case 'x':
+      threshold_pct = atof(optarg);
+      break;
+    case 't':
+      s_sample_ms = (uint32_t)atoi(optarg);
+      break;
+    case 'r':
+      s_repeats = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr,
+              "usage: %s [-o results.csv] [-b baseline.csv] [-x pct] "
+              "[-t ms] [-r n] [filter ...]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if (s_sample_ms == 0 || s_repeats < 1 || s_repeats > MAX_REPEATS) {
+    fprintf(stderr, "-t must be > 0 and -r 1 to %d\n", MAX_REPEATS);
+    return 2;
+  }
+  if (baseline_filename &&
+      (s_n_baseline = read_baseline(baseline_filename)) < 0) {
+    fprintf(stderr, "Can't read baseline %s\n", baseline_filename);
+    return 2;
+  }
+  if (results_filename) {
+    if ((results = fopen(results_filename, "w")) == NULL) {
+      fprintf(stderr, "Can't create %s\n", results_filename);
+      return 2;
+    }
+    fprintf(results, "name,ops,ns_per_op,min_ns_per_op,mb_per_s\n");
+  }
+
+  printf("%-32s %10s %10s %10s %8s", "case", "ns/op", "min", "MB/s", "ops");
+  if (s_n_baseline > 0) {
+    printf(" %8s", "vs base");
+  }
+  printf("\n");
+
+  for (size_t s = 0; s < sizeof(s_suites) / sizeof(s_suites[0]); s++) {
+    for (size_t i = 0; i < s_suites[s]->n_cases; i++) {
+      const mb_case_t *c = &s_suites[s]->cases[i];
+      result_t r;
+
+      if (!is_selected(c->name, argc - optind, &argv[optind])) {
+        continue;
+      }
+      measure(c, &r);
+      printf("%-32s %10.2f %10.2f %10.1f %8llu",
+             c->name,
+             r.ns_per_op,
+             r.min_ns_per_op,
+             r.mb_per_s,
+             (unsigned long long)r.ops);
+      double base = baseline_ns_per_op(c->name);
+      if (base > 0) {
+        double change_pct = 100.0 * (r.ns_per_op - base) / base;
+        bool is_regression = change_pct > threshold_pct;
+        printf(" %+7.1f%%%s", change_pct, is_regression ? " SLOWER" : "");
+        n_regressions += is_regression;
+      }
+      printf("\n");
+      if (results) {
+        fprintf(results,
+                "%s,%llu,%.3f,%.3f,%.3f\n",
+                c->name,
+                (unsigned long long)r.ops,
+                r.ns_per_op,
+                r.min_ns_per_op,
+                r.mb_per_s);
+      }
+    }
+  }
+
+  if (results) {
+    fclose(results);
+  }
+  if (n_regressions) {
+    printf("%d regression(s) of more than %.1f%%\n",
+           n_regressions,
+           threshold_pct);
+  }
+  return n_regressions ? 1 : 0;
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static void measure(const mb_case_t *c, result_t *r) {
+  const uint64_t target_ns = (uint64_t)s_sample_ms * 1000000ull;
+  double samples[MAX_REPEATS];
+  uint32_t n_ops = 1;
+  uint64_t elapsed;
+
+  if (c->setup) {
+    c->setup();
+  }
+  // Grow n_ops until a run takes a tenth of the target, then scale it up.
+  while ((elapsed = time_run(c, n_ops)) < target_ns / 10 &&
+         n_ops < UINT32_MAX / 16) {
+    n_ops *= 2;
+  }
+  uint64_t scaled = (uint64_t)n_ops * target_ns / (elapsed ? elapsed : 1);
+  n_ops = scaled > UINT32_MAX ? UINT32_MAX : scaled < 1 ? 1 : (uint32_t)scaled;
+
+  for (int i = 0; i < s_repeats; i++) {
+    samples[i] = (double)time_run(c, n_ops) / n_ops;
+  }
+  qsort(samples, s_repeats, sizeof(samples[0]), compare_doubles);
+
+  r->ops = n_ops;
+  r->ns_per_op = samples[s_repeats / 2];
+  r->min_ns_per_op = samples[0];
+  r->mb_per_s = c->bytes_per_op ? c->bytes_per_op * 1000.0 / r->ns_per_op : 0;
+}
+
+static uint64_t time_run(const mb_case_t *c, uint32_t n_ops) {
+  uint64_t t0 = now_ns();
+  c->run(n_ops);
+  return now_ns() - t0;
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static bool is_selected(const char *name, int n_filters, char *filters[]) {
+  if (n_filters == 0) {
+    return true;
+  }
+  for (int i = 0; i < n_filters; i++) {
+    if (strstr(name, filters[i])) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static int read_baseline(const char *filename) {
+  char line[MAX_LINE_LENGTH];
+  int n = 0;
+  FILE *f = fopen(filename, "r");
+
+  if (f == NULL) {
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f) && n < MAX_BASELINE_CASES) {
+    char *comma = strchr(line, ',');
+    unsigned long long ops;
+    double ns_per_op;
+
+    if (comma == NULL || comma - line >= MAX_NAME_LENGTH ||
+        sscanf(comma + 1, "%llu,%lf", &ops, &ns_per_op) != 2) {
+      continue; // header, or not ours
+    }
+    memcpy(s_baseline[n].name, line, comma - line);
+    s_baseline[n].name[comma - line] = '\0';
+    s_baseline[n].ns_per_op = ns_per_op;
+    n += 1;
+  }
+  fclose(f);
+  return n;
+}
+
+static double baseline_ns_per_op(const char *name) {
+  for (int i = 0; i < s_n_baseline; i++) {
+    if (strcmp(s_baseline[i].name, name) == 0) {
+      return s_baseline[i].ns_per_op;
+    }
+  }
+  return 0;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double da = *(const double *)a;
+  double db = *(const double *)b;
+  return (da > db) - (da < db);
+}
@@ -0,0 +1,91 @@
+/**
+ * @file microbench.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief Minimal harness for timing driver hot paths on a Linux host.
+ *
+ * Each mb_*.c file includes one firmware or vendored source file verbatim, so
+ * that its static functions can be reached, and exports a table of cases.
+ * microbench.c calibrates, times and reports every case.
+ */
+
+#ifndef _MICROBENCH_H_
+#define _MICROBENCH_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stddef.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+/**
+ * @brief Run the operation under test n_ops times.  Fold results into
+ * mb_sink so that the compiler cannot discard the work.
+ */
+typedef void (*mb_run_fn)(uint32_t n_ops);
+
+typedef struct {
+  const char *name;      // "<function>/<variant>", unique
+  mb_run_fn run;         // timed
+  void (*setup)(void);   // untimed, run once before timing, may be NULL
+  uint32_t bytes_per_op; // for throughput, or 0
+} mb_case_t;
+
+typedef struct {
+  const mb_case_t *cases;
+  size_t n_cases;
+} mb_suite_t;
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Results are folded in here.
+ */
+extern volatile uint32_t mb_sink;
+
+extern const mb_suite_t mb_nmspi_suite;
+extern const mb_suite_t mb_cloner_suite;
+extern const mb_suite_t mb_fatfs_suite;
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _MICROBENCH_H_ */
@@ -0,0 +1,174 @@
+/**
+ * @file trace_decode.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+Host-side decoder for the firmware's binary trace log.
+
+usage: trace_decode trace.bin [trace.bin ...]
+
+Reads a file written by the firmware's 't' command (or winc_sim_bench -t) and
+prints one line per event, oldest first: the time since the first event, the
+time since the previous event, both in microseconds, and the event formatted
+with the strings from firmware/src/trace.h.  Decode with the trace.h of the
+firmware that wrote the file.
+
+The 32 bit timestamps wrap (every 71 s at 60 MHz): gaps longer than that
+between consecutive events are shown short.
+
+Returns 0 if every file was decoded.
+*/
+
+// *****************************************************************************
+// Includes
+
+#include "trace.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+static bool decode_file(const char *filename);
+
+static void print_entry(const trace_entry_t *entry,
+                        uint64_t ticks,
+                        uint32_t delta,
+                        uint32_t ticks_per_sec);
+
+// *****************************************************************************
+// Private (static) storage
+
+#define EXPAND_TRACE_FORMATS(_id, _fmt) _fmt,
+static const char *s_trace_formats[] = {TRACE_EVENTS(EXPAND_TRACE_FORMATS)};
+
+// *****************************************************************************
+// Public code
+
+int main(int argc, char *argv[]) {
+  int n_failed = 0;
+
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s trace.bin [trace.bin ...]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  for (int i = 1; i < argc; i++) {
+    if (!decode_file(argv[i])) {
+      n_failed += 1;
+    }
+  }
+  return (n_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static bool decode_file(const char *filename) {
+  trace_file_header_t header;
+  trace_entry_t entry;
+  uint64_t ticks = 0;
+  uint32_t prev = 0;
+  uint32_t n_read = 0;
+  FILE *f = fopen(filename, "rb");
+
+  if (f == NULL) {
+    perror(filename);
+    return false;
+  }
+  if ((fread(&header, sizeof(header), 1, f) != 1) ||
+      (header.magic != TRACE_MAGIC) || (header.version != TRACE_VERSION) ||
+      (header.ticks_per_sec == 0)) {
+    fprintf(stderr, "%s: not a trace file\n", filename);
+    fclose(f);
+    return false;
+  }
+  if (header.n_events != TRACE_N_EVENTS) {
+    fprintf(stderr,
+            "%s: written with %u event types, trace.h has %u\n",
+            filename,
+            header.n_events,
+            TRACE_N_EVENTS);
+  }
+  printf("%s: %u events", filename, header.n_entries);
+  if (header.n_lost != 0) {
+    printf(" (%u older events overwritten)", header.n_lost);
+  }
+  printf("\n%14s %12s\n", "us", "+us");
+
+  for (; n_read < header.n_entries; n_read++) {
+    if (fread(&entry, sizeof(entry), 1, f) != 1) {
+      break;
+    }
+    // unsigned arithmetic handles counter wrap
+    uint32_t delta = (n_read == 0) ? 0 : entry.ticks - prev;
+    ticks += delta;
+    prev = entry.ticks;
+    print_entry(&entry, ticks, delta, header.ticks_per_sec);
+  }
+  fclose(f);
+  if (n_read != header.n_entries) {
+    fprintf(stderr,
+            "%s: truncated after %u of %u events\n",
+            filename,
+            n_read,
+            header.n_entries);
+    return false;
+  }
+  return true;
+}
+
+static void print_entry(const trace_entry_t *entry,
+                        uint64_t ticks,
+                        uint32_t delta,
+                        uint32_t ticks_per_sec) {
+  printf("%14.2f %12.2f  ",
+         ticks * 1e6 / ticks_per_sec,
+         delta * 1e6 / ticks_per_sec);
+  if (entry->id < TRACE_N_EVENTS) {
+    // The formats use long conversions: widen each argument to match.
+    printf(s_trace_formats[entry->id],
+           (unsigned long)entry->args[0],
+           (unsigned long)entry->args[1],
+           (unsigned long)entry->args[2],
+           (unsigned long)entry->args[3]);
+  } else {
+    printf("unknown event %u: 0x%08x 0x%08x 0x%08x 0x%08x",
+           entry->id,
+           entry->args[0],
+           entry->args[1],
+           entry->args[2],
+           entry->args[3]);
+  }
+  printf("\n");
+}
+
+// *****************************************************************************
+// End of file
@@ -0,0 +1,537 @@
+/**
+ * @file uart_stream.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+Host-side sender for the firmware's `s` command: streams a WINC image to the
+board over its console UART (the EDBG virtual COM port), so a WINC can be
+updated without an image on the SD card.
+
+usage: uart_stream [-v] [-e n] [-w secs] port image.img
+
+port is the board's serial device, e.g. /dev/ttyACM0, or the pty that
+tools/winc_sim/winc_sim_stream links.  uart_stream sends the `s` command at
+the console baud rate, follows the board to the baud rate its HELLO asks for
+and sends the image as described in firmware/src/uart_stream.h: a sliding
+window of DATA frames, going back to the frame expected on a NAK, or to the
+last one ACKed if the board is silent for a while.  Console text from the
+board is printed as it arrives.
+
+-e n corrupts every nth DATA frame on its first transmission, to exercise
+the NAK path.  -w waits up to secs for port to appear.  -v prints every ACK
+and NAK.  Ctrl-C sends ABORT.
+
+Returns 0 if the board reports that the update succeeded.
+*/
+
+// *****************************************************************************
+// Includes
+
+#include "crc32.h"
+#include "stream_frame.h"
+#include "uart_stream.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+// How long to wait for HELLO, and for an ACK of START before sending it again.
+#define HELLO_TIMEOUT_MS 5000
+#define START_RETRY_MS 1000
+#define START_TRIES 5
+
+// Go back to the last frame ACKed after this long without hearing from the
+// board.  Longer than the board takes to erase and program a sector, so that
+// the frames resent do not pile up behind the ones still in its receive ring.
+#define RESEND_MS 2000
+
+// Give up after this many resends of the same frame.
+#define MAX_RESENDS 10
+
+// After the last ACK the board may still be programming and boot checking
+// the WINC before it sends DONE.
+#define DONE_TIMEOUT_MS 60000
+
+typedef struct {
+  uint32_t baud;
+  speed_t speed;
+} baud_rate_t;
+
+typedef struct {
+  uint32_t n_frames; // DATA frames in the image
+  uint32_t acked;    // frames the board has ACKed
+  uint32_t next;     // the frame to send next
+  uint32_t limit;    // the first frame the board has not let us send
+  uint32_t high;     // one past the highest frame sent so far
+  uint32_t n_sent;   // DATA frames sent, resends included
+  uint32_t n_naks;
+  uint32_t n_timeouts;
+  uint32_t n_corrupted;
+  uint32_t resends;  // of the frame at acked
+} sender_t;
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+static bool open_port(const char *port, int wait_secs);
+
+static bool set_baud(uint32_t baud);
+
+static bool load_image(const char *filename);
+
+/**
+ * @brief Wait up to timeout_ms for a frame from the board, printing console
+ * text as it arrives.  Return false on timeout or if the port fails.
+ */
+static bool await_frame(int timeout_ms);
+
+static bool send_frame(stream_frame_type_t type,
+                       uint16_t seq,
+                       const uint8_t *payload,
+                       uint16_t len);
+
+static bool handshake(void);
+
+static bool send_image(void);
+
+static bool send_data(sender_t *sender);
+
+/**
+ * @brief Widen a 16 bit seq from the board to a frame number near ref.
+ */
+static uint32_t widen(uint16_t seq, uint32_t ref);
+
+static bool await_done(void);
+
+static uint64_t now_ms(void);
+
+static void on_interrupt(int sig);
+
+// *****************************************************************************
+// Private (static) storage
+
+static const baud_rate_t s_baud_rates[] = {
+    {115200, B115200},
+    {230400, B230400},
+    {460800, B460800},
+    {921600, B921600},
+    {1000000, B1000000},
+    {2000000, B2000000},
+};
+
+static int s_fd = -1;
+static struct termios s_tio;
+
+static uint8_t *s_image;
+static uint32_t s_image_size;
+
+static stream_frame_decoder_t s_decoder;
+static uint8_t s_tx_buf[STREAM_FRAME_MAX_SZ];
+
+static uint16_t s_payload_sz;
+static int s_corrupt_every;
+static bool s_is_verbose;
+
+static volatile sig_atomic_t s_is_interrupted;
+
+// *****************************************************************************
+// Public code
+
+int main(int argc, char *argv[]) {
+  int wait_secs = 0;
+  uint64_t t0;
+  bool ok;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "ve:w:")) != -1) {
+    switch (opt) {
+    case 'v':
+      s_is_verbose = true;
+      break;
+    case 'e':
+      s_corrupt_every = atoi(optarg);
+      break;
+    case 'w':
+      wait_secs = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-v] [-e n] [-w secs] port image.img\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if (optind != argc - 2) {
+    fprintf(stderr, "usage: %s [-v] [-e n] [-w secs] port image.img\n",
+            argv[0]);
+    return 2;
+  }
+  if (!load_image(argv[optind + 1]) || !open_port(argv[optind], wait_secs)) {
+    return 1;
+  }
+  signal(SIGINT, on_interrupt);
+  // progress lines interleave with console text
+  setvbuf(stdout, NULL, _IOLBF, 0);
+  stream_frame_decoder_init(&s_decoder);
+
+  t0 = now_ms();
+  ok = handshake() && send_image();
+  if (!ok) {
+    send_frame(STREAM_FRAME_ABORT, 0, NULL, 0);
+    tcdrain(s_fd);
+    fprintf(stderr, "\nuart_stream: %s\n",
+            s_is_interrupted ? "interrupted" : "gave up");
+  } else {
+    ok = await_done();
+  }
+  if (ok) {
+    printf("\nuart_stream: board updated the WINC, %u bytes in %.1f s\n",
+           s_image_size,
+           (now_ms() - t0) / 1e3);
+  } else {
+    printf("\nuart_stream: update FAILED after %.1f s\n",
+           (now_ms() - t0) / 1e3);
+  }
+  set_baud(UART_STREAM_CONSOLE_BAUD);
+  close(s_fd);
+  return ok ? 0 : 1;
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static bool open_port(const char *port, int wait_secs) {
+  uint64_t deadline = now_ms() + (uint64_t)wait_secs * 1000;
+
+  while ((s_fd = open(port, O_RDWR | O_NOCTTY)) < 0) {
+    if ((errno != ENOENT) || (now_ms() >= deadline)) {
+      perror(port);
+      return false;
+    }
+    usleep(100000);
+  }
+  if (tcgetattr(s_fd, &s_tio) != 0) {
+    perror(port);
+    return false;
+  }
+  cfmakeraw(&s_tio);
+  s_tio.c_cflag |= CLOCAL | CREAD;
+  s_tio.c_cc[VMIN] = 0;
+  s_tio.c_cc[VTIME] = 0;
+  if (!set_baud(UART_STREAM_CONSOLE_BAUD)) {
+    return false;
+  }
+  tcflush(s_fd, TCIOFLUSH);
+  return true;
+}
+
+static bool set_baud(uint32_t baud) {
+  for (size_t i = 0; i < sizeof(s_baud_rates) / sizeof(s_baud_rates[0]);
+       i++) {
+    if (s_baud_rates[i].baud == baud) {
+      cfsetispeed(&s_tio, s_baud_rates[i].speed);
+      cfsetospeed(&s_tio, s_baud_rates[i].speed);
+      if (tcsetattr(s_fd, TCSANOW, &s_tio) != 0) {
+        perror("tcsetattr");
+        return false;
+      }
+      return true;
+    }
+  }
+  fprintf(stderr, "uart_stream: %u baud is not supported\n", baud);
+  return false;
+}
+
+static bool load_image(const char *filename) {
+  FILE *f = fopen(filename, "rb");
+  long size;
+
+  if (f == NULL) {
+    perror(filename);
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  s_image = malloc(size > 0 ? size : 1);
+  if ((size <= 0) || (s_image == NULL) ||
+      (fread(s_image, 1, size, f) != (size_t)size)) {
+    fprintf(stderr, "%s: cannot read\n", filename);
+    fclose(f);
+    return false;
+  }
+  fclose(f);
+  s_image_size = (uint32_t)size;
+  return true;
+}
+
+static bool await_frame(int timeout_ms) {
+  uint64_t deadline = now_ms() + timeout_ms;
+  struct pollfd pfd = {.fd = s_fd, .events = POLLIN};
+  uint8_t buf[256];
+  ssize_t n_read;
+  uint64_t now;
+
+  while (!s_is_interrupted) {
+    now = now_ms();
+    if ((now >= deadline) || (poll(&pfd, 1, (int)(deadline - now)) <= 0)) {
+      return false;
+    }
+    // Read a byte at a time so that a frame is not followed into the next.
+    while ((n_read = read(s_fd, buf, 1)) == 1) {
+      switch (stream_frame_decode(&s_decoder, buf[0])) {
+      case STREAM_FRAME_OK:
+        return true;
+      case STREAM_FRAME_NOISE:
+        putchar(buf[0]);
+        fflush(stdout);
+        break;
+      default:
+        break;
+      }
+    }
+    if (n_read < 0) {
+      perror("read");
+      return false;
+    }
+  }
+  return false;
+}
+
+static bool send_frame(stream_frame_type_t type,
+                       uint16_t seq,
+                       const uint8_t *payload,
+                       uint16_t len) {
+  size_t n_bytes = stream_frame_encode(s_tx_buf, type, seq, payload, len);
+  return write(s_fd, s_tx_buf, n_bytes) == (ssize_t)n_bytes;
+}
+
+static bool handshake(void) {
+  const stream_frame_t *frame = &s_decoder.frame;
+  uint8_t command = UART_STREAM_COMMAND;
+  uint8_t start[UART_STREAM_START_SZ];
+
+  if (write(s_fd, &command, 1) != 1) {
+    perror("write");
+    return false;
+  }
+  do {
+    if (!await_frame(HELLO_TIMEOUT_MS)) {
+      fprintf(stderr, "\nuart_stream: no HELLO from the board\n");
+      return false;
+    }
+  } while (frame->type != STREAM_FRAME_HELLO);
+  if ((frame->len != UART_STREAM_HELLO_SZ) ||
+      (stream_frame_get_u16(&frame->payload[0]) != UART_STREAM_VERSION)) {
+    fprintf(stderr, "\nuart_stream: the board speaks another version\n");
+    return false;
+  }
+  s_payload_sz = stream_frame_get_u16(&frame->payload[2]);
+  if ((s_payload_sz == 0) || (s_payload_sz > STREAM_FRAME_MAX_PAYLOAD) ||
+      !set_baud(stream_frame_get_u32(&frame->payload[8]))) {
+    return false;
+  }
+  printf("uart_stream: %u baud, %u byte frames, window %u\n",
+         stream_frame_get_u32(&frame->payload[8]),
+         s_payload_sz,
+         stream_frame_get_u16(&frame->payload[4]));
+
+  stream_frame_put_u32(&start[0], s_image_size);
+  stream_frame_put_u32(&start[4], crc32_compute(s_image, s_image_size));
+  for (int i = 0; i < START_TRIES; i++) {
+    uint64_t deadline = now_ms() + START_RETRY_MS;
+    if (!send_frame(STREAM_FRAME_START, 0, start, sizeof(start))) {
+      perror("write");
+      return false;
+    }
+    while (now_ms() < deadline &&
+           await_frame((int)(deadline - now_ms()))) {
+      if (frame->type == STREAM_FRAME_ACK) {
+        return true;
+      } else if ((frame->type == STREAM_FRAME_ABORT) ||
+                 (frame->type == STREAM_FRAME_DONE)) {
+        return false;
+      }
+    }
+    if (s_is_interrupted) {
+      return false;
+    }
+  }
+  fprintf(stderr, "\nuart_stream: the board did not ACK START\n");
+  return false;
+}
+
+static bool send_image(void) {
+  const stream_frame_t *frame = &s_decoder.frame;
+  sender_t sender = {0};
+  uint32_t seq;
+
+  sender.n_frames = (s_image_size + s_payload_sz - 1) / s_payload_sz;
+  // handshake() left START's ACK in the decoder.
+  sender.limit = widen(stream_frame_get_u16(frame->payload), 0);
+
+  while (sender.acked < sender.n_frames) {
+    while ((sender.next < sender.limit) &&
+           (sender.next < sender.n_frames)) {
+      if (!send_data(&sender)) {
+        return false;
+      }
+    }
+    if (!await_frame(RESEND_MS)) {
+      if (s_is_interrupted || (++sender.resends > MAX_RESENDS)) {
+        return false;
+      }
+      sender.n_timeouts += 1;
+      sender.next = sender.acked;
+      continue;
+    }
+    switch (frame->type) {
+    case STREAM_FRAME_ACK:
+      seq = widen(frame->seq, sender.acked);
+      if (seq > sender.acked) {
+        sender.acked = seq;
+        sender.resends = 0;
+      }
+      seq = widen(stream_frame_get_u16(frame->payload), sender.limit);
+      if ((frame->len == UART_STREAM_ACK_SZ) && (seq > sender.limit)) {
+        sender.limit = seq;
+      }
+      if (sender.next < sender.acked) {
+        sender.next = sender.acked;
+      }
+      if (s_is_verbose) {
+        printf("ACK %u, limit %u\n", sender.acked, sender.limit);
+      }
+      break;
+    case STREAM_FRAME_NAK:
+      // Everything after the frame expected is being dropped: go back.
+      seq = widen(frame->seq, sender.acked);
+      if (seq > sender.acked) {
+        sender.acked = seq;
+      }
+      if (++sender.resends > MAX_RESENDS) {
+        return false;
+      }
+      sender.n_naks += 1;
+      sender.next = sender.acked;
+      if (s_is_verbose) {
+        printf("NAK %u\n", sender.acked);
+      }
+      break;
+    case STREAM_FRAME_ABORT:
+    case STREAM_FRAME_DONE:
+      fprintf(stderr, "\nuart_stream: the board stopped the stream\n");
+      return false;
+    default:
+      break;
+    }
+  }
+  printf("uart_stream: %u frames sent for %u, %u NAKs, %u timeouts",
+         sender.n_sent,
+         sender.n_frames,
+         sender.n_naks,
+         sender.n_timeouts);
+  if (s_corrupt_every > 0) {
+    printf(", %u corrupted", sender.n_corrupted);
+  }
+  printf("\n");
+  return true;
+}
+
+static bool send_data(sender_t *sender) {
+  uint32_t offset = sender->next * s_payload_sz;
+  uint32_t n_bytes = s_image_size - offset;
+  size_t n_frame;
+
+  if (n_bytes > s_payload_sz) {
+    n_bytes = s_payload_sz;
+  }
+  n_frame = stream_frame_encode(s_tx_buf,
+                                STREAM_FRAME_DATA,
+                                (uint16_t)sender->next,
+                                &s_image[offset],
+                                (uint16_t)n_bytes);
+  if ((s_corrupt_every > 0) && (sender->next >= sender->high) &&
+      ((sender->next + 1) % s_corrupt_every == 0)) {
+    s_tx_buf[STREAM_FRAME_HEADER_SZ] ^= 0x01;
+    sender->n_corrupted += 1;
+  }
+  if (write(s_fd, s_tx_buf, n_frame) != (ssize_t)n_frame) {
+    perror("write");
+    return false;
+  }
+  sender->n_sent += 1;
+  sender->next += 1;
+  if (sender->next > sender->high) {
+    sender->high = sender->next;
+  }
+  return true;
+}
+
+static uint32_t widen(uint16_t seq, uint32_t ref) {
+  // signed arithmetic handles seq wrap
+  return ref + (int16_t)(seq - (uint16_t)ref);
+}
+
+static bool await_done(void) {
+  const stream_frame_t *frame = &s_decoder.frame;
+
+  while (await_frame(DONE_TIMEOUT_MS)) {
+    if ((frame->type == STREAM_FRAME_DONE) &&
+        (frame->len == UART_STREAM_DONE_SZ)) {
+      return stream_frame_get_u32(&frame->payload[0]) ==
+             UART_STREAM_STATUS_OK;
+    } else if (frame->type == STREAM_FRAME_ABORT) {
+      break;
+    }
+  }
+  fprintf(stderr, "\nuart_stream: no DONE from the board\n");
+  return false;
+}
+
+static uint64_t now_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void on_interrupt(int sig) {
+  s_is_interrupted = 1;
+}
+
+// *****************************************************************************
+// End of file
@@ -0,0 +1,285 @@
+/**
+ * @file definitions.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief Host (Linux) stand-in for the Harmony definitions.h.
+ *
+ * Declares just enough of SYS_FS, SYS_CONSOLE, SYS_DEBUG, SYS_TIME and the
+ * console UART for the cloner core to compile off-target.  SYS_FS is backed
+ * by ordinary files (see host_system.c), the UART by a pseudo-terminal (see
+ * host_uart.c), and SYS_TIME runs on the modeled clock of the simulated WINC
+ * (see winc_sim.h), so timings printed by the firmware are modeled times.
+ */
+
+#ifndef _DEFINITIONS_H_
+#define _DEFINITIONS_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// SYS_DEBUG
+
+typedef enum {
+  SYS_ERROR_FATAL = 0,
+  SYS_ERROR_ERROR = 1,
+  SYS_ERROR_WARNING = 2,
+  SYS_ERROR_INFO = 3,
+  SYS_ERROR_DEBUG = 4,
+} SYS_ERROR_LEVEL;
+
+extern SYS_ERROR_LEVEL host_error_level;
+
+/**
+ * @brief printf() for format strings written for the 32 bit target, where
+ * long is 32 bits: the 'l' length modifiers are dropped.
+ */
+void host_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+#define SYS_DEBUG_PRINT(level, fmt, ...)                                       \
+  do {                                                                         \
+    if ((level) <= host_error_level) {                                         \
+      host_printf(fmt, ##__VA_ARGS__);                                         \
+    }                                                                          \
+  } while (0)
+
+#define SYS_DEBUG_MESSAGE(level, message) SYS_DEBUG_PRINT(level, "%s", message)
+
+#define SYS_ASSERT(test, message)                                              \
+  do {                                                                         \
+    if (!(test)) {                                                             \
+      host_assert_failed(message, __FILE__, __LINE__);                         \
+    }                                                                          \
+  } while (0)
+
+void host_assert_failed(const char *message, const char *file, int line);
+
+// *****************************************************************************
+// SYS_CONSOLE
+
+#define SYS_CONSOLE_DEFAULT_INSTANCE 0
+
+extern bool host_console_is_quiet;
+
+#define SYS_CONSOLE_PRINT(fmt, ...)                                            \
+  do {                                                                         \
+    if (!host_console_is_quiet) {                                              \
+      host_printf(fmt, ##__VA_ARGS__);                                         \
+    }                                                                          \
+  } while (0)
+
+#define SYS_CONSOLE_MESSAGE(message) SYS_CONSOLE_PRINT("%s", message)
+
+#define SYS_CONSOLE_INDEX_0 0
+#define SYS_CONSOLE_PRINT_BUFFER_SIZE 200
+
+typedef uintptr_t SYS_CONSOLE_HANDLE;
+
+SYS_CONSOLE_HANDLE SYS_CONSOLE_HandleGet(unsigned index);
+
+/**
+ * @brief Output goes straight to stdout, so there is always room.
+ */
+ssize_t SYS_CONSOLE_WriteFreeBufferCountGet(SYS_CONSOLE_HANDLE handle);
+
+// *****************************************************************************
+// SYS_FS
+
+typedef uintptr_t SYS_FS_HANDLE;
+
+#define SYS_FS_HANDLE_INVALID ((SYS_FS_HANDLE)(-1))
+
+typedef enum {
+  SYS_FS_RES_SUCCESS = 0,
+  SYS_FS_RES_FAILURE = -1,
+} SYS_FS_RESULT;
+
+typedef enum {
+  SYS_FS_FILE_OPEN_READ = 0,
+  SYS_FS_FILE_OPEN_WRITE,
+  SYS_FS_FILE_OPEN_APPEND,
+  SYS_FS_FILE_OPEN_READ_PLUS,
+  SYS_FS_FILE_OPEN_WRITE_PLUS,
+  SYS_FS_FILE_OPEN_APPEND_PLUS,
+} SYS_FS_FILE_OPEN_ATTRIBUTES;
+
+typedef struct {
+  uint32_t fsize;
+  uint16_t fdate;
+  uint16_t ftime;
+  uint8_t fattrib;
+  char altname[13];
+  char fname[256];
+  char *lfname;
+  uint32_t lfsize;
+} SYS_FS_FSTAT;
+
+typedef enum {
+  SYS_FS_SEEK_SET,
+  SYS_FS_SEEK_CUR,
+  SYS_FS_SEEK_END,
+} SYS_FS_FILE_SEEK_CONTROL;
+
+SYS_FS_HANDLE SYS_FS_FileOpen(const char *fname,
+                              SYS_FS_FILE_OPEN_ATTRIBUTES attributes);
+SYS_FS_RESULT SYS_FS_FileClose(SYS_FS_HANDLE handle);
+size_t SYS_FS_FileRead(SYS_FS_HANDLE handle, void *buf, size_t nbyte);
+size_t SYS_FS_FileWrite(SYS_FS_HANDLE handle, const void *buf, size_t nbyte);
+int32_t SYS_FS_FileSeek(SYS_FS_HANDLE handle,
+                        int32_t offset,
+                        SYS_FS_FILE_SEEK_CONTROL whence);
+int32_t SYS_FS_FileTell(SYS_FS_HANDLE handle);
+int32_t SYS_FS_FileSize(SYS_FS_HANDLE handle);
+SYS_FS_RESULT SYS_FS_FileSync(SYS_FS_HANDLE handle);
+SYS_FS_RESULT SYS_FS_FileDirectoryRemove(const char *path);
+SYS_FS_RESULT SYS_FS_FileStat(const char *fname, SYS_FS_FSTAT *buf);
+
+// *****************************************************************************
+// SYS_TIME
+
+typedef uintptr_t SYS_TIME_HANDLE;
+
+#define SYS_TIME_HANDLE_INVALID ((SYS_TIME_HANDLE)(-1))
+
+typedef enum {
+  SYS_TIME_ERROR = 0,
+  SYS_TIME_SUCCESS,
+} SYS_TIME_RESULT;
+
+uint32_t SYS_TIME_FrequencyGet(void);
+uint32_t SYS_TIME_CounterGet(void);
+uint64_t SYS_TIME_Counter64Get(void);
+SYS_TIME_RESULT SYS_TIME_DelayMS(uint32_t ms, SYS_TIME_HANDLE *handle);
+bool SYS_TIME_DelayIsComplete(SYS_TIME_HANDLE handle);
+
+// *****************************************************************************
+// SERCOM2 USART (the console UART): see host_uart.c
+
+typedef enum {
+  USART_DATA_8_BIT = 0,
+} USART_DATA;
+
+typedef enum {
+  USART_PARITY_NONE = 0x2,
+} USART_PARITY;
+
+typedef enum {
+  USART_STOP_1_BIT = 0,
+} USART_STOP;
+
+typedef struct {
+  uint32_t baudRate;
+  USART_PARITY parity;
+  USART_DATA dataWidth;
+  USART_STOP stopBits;
+} USART_SERIAL_SETUP;
+
+bool SERCOM2_USART_SerialSetup(USART_SERIAL_SETUP *serialSetup,
+                               uint32_t clkFrequency);
+uint32_t SERCOM2_USART_FrequencyGet(void);
+bool SERCOM2_USART_TransmitComplete(void);
+size_t SERCOM2_USART_Write(uint8_t *pWrBuffer, const size_t size);
+size_t SERCOM2_USART_WriteCountGet(void);
+size_t SERCOM2_USART_Read(uint8_t *pRdBuffer, const size_t size);
+size_t SERCOM2_USART_ReadBufferSizeGet(void);
+
+/**
+ * @brief Connect the UART to a new pseudo-terminal, with a symlink to it at
+ * link_path.  Until then, nothing is received and writes are dropped.
+ */
+bool host_uart_open_pty(const char *link_path);
+
+/**
+ * @brief Return the most bytes that were ever waiting in the receive ring.
+ */
+size_t host_uart_high_water(void);
+
+/**
+ * @brief Return the # of received bytes dropped because the receive ring was
+ * full, as the target would drop them.
+ */
+size_t host_uart_dropped(void);
+
+// *****************************************************************************
+// SYS_PORTS
+
+typedef uint32_t SYS_PORT_PIN;
+
+#define SYS_PORT_PIN_NONE ((SYS_PORT_PIN)(-1))
+
+// *****************************************************************************
+// WDRV_WINC (SPI) and the winc_bus slots: one per simulated WINC
+
+typedef uintptr_t SYS_MODULE_INDEX;
+
+typedef struct {
+  SYS_MODULE_INDEX drvIndex;
+  uint32_t baudRateInHz;
+  SYS_PORT_PIN chipSelect;
+} WDRV_WINC_SPI_CFG;
+
+#define WDRV_WINC_SPI_MAX_TARGETS 4
+
+#define DRV_SPI_INDEX_0 0
+#define DRV_SPI_INDEX_1 1
+#define DRV_SPI_INDEX_2 2
+#define DRV_SPI_INDEX_3 3
+
+#define WDRV_WINC_RESETN_PIN 0
+#define WDRV_WINC_CHIP_EN_PIN 1
+#define WINC_BUS1_RESETN_PIN 2
+#define WINC_BUS1_CHIP_EN_PIN 3
+#define WINC_BUS2_RESETN_PIN 4
+#define WINC_BUS2_CHIP_EN_PIN 5
+#define WINC_BUS3_RESETN_PIN 6
+#define WINC_BUS3_CHIP_EN_PIN 7
+
+bool WDRV_WINC_SPIOpen(void);
+bool WDRV_WINC_SPITargetInitialize(unsigned int target,
+                                   const WDRV_WINC_SPI_CFG *const pInitData);
+bool WDRV_WINC_SPITargetSelect(unsigned int target);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _DEFINITIONS_H_ */
@@ -0,0 +1,134 @@
+/**
+ * @file osal.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief Host (Linux) stand-in for the Harmony bare-metal OSAL.
+ *
+ * The host build is single threaded, so semaphores and mutexes are plain
+ * counters with the same non-blocking semantics as osal_impl_basic.h.
+ */
+
+#ifndef _OSAL_H
+#define _OSAL_H
+
+// *****************************************************************************
+// Includes
+
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+#define OSAL_WAIT_FOREVER (uint16_t)0xFFFF
+
+#define OSAL_SEM_DECLARE(semID) uint8_t semID
+
+typedef uint8_t OSAL_SEM_HANDLE_TYPE;
+
+typedef enum {
+  OSAL_SEM_TYPE_BINARY,
+  OSAL_SEM_TYPE_COUNTING,
+} OSAL_SEM_TYPE;
+
+typedef enum {
+  OSAL_RESULT_NOT_IMPLEMENTED = -1,
+  OSAL_RESULT_FALSE = 0,
+  OSAL_RESULT_TRUE = 1,
+} OSAL_RESULT;
+
+static inline OSAL_RESULT OSAL_SEM_Create(OSAL_SEM_HANDLE_TYPE *semID,
+                                          OSAL_SEM_TYPE type,
+                                          uint8_t maxCount,
+                                          uint8_t initialCount) {
+  (void)type;
+  (void)maxCount;
+  *semID = initialCount;
+  return OSAL_RESULT_TRUE;
+}
+
+static inline OSAL_RESULT OSAL_SEM_Pend(OSAL_SEM_HANDLE_TYPE *semID,
+                                        uint16_t waitMS) {
+  (void)waitMS; // nothing else can post while we wait
+  if (*semID == 0) {
+    return OSAL_RESULT_FALSE;
+  }
+  *semID -= 1;
+  return OSAL_RESULT_TRUE;
+}
+
+static inline OSAL_RESULT OSAL_SEM_Post(OSAL_SEM_HANDLE_TYPE *semID) {
+  *semID += 1;
+  return OSAL_RESULT_TRUE;
+}
+
+static inline uint8_t OSAL_SEM_GetCount(OSAL_SEM_HANDLE_TYPE *semID) {
+  return *semID;
+}
+
+#define OSAL_MUTEX_DECLARE(mutexID) uint8_t mutexID
+
+typedef uint8_t OSAL_MUTEX_HANDLE_TYPE;
+
+static inline OSAL_RESULT OSAL_MUTEX_Create(OSAL_MUTEX_HANDLE_TYPE *mutexID) {
+  *mutexID = 1;
+  return OSAL_RESULT_TRUE;
+}
+
+static inline OSAL_RESULT OSAL_MUTEX_Delete(OSAL_MUTEX_HANDLE_TYPE *mutexID) {
+  (void)mutexID;
+  return OSAL_RESULT_TRUE;
+}
+
+static inline OSAL_RESULT OSAL_MUTEX_Lock(OSAL_MUTEX_HANDLE_TYPE *mutexID,
+                                          uint16_t waitMS) {
+  (void)waitMS;
+  if (*mutexID == 1) {
+    *mutexID = 0;
+    return OSAL_RESULT_TRUE;
+  }
+  return OSAL_RESULT_FALSE;
+}
+
+static inline OSAL_RESULT OSAL_MUTEX_Unlock(OSAL_MUTEX_HANDLE_TYPE *mutexID) {
+  *mutexID = 1;
+  return OSAL_RESULT_TRUE;
+}
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _OSAL_H */
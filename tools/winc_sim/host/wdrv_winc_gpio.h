@@ -0,0 +1,45 @@
+/**
+ * @file wdrv_winc_gpio.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief Host (Linux) stand-in for the WINC driver's GPIO interface, which
+ * winc_bus.c uses to switch reset and chip enable lines between slots.
+ */
+
+#ifndef _WDRV_WINC_GPIO_H
+#define _WDRV_WINC_GPIO_H
+
+// *****************************************************************************
+// Includes
+
+#include "definitions.h"
+
+// *****************************************************************************
+// Public declarations
+
+void WDRV_WINC_GPIOSelect(SYS_PORT_PIN resetN, SYS_PORT_PIN chipEn);
+
+#endif /* #ifndef _WDRV_WINC_GPIO_H */
@@ -0,0 +1,268 @@
+/**
+ * @file host_system.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+Host (Linux) implementations of the Harmony services declared in
+host/definitions.h.  SYS_FS files are ordinary files relative to the current
+directory; every access is charged to the modeled clock as an SD access.
+SYS_TIME counts modeled time at the same 60 MHz as the target's TC0.
+*/
+
+// *****************************************************************************
+// Includes
+
+#include "definitions.h"
+#include "image_cache.h"
+#include "sched.h"
+#include "winc_sim.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+#define SYS_TIME_FREQUENCY 60000000ul
+
+#define MAX_FORMAT_LENGTH 256
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+static FILE *to_file(SYS_FS_HANDLE handle);
+
+// *****************************************************************************
+// Public storage
+
+SYS_ERROR_LEVEL host_error_level = SYS_ERROR_ERROR;
+
+bool host_console_is_quiet = false;
+
+// *****************************************************************************
+// Public code
+
+void host_printf(const char *fmt, ...) {
+  char host_fmt[MAX_FORMAT_LENGTH];
+  size_t n = 0;
+  va_list ap;
+
+  // "%ld" => "%d", "%08lx" => "%08x", etc.  "%lld" is left alone.
+  for (const char *p = fmt; *p && (n < sizeof(host_fmt) - 1); p++) {
+    host_fmt[n++] = *p;
+    if (*p != '%') {
+      continue;
+    }
+    while (p[1] && (strchr("-+ #0123456789.*", p[1]) != NULL) &&
+           (n < sizeof(host_fmt) - 1)) {
+      host_fmt[n++] = *++p;
+    }
+    if ((p[1] == 'l') && (p[2] != 'l')) {
+      p++; // skip the 'l'
+    }
+  }
+  host_fmt[n] = '\0';
+  va_start(ap, fmt);
+  vprintf(host_fmt, ap);
+  va_end(ap);
+}
+
+void host_assert_failed(const char *message, const char *file, int line) {
+  fprintf(stderr, "\n%s:%d: assertion failed: %s\n", file, line, message);
+  abort();
+}
+
+SYS_FS_HANDLE SYS_FS_FileOpen(const char *fname,
+                              SYS_FS_FILE_OPEN_ATTRIBUTES attributes) {
+  static const char *modes[] = {"rb", "wb", "ab", "r+b", "w+b", "a+b"};
+  FILE *f = fopen(fname, modes[attributes]);
+
+  winc_sim_sd_access(false, 0);
+  return (f == NULL) ? SYS_FS_HANDLE_INVALID : (SYS_FS_HANDLE)f;
+}
+
+SYS_FS_RESULT SYS_FS_FileClose(SYS_FS_HANDLE handle) {
+  winc_sim_sd_access(true, 0);
+  return (fclose(to_file(handle)) == 0) ? SYS_FS_RES_SUCCESS
+                                         : SYS_FS_RES_FAILURE;
+}
+
+size_t SYS_FS_FileRead(SYS_FS_HANDLE handle, void *buf, size_t nbyte) {
+  size_t n = fread(buf, 1, nbyte, to_file(handle));
+  winc_sim_sd_access(false, n);
+  return n;
+}
+
+size_t SYS_FS_FileWrite(SYS_FS_HANDLE handle, const void *buf, size_t nbyte) {
+  size_t n = fwrite(buf, 1, nbyte, to_file(handle));
+  winc_sim_sd_access(true, n);
+  return (n == nbyte) ? n : (size_t)-1;
+}
+
+int32_t SYS_FS_FileSeek(SYS_FS_HANDLE handle,
+                        int32_t offset,
+                        SYS_FS_FILE_SEEK_CONTROL whence) {
+  static const int whences[] = {SEEK_SET, SEEK_CUR, SEEK_END};
+  FILE *f = to_file(handle);
+
+  if (fseek(f, offset, whences[whence]) != 0) {
+    return -1;
+  }
+  return (int32_t)ftell(f);
+}
+
+int32_t SYS_FS_FileTell(SYS_FS_HANDLE handle) {
+  return (int32_t)ftell(to_file(handle));
+}
+
+int32_t SYS_FS_FileSize(SYS_FS_HANDLE handle) {
+  FILE *f = to_file(handle);
+  long pos = ftell(f);
+  long size;
+
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, pos, SEEK_SET);
+  return (int32_t)size;
+}
+
+SYS_FS_RESULT SYS_FS_FileSync(SYS_FS_HANDLE handle) {
+  winc_sim_sd_access(true, 0);
+  return (fflush(to_file(handle)) == 0) ? SYS_FS_RES_SUCCESS
+                                         : SYS_FS_RES_FAILURE;
+}
+
+SYS_FS_RESULT SYS_FS_FileDirectoryRemove(const char *path) {
+  winc_sim_sd_access(true, 0);
+  return (unlink(path) == 0) ? SYS_FS_RES_SUCCESS : SYS_FS_RES_FAILURE;
+}
+
+SYS_FS_RESULT SYS_FS_FileStat(const char *fname, SYS_FS_FSTAT *buf) {
+  struct stat st;
+  struct tm tm;
+
+  winc_sim_sd_access(false, 0);
+  if ((stat(fname, &st) != 0) || (localtime_r(&st.st_mtime, &tm) == NULL)) {
+    return SYS_FS_RES_FAILURE;
+  }
+  buf->fsize = (uint32_t)st.st_size;
+  // As FAT keeps them, and as tools/image_plan stamps a plan.
+  buf->fdate = ((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday;
+  buf->ftime = (tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2);
+  return SYS_FS_RES_SUCCESS;
+}
+
+uint32_t SYS_TIME_FrequencyGet(void) { return SYS_TIME_FREQUENCY; }
+
+uint32_t SYS_TIME_CounterGet(void) { return (uint32_t)SYS_TIME_Counter64Get(); }
+
+uint64_t SYS_TIME_Counter64Get(void) {
+  return winc_sim_now_ns() * (SYS_TIME_FREQUENCY / 1000000) / 1000;
+}
+
+SYS_TIME_RESULT SYS_TIME_DelayMS(uint32_t ms, SYS_TIME_HANDLE *handle) {
+  // nothing else runs meanwhile, so just advance the clock
+  winc_sim_advance_ns(ms * 1000000ull);
+  *handle = 0;
+  return SYS_TIME_SUCCESS;
+}
+
+bool SYS_TIME_DelayIsComplete(SYS_TIME_HANDLE handle) {
+  (void)handle;
+  return true;
+}
+
+SYS_CONSOLE_HANDLE SYS_CONSOLE_HandleGet(unsigned index) { return index; }
+
+ssize_t SYS_CONSOLE_WriteFreeBufferCountGet(SYS_CONSOLE_HANDLE handle) {
+  (void)handle;
+  return SYS_CONSOLE_PRINT_BUFFER_SIZE;
+}
+
+// The host build has no scheduler: the cloner is stepped directly, and the
+// trace formatter task is never run (trace_dump() still works).
+
+sched_task_id_t sched_task_create(const char *name,
+                                  sched_step_fn step_fn,
+                                  uint8_t priority) {
+  (void)name;
+  (void)step_fn;
+  (void)priority;
+  return SCHED_TASK_ID_INVALID;
+}
+
+void sched_sleep_ms(uint32_t ms) { (void)ms; }
+
+void sched_wait_ms(uint32_t ms) { (void)ms; }
+
+void sched_signal(sched_task_id_t id, uint32_t events) {
+  (void)id;
+  (void)events;
+}
+
+uint32_t sched_take_events(void) { return 0; }
+
+// The host build has no internal flash, so the image cache is always empty.
+
+void image_cache_init(void) {}
+
+bool image_cache_stage(const char *filename) {
+  (void)filename;
+  return false;
+}
+
+bool image_cache_is_valid(void) { return false; }
+
+const char *image_cache_image_name(void) { return ""; }
+
+uint32_t image_cache_image_size(void) { return 0; }
+
+bool image_cache_read(uint8_t *dst, uint32_t addr, size_t n_bytes) {
+  (void)dst;
+  (void)addr;
+  (void)n_bytes;
+  return false;
+}
+
+bool image_cache_get_plan(image_plan_t *plan) {
+  (void)plan;
+  return false;
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static FILE *to_file(SYS_FS_HANDLE handle) { return (FILE *)handle; }
+
+// *****************************************************************************
+// End of file
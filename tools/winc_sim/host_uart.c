@@ -0,0 +1,316 @@
+/**
+ * @file host_uart.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+Host (Linux) stand-in for the console UART (SERCOM2 in ring buffer mode),
+declared in host/definitions.h.  host_uart_open_pty() puts a pseudo-terminal
+behind it, so a host program such as tools/uart_stream can talk to the
+firmware's uart_stream.c as it would to the EDBG virtual COM port.
+
+Once the pty is open, the modeled clock and the wall clock are kept in step:
+a read sleeps until the wall clock catches up with the time that the WINC
+has been modeled as busy, and a read that finds nothing advances the modeled
+clock to the wall clock.  The sender therefore sees the WINC's erase and
+program times, and the firmware's timeouts run in real time.
+
+Received bytes are modeled as the target gets them.  Whatever the sender
+writes is taken off the pty at once (so the pty never holds the sender back)
+and then arrives at the baud rate set by SERCOM2_USART_SerialSetup(), into a
+receive ring of the target's size.  A byte that arrives while the ring is
+full, say because the firmware was busy with the WINC, is dropped and
+counted.  Writes are not paced.
+*/
+
+// *****************************************************************************
+// Includes
+
+// For posix_openpt() and friends.
+#define _GNU_SOURCE
+
+#include "definitions.h"
+#include "winc_sim.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+// As in the firmware's plib_sercom2_usart.c, whose ring keeps a byte free
+#define READ_BUFFER_SIZE 4096
+#define FREQUENCY 60000000ul
+
+// The console baud rate, until SERCOM2_USART_SerialSetup() changes it
+#define INITIAL_BAUD 115200
+
+// 8N1: a start bit, eight data bits and a stop bit
+#define BITS_PER_BYTE 10
+
+// Bytes taken off the pty that have yet to arrive: far more than a sender
+// that honours the board's window has in flight.
+#define WIRE_SIZE 65536
+
+// How long a read that finds nothing waits for more.
+#define IDLE_POLL_MS 1
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+/**
+ * @brief Bring the modeled and wall clocks back in step.
+ */
+static void pace(void);
+
+/**
+ * @brief Take whatever the sender has written off the pty.
+ */
+static void drain_pty(void);
+
+/**
+ * @brief Move the bytes that have arrived by now into the receive ring, as
+ * the target's receive interrupt would, dropping those that find it full.
+ */
+static void arrive(void);
+
+/**
+ * @brief Return the wall clock since the pty opened.
+ */
+static uint64_t wall_elapsed_ns(void);
+
+static uint64_t wall_ns(void);
+
+// *****************************************************************************
+// Private (static) storage
+
+static int s_master_fd = -1;
+static int s_slave_fd = -1; // held open so the pty outlives its clients
+
+static uint64_t s_wall_start_ns;  // wall clock when the pty opened
+static uint64_t s_model_start_ns; // modeled clock when the pty opened
+
+static uint32_t s_baud = INITIAL_BAUD;
+
+static uint8_t s_wire[WIRE_SIZE]; // taken off the pty, yet to arrive
+static size_t s_wire_head;        // index of the next byte to arrive
+static size_t s_wire_count;       // # of bytes in s_wire[]
+static uint64_t s_wire_ns;        // wall_elapsed_ns() when the last one did
+
+static uint8_t s_ring[READ_BUFFER_SIZE]; // the target's receive ring
+static size_t s_ring_head;               // index of the oldest byte
+static size_t s_ring_count;              // # of bytes in s_ring[]
+
+static size_t s_high_water;
+static size_t s_n_dropped;
+
+// *****************************************************************************
+// Public code
+
+bool host_uart_open_pty(const char *link_path) {
+  struct termios tio;
+  const char *slave_name;
+
+  s_master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+  if ((s_master_fd < 0) || (grantpt(s_master_fd) != 0) ||
+      (unlockpt(s_master_fd) != 0) ||
+      ((slave_name = ptsname(s_master_fd)) == NULL)) {
+    perror("pty");
+    return false;
+  }
+  s_slave_fd = open(slave_name, O_RDWR | O_NOCTTY);
+  if ((s_slave_fd < 0) || (tcgetattr(s_slave_fd, &tio) != 0)) {
+    perror(slave_name);
+    return false;
+  }
+  // no echo or line editing until the client sets up the port itself
+  cfmakeraw(&tio);
+  tcsetattr(s_slave_fd, TCSANOW, &tio);
+  fcntl(s_master_fd, F_SETFL, fcntl(s_master_fd, F_GETFL) | O_NONBLOCK);
+
+  unlink(link_path);
+  if (symlink(slave_name, link_path) != 0) {
+    perror(link_path);
+    return false;
+  }
+  s_wall_start_ns = wall_ns();
+  s_model_start_ns = winc_sim_now_ns();
+  return true;
+}
+
+size_t host_uart_high_water(void) { return s_high_water; }
+
+size_t host_uart_dropped(void) { return s_n_dropped; }
+
+bool SERCOM2_USART_SerialSetup(USART_SERIAL_SETUP *serialSetup,
+                               uint32_t clkFrequency) {
+  (void)clkFrequency;
+  if ((serialSetup == NULL) || (serialSetup->baudRate == 0)) {
+    return false;
+  }
+  s_baud = serialSetup->baudRate;
+  return true;
+}
+
+uint32_t SERCOM2_USART_FrequencyGet(void) { return FREQUENCY; }
+
+bool SERCOM2_USART_TransmitComplete(void) { return true; }
+
+size_t SERCOM2_USART_Write(uint8_t *pWrBuffer, const size_t size) {
+  size_t n_written = 0;
+
+  if (s_master_fd < 0) {
+    return size;
+  }
+  while (n_written < size) {
+    ssize_t n = write(s_master_fd, &pWrBuffer[n_written], size - n_written);
+    if (n > 0) {
+      n_written += n;
+    } else if ((n < 0) && (errno != EAGAIN) && (errno != EINTR)) {
+      break;
+    } else {
+      // the client is not reading: wait for room
+      struct pollfd pfd = {.fd = s_master_fd, .events = POLLOUT};
+      poll(&pfd, 1, IDLE_POLL_MS);
+    }
+  }
+  return n_written;
+}
+
+size_t SERCOM2_USART_WriteCountGet(void) { return 0; }
+
+size_t SERCOM2_USART_Read(uint8_t *pRdBuffer, const size_t size) {
+  struct pollfd pfd = {.fd = s_master_fd, .events = POLLIN};
+  size_t n_read = 0;
+
+  if (s_master_fd < 0) {
+    return 0;
+  }
+  pace();
+  arrive();
+  while ((n_read < size) && (s_ring_count > 0)) {
+    pRdBuffer[n_read++] = s_ring[s_ring_head];
+    s_ring_head = (s_ring_head + 1) % READ_BUFFER_SIZE;
+    s_ring_count -= 1;
+  }
+  if (n_read > 0) {
+    return n_read;
+  }
+  if (s_wire_count == 0) {
+    // Nothing on the way: wait a little rather than spin, and let time pass.
+    poll(&pfd, 1, IDLE_POLL_MS);
+  }
+  pace();
+  return 0;
+}
+
+size_t SERCOM2_USART_ReadBufferSizeGet(void) { return READ_BUFFER_SIZE - 1; }
+
+// *****************************************************************************
+// Private (static) code
+
+static void pace(void) {
+  uint64_t model = winc_sim_now_ns() - s_model_start_ns;
+  uint64_t wall = wall_elapsed_ns();
+
+  if (model > wall) {
+    // The WINC is still busy, but the sender carries on: keep taking its
+    // bytes off the pty, a millisecond at a time.
+    while (model > wall) {
+      uint64_t wait = model - wall;
+      struct timespec ts = {.tv_sec = 0,
+                            .tv_nsec = (wait < 1000000) ? wait : 1000000};
+      nanosleep(&ts, NULL);
+      drain_pty();
+      wall = wall_elapsed_ns();
+    }
+  } else {
+    winc_sim_advance_ns(wall - model);
+  }
+}
+
+static void drain_pty(void) {
+  ssize_t n;
+
+  if ((s_wire_count == 0) && (s_wire_ns < wall_elapsed_ns())) {
+    // the line was idle: what comes next starts arriving now
+    s_wire_ns = wall_elapsed_ns();
+  }
+  while (s_wire_count < WIRE_SIZE) {
+    size_t tail = (s_wire_head + s_wire_count) % WIRE_SIZE;
+    size_t room = WIRE_SIZE - s_wire_count;
+    if (room > WIRE_SIZE - tail) {
+      room = WIRE_SIZE - tail;
+    }
+    n = read(s_master_fd, &s_wire[tail], room);
+    if (n <= 0) {
+      return;
+    }
+    s_wire_count += n;
+  }
+}
+
+static void arrive(void) {
+  uint64_t byte_ns = BITS_PER_BYTE * 1000000000ull / s_baud;
+  uint64_t now;
+
+  drain_pty();
+  now = wall_elapsed_ns();
+  while ((s_wire_count > 0) && (s_wire_ns + byte_ns <= now)) {
+    s_wire_ns += byte_ns;
+    if (s_ring_count < READ_BUFFER_SIZE - 1) {
+      s_ring[(s_ring_head + s_ring_count) % READ_BUFFER_SIZE] =
+          s_wire[s_wire_head];
+      s_ring_count += 1;
+    } else {
+      s_n_dropped += 1;
+    }
+    s_wire_head = (s_wire_head + 1) % WIRE_SIZE;
+    s_wire_count -= 1;
+  }
+  if (s_ring_count > s_high_water) {
+    s_high_water = s_ring_count;
+  }
+}
+
+static uint64_t wall_elapsed_ns(void) { return wall_ns() - s_wall_start_ns; }
+
+static uint64_t wall_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// *****************************************************************************
+// End of file
@@ -0,0 +1,74 @@
+/**
+ * @file host_winc_bus.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+Host (Linux) stand-ins for the parts of the WINC driver that winc_bus.c
+calls.  Each winc_bus slot is one of the simulated WINCs: selecting an SPI
+target selects the device in winc_sim.  The simulated WINCs need no reset or
+SPI CRC negotiation, so there is no per-slot driver state to save and
+restore.
+*/
+
+// *****************************************************************************
+// Includes
+
+#include "definitions.h"
+#include "nm_common.h"
+#include "nmspi.h"
+#include "wdrv_winc_gpio.h"
+#include "winc_sim.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// Public code
+
+bool WDRV_WINC_SPIOpen(void) { return true; }
+
+bool WDRV_WINC_SPITargetInitialize(unsigned int target,
+                                   const WDRV_WINC_SPI_CFG *const pInitData) {
+  (void)pInitData;
+  return target < WINC_SIM_N_DEVICES;
+}
+
+bool WDRV_WINC_SPITargetSelect(unsigned int target) {
+  return winc_sim_select(target);
+}
+
+void WDRV_WINC_GPIOSelect(SYS_PORT_PIN resetN, SYS_PORT_PIN chipEn) {
+  (void)resetN;
+  (void)chipEn;
+}
+
+void nm_reset(void) {}
+
+uint8_t nm_spi_get_crc_off(void) { return 1; }
+
+void nm_spi_set_crc_off(uint8_t u8CrcOff) { (void)u8CrcOff; }
+
+// *****************************************************************************
+// End of file
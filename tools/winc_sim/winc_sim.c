@@ -0,0 +1,502 @@
+/**
+ * @file winc_sim.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "winc_sim.h"
+
+#include "bus_capture.h"
+#include "nmasic.h"
+#include "nmbus.h"
+#include "nmdrv.h"
+#include "ota_control.h"
+#include "spi_flash_map.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+// WINC registers and memory used by spi_flash.c (see spi_flash.c)
+#define CHIP_ID_REG 0x1000
+#define DUMMY_REGISTER 0x1084
+#define SPI_FLASH_BASE 0x10200
+#define SPI_FLASH_MODE (SPI_FLASH_BASE + 0x00)
+#define SPI_FLASH_CMD_CNT (SPI_FLASH_BASE + 0x04)
+#define SPI_FLASH_DATA_CNT (SPI_FLASH_BASE + 0x08)
+#define SPI_FLASH_BUF1 (SPI_FLASH_BASE + 0x0c)
+#define SPI_FLASH_BUF2 (SPI_FLASH_BASE + 0x10)
+#define SPI_FLASH_BUF_DIR (SPI_FLASH_BASE + 0x14)
+#define SPI_FLASH_TR_DONE (SPI_FLASH_BASE + 0x18)
+#define SPI_FLASH_DMA_ADDR (SPI_FLASH_BASE + 0x1c)
+
+#define SHARED_MEM_BASE 0xd0000
+#define SHARED_MEM_SIZE (64 * 1024ul)
+
+#define CHIP_ID 0x1503a0
+#define FLASH_ID 0x1420c2 // MX25L8006E: 8 Mbit
+
+// SPI flash commands
+#define CMD_WRITE_DISABLE 0x04
+#define CMD_READ_STATUS 0x05
+#define CMD_WRITE_ENABLE 0x06
+#define CMD_PAGE_PROGRAM 0x02
+#define CMD_FAST_READ 0x0b
+#define CMD_SECTOR_ERASE 0x20
+#define CMD_BLOCK_ERASE_32K 0x52
+#define CMD_READ_ID 0x9f
+
+#define STATUS_WIP 0x01
+#define STATUS_WEL 0x02
+
+#define SECTOR_SIZE 4096
+#define BLOCK_SIZE 32768
+#define PAGE_SIZE 256
+
+// Approximate SPI bytes per nm_* transaction, excluding block data.
+#define REG_XFER_BYTES 12
+#define BLOCK_XFER_BYTES 8
+
+/**
+ * @brief One WINC and its SPI flash.
+ */
+typedef struct {
+  uint8_t flash[WINC_SIM_FLASH_SIZE];
+  uint8_t shared_mem[SHARED_MEM_SIZE];
+  uint32_t data_cnt;
+  uint32_t buf1;
+  uint32_t dma_addr;
+  uint32_t dummy;
+  bool write_enabled;
+  uint64_t dma_done_ns;   // SPI_FLASH_TR_DONE reads 0 until then
+  uint64_t flash_busy_ns; // status WIP reads 1 until then
+  uint32_t fw_version;    // of the running firmware, or 0 if it is halted
+} winc_sim_device_t;
+
+/**
+ * @brief The WINCs share the clock, the timing model and the counters.
+ */
+typedef struct {
+  winc_sim_device_t devices[WINC_SIM_N_DEVICES];
+  winc_sim_device_t *dev; // the selected device
+  uint64_t now_ns;
+  winc_sim_timing_t timing;
+  winc_sim_stats_t stats;
+} winc_sim_t;
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+/**
+ * @brief Charge one bus transaction of n_bytes to the clock and counters.
+ */
+static void bus_xfer(size_t n_bytes);
+
+/**
+ * @brief Return the time to move n_bytes at clock_hz.
+ */
+static uint64_t xfer_ns(size_t n_bytes, uint32_t clock_hz);
+
+/**
+ * @brief Carry out the flash command set up in the SPI_FLASH_* registers.
+ */
+static void execute_command(uint32_t cmd_cnt);
+
+/**
+ * @brief Return a pointer to n_bytes of shared memory at addr, or NULL if
+ * out of range.
+ */
+static uint8_t *shared_mem(uint32_t addr, size_t n_bytes);
+
+// *****************************************************************************
+// Private (static) storage
+
+static winc_sim_t s_sim;
+
+static const winc_sim_timing_t s_default_timing = {
+    .spi_clock_hz = 24000000,
+    .xfer_overhead_ns = 5000,
+    .flash_clock_hz = 40000000,
+    .erase_ns = 45000000,
+    .block_erase_ns = 250000000,
+    .program_ns = 850000,
+    .sd_read_bps = 2000000,
+    .sd_write_bps = 1000000,
+    .sd_overhead_ns = 100000,
+    // nm_reset()'s 120 ms of delays, then the boot ROM loading the firmware
+    .boot_ns = 250000000,
+};
+
+// *****************************************************************************
+// Public code
+
+void winc_sim_init(void) {
+  memset(&s_sim, 0, sizeof(s_sim));
+  for (int i = 0; i < WINC_SIM_N_DEVICES; i++) {
+    memset(s_sim.devices[i].flash, 0xff, sizeof(s_sim.devices[i].flash));
+  }
+  s_sim.dev = &s_sim.devices[0];
+  s_sim.timing = s_default_timing;
+}
+
+bool winc_sim_select(int device) {
+  if ((device < 0) || (device >= WINC_SIM_N_DEVICES)) {
+    return false;
+  }
+  s_sim.dev = &s_sim.devices[device];
+  return true;
+}
+
+winc_sim_timing_t *winc_sim_timing(void) { return &s_sim.timing; }
+
+bool winc_sim_load(const char *filename) {
+  FILE *f = fopen(filename, "rb");
+
+  if (f == NULL) {
+    return false;
+  }
+  memset(s_sim.dev->flash, 0xff, sizeof(s_sim.dev->flash));
+  fread(s_sim.dev->flash, 1, sizeof(s_sim.dev->flash), f);
+  fclose(f);
+  return true;
+}
+
+const uint8_t *winc_sim_flash(void) { return s_sim.dev->flash; }
+
+const winc_sim_stats_t *winc_sim_stats(void) { return &s_sim.stats; }
+
+void winc_sim_reset_stats(void) {
+  memset(&s_sim.stats, 0, sizeof(s_sim.stats));
+}
+
+uint64_t winc_sim_now_ns(void) { return s_sim.now_ns; }
+
+void winc_sim_advance_ns(uint64_t ns) { s_sim.now_ns += ns; }
+
+void winc_sim_sd_access(bool is_write, size_t n_bytes) {
+  winc_sim_timing_t *timing = &s_sim.timing;
+  uint32_t bps = is_write ? timing->sd_write_bps : timing->sd_read_bps;
+
+  if (is_write) {
+    s_sim.stats.sd_writes += 1;
+  } else {
+    s_sim.stats.sd_reads += 1;
+  }
+  s_sim.stats.sd_bytes += n_bytes;
+  s_sim.now_ns += timing->sd_overhead_ns + n_bytes * 1000000000ull / bps;
+}
+
+// The nm_* bus interface (nmbus.h), captured just as the firmware's nmbus.c
+
+uint32_t nm_read_reg(uint32_t u32Addr) {
+  uint32_t val = 0;
+  nm_read_reg_with_ret(u32Addr, &val);
+  return val;
+}
+
+int8_t nm_read_reg_with_ret(uint32_t u32Addr, uint32_t *pu32RetVal) {
+  BUS_CAPTURE_BEGIN();
+  s_sim.stats.reg_reads += 1;
+  bus_xfer(REG_XFER_BYTES);
+
+  switch (u32Addr) {
+  case CHIP_ID_REG:
+    *pu32RetVal = CHIP_ID;
+    break;
+  case DUMMY_REGISTER:
+    *pu32RetVal = s_sim.dev->dummy;
+    break;
+  case SPI_FLASH_TR_DONE:
+    *pu32RetVal = (s_sim.now_ns >= s_sim.dev->dma_done_ns) ? 1 : 0;
+    break;
+  default:
+    // efuse, pinmux, etc: reads as zero
+    *pu32RetVal = 0;
+    break;
+  }
+  BUS_CAPTURE_END(
+      BUS_CAPTURE_REG_READ, u32Addr, *pu32RetVal, 4, M2M_SUCCESS);
+  return M2M_SUCCESS;
+}
+
+int8_t nm_write_reg(uint32_t u32Addr, uint32_t u32Val) {
+  BUS_CAPTURE_BEGIN();
+  s_sim.stats.reg_writes += 1;
+  bus_xfer(REG_XFER_BYTES);
+
+  switch (u32Addr) {
+  case SPI_FLASH_DATA_CNT:
+    s_sim.dev->data_cnt = u32Val;
+    break;
+  case SPI_FLASH_BUF1:
+    s_sim.dev->buf1 = u32Val;
+    break;
+  case SPI_FLASH_DMA_ADDR:
+    s_sim.dev->dma_addr = u32Val;
+    break;
+  case SPI_FLASH_CMD_CNT:
+    execute_command(u32Val);
+    break;
+  default:
+    // SPI_FLASH_BUF2, SPI_FLASH_BUF_DIR, pinmux, etc: ignored
+    break;
+  }
+  BUS_CAPTURE_END(BUS_CAPTURE_REG_WRITE, u32Addr, u32Val, 4, M2M_SUCCESS);
+  return M2M_SUCCESS;
+}
+
+int8_t nm_read_block(uint32_t u32Addr, uint8_t *puBuf, uint32_t u32Sz) {
+  uint8_t *src = shared_mem(u32Addr, u32Sz);
+  int8_t ret = M2M_ERR_BUS_FAIL;
+
+  BUS_CAPTURE_BEGIN();
+  s_sim.stats.block_reads += 1;
+  bus_xfer(BLOCK_XFER_BYTES + u32Sz);
+  if (src != NULL) {
+    memcpy(puBuf, src, u32Sz);
+    ret = M2M_SUCCESS;
+  }
+  BUS_CAPTURE_END(BUS_CAPTURE_BLOCK_READ, u32Addr, 0, u32Sz, ret);
+  return ret;
+}
+
+int8_t nm_write_block(uint32_t u32Addr, uint8_t *puBuf, uint32_t u32Sz) {
+  uint8_t *dst = shared_mem(u32Addr, u32Sz);
+  int8_t ret = M2M_ERR_BUS_FAIL;
+
+  BUS_CAPTURE_BEGIN();
+  s_sim.stats.block_writes += 1;
+  bus_xfer(BLOCK_XFER_BYTES + u32Sz);
+  if (dst != NULL) {
+    memcpy(dst, puBuf, u32Sz);
+    ret = M2M_SUCCESS;
+  }
+  BUS_CAPTURE_END(BUS_CAPTURE_BLOCK_WRITE, u32Addr, 0, u32Sz, ret);
+  return ret;
+}
+
+// The parts of the WINC driver that spi_flash.c and winc_cloner.c call.
+
+uint32_t nmi_get_chipid(void) { return CHIP_ID; }
+
+uint32_t nmi_get_chipid_cache(void) { return CHIP_ID; }
+
+void nmi_set_chipid_cache(uint32_t u32ChipId) { (void)u32ChipId; }
+
+int8_t nmi_get_otp_mac_address(uint8_t *pu8MacAddr, uint8_t *pu8IsValid) {
+  // a distinct, programmed MAC address for each simulated WINC
+  static const uint8_t mac[6] = {0xf8, 0xf0, 0x05, 0x00, 0x00, 0x00};
+
+  memcpy(pu8MacAddr, mac, sizeof(mac));
+  pu8MacAddr[5] = (uint8_t)(s_sim.dev - s_sim.devices);
+  *pu8IsValid = 1;
+  return M2M_SUCCESS;
+}
+
+int8_t m2m_wifi_download_mode(void) {
+  s_sim.dev->fw_version = 0; // reset and halted
+  return M2M_SUCCESS;
+}
+
+int8_t nm_drv_init(void *arg) {
+  static const uint32_t addrs[] = {M2M_CONTROL_FLASH_OFFSET,
+                                   M2M_CONTROL_FLASH_BKP_OFFSET};
+  winc_sim_device_t *dev = s_sim.dev;
+  tstrOtaControlSec control;
+
+  (void)arg;
+  // The boot ROM reads the control sector and loads the slot it names.
+  s_sim.now_ns += s_sim.timing.boot_ns;
+  dev->fw_version = 0;
+  for (size_t i = 0; i < sizeof(addrs) / sizeof(addrs[0]); i++) {
+    memcpy(&control, &dev->flash[addrs[i]], sizeof(control));
+    if (ota_control_is_valid(&control)) {
+      break;
+    }
+  }
+  if (!ota_control_is_valid(&control) ||
+      (ota_control_inactive_slot(&control) == OTA_CONTROL_NO_SLOT) ||
+      (dev->flash[control.u32OtaCurrentWorkingImagOffset] == 0xff)) {
+    return M2M_ERR_INIT;
+  }
+  dev->fw_version = control.u32OtaCurrentworkingImagFirmwareVer;
+  return M2M_SUCCESS;
+}
+
+int8_t nm_get_firmware_full_info(tstrM2mRev *pstrRev) {
+  uint32_t version = s_sim.dev->fw_version;
+  uint16_t drv_ver = M2M_MAKE_VERSION(M2M_RELEASE_VERSION_MAJOR_NO,
+                                      M2M_RELEASE_VERSION_MINOR_NO,
+                                      M2M_RELEASE_VERSION_PATCH_NO);
+
+  // a register read and two block reads, as in nmdrv.c
+  s_sim.stats.reg_reads += 1;
+  s_sim.stats.block_reads += 2;
+  bus_xfer(REG_XFER_BYTES);
+  bus_xfer(BLOCK_XFER_BYTES + sizeof(tstrGpRegs));
+  bus_xfer(BLOCK_XFER_BYTES + sizeof(*pstrRev));
+  memset(pstrRev, 0, sizeof(*pstrRev));
+  if (version == 0) {
+    return M2M_ERR_FAIL;
+  }
+  pstrRev->u32Chipid = CHIP_ID;
+  pstrRev->u8FirmwareMajor = M2M_GET_FW_MAJOR(version);
+  pstrRev->u8FirmwareMinor = M2M_GET_FW_MINOR(version);
+  pstrRev->u8FirmwarePatch = M2M_GET_FW_PATCH(version);
+  pstrRev->u8DriverMajor = M2M_GET_DRV_MAJOR(version);
+  pstrRev->u8DriverMinor = M2M_GET_DRV_MINOR(version);
+  pstrRev->u8DriverPatch = M2M_GET_DRV_PATCH(version);
+  memcpy(pstrRev->BuildDate, "Jan  1 2022", sizeof(pstrRev->BuildDate));
+  memcpy(pstrRev->BuildTime, "00:00:00", sizeof(pstrRev->BuildTime));
+  return ((drv_ver < M2M_GET_DRV_VER(version)) ||
+          (drv_ver > M2M_GET_FW_VER(version)))
+             ? M2M_ERR_FW_VER_MISMATCH
+             : M2M_SUCCESS;
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static void bus_xfer(size_t n_bytes) {
+  s_sim.stats.bus_bytes += n_bytes;
+  s_sim.now_ns += s_sim.timing.xfer_overhead_ns +
+                  xfer_ns(n_bytes, s_sim.timing.spi_clock_hz);
+}
+
+static uint64_t xfer_ns(size_t n_bytes, uint32_t clock_hz) {
+  return (uint64_t)n_bytes * 8 * 1000000000ull / clock_hz;
+}
+
+static void execute_command(uint32_t cmd_cnt) {
+  uint8_t cmd = s_sim.dev->buf1 & 0xff;
+  // address bytes follow the command byte, most significant first
+  uint32_t addr = (((s_sim.dev->buf1 >> 8) & 0xff) << 16) |
+                  (((s_sim.dev->buf1 >> 16) & 0xff) << 8) |
+                  ((s_sim.dev->buf1 >> 24) & 0xff);
+  bool is_busy = s_sim.now_ns < s_sim.dev->flash_busy_ns;
+  uint8_t *mem;
+
+  s_sim.dev->dma_done_ns = s_sim.now_ns;
+
+  switch (cmd) {
+  case CMD_READ_STATUS:
+    s_sim.dev->dummy = (is_busy ? STATUS_WIP : 0) |
+                  (s_sim.dev->write_enabled ? STATUS_WEL : 0);
+    break;
+
+  case CMD_READ_ID:
+    s_sim.dev->dummy = FLASH_ID;
+    break;
+
+  case CMD_WRITE_ENABLE:
+    s_sim.dev->write_enabled = true;
+    break;
+
+  case CMD_WRITE_DISABLE:
+    s_sim.dev->write_enabled = false;
+    break;
+
+  case CMD_FAST_READ:
+    mem = shared_mem(s_sim.dev->dma_addr, s_sim.dev->data_cnt);
+    if ((mem == NULL) || is_busy) {
+      break;
+    }
+    for (uint32_t i = 0; i < s_sim.dev->data_cnt; i++) {
+      mem[i] = s_sim.dev->flash[(addr + i) % WINC_SIM_FLASH_SIZE];
+    }
+    s_sim.stats.flash_reads += 1;
+    s_sim.stats.flash_bytes_read += s_sim.dev->data_cnt;
+    // command, address, dummy byte, then the data
+    s_sim.dev->dma_done_ns =
+        s_sim.now_ns +
+        xfer_ns(5 + s_sim.dev->data_cnt, s_sim.timing.flash_clock_hz);
+    break;
+
+  case CMD_SECTOR_ERASE:
+    if (!s_sim.dev->write_enabled || is_busy) {
+      break;
+    }
+    addr = (addr % WINC_SIM_FLASH_SIZE) & ~(SECTOR_SIZE - 1);
+    memset(&s_sim.dev->flash[addr], 0xff, SECTOR_SIZE);
+    s_sim.dev->write_enabled = false;
+    s_sim.dev->flash_busy_ns = s_sim.now_ns + s_sim.timing.erase_ns;
+    s_sim.stats.sector_erases += 1;
+    break;
+
+  case CMD_BLOCK_ERASE_32K:
+    if (!s_sim.dev->write_enabled || is_busy) {
+      break;
+    }
+    addr = (addr % WINC_SIM_FLASH_SIZE) & ~(BLOCK_SIZE - 1);
+    memset(&s_sim.dev->flash[addr], 0xff, BLOCK_SIZE);
+    s_sim.dev->write_enabled = false;
+    s_sim.dev->flash_busy_ns = s_sim.now_ns + s_sim.timing.block_erase_ns;
+    s_sim.stats.block_erases += 1;
+    break;
+
+  case CMD_PAGE_PROGRAM: {
+    uint32_t n_bytes = (cmd_cnt >> 8) & 0xfffff;
+    bool is_dirty = false;
+    mem = shared_mem(s_sim.dev->dma_addr, n_bytes);
+    if (!s_sim.dev->write_enabled || is_busy || (mem == NULL)) {
+      break;
+    }
+    addr %= WINC_SIM_FLASH_SIZE;
+    for (uint32_t i = 0; i < n_bytes; i++) {
+      // NOR: programming wraps within the page and can only clear bits
+      uint32_t a = (addr & ~(PAGE_SIZE - 1)) | ((addr + i) & (PAGE_SIZE - 1));
+      if ((s_sim.dev->flash[a] != 0xff) && (mem[i] != 0xff)) {
+        is_dirty = true;
+      }
+      s_sim.dev->flash[a] &= mem[i];
+    }
+    s_sim.dev->write_enabled = false;
+    s_sim.dev->flash_busy_ns = s_sim.now_ns + s_sim.timing.program_ns;
+    s_sim.stats.page_programs += 1;
+    s_sim.stats.dirty_programs += is_dirty ? 1 : 0;
+  } break;
+
+  default:
+    // deep power down / release and anything else: no effect
+    break;
+  }
+}
+
+static uint8_t *shared_mem(uint32_t addr, size_t n_bytes) {
+  if ((addr < SHARED_MEM_BASE) ||
+      (addr + n_bytes > SHARED_MEM_BASE + SHARED_MEM_SIZE)) {
+    return NULL;
+  }
+  return &s_sim.dev->shared_mem[addr - SHARED_MEM_BASE];
+}
+
+// *****************************************************************************
+// End of file
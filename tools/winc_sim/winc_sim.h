@@ -0,0 +1,178 @@
+/**
+ * @file winc_sim.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @brief winc_sim simulates a WINC1500 and its SPI flash behind the nm_*
+ * bus interface (nmbus.h), so that the vendored spi_flash.c and the cloner
+ * core run unmodified on a Linux host.
+ *
+ * The simulation decodes the register sequences that spi_flash.c writes to
+ * the WINC's SPI flash controller: read (DMA into shared memory), sector
+ * erase, page program, write enable / disable, read status and read ID.  The
+ * flash follows NOR rules: erase sets a sector to 0xff, and programming can
+ * only clear bits.  Erase and program require the write enable latch and
+ * keep the status register busy for a realistic time.
+ *
+ * There are WINC_SIM_N_DEVICES WINCs, each with its own flash, as on a
+ * winc_bus with every slot populated.  winc_sim_select() picks the one that
+ * the bus addresses; winc_bus.c reaches it through
+ * WDRV_WINC_SPITargetSelect().
+ *
+ * nm_drv_init() boots the simulated firmware: it starts if the control
+ * sector (or its backup) is valid and points at a programmed OTA slot, and
+ * then reports the version that the control sector gives for that slot.
+ * m2m_wifi_download_mode() stops it again.
+ *
+ * Time is modeled rather than measured: every bus transaction, flash
+ * operation and (see host_system.c) SD access advances a nanosecond clock,
+ * which also drives SYS_TIME.  Host CPU time is not modeled.
+ */
+
+#ifndef _WINC_SIM_H_
+#define _WINC_SIM_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// *****************************************************************************
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+#define WINC_SIM_FLASH_SIZE (1024 * 1024ul) // 8 Mbit
+
+// WINCs on the simulated bus, one per winc_bus slot.
+#define WINC_SIM_N_DEVICES 4
+
+/**
+ * @brief Timing model.  All times in nanoseconds.
+ */
+typedef struct {
+  uint32_t spi_clock_hz;     // host to WINC SPI clock
+  uint32_t xfer_overhead_ns; // per nm_* transaction (CS, command, CRC)
+  uint32_t flash_clock_hz;   // WINC to SPI flash clock
+  uint32_t erase_ns;         // 4K sector erase
+  uint32_t block_erase_ns;   // 32K block erase
+  uint32_t program_ns;       // 256 byte page program
+  uint32_t sd_read_bps;      // SD sequential read, bytes per second
+  uint32_t sd_write_bps;     // SD sequential write, bytes per second
+  uint32_t sd_overhead_ns;   // per SYS_FS call
+  uint32_t boot_ns;          // reset until the firmware is up
+} winc_sim_timing_t;
+
+/**
+ * @brief Counters, reset by winc_sim_reset_stats().
+ */
+typedef struct {
+  uint32_t reg_reads;
+  uint32_t reg_writes;
+  uint32_t block_reads;
+  uint32_t block_writes;
+  uint64_t bus_bytes; // bytes moved over the host to WINC SPI bus
+  uint32_t flash_reads;
+  uint64_t flash_bytes_read;
+  uint32_t sector_erases;
+  uint32_t block_erases; // 32K, not counted in sector_erases
+  uint32_t page_programs;
+  uint32_t dirty_programs; // programs that cleared bits in non-erased bytes
+  uint32_t sd_reads;
+  uint32_t sd_writes;
+  uint64_t sd_bytes;
+} winc_sim_stats_t;
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Reset the simulated WINCs: erase their flash, select device 0 and
+ * use the default timing model.
+ */
+void winc_sim_init(void);
+
+/**
+ * @brief Select the WINC that the nm_* bus interface, winc_sim_load() and
+ * winc_sim_flash() address.  Return false if device is out of range.
+ */
+bool winc_sim_select(int device);
+
+/**
+ * @brief Return the timing model, which may be modified.
+ */
+winc_sim_timing_t *winc_sim_timing(void);
+
+/**
+ * @brief Load the selected WINC's flash from an image file (the rest is
+ * erased).  Return false if the file can't be read.
+ */
+bool winc_sim_load(const char *filename);
+
+/**
+ * @brief Return a pointer to the selected WINC's flash contents.
+ */
+const uint8_t *winc_sim_flash(void);
+
+/**
+ * @brief Return the counters.
+ */
+const winc_sim_stats_t *winc_sim_stats(void);
+
+/**
+ * @brief Clear the counters.
+ */
+void winc_sim_reset_stats(void);
+
+/**
+ * @brief Return the modeled time in nanoseconds.
+ */
+uint64_t winc_sim_now_ns(void);
+
+/**
+ * @brief Advance the modeled clock by ns.
+ */
+void winc_sim_advance_ns(uint64_t ns);
+
+/**
+ * @brief Charge one SD access of n_bytes to the modeled clock.
+ */
+void winc_sim_sd_access(bool is_write, size_t n_bytes);
+
+// *****************************************************************************
+// End of file
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _WINC_SIM_H_ */
@@ -0,0 +1,593 @@
+/**
+ * @file winc_sim_bench.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+Host-side benchmark driver for the cloner core running on a simulated WINC.
+
+usage: winc_sim_bench [-v] [-g] [-a] [-b] [-P] [-p steps] [-r regions]
+                      [-s spi_hz] [-f flash_hz] [-t trace.bin] [-c capture.bin]
+                      image.img [image.img ...]
+
+The simulated WINC starts out holding the first image.  Then, for each image
+in turn, winc_sim_bench runs the real winc_cloner code to:
+  update   the WINC from the image (erasing and programming what differs)
+  again    update a second time (the quick check finds it up to date)
+  full     update a third time with the quick check off
+  compare  the WINC against the image
+  extract  the WINC into a file
+and prints the simulated bus transactions, bytes moved, flash operations, SD
+accesses and modeled wall time of each.  Updates and extracts are checked
+against the image.  Images are copied into a scratch directory first, so no
+manifests are left next to them.
+
+With -P, each image's programming plan (image.img.plan, from tools/image_plan)
+is copied along with it, so updates are planned.  Copies keep their
+modification times, which tie a plan to its image.
+
+With -g, every image is instead written to all WINC_SIM_N_DEVICES simulated
+WINCs at once by winc_gang (the firmware's 'm' command):
+  gang     update every WINC from the image (all but the first start erased)
+  again    update every WINC a second time
+and every WINC is checked against the image.
+
+With -a, each image is instead written into the simulated WINC's spare OTA
+slot by winc_cloner_slot_update() (the firmware's 'w' command):
+  slot     write the spare slot, verify it and switch the control sector
+  again    the same image again (the WINC is already running it)
+and the WINC is checked to boot the image's firmware.
+
+With -b, the boot check (the firmware's 'k' command) is on: each update and
+slot update ends by booting the simulated WINC and checking the firmware
+version it reports, which stands in for the compare row in station mode.
+
+With -p, each update is instead cut off after the given number of cloner
+steps, as if the power had failed, and the cloner is restarted:
+  cut      the update, abandoned mid-way
+  resume   winc_cloner_resume_update(), from the journal the cut left behind
+
+-r limits update, compare and extract to the given flash regions (as for the
+firmware's 'o' command, e.g. "firmware" or "certs"); only those regions are
+checked.
+
+-v prints the cloner's console output, including its per-phase summary;
+-s and -f set the host to WINC SPI clock and the WINC to flash clock in Hz;
+-t writes the cloner's trace log (the last events of the run, in modeled time)
+to trace.bin, for tools/trace_decode; -c captures every bus transaction of the
+run to capture.bin, for winc_sim_replay.
+
+Returns 0 if every operation succeeded and checked out.
+*/
+
+// *****************************************************************************
+// Includes
+
+#include "definitions.h"
+#include "bus_capture.h"
+#include "flash_regions.h"
+#include "image_plan.h"
+#include "ota_control.h"
+#include "spi_flash_map.h"
+#include "trace.h"
+#include "winc_bus.h"
+#include "winc_cloner.h"
+#include "winc_gang.h"
+#include "winc_sim.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+#define MAX_PATH_LENGTH 1024
+#define SCRATCH_TEMPLATE "/tmp/winc_sim.XXXXXX"
+#define EXTRACT_FILENAME "extract.img"
+
+/**
+ * @brief The cloner and winc_gang are driven the same way.
+ */
+typedef struct {
+  bool (*start)(const char *filename);
+  void (*step)(void);
+  bool (*is_busy)(void);
+  bool (*is_complete)(void);
+  int n_wincs; // # of simulated WINCs that the operation writes
+  bool (*matches)(const char *filename); // checks one simulated WINC
+} bench_op_t;
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+/**
+ * @brief Run one operation to completion and print its statistics.  If
+ * check_filename is given, check the simulated WINCs it wrote against it.
+ */
+static bool run_op(const char *op_name,
+                   const bench_op_t *op,
+                   const char *filename,
+                   const char *check_filename);
+
+/**
+ * @brief Return true if the selected simulated WINC holds filename in the
+ * cloner's selected regions, ignoring the PLL and gain sector, which update
+ * never overwrites.
+ */
+static bool flash_matches(const char *filename);
+
+/**
+ * @brief Return true if the simulated WINC has a valid control sector and
+ * boots from a slot that holds the firmware of filename.
+ */
+static bool slot_matches(const char *filename);
+
+/**
+ * @brief Copy src into the current directory as dst, keeping its modification
+ * time.
+ */
+static bool copy_file(const char *src, const char *dst);
+
+/**
+ * @brief Set path to name, made absolute relative to cwd.
+ */
+static void make_path(char *path, const char *cwd, const char *name);
+
+/**
+ * @brief Return the last component of path.
+ */
+static const char *base_name(const char *path);
+
+/**
+ * @brief Start an update of filename and abandon it after n_steps, leaving
+ * the cloner as a power failure would.
+ */
+static void cut_update(const char *filename, int n_steps);
+
+static bool resume_update(const char *filename);
+
+static bool full_update(const char *filename);
+
+// *****************************************************************************
+// Private (static) storage
+
+static uint8_t s_image[WINC_SIM_FLASH_SIZE];
+
+static const bench_op_t s_update_op = {winc_cloner_update,
+                                       winc_cloner_step,
+                                       winc_cloner_is_busy,
+                                       winc_cloner_is_complete,
+                                       1,
+                                       flash_matches};
+
+static const bench_op_t s_full_update_op = {full_update,
+                                            winc_cloner_step,
+                                            winc_cloner_is_busy,
+                                            winc_cloner_is_complete,
+                                            1,
+                                            flash_matches};
+
+static const bench_op_t s_slot_op = {winc_cloner_slot_update,
+                                     winc_cloner_step,
+                                     winc_cloner_is_busy,
+                                     winc_cloner_is_complete,
+                                     1,
+                                     slot_matches};
+
+static const bench_op_t s_compare_op = {winc_cloner_compare,
+                                        winc_cloner_step,
+                                        winc_cloner_is_busy,
+                                        winc_cloner_is_complete,
+                                        1,
+                                        flash_matches};
+
+static const bench_op_t s_extract_op = {winc_cloner_extract,
+                                        winc_cloner_step,
+                                        winc_cloner_is_busy,
+                                        winc_cloner_is_complete,
+                                        1,
+                                        flash_matches};
+
+static const bench_op_t s_resume_op = {resume_update,
+                                       winc_cloner_step,
+                                       winc_cloner_is_busy,
+                                       winc_cloner_is_complete,
+                                       1,
+                                       flash_matches};
+
+static const bench_op_t s_gang_op = {winc_gang_update,
+                                     winc_gang_step,
+                                     winc_gang_is_busy,
+                                     winc_gang_is_complete,
+                                     WINC_SIM_N_DEVICES,
+                                     flash_matches};
+
+// *****************************************************************************
+// Public code
+
+int main(int argc, char *argv[]) {
+  char scratch[] = SCRATCH_TEMPLATE;
+  char cwd[MAX_PATH_LENGTH];
+  char path[MAX_PATH_LENGTH];
+  const char *trace_name = NULL;
+  const char *capture_name = NULL;
+  bool ok = true;
+  bool is_gang = false;
+  bool is_slot = false;
+  bool is_boot_check = false;
+  bool is_planned = false;
+  int cut_steps = 0;
+  flash_region_set_t regions = FLASH_REGION_SET_ALL;
+  int opt;
+
+  winc_sim_init();
+  host_console_is_quiet = true;
+  while ((opt = getopt(argc, argv, "vgabPp:r:s:f:t:c:")) != -1) {
+    switch (opt) {
+    case 'v':
+      host_console_is_quiet = false;
+      break;
+    case 'g':
+      is_gang = true;
+      break;
+    case 'a':
+      is_slot = true;
+      break;
+    case 'b':
+      is_boot_check = true;
+      break;
+    case 'P':
+      is_planned = true;
+      break;
+    case 'p':
+      cut_steps = atoi(optarg);
+      break;
+    case 'r':
+      if (!flash_region_set_parse(optarg, &regions) || (regions == 0)) {
+        fprintf(stderr, "%s: unknown regions %s\n", argv[0], optarg);
+        return 2;
+      }
+      break;
+    case 's':
+      winc_sim_timing()->spi_clock_hz = strtoul(optarg, NULL, 0);
+      break;
+    case 'f':
+      winc_sim_timing()->flash_clock_hz = strtoul(optarg, NULL, 0);
+      break;
+    case 't':
+      trace_name = optarg;
+      break;
+    case 'c':
+      capture_name = optarg;
+      break;
+    default:
+      fprintf(stderr,
+              "usage: %s [-v] [-g] [-a] [-b] [-P] [-p steps] [-r regions] "
+              "[-s spi_hz] [-f flash_hz] [-t trace.bin] [-c capture.bin] "
+              "image.img...\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "%s: no images given\n", argv[0]);
+    return 2;
+  }
+  if ((getcwd(cwd, sizeof(cwd)) == NULL) || (mkdtemp(scratch) == NULL) ||
+      (chdir(scratch) != 0)) {
+    perror("scratch directory");
+    return 1;
+  }
+  for (int i = optind; i < argc; i++) {
+    make_path(path, cwd, argv[i]);
+    if (!copy_file(path, base_name(argv[i]))) {
+      fprintf(stderr, "could not copy %s\n", argv[i]);
+      return 1;
+    }
+    if (is_planned) {
+      char plan[MAX_PATH_LENGTH];
+      snprintf(
+          plan, sizeof(plan), "%s%s", base_name(argv[i]), IMAGE_PLAN_SUFFIX);
+      strncat(path, IMAGE_PLAN_SUFFIX, sizeof(path) - strlen(path) - 1);
+      if (!copy_file(path, plan)) {
+        fprintf(stderr, "could not copy %s\n", path);
+        return 1;
+      }
+    }
+  }
+
+  winc_sim_load(base_name(argv[optind]));
+  winc_cloner_init();
+  winc_cloner_set_regions(regions);
+  winc_cloner_set_boot_check(is_boot_check);
+  winc_bus_init();
+  winc_gang_init();
+  trace_init();
+  printf("SPI %u Hz, flash %u Hz, scratch %s\n",
+         winc_sim_timing()->spi_clock_hz,
+         winc_sim_timing()->flash_clock_hz,
+         scratch);
+  printf("%-8s %-28s %8s %9s %6s %6s %6s %9s %10s %s\n",
+         "op",
+         "image",
+         "bus xfer",
+         "bus KB",
+         "erase",
+         "prog",
+         "sd ops",
+         "sd KB",
+         "modeled s",
+         "check");
+
+  if (capture_name != NULL) {
+    make_path(path, cwd, capture_name);
+    if (!bus_capture_start(path)) {
+      return 1;
+    }
+  }
+  for (int i = optind; i < argc; i++) {
+    const char *image = base_name(argv[i]);
+    if (is_gang) {
+      ok &= run_op("gang", &s_gang_op, image, image);
+      ok &= run_op("again", &s_gang_op, image, image);
+      continue;
+    }
+    if (is_slot) {
+      ok &= run_op("slot", &s_slot_op, image, image);
+      ok &= run_op("again", &s_slot_op, image, image);
+      continue;
+    }
+    if (cut_steps > 0) {
+      cut_update(image, cut_steps);
+      ok &= run_op("resume", &s_resume_op, image, image);
+    } else {
+      ok &= run_op("update", &s_update_op, image, image);
+    }
+    ok &= run_op("again", &s_update_op, image, image);
+    ok &= run_op("full", &s_full_update_op, image, image);
+    ok &= run_op("compare", &s_compare_op, image, NULL);
+    ok &= run_op("extract", &s_extract_op, EXTRACT_FILENAME, EXTRACT_FILENAME);
+  }
+  if (capture_name != NULL) {
+    ok &= bus_capture_stop() >= 0;
+  }
+  if (trace_name != NULL) {
+    make_path(path, cwd, trace_name);
+    ok &= trace_dump(path) >= 0;
+  }
+  return ok ? 0 : 1;
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static bool run_op(const char *op_name,
+                   const bench_op_t *op,
+                   const char *filename,
+                   const char *check_filename) {
+  const winc_sim_stats_t *stats = winc_sim_stats();
+  uint64_t started_at = winc_sim_now_ns();
+
+  winc_sim_reset_stats();
+  if (!op->start(filename)) {
+    printf("%-8s %-28s could not start\n", op_name, filename);
+    return false;
+  }
+  while (op->is_busy()) {
+    op->step();
+  }
+  if (!host_console_is_quiet) {
+    printf("\n");
+  }
+  uint64_t elapsed_ns = winc_sim_now_ns() - started_at;
+  printf("%-8s %-28s %8u %9llu %6u %6u %6u %9llu %6llu.%03llu %s",
+         op_name,
+         filename,
+         stats->reg_reads + stats->reg_writes + stats->block_reads +
+             stats->block_writes,
+         (unsigned long long)(stats->bus_bytes / 1024),
+         stats->sector_erases,
+         stats->page_programs,
+         stats->sd_reads + stats->sd_writes,
+         (unsigned long long)(stats->sd_bytes / 1024),
+         (unsigned long long)(elapsed_ns / 1000000000),
+         (unsigned long long)(elapsed_ns / 1000000 % 1000),
+         op->is_complete() ? "" : "FAILED");
+  if (stats->block_erases != 0) {
+    printf(" (%u block erases) ", stats->block_erases);
+  }
+  if (stats->dirty_programs != 0) {
+    printf(" (%u programs over unerased bytes)", stats->dirty_programs);
+  }
+  if (!op->is_complete()) {
+    printf("\n");
+    return false;
+  }
+  if (check_filename == NULL) {
+    printf("\n");
+    return true;
+  }
+  bool matches = true;
+  for (int winc = 0; winc < op->n_wincs; winc++) {
+    winc_sim_select(winc);
+    matches &= op->matches(check_filename);
+  }
+  winc_sim_select(0); // where winc_bus left it
+  if (matches) {
+    printf("ok\n");
+  }
+  return matches;
+}
+
+static void cut_update(const char *filename, int n_steps) {
+  uint64_t started_at = winc_sim_now_ns();
+
+  winc_sim_reset_stats();
+  if (winc_cloner_update(filename)) {
+    for (int i = 0; (i < n_steps) && winc_cloner_is_busy(); i++) {
+      winc_cloner_step();
+    }
+  }
+  uint64_t elapsed_ns = winc_sim_now_ns() - started_at;
+  printf("%-8s %-28s %8s %9s %6u %6u %6u %9s %6llu.%03llu\n",
+         "cut",
+         filename,
+         "",
+         "",
+         winc_sim_stats()->sector_erases,
+         winc_sim_stats()->page_programs,
+         winc_sim_stats()->sd_reads + winc_sim_stats()->sd_writes,
+         "",
+         (unsigned long long)(elapsed_ns / 1000000000),
+         (unsigned long long)(elapsed_ns / 1000000 % 1000));
+  // Power comes back: the cloner starts afresh, the WINC and card keep what
+  // was written to them.  The abandoned image file handle is leaked.
+  flash_region_set_t regions = winc_cloner_get_regions();
+  bool is_boot_check = winc_cloner_get_boot_check();
+  winc_cloner_init();
+  winc_cloner_set_regions(regions);
+  winc_cloner_set_boot_check(is_boot_check);
+}
+
+static bool resume_update(const char *filename) {
+  (void)filename; // the journal names the image
+  return winc_cloner_resume_update();
+}
+
+static bool full_update(const char *filename) {
+  bool started;
+
+  winc_cloner_set_quick_check(false);
+  started = winc_cloner_update(filename);
+  winc_cloner_set_quick_check(true);
+  return started;
+}
+
+static bool flash_matches(const char *filename) {
+  FILE *f = fopen(filename, "rb");
+  size_t n_bytes;
+
+  if (f == NULL) {
+    printf("\n  %s: cannot open\n", filename);
+    return false;
+  }
+  memset(s_image, 0xff, sizeof(s_image));
+  n_bytes = fread(s_image, 1, sizeof(s_image), f);
+  fclose(f);
+  for (size_t addr = 0; addr < n_bytes; addr++) {
+    if ((flash_region_find(addr) == FLASH_REGION_PLL_GAIN) ||
+        !flash_region_set_contains(winc_cloner_get_regions(), addr)) {
+      continue;
+    }
+    if (winc_sim_flash()[addr] != s_image[addr]) {
+      printf("\n  WINC differs from %s at 0x%zx\n", filename, addr);
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool slot_matches(const char *filename) {
+  const uint8_t *flash = winc_sim_flash();
+  tstrOtaControlSec winc_control;
+  tstrOtaControlSec image_control;
+  FILE *f = fopen(filename, "rb");
+
+  if (f == NULL) {
+    printf("\n  %s: cannot open\n", filename);
+    return false;
+  }
+  memset(s_image, 0xff, sizeof(s_image));
+  fread(s_image, 1, sizeof(s_image), f);
+  fclose(f);
+  memcpy(&winc_control, &flash[M2M_CONTROL_FLASH_OFFSET], sizeof(winc_control));
+  memcpy(&image_control,
+         &s_image[M2M_CONTROL_FLASH_OFFSET],
+         sizeof(image_control));
+  if (!ota_control_is_valid(&winc_control) ||
+      (ota_control_inactive_slot(&winc_control) == OTA_CONTROL_NO_SLOT)) {
+    printf("\n  WINC control sector is not valid\n");
+    return false;
+  }
+  if ((winc_control.u32OtaCurrentworkingImagFirmwareVer !=
+       image_control.u32OtaCurrentworkingImagFirmwareVer) ||
+      (memcmp(&flash[winc_control.u32OtaCurrentWorkingImagOffset],
+              &s_image[image_control.u32OtaCurrentWorkingImagOffset],
+              OTA_IMAGE_SIZE) != 0)) {
+    printf("\n  WINC does not boot %s from 0x%lx\n",
+           filename,
+           (unsigned long)winc_control.u32OtaCurrentWorkingImagOffset);
+    return false;
+  }
+  return true;
+}
+
+static bool copy_file(const char *src, const char *dst) {
+  FILE *in = fopen(src, "rb");
+  FILE *out = (in == NULL) ? NULL : fopen(dst, "wb");
+  size_t n;
+  bool ok = (out != NULL);
+
+  while (ok && ((n = fread(s_image, 1, sizeof(s_image), in)) > 0)) {
+    ok = fwrite(s_image, 1, n, out) == n;
+  }
+  if (in) {
+    fclose(in);
+  }
+  if (out) {
+    fclose(out);
+  }
+  if (ok) {
+    struct stat st;
+    ok = (stat(src, &st) == 0);
+    if (ok) {
+      struct timespec times[2] = {st.st_atim, st.st_mtim};
+      ok = (utimensat(AT_FDCWD, dst, times, 0) == 0);
+    }
+  }
+  return ok;
+}
+
+static void make_path(char *path, const char *cwd, const char *name) {
+  snprintf(path,
+           MAX_PATH_LENGTH,
+           "%s%s%s",
+           (name[0] == '/') ? "" : cwd,
+           (name[0] == '/') ? "" : "/",
+           name);
+}
+
+static const char *base_name(const char *path) {
+  const char *slash = strrchr(path, '/');
+  return (slash == NULL) ? path : slash + 1;
+}
+
+// *****************************************************************************
+// End of file
@@ -0,0 +1,417 @@
+/**
+ * @file winc_sim_replay.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+Host-side replay of a WINC bus capture on the simulated WINC.
+
+usage: winc_sim_replay [-s spi_hz] [-f flash_hz] [-n top] capture.bin
+
+Reads a capture written by the firmware's 'x' command (or winc_sim_bench -c)
+and issues every transaction, repeats included, to the simulated WINC in the
+same order with the same addresses, register values and sizes.  Block
+contents are not captured: block writes send 0xff.  It then prints, per
+transaction type, the count, bytes, response polls and errors, and the time
+each took as captured next to the time the simulation models for it.  Also
+printed: how much of the captured session the bus was busy, the longest runs
+of identical transactions (poll loops) and the busiest registers.
+
+-s and -f set the SPI and flash clocks of the model, to ask what a session
+would cost on faster hardware; -n sets the length of the top lists (8).
+
+Returns 0 if the capture was read completely.
+*/
+
+// *****************************************************************************
+// Includes
+
+#include "bus_capture.h"
+#include "nmbus.h"
+#include "winc_sim.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+#define MAX_BLOCK_SIZE UINT16_MAX
+#define MAX_REGISTERS 1024
+#define DEFAULT_TOP 8
+#define MAX_TOP 64
+
+typedef struct {
+  uint32_t count; // transactions, counting repeats
+  uint32_t errors;
+  uint64_t bytes;
+  uint64_t polls;
+  uint64_t captured_ticks;
+  uint64_t modeled_ns;
+} type_stats_t;
+
+typedef struct {
+  uint32_t addr;
+  uint32_t reads;
+  uint32_t writes;
+  uint64_t captured_ticks;
+} register_stats_t;
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+/**
+ * @brief Issue rec (and its repeats) to the simulated WINC and return the
+ * modeled time it took.
+ */
+static uint64_t replay_record(const bus_capture_record_t *rec);
+
+/**
+ * @brief Charge rec to its register's row, if it is a register access.
+ */
+static void count_register(const bus_capture_record_t *rec);
+
+/**
+ * @brief Keep rec if it is one of the n_top longest runs seen so far.
+ */
+static void keep_longest_run(const bus_capture_record_t *rec, int n_top);
+
+static void print_report(const bus_capture_header_t *header,
+                         uint64_t span_ticks,
+                         int n_top);
+
+static double ticks_to_ms(uint64_t ticks);
+
+static int compare_registers(const void *a, const void *b);
+
+// *****************************************************************************
+// Private (static) storage
+
+#define EXPAND_BUS_CAPTURE_NAMES(_id, _name) _name,
+static const char *s_type_names[] = {
+    BUS_CAPTURE_TYPES(EXPAND_BUS_CAPTURE_NAMES)};
+
+static type_stats_t s_types[BUS_CAPTURE_N_TYPES];
+
+static register_stats_t s_registers[MAX_REGISTERS];
+static int s_n_registers;
+static uint32_t s_n_untracked; // register accesses beyond MAX_REGISTERS
+
+static bus_capture_record_t s_runs[MAX_TOP];
+static int s_n_runs;
+
+static uint8_t s_block[MAX_BLOCK_SIZE];
+
+static uint32_t s_ticks_per_sec;
+
+// *****************************************************************************
+// Public code
+
+int main(int argc, char *argv[]) {
+  bus_capture_header_t header;
+  bus_capture_record_t rec;
+  uint64_t span_ticks = 0;
+  uint32_t prev_end = 0;
+  uint32_t n_read = 0;
+  int n_top = DEFAULT_TOP;
+  FILE *f;
+  int opt;
+
+  winc_sim_init();
+  while ((opt = getopt(argc, argv, "s:f:n:")) != -1) {
+    switch (opt) {
+    case 's':
+      winc_sim_timing()->spi_clock_hz = strtoul(optarg, NULL, 0);
+      break;
+    case 'f':
+      winc_sim_timing()->flash_clock_hz = strtoul(optarg, NULL, 0);
+      break;
+    case 'n':
+      n_top = atoi(optarg);
+      n_top = (n_top < 0) ? 0 : (n_top > MAX_TOP) ? MAX_TOP : n_top;
+      break;
+    default:
+      fprintf(stderr,
+              "usage: %s [-s spi_hz] [-f flash_hz] [-n top] capture.bin\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if (optind != argc - 1) {
+    fprintf(stderr, "%s: expected one capture file\n", argv[0]);
+    return 2;
+  }
+
+  f = fopen(argv[optind], "rb");
+  if (f == NULL) {
+    perror(argv[optind]);
+    return 1;
+  }
+  if ((fread(&header, sizeof(header), 1, f) != 1) ||
+      (header.magic != BUS_CAPTURE_MAGIC) ||
+      (header.version != BUS_CAPTURE_VERSION) ||
+      (header.record_size != sizeof(bus_capture_record_t)) ||
+      (header.ticks_per_sec == 0)) {
+    fprintf(stderr, "%s: not a bus capture\n", argv[optind]);
+    fclose(f);
+    return 1;
+  }
+  s_ticks_per_sec = header.ticks_per_sec;
+  memset(s_block, 0xff, sizeof(s_block));
+
+  for (; n_read < header.n_records; n_read++) {
+    if (fread(&rec, sizeof(rec), 1, f) != 1) {
+      break;
+    }
+    if ((rec.type >= BUS_CAPTURE_N_TYPES) || (rec.repeat == 0)) {
+      fprintf(stderr, "%s: bad record %u\n", argv[optind], n_read);
+      break;
+    }
+    // unsigned arithmetic handles counter wrap
+    if (n_read > 0) {
+      span_ticks += rec.ticks - prev_end;
+    }
+    span_ticks += rec.duration;
+    prev_end = rec.ticks + rec.duration;
+
+    type_stats_t *stats = &s_types[rec.type];
+    stats->count += rec.repeat;
+    stats->errors += (rec.result < 0) ? rec.repeat : 0;
+    stats->bytes += (uint64_t)rec.size * rec.repeat;
+    stats->polls += rec.polls;
+    stats->captured_ticks += rec.duration;
+    stats->modeled_ns += replay_record(&rec);
+    count_register(&rec);
+    keep_longest_run(&rec, n_top);
+  }
+  fclose(f);
+
+  printf("%s: ", argv[optind]);
+  print_report(&header, span_ticks, n_top);
+  if (n_read != header.n_records) {
+    fprintf(stderr,
+            "%s: read %u of %u records\n",
+            argv[optind],
+            n_read,
+            header.n_records);
+    return 1;
+  }
+  return 0;
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static uint64_t replay_record(const bus_capture_record_t *rec) {
+  uint64_t started_at = winc_sim_now_ns();
+  uint32_t value;
+
+  for (uint32_t i = 0; i < rec->repeat; i++) {
+    switch (rec->type) {
+    case BUS_CAPTURE_REG_READ:
+      nm_read_reg_with_ret(rec->addr, &value);
+      break;
+    case BUS_CAPTURE_REG_WRITE:
+      nm_write_reg(rec->addr, rec->value);
+      break;
+    case BUS_CAPTURE_BLOCK_READ:
+      nm_read_block(rec->addr, s_block, rec->size);
+      break;
+    case BUS_CAPTURE_BLOCK_WRITE:
+      nm_write_block(rec->addr, s_block, rec->size);
+      memset(s_block, 0xff, rec->size); // in case the WINC side wrote it
+      break;
+    }
+  }
+  return winc_sim_now_ns() - started_at;
+}
+
+static void count_register(const bus_capture_record_t *rec) {
+  register_stats_t *reg = NULL;
+
+  if ((rec->type != BUS_CAPTURE_REG_READ) &&
+      (rec->type != BUS_CAPTURE_REG_WRITE)) {
+    return;
+  }
+  for (int i = 0; i < s_n_registers; i++) {
+    if (s_registers[i].addr == rec->addr) {
+      reg = &s_registers[i];
+      break;
+    }
+  }
+  if (reg == NULL) {
+    if (s_n_registers == MAX_REGISTERS) {
+      s_n_untracked += rec->repeat;
+      return;
+    }
+    reg = &s_registers[s_n_registers++];
+    reg->addr = rec->addr;
+  }
+  if (rec->type == BUS_CAPTURE_REG_READ) {
+    reg->reads += rec->repeat;
+  } else {
+    reg->writes += rec->repeat;
+  }
+  reg->captured_ticks += rec->duration;
+}
+
+static void keep_longest_run(const bus_capture_record_t *rec, int n_top) {
+  int i;
+
+  if ((n_top == 0) || (rec->repeat < 2)) {
+    return;
+  }
+  if (s_n_runs == n_top) {
+    if (rec->repeat <= s_runs[n_top - 1].repeat) {
+      return;
+    }
+    s_n_runs -= 1; // drop the shortest
+  }
+  // insertion sort, longest first
+  for (i = s_n_runs; (i > 0) && (s_runs[i - 1].repeat < rec->repeat); i--) {
+    s_runs[i] = s_runs[i - 1];
+  }
+  s_runs[i] = *rec;
+  s_n_runs += 1;
+}
+
+static void print_report(const bus_capture_header_t *header,
+                         uint64_t span_ticks,
+                         int n_top) {
+  type_stats_t total = {0};
+
+  printf("%u transactions in %u records over %.3f ms "
+         "(%.3f ms of capture writes left out)\n",
+         header->n_transactions,
+         header->n_records,
+         ticks_to_ms(span_ticks),
+         ticks_to_ms(header->flush_ticks));
+  printf("model: SPI %u Hz, flash %u Hz\n\n",
+         winc_sim_timing()->spi_clock_hz,
+         winc_sim_timing()->flash_clock_hz);
+
+  printf("%-12s %9s %9s %12s %9s %12s %9s %7s %6s\n",
+         "type",
+         "count",
+         "KB",
+         "captured ms",
+         "mean us",
+         "modeled ms",
+         "mean us",
+         "polls",
+         "errors");
+  for (int i = 0; i <= BUS_CAPTURE_N_TYPES; i++) {
+    const type_stats_t *stats = &s_types[i];
+    const char *name = "total";
+    if (i < BUS_CAPTURE_N_TYPES) {
+      name = s_type_names[i];
+      total.count += stats->count;
+      total.errors += stats->errors;
+      total.bytes += stats->bytes;
+      total.polls += stats->polls;
+      total.captured_ticks += stats->captured_ticks;
+      total.modeled_ns += stats->modeled_ns;
+    } else {
+      stats = &total;
+    }
+    if (stats->count == 0) {
+      continue;
+    }
+    // polls are response bytes read per transaction, on average
+    printf("%-12s %9u %9.1f %12.3f %9.2f %12.3f %9.2f %7.2f %6u\n",
+           name,
+           stats->count,
+           stats->bytes / 1024.0,
+           ticks_to_ms(stats->captured_ticks),
+           ticks_to_ms(stats->captured_ticks) * 1000.0 / stats->count,
+           stats->modeled_ns / 1e6,
+           stats->modeled_ns / 1e3 / stats->count,
+           (double)stats->polls / stats->count,
+           stats->errors);
+  }
+  if (span_ticks != 0) {
+    printf("\nbus busy %.3f ms of %.3f ms captured (%.1f%%)\n",
+           ticks_to_ms(total.captured_ticks),
+           ticks_to_ms(span_ticks),
+           100.0 * total.captured_ticks / span_ticks);
+  }
+
+  if (s_n_runs > 0) {
+    printf("\nlongest runs of identical transactions:\n");
+    printf("  %-12s %10s %10s %8s %12s\n",
+           "type",
+           "addr",
+           "value",
+           "repeat",
+           "captured ms");
+    for (int i = 0; i < s_n_runs; i++) {
+      printf("  %-12s 0x%08x 0x%08x %8u %12.3f\n",
+             s_type_names[s_runs[i].type],
+             s_runs[i].addr,
+             s_runs[i].value,
+             s_runs[i].repeat,
+             ticks_to_ms(s_runs[i].duration));
+    }
+  }
+
+  if ((n_top > 0) && (s_n_registers > 0)) {
+    qsort(s_registers,
+          s_n_registers,
+          sizeof(s_registers[0]),
+          compare_registers);
+    printf("\nbusiest registers:\n");
+    printf("  %10s %9s %9s %12s\n", "addr", "reads", "writes", "captured ms");
+    for (int i = 0; (i < s_n_registers) && (i < n_top); i++) {
+      printf("  0x%08x %9u %9u %12.3f\n",
+             s_registers[i].addr,
+             s_registers[i].reads,
+             s_registers[i].writes,
+             ticks_to_ms(s_registers[i].captured_ticks));
+    }
+    if (s_n_untracked != 0) {
+      printf("  (%u accesses to further registers not listed)\n",
+             s_n_untracked);
+    }
+  }
+}
+
+static double ticks_to_ms(uint64_t ticks) {
+  return ticks * 1000.0 / s_ticks_per_sec;
+}
+
+static int compare_registers(const void *a, const void *b) {
+  const register_stats_t *ra = a;
+  const register_stats_t *rb = b;
+  uint32_t na = ra->reads + ra->writes;
+  uint32_t nb = rb->reads + rb->writes;
+
+  return (na < nb) - (na > nb); // most accesses first
+}
+
+// *****************************************************************************
+// End of file
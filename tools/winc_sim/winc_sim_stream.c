@@ -0,0 +1,233 @@
+/**
+ * @file winc_sim_stream.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 R. D. Poor (https://github.com/rdpoor)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+Stands in for the board at the other end of tools/uart_stream: the firmware's
+`s` command, running on a simulated WINC behind a Linux pseudo-terminal.
+
+usage: winc_sim_stream [-v] [-b] [-i initial.img] [-l link] image.img
+
+winc_sim_stream opens a pty, links it at link (default /tmp/winc_sim.pty)
+and waits for the host to send the `s` command.  Then it runs the real
+uart_stream and winc_cloner code to receive the image and update the
+simulated WINC from it, as the firmware does, and checks the WINC against
+image.img.  The modeled clock is held to the wall clock (see host_uart.c),
+so the host sees the WINC's real erase and program times.
+
+The simulated WINC starts out erased, or holding initial.img with -i.  -b
+turns the boot check on.  -v prints the cloner's console output, which on the
+board would go to the host between frames.
+
+Received bytes arrive at the stream baud rate into a ring the size of the
+board's (see host_uart.c), so the update also fails if the host ever sends
+more than the ring can hold while the board is busy with the WINC.  Returns 0
+if the update succeeded, no bytes were dropped and the WINC checked out.
+*/
+
+// *****************************************************************************
+// Includes
+
+#include "definitions.h"
+#include "flash_regions.h"
+#include "trace.h"
+#include "uart_stream.h"
+#include "winc_bus.h"
+#include "winc_cloner.h"
+#include "winc_sim.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// *****************************************************************************
+// Private types and definitions
+
+#define DEFAULT_LINK "/tmp/winc_sim.pty"
+
+// How long to wait for the host to send the `s` command.
+#define COMMAND_TIMEOUT_NS (30 * 1000000000ull)
+
+// *****************************************************************************
+// Private (static, forward) declarations
+
+/**
+ * @brief Wait for the host to send UART_STREAM_COMMAND, as the firmware's
+ * command prompt does.
+ */
+static bool await_command(void);
+
+/**
+ * @brief Receive the image and update the simulated WINC from it.
+ */
+static bool stream_update(void);
+
+/**
+ * @brief Return true if the simulated WINC holds filename, except for the
+ * PLL tables.
+ */
+static bool flash_matches(const char *filename);
+
+// *****************************************************************************
+// Private (static) storage
+
+static uint8_t s_image[WINC_SIM_FLASH_SIZE];
+
+// *****************************************************************************
+// Public code
+
+int main(int argc, char *argv[]) {
+  const char *link = DEFAULT_LINK;
+  const char *initial = NULL;
+  bool is_boot_check = false;
+  bool ok;
+  uint64_t t0;
+  int opt;
+
+  winc_sim_init();
+  host_console_is_quiet = true;
+  while ((opt = getopt(argc, argv, "vbi:l:")) != -1) {
+    switch (opt) {
+    case 'v':
+      host_console_is_quiet = false;
+      break;
+    case 'b':
+      is_boot_check = true;
+      break;
+    case 'i':
+      initial = optarg;
+      break;
+    case 'l':
+      link = optarg;
+      break;
+    default:
+      fprintf(stderr,
+              "usage: %s [-v] [-b] [-i initial.img] [-l link] image.img\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if (optind != argc - 1) {
+    fprintf(stderr, "%s: give one image to check against\n", argv[0]);
+    return 2;
+  }
+  if ((initial != NULL) && !winc_sim_load(initial)) {
+    fprintf(stderr, "%s: cannot load %s\n", argv[0], initial);
+    return 1;
+  }
+  winc_cloner_init();
+  winc_cloner_set_boot_check(is_boot_check);
+  winc_bus_init();
+  trace_init();
+  if (!host_uart_open_pty(link)) {
+    return 1;
+  }
+  printf("Console UART on %s: waiting for the host\n", link);
+  fflush(stdout);
+
+  if (!await_command()) {
+    fprintf(stderr, "%s: no command from the host\n", argv[0]);
+    return 1;
+  }
+  t0 = winc_sim_now_ns();
+  ok = stream_update();
+  printf("\nstream update: %s in %.3f s, %u erases, %u programs\n",
+         ok ? "ok" : "FAILED",
+         (winc_sim_now_ns() - t0) / 1e9,
+         winc_sim_stats()->sector_erases,
+         winc_sim_stats()->page_programs);
+  printf("UART receive ring: at most %zu of %zu bytes waiting\n",
+         host_uart_high_water(),
+         SERCOM2_USART_ReadBufferSizeGet());
+  if (host_uart_dropped() > 0) {
+    printf("  the host overran the board's receive ring: %zu bytes dropped\n",
+           host_uart_dropped());
+    ok = false;
+  }
+  if (ok) {
+    ok = flash_matches(argv[optind]);
+    printf("WINC %s %s\n", ok ? "matches" : "does not match", argv[optind]);
+  }
+  unlink(link);
+  return ok ? 0 : 1;
+}
+
+// *****************************************************************************
+// Private (static) code
+
+static bool await_command(void) {
+  uint64_t start = winc_sim_now_ns();
+  uint8_t ch;
+
+  while (winc_sim_now_ns() - start < COMMAND_TIMEOUT_NS) {
+    if ((SERCOM2_USART_Read(&ch, 1) == 1) && (ch == UART_STREAM_COMMAND)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool stream_update(void) {
+  bool ok;
+
+  uart_stream_listen();
+  while (!uart_stream_is_started() && !uart_stream_has_error()) {
+    uart_stream_step();
+  }
+  ok = uart_stream_is_started() && winc_cloner_stream_update();
+  while (ok && winc_cloner_is_busy()) {
+    winc_cloner_step();
+  }
+  ok = ok && winc_cloner_is_complete();
+  uart_stream_close(ok);
+  return ok;
+}
+
+static bool flash_matches(const char *filename) {
+  FILE *f = fopen(filename, "rb");
+  size_t n_bytes;
+
+  if (f == NULL) {
+    printf("  %s: cannot open\n", filename);
+    return false;
+  }
+  memset(s_image, 0xff, sizeof(s_image));
+  n_bytes = fread(s_image, 1, sizeof(s_image), f);
+  fclose(f);
+  for (size_t addr = 0; addr < n_bytes; addr++) {
+    if ((flash_region_find(addr) != FLASH_REGION_PLL_GAIN) &&
+        (winc_sim_flash()[addr] != s_image[addr])) {
+      printf("  WINC differs from %s at 0x%zx\n", filename, addr);
+      return false;
+    }
+  }
+  return true;
+}
+
+// *****************************************************************************
+// End of file